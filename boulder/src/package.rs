@@ -5,7 +5,6 @@ use std::{io, num::NonZeroU64};
 
 use fs_err as fs;
 use itertools::Itertools;
-use stone::StoneDigestWriterHasher;
 use thiserror::Error;
 
 use moss::util;
@@ -59,21 +58,15 @@ impl<'a> Packager<'a> {
     }
 
     pub fn package(&self, timing: &mut Timing) -> Result<(), Error> {
-        // Hasher used for calculating file digests
-        let mut hasher = StoneDigestWriterHasher::new();
-
         let timer = timing.begin(timing::Kind::Analyze);
 
         // Collect all paths under install root
-        let paths = self
-            .collector
-            .enumerate_paths(None, &mut hasher)
-            .map_err(Error::CollectPaths)?;
+        let paths = self.collector.enumerate_paths(None).map_err(Error::CollectPaths)?;
 
         // Process all paths with the analysis chain
         // This will determine which files get included
         // and what deps / provides they produce
-        let mut analysis = analysis::Chain::new(self.paths, self.recipe, &self.collector, &mut hasher);
+        let mut analysis = analysis::Chain::new(self.paths, self.recipe, &self.collector);
         analysis.process(paths).map_err(Error::Analysis)?;
 
         timing.finish(timer);
@@ -1,13 +1,11 @@
 // SPDX-FileCopyrightText: 2024 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
 
-use std::collections::BTreeMap;
-use std::{
-    collections::{BTreeSet, VecDeque},
-    path::PathBuf,
-};
+use std::collections::{BTreeMap, HashMap};
+use std::{collections::BTreeSet, path::PathBuf};
 
 use moss::{Dependency, Provider};
+use rayon::iter::{IntoParallelIterator as _, ParallelIterator as _};
 use stone::StoneDigestWriterHasher;
 use tui::{ProgressBar, ProgressStyle, Styled};
 
@@ -24,17 +22,11 @@ pub struct Chain<'a> {
     recipe: &'a Recipe,
     paths: &'a Paths,
     collector: &'a Collector,
-    hasher: &'a mut StoneDigestWriterHasher,
     pub buckets: BTreeMap<String, Bucket>,
 }
 
 impl<'a> Chain<'a> {
-    pub fn new(
-        paths: &'a Paths,
-        recipe: &'a Recipe,
-        collector: &'a Collector,
-        hasher: &'a mut StoneDigestWriterHasher,
-    ) -> Self {
+    pub fn new(paths: &'a Paths, recipe: &'a Recipe, collector: &'a Collector) -> Self {
         Self {
             handlers: vec![
                 Box::new(handler::ignore_blocked),
@@ -50,15 +42,20 @@ impl<'a> Chain<'a> {
             paths,
             recipe,
             collector,
-            hasher,
             buckets: Default::default(),
         }
     }
 
+    /// Run every path through the handlers & sort the results into buckets
+    ///
+    /// Paths are analyzed in parallel, then merged into their buckets in the
+    /// order they were given. Paths generated along the way are analyzed in
+    /// a following round, so the buckets end up exactly as if every path was
+    /// taken one at a time from a queue that generated paths are appended to.
     pub fn process(&mut self, paths: impl IntoIterator<Item = PathInfo>) -> Result<(), BoxError> {
         println!("│Analyzing artefacts (» = Include, × = Ignore, ^ = Replace)");
 
-        let mut queue = paths.into_iter().collect::<VecDeque<_>>();
+        let mut queue = paths.into_iter().collect::<Vec<_>>();
 
         let pb = ProgressBar::new(queue.len() as u64)
             .with_message("Analyzing")
@@ -69,35 +66,28 @@ impl<'a> Chain<'a> {
             );
         pb.tick();
 
-        'paths: while let Some(mut path) = queue.pop_front() {
-            let bucket = self.buckets.entry(path.package.clone()).or_default();
+        while !queue.is_empty() {
+            let analyzed = self.analyze(queue, &pb);
+            queue = vec![];
 
-            pb.set_message(format!("Analyzing {}", path.target_path.display()));
+            for analyzed in analyzed {
+                let Analyzed {
+                    path,
+                    outcome,
+                    providers,
+                    dependencies,
+                    generated_paths,
+                } = analyzed?;
 
-            'handlers: for handler in &self.handlers {
-                // Only give handlers ability to update
-                // certain bucket fields
-                let mut bucket_mut = BucketMut {
-                    providers: &mut bucket.providers,
-                    dependencies: &mut bucket.dependencies,
-                    hasher: self.hasher,
-                    recipe: self.recipe,
-                    paths: self.paths,
-                };
+                let bucket = self.buckets.entry(path.package.clone()).or_default();
+                bucket.providers.extend(providers);
+                bucket.dependencies.extend(dependencies);
 
-                let response = handler.handle(&mut bucket_mut, &mut path)?;
+                queue.extend(generated_paths);
 
-                response.generated_paths.into_iter().try_for_each(|path| {
-                    let info = self.collector.path(&path, self.hasher)?;
-
-                    queue.push_back(info);
-
-                    Ok(()) as Result<(), BoxError>
-                })?;
-
-                match response.decision {
-                    Decision::NextHandler => continue 'handlers,
-                    Decision::IgnoreFile { reason } => {
+                match outcome {
+                    None => {}
+                    Some(Outcome::Ignore { reason }) => {
                         pb.suspend(|| {
                             println!(
                                 "│A{} {} {}",
@@ -106,26 +96,19 @@ impl<'a> Chain<'a> {
                                 format!("({reason})").yellow()
                             );
                         });
-                        pb.inc(1);
-                        continue 'paths;
                     }
-                    Decision::IncludeFile => {
+                    Some(Outcome::Include) => {
                         pb.suspend(|| println!("│A{} {}", "│ »".green(), path.target_path.display()));
-                        pb.inc(1);
                         bucket.paths.push(path);
-                        continue 'paths;
                     }
-                    Decision::ReplaceFile { newpath } => {
-                        let newpathinfo = self.collector.path(&newpath, self.hasher)?;
+                    Some(Outcome::Replace(newpathinfo)) => {
                         pb.println(format!(
                             "│A{} {} » {}",
                             "│ ^".dark_magenta(),
                             format!("{}", path.target_path.display()).dim(),
                             newpathinfo.target_path.display()
                         ));
-                        pb.inc(1);
                         bucket.paths.push(newpathinfo);
-                        continue 'paths;
                     }
                 }
             }
@@ -136,6 +119,116 @@ impl<'a> Chain<'a> {
 
         Ok(())
     }
+
+    /// Analyze `paths` in parallel, returning the results in the same order
+    fn analyze(&self, paths: Vec<PathInfo>, pb: &ProgressBar) -> Vec<Result<Analyzed, BoxError>> {
+        // Paths with the same contents are analyzed in order by the same worker, so
+        // hard links are never stripped at once & only the first copy of a binary
+        // splits out the debug info they share
+        let mut groups = vec![];
+        let mut group_of_hash = HashMap::new();
+
+        for (index, path) in paths.into_iter().enumerate() {
+            let group = match path.file_hash() {
+                Some(hash) => *group_of_hash.entry(hash).or_insert_with(|| {
+                    groups.push(vec![]);
+                    groups.len() - 1
+                }),
+                None => {
+                    groups.push(vec![]);
+                    groups.len() - 1
+                }
+            };
+            groups[group].push((index, path));
+        }
+
+        let mut analyzed = groups
+            .into_par_iter()
+            .map_init(StoneDigestWriterHasher::new, |hasher, group| {
+                group
+                    .into_iter()
+                    .map(|(index, path)| (index, self.analyze_path(path, hasher, pb)))
+                    .collect::<Vec<_>>()
+            })
+            .flatten()
+            .collect::<Vec<_>>();
+
+        analyzed.sort_unstable_by_key(|(index, _)| *index);
+        analyzed.into_iter().map(|(_, analyzed)| analyzed).collect()
+    }
+
+    /// Run `path` through each handler until one decides what to do with it
+    fn analyze_path(
+        &self,
+        mut path: PathInfo,
+        hasher: &mut StoneDigestWriterHasher,
+        pb: &ProgressBar,
+    ) -> Result<Analyzed, BoxError> {
+        pb.set_message(format!("Analyzing {}", path.target_path.display()));
+
+        let mut providers = BTreeSet::new();
+        let mut dependencies = BTreeSet::new();
+        let mut generated_paths = vec![];
+
+        for handler in &self.handlers {
+            // Only give handlers ability to update
+            // certain bucket fields
+            let mut bucket_mut = BucketMut {
+                providers: &mut providers,
+                dependencies: &mut dependencies,
+                hasher,
+                recipe: self.recipe,
+                paths: self.paths,
+            };
+
+            let response = handler.handle(&mut bucket_mut, &mut path)?;
+
+            for generated_path in response.generated_paths {
+                generated_paths.push(self.collector.path(&generated_path, hasher)?);
+            }
+
+            let outcome = match response.decision {
+                Decision::NextHandler => continue,
+                Decision::IgnoreFile { reason } => Outcome::Ignore { reason },
+                Decision::IncludeFile => Outcome::Include,
+                Decision::ReplaceFile { newpath } => Outcome::Replace(self.collector.path(&newpath, hasher)?),
+            };
+
+            pb.inc(1);
+
+            return Ok(Analyzed {
+                path,
+                outcome: Some(outcome),
+                providers,
+                dependencies,
+                generated_paths,
+            });
+        }
+
+        Ok(Analyzed {
+            path,
+            outcome: None,
+            providers,
+            dependencies,
+            generated_paths,
+        })
+    }
+}
+
+/// Result of running a path through the handlers, before it's merged into its bucket
+struct Analyzed {
+    path: PathInfo,
+    /// `None` if every handler passed on it
+    outcome: Option<Outcome>,
+    providers: BTreeSet<Provider>,
+    dependencies: BTreeSet<Dependency>,
+    generated_paths: Vec<PathInfo>,
+}
+
+enum Outcome {
+    Ignore { reason: String },
+    Include,
+    Replace(PathInfo),
 }
 
 #[derive(Debug, Default)]
@@ -187,13 +280,13 @@ impl From<Decision> for Response {
     }
 }
 
-pub trait Handler {
+pub trait Handler: Send + Sync {
     fn handle(&self, bucket: &mut BucketMut<'_>, path: &mut PathInfo) -> Result<Response, BoxError>;
 }
 
 impl<T> Handler for T
 where
-    T: Fn(&mut BucketMut<'_>, &mut PathInfo) -> Result<Response, BoxError>,
+    T: Fn(&mut BucketMut<'_>, &mut PathInfo) -> Result<Response, BoxError> + Send + Sync,
 {
     fn handle(&self, bucket: &mut BucketMut<'_>, path: &mut PathInfo) -> Result<Response, BoxError> {
         (self)(bucket, path)
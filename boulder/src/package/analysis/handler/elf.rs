@@ -3,21 +3,24 @@
 
 use std::{
     ffi::CStr,
+    io,
     path::{Path, PathBuf},
     process::Command,
 };
 
 use elf::{
+    ElfBytes,
     abi::{DT_NEEDED, DT_RPATH, DT_RUNPATH, DT_SONAME},
     endian::AnyEndian,
     file::Class,
     note::Note,
+    section::SectionHeader,
     to_str,
 };
 use fs_err::File;
 use path_clean::clean;
 
-use moss::{Dependency, Provider, dependency, util};
+use moss::{Dependency, Provider, dependency, util, util::Mapping};
 use stone_recipe::tuning::Toolchain;
 
 use crate::package::{
@@ -35,20 +38,30 @@ pub fn elf(bucket: &mut BucketMut<'_>, info: &mut PathInfo) -> Result<Response,
         return Ok(Decision::NextHandler.into());
     }
 
-    let Ok(mut elf) = parse_elf(&info.path) else {
+    let Ok(mapping) = map_file(&info.path) else {
         return Ok(Decision::NextHandler.into());
     };
 
-    let machine_isa = to_str::e_machine_to_str(elf.ehdr.e_machine)
-        .map(|s| s.strip_prefix("EM_").unwrap_or(s))
-        .unwrap_or_default()
-        .to_lowercase();
-    let bit_size = elf.ehdr.class;
+    // Parsed in place, the mapping is dropped before anything rewrites the file
+    let (bit_size, build_id, is_stripped) = {
+        let Ok(elf) = ElfBytes::<AnyEndian>::minimal_parse(mapping.as_slice()) else {
+            return Ok(Decision::NextHandler.into());
+        };
 
-    parse_dynamic_section(&mut elf, bucket, &machine_isa, bit_size, info, file_name);
-    parse_interp_section(&mut elf, bucket, &machine_isa);
+        let machine_isa = to_str::e_machine_to_str(elf.ehdr.e_machine)
+            .map(|s| s.strip_prefix("EM_").unwrap_or(s))
+            .unwrap_or_default()
+            .to_lowercase();
+        let bit_size = elf.ehdr.class;
 
-    let build_id = parse_build_id(&mut elf);
+        let sections = Sections::scan(&elf);
+
+        parse_dynamic_section(&elf, bucket, &machine_isa, bit_size, info, file_name);
+        parse_interp_section(&elf, &sections, bucket, &machine_isa);
+
+        (bit_size, parse_build_id(&elf, &sections), sections.is_stripped())
+    };
+    drop(mapping);
 
     let mut generated_paths = vec![];
 
@@ -65,7 +78,8 @@ pub fn elf(bucket: &mut BucketMut<'_>, info: &mut PathInfo) -> Result<Response,
             }
         }
 
-        if let Err(err) = strip(bucket, info) {
+        // Nothing left for strip to remove
+        if !is_stripped && let Err(err) = strip(bucket, info) {
             // TODO: Error logging
             eprintln!("error stripping {}: {err}", info.path.display());
         }
@@ -80,13 +94,56 @@ pub fn elf(bucket: &mut BucketMut<'_>, info: &mut PathInfo) -> Result<Response,
     })
 }
 
-fn parse_elf(path: &Path) -> Result<elf::ElfStream<AnyEndian, File>, BoxError> {
+/// Map in the file at `path`, which must not be modified until the mapping is dropped
+fn map_file(path: &Path) -> io::Result<Mapping> {
     let file = File::open(path)?;
-    Ok(elf::ElfStream::open_stream(file)?)
+    // SAFETY: Build output is only rewritten by `split_debug` & `strip`, which
+    // `elf` runs once the mapping is dropped
+    unsafe { Mapping::new(file.file()) }
+}
+
+/// Sections of interest, found in a single pass over the section headers
+#[derive(Debug, Default)]
+struct Sections {
+    interp: Option<SectionHeader>,
+    build_id: Option<SectionHeader>,
+    has_symbols: bool,
+    has_debug_info: bool,
+}
+
+impl Sections {
+    fn scan(elf: &ElfBytes<'_, AnyEndian>) -> Self {
+        let mut sections = Self::default();
+
+        let Ok((Some(headers), Some(strtab))) = elf.section_headers_with_strtab() else {
+            return sections;
+        };
+
+        for header in headers.iter() {
+            let Ok(name) = strtab.get(header.sh_name as usize) else {
+                continue;
+            };
+
+            match name {
+                ".interp" => sections.interp = Some(header),
+                ".note.gnu.build-id" => sections.build_id = Some(header),
+                ".symtab" => sections.has_symbols = true,
+                _ if name.starts_with(".debug_") || name.starts_with(".zdebug_") => sections.has_debug_info = true,
+                _ => {}
+            }
+        }
+
+        sections
+    }
+
+    /// Neither a symbol table nor debug info, as left by a previous strip
+    fn is_stripped(&self) -> bool {
+        !self.has_symbols && !self.has_debug_info
+    }
 }
 
 fn parse_dynamic_section(
-    elf: &mut elf::ElfStream<AnyEndian, File>,
+    elf: &ElfBytes<'_, AnyEndian>,
     bucket: &mut BucketMut<'_>,
     machine_isa: &str,
     bit_size: Class,
@@ -254,8 +311,13 @@ fn parse_dynamic_section(
     }
 }
 
-fn parse_interp_section(elf: &mut elf::ElfStream<AnyEndian, File>, bucket: &mut BucketMut<'_>, machine_isa: &str) {
-    let Some(section) = elf.section_header_by_name(".interp").ok().flatten().copied() else {
+fn parse_interp_section(
+    elf: &ElfBytes<'_, AnyEndian>,
+    sections: &Sections,
+    bucket: &mut BucketMut<'_>,
+    machine_isa: &str,
+) {
+    let Some(section) = sections.interp else {
         return;
     };
 
@@ -271,8 +333,8 @@ fn parse_interp_section(elf: &mut elf::ElfStream<AnyEndian, File>, bucket: &mut
     }
 }
 
-fn parse_build_id(elf: &mut elf::ElfStream<AnyEndian, File>) -> Option<String> {
-    let section = *elf.section_header_by_name(".note.gnu.build-id").ok()??;
+fn parse_build_id(elf: &ElfBytes<'_, AnyEndian>, sections: &Sections) -> Option<String> {
+    let section = sections.build_id?;
     let notes = elf.section_data_as_notes(&section).ok()?;
 
     for note in notes {
@@ -3,7 +3,7 @@
 use std::{
     ffi::OsStr,
     fs::Metadata,
-    io,
+    io::{self, Read as _},
     os::unix::fs::{FileTypeExt, MetadataExt},
     path::{Path, PathBuf},
 };
@@ -12,8 +12,12 @@ use astr::AStr;
 use fs_err as fs;
 use glob::Pattern;
 use nix::libc::{S_IFDIR, S_IRGRP, S_IROTH, S_IRWXU, S_IXGRP, S_IXOTH};
+use rayon::iter::{IntoParallelIterator as _, ParallelIterator as _};
 use snafu::{ResultExt as _, Snafu};
-use stone::{StoneDigestWriter, StoneDigestWriterHasher, StonePayloadLayoutFile, StonePayloadLayoutRecord};
+use stone::{StoneDigestWriterHasher, StonePayloadLayoutFile, StonePayloadLayoutRecord};
+
+/// Read buffer used while hashing, files smaller than this are read in one go
+const READ_BUFFER_SIZE: usize = 1024 * 1024;
 
 #[derive(Debug, Clone, Eq, PartialEq)]
 pub struct Rule {
@@ -91,13 +95,20 @@ impl Collector {
     }
 
     /// Enumerates all paths from the filesystem starting at root or subdir of root, if provided
-    pub fn enumerate_paths(
-        &self,
-        subdir: Option<(PathBuf, Metadata)>,
-        hasher: &mut StoneDigestWriterHasher,
-    ) -> Result<Vec<PathInfo>, Error> {
-        let mut paths = vec![];
+    ///
+    /// Directories are walked & files hashed in parallel, each worker using its own
+    /// hasher. Paths are returned in the same sorted, depth first order as a serial walk.
+    pub fn enumerate_paths(&self, subdir: Option<(PathBuf, Metadata)>) -> Result<Vec<PathInfo>, Error> {
+        self.enumerate_entries(subdir)?
+            .into_par_iter()
+            .map_init(StoneDigestWriterHasher::new, |hasher, (path, metadata)| {
+                self.path_with_metadata(path, &metadata, hasher)
+            })
+            .collect()
+    }
 
+    /// Walks root or subdir of root, returning each path to collect along with its metadata
+    fn enumerate_entries(&self, subdir: Option<(PathBuf, Metadata)>) -> Result<Vec<(PathBuf, Metadata)>, Error> {
         let dir = subdir.as_ref().map(|t| t.0.as_path()).unwrap_or(&self.root);
         let mut entries: Vec<_> = fs::read_dir(dir)
             .context(IoSnafu)?
@@ -106,17 +117,23 @@ impl Collector {
 
         entries.sort_by_key(|entry| entry.file_name());
 
-        for entry in entries {
-            let metadata = entry.metadata().context(IoSnafu)?;
+        let mut paths = entries
+            .into_par_iter()
+            .map(|entry| {
+                let metadata = entry.metadata().context(IoSnafu)?;
 
-            let host_path = entry.path();
+                let host_path = entry.path();
 
-            if metadata.is_dir() {
-                paths.extend(self.enumerate_paths(Some((host_path, metadata)), hasher)?);
-            } else {
-                paths.push(self.path_with_metadata(host_path, &metadata, hasher)?);
-            }
-        }
+                if metadata.is_dir() {
+                    self.enumerate_entries(Some((host_path, metadata)))
+                } else {
+                    Ok(vec![(host_path, metadata)])
+                }
+            })
+            .collect::<Result<Vec<_>, _>>()?
+            .into_iter()
+            .flatten()
+            .collect::<Vec<_>>();
 
         // Include empty or special dir
         //
@@ -128,7 +145,7 @@ impl Collector {
             let is_special = meta.mode() != REGULAR_DIR_MODE;
 
             if meta.is_dir() && (paths.is_empty() || is_special) {
-                paths.push(self.path_with_metadata(dir, &meta, hasher)?);
+                paths.push((dir, meta));
             }
         }
 
@@ -232,22 +249,33 @@ fn layout_from_metadata(
         } else if file_type.is_socket() {
             StonePayloadLayoutFile::Socket(target)
         } else {
-            hasher.reset();
-
-            let mut digest_writer = StoneDigestWriter::new(io::sink(), hasher);
-            let mut file = fs::File::open(path).context(IoSnafu)?;
-
-            // Copy bytes to null sink so we don't
-            // explode memory
-            io::copy(&mut file, &mut digest_writer).context(IoSnafu)?;
-
-            let hash = hasher.digest128();
+            let hash = hash_file(path, metadata.size(), hasher).context(IoSnafu)?;
 
             StonePayloadLayoutFile::Regular(hash, target)
         },
     })
 }
 
+/// Hash the file at `path` of `len` bytes, reading large files
+/// in big chunks rather than [`io::copy`]'s small buffer
+fn hash_file(path: &Path, len: u64, hasher: &mut StoneDigestWriterHasher) -> io::Result<u128> {
+    let mut file = fs::File::open(path)?;
+    let mut buffer = vec![0; (len as usize).clamp(1, READ_BUFFER_SIZE)];
+
+    hasher.reset();
+
+    loop {
+        match file.read(&mut buffer) {
+            Ok(0) => break,
+            Ok(read) => hasher.update(&buffer[..read]),
+            Err(error) if error.kind() == io::ErrorKind::Interrupted => continue,
+            Err(error) => return Err(error),
+        }
+    }
+
+    Ok(hasher.digest128())
+}
+
 #[derive(Debug, Snafu)]
 pub enum Error {
     #[snafu(display("no matching path rule"))]
@@ -4,6 +4,7 @@ use std::{
     io::{self, Write},
     num::NonZeroU64,
     path::PathBuf,
+    sync::Mutex,
     time::Duration,
 };
 
@@ -13,10 +14,10 @@ use moss::{Dependency, Provider, package::Meta, util};
 use regex::Regex;
 use snafu::{ResultExt, Snafu};
 use stone::{StoneHeaderV1FileType, StoneWriteError, StoneWriter};
-use tui::{ProgressBar, ProgressStyle, Styled};
+use tui::{MultiProgress, ProgressBar, ProgressStyle, Styled};
 
 use self::manifest::Manifest;
-use super::analysis;
+use super::{analysis, collect::PathInfo};
 use crate::{Architecture, Paths, Recipe, architecture};
 
 mod manifest;
@@ -186,9 +187,47 @@ pub fn emit(paths: &Paths, recipe: &Recipe, packages: &[Package<'_>]) -> Result<
 
     println!("Packaging");
 
-    for package in packages {
-        emit_package(paths, package)?;
-    }
+    // Largest first, so the biggest package (usually -dbginfo) isn't
+    // left compressing on its own once the others are done
+    let packages = packages
+        .iter()
+        .map(|package| (package_files(package), package))
+        .sorted_by_key(|(files, _)| files.iter().map(|info| info.size).sum::<u64>())
+        .rev()
+        .collect::<Vec<_>>();
+
+    let total_size = packages
+        .iter()
+        .flat_map(|(files, _)| files.iter().map(|info| info.size))
+        .sum::<u64>()
+        .max(1);
+    let num_cpus = util::num_cpus().get() as u64;
+
+    let multi_progress = MultiProgress::new();
+    let results = Mutex::new(vec![]);
+
+    // Packages are emitted concurrently, splitting the zstd workers between
+    // them by size rather than each one spinning up a worker per cpu
+    rayon::scope_fifo(|scope| {
+        for (files, package) in &packages {
+            let size = files.iter().map(|info| info.size).sum::<u64>();
+            let num_workers = (num_cpus * size / total_size).max(1) as u32;
+
+            let multi_progress = &multi_progress;
+            let results = &results;
+
+            scope.spawn_fifo(move |_| {
+                let result = emit_package(paths, package, files, num_workers, multi_progress);
+                results.lock().unwrap_or_else(|e| e.into_inner()).push(result);
+            });
+        }
+    });
+
+    results
+        .into_inner()
+        .unwrap_or_else(|e| e.into_inner())
+        .into_iter()
+        .collect::<Result<(), _>>()?;
 
     if emit_manifests {
         manifest.write_binary().context(ManifestSnafu)?;
@@ -200,11 +239,10 @@ pub fn emit(paths: &Paths, recipe: &Recipe, packages: &[Package<'_>]) -> Result<
     Ok(())
 }
 
-fn emit_package(paths: &Paths, package: &Package<'_>) -> Result<(), Error> {
-    let filename = package.filename();
-
+/// Files making up the content payload of `package`
+fn package_files<'a>(package: &'a Package<'_>) -> Vec<&'a PathInfo> {
     // Filter for all files -> dedupe by hash -> sort largest to smallest
-    let files = package
+    package
         .analysis
         .paths
         .iter()
@@ -215,17 +253,29 @@ fn emit_package(paths: &Paths, package: &Package<'_>) -> Result<(), Error> {
         // Sort largest to smallest
         .sorted_by(|(_, a), (_, b)| a.size.cmp(&b.size).reverse())
         .map(|(_, info)| info)
-        .collect::<Vec<_>>();
+        .collect()
+}
+
+fn emit_package(
+    paths: &Paths,
+    package: &Package<'_>,
+    files: &[&PathInfo],
+    num_workers: u32,
+    multi_progress: &MultiProgress,
+) -> Result<(), Error> {
+    let filename = package.filename();
 
     let total_file_size = files.iter().map(|info| info.size).sum();
 
-    let pb = ProgressBar::new(total_file_size)
-        .with_message(format!("Generating {filename}"))
-        .with_style(
-            ProgressStyle::with_template(" {spinner} |{percent:>3}%| {wide_msg} {binary_bytes_per_sec:>.dim} ")
-                .unwrap()
-                .tick_chars("--=≡■≡=--"),
-        );
+    let pb = multi_progress.add(
+        ProgressBar::new(total_file_size)
+            .with_message(format!("Generating {filename}"))
+            .with_style(
+                ProgressStyle::with_template(" {spinner} |{percent:>3}%| {wide_msg} {binary_bytes_per_sec:>.dim} ")
+                    .unwrap()
+                    .tick_chars("--=≡■≡=--"),
+            ),
+    );
     pb.enable_steady_tick(Duration::from_millis(150));
 
     // Output file to artefacts directory
@@ -272,7 +322,7 @@ fn emit_package(paths: &Paths, package: &Package<'_>) -> Result<(), Error> {
 
         // Convert to content writer using pledged size = total size of all files
         let mut writer = writer
-            .with_content(&mut temp_content, Some(total_file_size), util::num_cpus().get() as u32)
+            .with_content(&mut temp_content, Some(total_file_size), num_workers)
             .context(StoneBinaryWriterSnafu)?;
 
         for info in files {
@@ -294,8 +344,9 @@ fn emit_package(paths: &Paths, package: &Package<'_>) -> Result<(), Error> {
         out_file.flush().context(IoSnafu)?;
     }
 
-    pb.suspend(|| println!("{} {filename}", "Emitted".green()));
+    multi_progress.suspend(|| println!("{} {filename}", "Emitted".green()));
     pb.finish_and_clear();
+    multi_progress.remove(&pb);
 
     Ok(())
 }
@@ -0,0 +1,252 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+//! Reader & writer benchmarks over synthetic archives
+//!
+//! Archives are generated in the temporary directory for every combination of
+//! `STONE_BENCH_LAYOUTS`, a comma separated list of layout entry counts (`1000,100000`
+//! by default), and `STONE_BENCH_CONTENT_MIB`, a comma separated list of content sizes
+//! in MiB (`10` by default). For example, to cover 1k → 1M entries & 10 MB → 10 GB:
+//!
+//! ```sh
+//! STONE_BENCH_LAYOUTS=1000,1000000 STONE_BENCH_CONTENT_MIB=10,10240 cargo bench -p stone --bench archive
+//! ```
+//!
+//! Criterion records every result as JSON in `target/criterion/<group>/<id>/new/estimates.json`,
+//! which is what regressions are tracked against.
+
+use std::{
+    env,
+    hint::black_box,
+    io::{self, Read, Write},
+    path::PathBuf,
+    process, thread,
+};
+
+use criterion::{BatchSize, BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use fs_err::{self as fs, File};
+use stone::{
+    StoneHeaderV1FileType, StonePayloadKind, StonePayloadLayoutFile, StonePayloadLayoutRecord,
+    StonePayloadMetaPrimitive, StonePayloadMetaRecord, StonePayloadMetaTag, StoneWriteError, StoneWriter,
+};
+
+/// Content is never split into files smaller than this
+const MIN_FILE_SIZE: u64 = 4096;
+
+/// Deterministic file content, from an alphabet of 16 bytes so it compresses
+/// about 2:1 without ever repeating within the zstd window
+struct Synthetic {
+    remaining: u64,
+    state: u64,
+}
+
+impl Synthetic {
+    fn new(len: u64, seed: u64) -> Self {
+        Self {
+            remaining: len,
+            state: seed | 1,
+        }
+    }
+
+    /// xorshift64
+    fn next_random(&mut self) -> u64 {
+        self.state ^= self.state << 13;
+        self.state ^= self.state >> 7;
+        self.state ^= self.state << 17;
+        self.state
+    }
+}
+
+impl Read for Synthetic {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let len = self.remaining.min(buf.len() as u64) as usize;
+
+        for chunk in buf[..len].chunks_mut(8) {
+            let random = self.next_random().to_le_bytes();
+            for (byte, random) in chunk.iter_mut().zip(random) {
+                *byte = b'a' + (random & 0x0f);
+            }
+        }
+
+        self.remaining -= len as u64;
+        Ok(len)
+    }
+}
+
+/// Unlinked file holding compressed content until the archive is finalized
+fn scratch_file() -> File {
+    let path = env::temp_dir().join(format!("stone-bench-{}.content", process::id()));
+    let file = File::options()
+        .read(true)
+        .write(true)
+        .create(true)
+        .truncate(true)
+        .open(&path)
+        .unwrap();
+    fs::remove_file(&path).unwrap();
+    file
+}
+
+/// Write an archive of `layouts` entries referencing `content` bytes split across files
+fn write_archive<W: Write>(out: W, buffer: File, layouts: usize, content: u64) -> Result<(), StoneWriteError> {
+    let files = (layouts as u64).min((content / MIN_FILE_SIZE).max(1));
+    let num_workers = thread::available_parallelism().map_or(1, |n| n.get() as u32);
+
+    let mut writer =
+        StoneWriter::new(out, StoneHeaderV1FileType::Binary)?.with_content(buffer, Some(content), num_workers)?;
+
+    writer.add_payload(
+        [StonePayloadMetaRecord {
+            tag: StonePayloadMetaTag::Name,
+            primitive: StonePayloadMetaPrimitive::String("bench".to_owned()),
+        }]
+        .as_slice(),
+    )?;
+
+    let mut digests = Vec::with_capacity(files as usize);
+    for file in 0..files {
+        // Spread the remainder over the first files
+        let len = content / files + u64::from(file < content % files);
+        digests.push(writer.add_content(&mut Synthetic::new(len, file + 1))?.digest);
+    }
+
+    let records = (0..layouts)
+        .map(|i| {
+            let name = format!("usr/share/bench/{i}").into();
+
+            // Every file of content is installed once, the rest is a mix of
+            // directories, symlinks & duplicates
+            let (mode, file) = match i % 3 {
+                _ if i < digests.len() => (0o100644, StonePayloadLayoutFile::Regular(digests[i], name)),
+                0 => (0o40755, StonePayloadLayoutFile::Directory(name)),
+                1 => (
+                    0o120777,
+                    StonePayloadLayoutFile::Symlink(format!("{}", i - 1).into(), name),
+                ),
+                _ => (
+                    0o100644,
+                    StonePayloadLayoutFile::Regular(digests[i % digests.len()], name),
+                ),
+            };
+
+            StonePayloadLayoutRecord {
+                uid: 0,
+                gid: 0,
+                mode,
+                tag: 0,
+                file,
+            }
+        })
+        .collect::<Vec<_>>();
+    writer.add_payload(records.as_slice())?;
+
+    writer.finalize()
+}
+
+struct Archive {
+    path: PathBuf,
+    layouts: usize,
+    content: u64,
+}
+
+impl Archive {
+    fn generate(layouts: usize, content: u64) -> Self {
+        let path = env::temp_dir().join(format!("stone-bench-{}-{layouts}-{content}.stone", process::id()));
+
+        write_archive(File::create(&path).unwrap(), scratch_file(), layouts, content).unwrap();
+
+        Self { path, layouts, content }
+    }
+
+    fn label(&self) -> String {
+        format!("{}-layouts/{}-MiB", self.layouts, self.content >> 20)
+    }
+}
+
+impl Drop for Archive {
+    fn drop(&mut self) {
+        let _ = fs::remove_file(&self.path);
+    }
+}
+
+fn sizes(var: &str, default: &str) -> Vec<u64> {
+    env::var(var)
+        .unwrap_or_else(|_| default.to_owned())
+        .split(',')
+        .map(|size| {
+            size.trim()
+                .parse()
+                .unwrap_or_else(|_| panic!("{var} should be a comma separated list of numbers"))
+        })
+        .collect()
+}
+
+fn bench_archive(c: &mut Criterion, archive: &Archive) {
+    let label = archive.label();
+
+    // Header & payload table, without decoding any payload body
+    let mut group = c.benchmark_group("open");
+    group.bench_function(&label, |b| {
+        b.iter(|| {
+            let mut reader = stone::read(File::open(&archive.path).unwrap()).unwrap();
+            black_box(reader.payload_table().unwrap().len())
+        });
+    });
+    group.finish();
+
+    let mut reader = stone::read(File::open(&archive.path).unwrap()).unwrap();
+
+    let mut group = c.benchmark_group("decode");
+    for kind in [
+        StonePayloadKind::Meta,
+        StonePayloadKind::Layout,
+        StonePayloadKind::Index,
+    ] {
+        let entry = reader
+            .payload_table()
+            .unwrap()
+            .iter()
+            .find(|entry| entry.header.kind == kind)
+            .copied()
+            .unwrap();
+
+        group.throughput(Throughput::Bytes(entry.header.plain_size));
+        group.bench_function(BenchmarkId::new(kind.to_string(), &label), |b| {
+            b.iter(|| reader.decode_payload(&entry).unwrap());
+        });
+    }
+    group.finish();
+
+    let content = reader.payload_by_kind(StonePayloadKind::Content).unwrap().unwrap();
+    let content = content.content().unwrap();
+
+    let mut group = c.benchmark_group("unpack");
+    group.sample_size(10).throughput(Throughput::Bytes(archive.content));
+    group.bench_function(&label, |b| {
+        b.iter(|| reader.unpack_content(content, &mut io::sink()).unwrap());
+    });
+    group.finish();
+
+    let mut group = c.benchmark_group("write");
+    group.sample_size(10).throughput(Throughput::Bytes(archive.content));
+    group.bench_function(&label, |b| {
+        b.iter_batched(
+            scratch_file,
+            |buffer| write_archive(io::sink(), buffer, archive.layouts, archive.content).unwrap(),
+            BatchSize::PerIteration,
+        );
+    });
+    group.finish();
+}
+
+fn criterion_benchmark(c: &mut Criterion) {
+    for layouts in sizes("STONE_BENCH_LAYOUTS", "1000,100000") {
+        for mib in sizes("STONE_BENCH_CONTENT_MIB", "10") {
+            let archive = Archive::generate(layouts as usize, mib << 20);
+            bench_archive(c, &archive);
+        }
+    }
+}
+
+criterion_group!(benches, criterion_benchmark);
+criterion_main!(benches);
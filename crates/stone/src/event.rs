@@ -0,0 +1,118 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+//! Process wide hook observing the cost of reading archives
+//!
+//! Nothing is timed until a hook is installed with [`set_event_hook`], so
+//! readers pay a single relaxed load per payload when no one is listening.
+
+use std::{
+    sync::{
+        RwLock,
+        atomic::{AtomicBool, Ordering},
+    },
+    time::{Duration, Instant},
+};
+
+use crate::StonePayloadKind;
+
+/// Work done by a reader, reported once it completes successfully
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum StoneEvent {
+    /// A record payload was read, checksummed & decoded
+    PayloadDecoded {
+        kind: StonePayloadKind,
+        stored_size: u64,
+        plain_size: u64,
+        /// Including `checksum`
+        elapsed: Duration,
+        checksum: Duration,
+    },
+    /// The content payload was decompressed & checksummed in full
+    ContentUnpacked {
+        stored_size: u64,
+        plain_size: u64,
+        /// Including `checksum`
+        elapsed: Duration,
+        checksum: Duration,
+    },
+    /// An asset of the content payload was hashed & matched its index record
+    AssetVerified { size: u64, elapsed: Duration },
+}
+
+pub type StoneEventHook = Box<dyn Fn(&StoneEvent) + Send + Sync>;
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+static HOOK: RwLock<Option<StoneEventHook>> = RwLock::new(None);
+
+/// Install `hook` to be called with every [`StoneEvent`], replacing any
+/// previous hook, or remove it with `None`
+///
+/// The hook is called from whichever thread did the work, including the
+/// worker threads of [`crate::StoneReader::unpack_content_to`].
+pub fn set_event_hook(hook: Option<StoneEventHook>) {
+    let mut current = HOOK.write().unwrap_or_else(|e| e.into_inner());
+
+    ENABLED.store(hook.is_some(), Ordering::Relaxed);
+    *current = hook;
+}
+
+pub(crate) fn enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+/// Start of the work for an event, if anyone is listening
+pub(crate) fn start() -> Option<Instant> {
+    enabled().then(Instant::now)
+}
+
+pub(crate) fn emit(event: StoneEvent) {
+    if let Some(hook) = HOOK.read().unwrap_or_else(|e| e.into_inner()).as_ref() {
+        hook(&event);
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use std::sync::{Arc, Mutex};
+
+    use super::*;
+    use crate::read_bytes;
+
+    #[test]
+    fn hook_receives_events() {
+        let events = Arc::new(Mutex::new(vec![]));
+
+        let recorded = events.clone();
+        set_event_hook(Some(Box::new(move |event| recorded.lock().unwrap().push(*event))));
+
+        let mut reader = read_bytes(include_bytes!("../../../test/bash-completion-2.11-1-1-x86_64.stone")).unwrap();
+        let payloads = reader.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+        let content = payloads.iter().find_map(|payload| payload.content()).unwrap();
+        reader.unpack_content(content, &mut std::io::sink()).unwrap();
+
+        set_event_hook(None);
+
+        let events = events.lock().unwrap();
+        let decoded = events
+            .iter()
+            .filter_map(|event| match event {
+                StoneEvent::PayloadDecoded { kind, plain_size, .. } => Some((*kind, *plain_size)),
+                _ => None,
+            })
+            .collect::<Vec<_>>();
+        let expected = payloads
+            .iter()
+            .filter(|payload| payload.content().is_none())
+            .map(|payload| (payload.header().kind, payload.header().plain_size))
+            .collect::<Vec<_>>();
+
+        // Other tests may be reading archives at the same time
+        assert!(expected.iter().all(|payload| decoded.contains(payload)));
+        assert!(events.iter().any(|event| matches!(
+            event,
+            StoneEvent::ContentUnpacked { plain_size, checksum, elapsed, .. }
+            if *plain_size == content.header.plain_size && checksum <= elapsed
+        )));
+    }
+}
@@ -1,25 +1,32 @@
 // SPDX-FileCopyrightText: 2023 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
 
+mod event;
 pub(crate) mod ext;
 mod header;
 mod payload;
 mod read;
 mod write;
 
+pub use self::event::{StoneEvent, StoneEventHook, set_event_hook};
 pub use self::header::{
     STONE_HEADER_MAGIC, StoneAgnosticHeader, StoneHeader, StoneHeaderDecodeError, StoneHeaderV1,
     StoneHeaderV1DecodeError, StoneHeaderV1FileType, StoneHeaderVersion,
 };
 pub use self::payload::{
-    StonePayload, StonePayloadAttributeRecord, StonePayloadCompression, StonePayloadContent, StonePayloadDecodeError,
-    StonePayloadEncodeError, StonePayloadHeader, StonePayloadIndexRecord, StonePayloadKind, StonePayloadLayoutFile,
-    StonePayloadLayoutFileType, StonePayloadLayoutRecord, StonePayloadMetaDependency, StonePayloadMetaPrimitive,
-    StonePayloadMetaRecord, StonePayloadMetaTag,
+    StonePayload, StonePayloadAttributeRecord, StonePayloadAttributeRecordView, StonePayloadCompression,
+    StonePayloadContent, StonePayloadDecodeError, StonePayloadEncodeError, StonePayloadFrameRecord, StonePayloadHeader,
+    StonePayloadIndexRecord, StonePayloadKind, StonePayloadLayoutFile, StonePayloadLayoutFileType,
+    StonePayloadLayoutFileView, StonePayloadLayoutRecord, StonePayloadLayoutRecordView, StonePayloadLookupKind,
+    StonePayloadLookupRecord, StonePayloadLookupRecordView, StonePayloadMetaDependency, StonePayloadMetaPrimitive,
+    StonePayloadMetaPrimitiveView, StonePayloadMetaRecord, StonePayloadMetaRecordView, StonePayloadMetaTag,
 };
 #[cfg(feature = "ffi")]
 pub use self::read::StonePayloadContentReader;
-pub use self::read::{StoneDecodedPayload, StoneReadError, StoneReader, read, read_bytes};
+pub use self::read::{
+    StoneContentSink, StoneDecodeContext, StoneDecodedPayload, StonePayloadTableEntry, StoneReadError, StoneReader,
+    StoneSlicePayload, StoneSliceReader, read, read_bytes, read_slice, read_with_context,
+};
 pub use self::write::{
     StoneContentWriter, StoneDigestWriter, StoneDigestWriterHasher, StoneWriteError, StoneWritePayload, StoneWriter,
 };
@@ -104,4 +111,122 @@ mod test {
             out_stone.len()
         );
     }
+
+    #[test]
+    fn seekable_content() {
+        let mut reader = read_bytes(include_bytes!("../../../test/bash-completion-2.11-1-1-x86_64.stone")).unwrap();
+
+        let payloads = reader.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+        let indices = payloads.iter().find_map(StoneDecodedPayload::index).unwrap();
+        let content = payloads.iter().find_map(StoneDecodedPayload::content).unwrap();
+
+        let mut content_buffer = vec![];
+        reader.unpack_content(content, &mut content_buffer).unwrap();
+
+        let mut out_stone = vec![];
+        let mut temp_content_buffer: Vec<u8> = vec![];
+        let mut writer = StoneWriter::new(&mut out_stone, StoneHeaderV1FileType::Binary)
+            .unwrap()
+            .with_seekable_content(Cursor::new(&mut temp_content_buffer), 16 * 1024, 1)
+            .unwrap();
+
+        for index in &indices.body {
+            let mut bytes = &content_buffer[index.start as usize..index.end as usize];
+
+            writer.add_content(&mut bytes).unwrap();
+        }
+
+        writer.finalize().unwrap();
+
+        let mut rt_reader = read_bytes(&out_stone).unwrap();
+        let rt_payloads = rt_reader.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+        let rt_frames = rt_payloads.iter().find_map(StoneDecodedPayload::frames).unwrap();
+        let rt_content = rt_payloads.iter().find_map(StoneDecodedPayload::content).unwrap();
+
+        assert!(rt_frames.body.len() > 1);
+        assert_eq!(rt_frames.body.last().unwrap().plain_end, rt_content.header.plain_size);
+        assert_eq!(rt_frames.body.last().unwrap().stored_end, rt_content.header.stored_size);
+
+        // Frames decode sequentially for readers that don't know about them
+        let mut rt_content_buffer = vec![];
+        rt_reader.unpack_content(rt_content, &mut rt_content_buffer).unwrap();
+        assert_eq!(rt_content_buffer, content_buffer);
+
+        for index in &indices.body {
+            let mut extracted = vec![];
+            rt_reader
+                .extract_range(rt_content, &rt_frames.body, index.start, index.end, &mut extracted)
+                .unwrap();
+
+            assert_eq!(extracted, content_buffer[index.start as usize..index.end as usize]);
+        }
+    }
+
+    #[test]
+    fn compression_parameters() {
+        let content = (0..64 * 1024).map(|i| (i % 251) as u8).collect::<Vec<_>>();
+
+        let mut out_stone = vec![];
+        let mut temp_content_buffer: Vec<u8> = vec![];
+        let mut writer = StoneWriter::new(&mut out_stone, StoneHeaderV1FileType::Binary).unwrap();
+        writer.set_compression_level(3).unwrap();
+        writer.set_window_log(20).unwrap();
+        writer.set_long_distance_matching(true).unwrap();
+
+        let mut writer = writer
+            .with_content(Cursor::new(&mut temp_content_buffer), None, 2)
+            .unwrap();
+        let index = writer.add_content(&mut content.as_slice()).unwrap();
+        writer.finalize().unwrap();
+
+        let mut rt_reader = read_bytes(&out_stone).unwrap();
+        let rt_payloads = rt_reader.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+        let rt_indices = rt_payloads.iter().find_map(StoneDecodedPayload::index).unwrap();
+        let rt_content = rt_payloads.iter().find_map(StoneDecodedPayload::content).unwrap();
+
+        assert_eq!(rt_content.header.num_records, 0);
+        assert_eq!(rt_indices.body, [index]);
+
+        let mut rt_content_buffer = vec![];
+        rt_reader.unpack_content(rt_content, &mut rt_content_buffer).unwrap();
+        assert_eq!(rt_content_buffer, content);
+    }
+
+    #[test]
+    fn lookup_payload() {
+        let mut reader = read_bytes(include_bytes!("../../../test/bash-completion-2.11-1-1-x86_64.stone")).unwrap();
+        let meta = reader.payload_by_kind(StonePayloadKind::Meta).unwrap().unwrap();
+        let meta = meta.meta().unwrap();
+
+        let mut out_stone = vec![];
+        let mut writer = StoneWriter::new(&mut out_stone, StoneHeaderV1FileType::Repository).unwrap();
+        let mut lookup = vec![];
+
+        for key in ["a", "b", "c"] {
+            lookup.push(StonePayloadLookupRecord {
+                offset: writer.payload_offset(),
+                kind: StonePayloadLookupKind::Name,
+                key: key.to_owned(),
+            });
+            writer.add_payload(meta.body.as_slice()).unwrap();
+        }
+
+        writer.add_payload(lookup.as_slice()).unwrap();
+        writer.finalize().unwrap();
+
+        let mut rt_reader = read_bytes(&out_stone).unwrap();
+        let rt_lookup = rt_reader.payload_by_kind(StonePayloadKind::Lookup).unwrap().unwrap();
+        let rt_lookup = rt_lookup.lookup().unwrap();
+        assert_eq!(rt_lookup.body, lookup);
+
+        let [record] = StonePayloadLookupRecord::find(&rt_lookup.body, StonePayloadLookupKind::Name, "b") else {
+            panic!("expected a single record");
+        };
+        let rt_meta = rt_reader.decode_payload_at(record.offset).unwrap();
+        assert_eq!(rt_meta.meta().unwrap().body.len(), meta.body.len());
+        assert_eq!(
+            rt_reader.payload_table().unwrap()[1].offset,
+            record.offset + StonePayloadHeader::SIZE as u64
+        );
+    }
 }
@@ -3,7 +3,7 @@
 
 use std::io::{Read, Write};
 
-use super::{Record, StonePayloadDecodeError, StonePayloadEncodeError};
+use super::{Record, RecordView, StonePayloadDecodeError, StonePayloadEncodeError, take_bytes};
 use crate::ext::{ReadExt, WriteExt};
 
 #[derive(Debug, Clone)]
@@ -12,6 +12,22 @@ pub struct StonePayloadAttributeRecord {
     pub value: Vec<u8>,
 }
 
+impl StonePayloadAttributeRecord {
+    pub fn as_view(&self) -> StonePayloadAttributeRecordView<'_> {
+        StonePayloadAttributeRecordView {
+            key: &self.key,
+            value: &self.value,
+        }
+    }
+}
+
+/// Borrowed counterpart of [`StonePayloadAttributeRecord`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct StonePayloadAttributeRecordView<'a> {
+    pub key: &'a [u8],
+    pub value: &'a [u8],
+}
+
 impl Record for StonePayloadAttributeRecord {
     fn decode<R: Read>(mut reader: R) -> Result<Self, StonePayloadDecodeError> {
         let key_length = reader.read_u64()?;
@@ -36,3 +52,15 @@ impl Record for StonePayloadAttributeRecord {
         8 + 8 + self.key.len() + self.value.len()
     }
 }
+
+impl<'a> RecordView<'a> for StonePayloadAttributeRecordView<'a> {
+    fn decode_view(bytes: &mut &'a [u8]) -> Result<Self, StonePayloadDecodeError> {
+        let key_length = bytes.read_u64()?;
+        let value_length = bytes.read_u64()?;
+
+        let key = take_bytes(bytes, key_length as usize)?;
+        let value = take_bytes(bytes, value_length as usize)?;
+
+        Ok(Self { key, value })
+    }
+}
@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+use std::io::{Read, Write};
+
+use super::{Record, RecordView, StonePayloadDecodeError, StonePayloadEncodeError};
+use crate::ext::{ReadExt, WriteExt};
+
+/// A FrameRecord (a series of sequential entries within the FramesPayload)
+/// locates one independently decodable zstd frame of a seekable ContentPayload.
+///
+/// Frames are cut on index boundaries, so any file can be extracted by only
+/// decompressing the frames overlapping its index range.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(C)]
+pub struct StonePayloadFrameRecord {
+    /// Start of the frame within the decompressed ContentPayload
+    pub plain_start: u64,
+
+    /// End pointer within the decompressed ContentPayload
+    pub plain_end: u64,
+
+    /// Start of the frame within the stored (compressed) ContentPayload
+    pub stored_start: u64,
+
+    /// End pointer within the stored (compressed) ContentPayload
+    pub stored_end: u64,
+}
+
+impl Record for StonePayloadFrameRecord {
+    fn decode<R: Read>(mut reader: R) -> Result<Self, StonePayloadDecodeError> {
+        let plain_start = reader.read_u64()?;
+        let plain_end = reader.read_u64()?;
+        let stored_start = reader.read_u64()?;
+        let stored_end = reader.read_u64()?;
+
+        Ok(Self {
+            plain_start,
+            plain_end,
+            stored_start,
+            stored_end,
+        })
+    }
+
+    fn encode<W: Write>(&self, writer: &mut W) -> Result<(), StonePayloadEncodeError> {
+        writer.write_u64(self.plain_start)?;
+        writer.write_u64(self.plain_end)?;
+        writer.write_u64(self.stored_start)?;
+        writer.write_u64(self.stored_end)?;
+        Ok(())
+    }
+
+    fn size(&self) -> usize {
+        size_of::<Self>()
+    }
+}
+
+/// Frame records hold no variable length data, so the view is the record itself
+impl RecordView<'_> for StonePayloadFrameRecord {
+    fn decode_view(bytes: &mut &[u8]) -> Result<Self, StonePayloadDecodeError> {
+        Self::decode(bytes)
+    }
+}
@@ -3,7 +3,7 @@
 
 use std::io::{Read, Write};
 
-use super::{Record, StonePayloadDecodeError, StonePayloadEncodeError};
+use super::{Record, RecordView, StonePayloadDecodeError, StonePayloadEncodeError};
 use crate::ext::{ReadExt, WriteExt};
 
 /// An IndexEntry (a series of sequential entries within the IndexPayload)
@@ -43,3 +43,10 @@ impl Record for StonePayloadIndexRecord {
         size_of::<Self>()
     }
 }
+
+/// Index records hold no variable length data, so the view is the record itself
+impl RecordView<'_> for StonePayloadIndexRecord {
+    fn decode_view(bytes: &mut &[u8]) -> Result<Self, StonePayloadDecodeError> {
+        Self::decode(bytes)
+    }
+}
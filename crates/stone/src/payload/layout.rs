@@ -1,11 +1,12 @@
 // SPDX-FileCopyrightText: 2023 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
 
-use std::io::{Read, Write};
+use std::io::{self, Read, Write};
+use std::iter;
 
 use astr::AStr;
 
-use super::{Record, StonePayloadDecodeError, StonePayloadEncodeError};
+use super::{Record, RecordView, StonePayloadDecodeError, StonePayloadEncodeError, take_bytes, take_str};
 use crate::ext::{ReadExt, WriteExt};
 
 /// Layout entries record their target file type so they can be rebuilt on
@@ -103,7 +104,153 @@ pub struct StonePayloadLayoutRecord {
     pub file: StonePayloadLayoutFile,
 }
 
-impl Record for StonePayloadLayoutRecord {
+impl StonePayloadLayoutRecord {
+    /// Encode `records` back to back, as they're stored in the body of a layout payload
+    pub fn encode_all<'a, W: Write>(
+        records: impl IntoIterator<Item = &'a Self>,
+        writer: &mut W,
+    ) -> Result<(), StonePayloadEncodeError> {
+        for record in records {
+            record.encode(writer)?;
+        }
+
+        Ok(())
+    }
+
+    pub fn as_view(&self) -> StonePayloadLayoutRecordView<'_> {
+        StonePayloadLayoutRecordView {
+            uid: self.uid,
+            gid: self.gid,
+            mode: self.mode,
+            tag: self.tag,
+            file: match &self.file {
+                StonePayloadLayoutFile::Regular(hash, target) => StonePayloadLayoutFileView::Regular(*hash, target),
+                StonePayloadLayoutFile::Symlink(source, target) => StonePayloadLayoutFileView::Symlink(source, target),
+                StonePayloadLayoutFile::Directory(target) => StonePayloadLayoutFileView::Directory(target),
+                StonePayloadLayoutFile::CharacterDevice(target) => StonePayloadLayoutFileView::CharacterDevice(target),
+                StonePayloadLayoutFile::BlockDevice(target) => StonePayloadLayoutFileView::BlockDevice(target),
+                StonePayloadLayoutFile::Fifo(target) => StonePayloadLayoutFileView::Fifo(target),
+                StonePayloadLayoutFile::Socket(target) => StonePayloadLayoutFileView::Socket(target),
+                StonePayloadLayoutFile::Unknown(source, target) => StonePayloadLayoutFileView::Unknown(source, target),
+            },
+        }
+    }
+}
+
+/// Borrowed counterpart of [`StonePayloadLayoutFile`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum StonePayloadLayoutFileView<'a> {
+    Regular(u128, &'a str),
+    Symlink(&'a str, &'a str),
+    Directory(&'a str),
+
+    // not properly supported
+    CharacterDevice(&'a str),
+    BlockDevice(&'a str),
+    Fifo(&'a str),
+    Socket(&'a str),
+
+    Unknown(&'a str, &'a str),
+}
+
+impl StonePayloadLayoutFileView<'_> {
+    pub fn target(&self) -> &str {
+        match self {
+            StonePayloadLayoutFileView::Regular(_, target)
+            | StonePayloadLayoutFileView::Symlink(_, target)
+            | StonePayloadLayoutFileView::Directory(target)
+            | StonePayloadLayoutFileView::CharacterDevice(target)
+            | StonePayloadLayoutFileView::BlockDevice(target)
+            | StonePayloadLayoutFileView::Fifo(target)
+            | StonePayloadLayoutFileView::Socket(target)
+            | StonePayloadLayoutFileView::Unknown(_, target) => target,
+        }
+    }
+
+    pub fn file_type(&self) -> StonePayloadLayoutFileType {
+        match self {
+            StonePayloadLayoutFileView::Regular(..) => StonePayloadLayoutFileType::Regular,
+            StonePayloadLayoutFileView::Symlink(..) => StonePayloadLayoutFileType::Symlink,
+            StonePayloadLayoutFileView::Directory(_) => StonePayloadLayoutFileType::Directory,
+            StonePayloadLayoutFileView::CharacterDevice(_) => StonePayloadLayoutFileType::CharacterDevice,
+            StonePayloadLayoutFileView::BlockDevice(_) => StonePayloadLayoutFileType::BlockDevice,
+            StonePayloadLayoutFileView::Fifo(_) => StonePayloadLayoutFileType::Fifo,
+            StonePayloadLayoutFileView::Socket(_) => StonePayloadLayoutFileType::Socket,
+            StonePayloadLayoutFileView::Unknown(..) => StonePayloadLayoutFileType::Unknown,
+        }
+    }
+}
+
+/// Borrowed counterpart of [`StonePayloadLayoutRecord`], decoded
+/// without copying path strings
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct StonePayloadLayoutRecordView<'a> {
+    pub uid: u32,
+    pub gid: u32,
+    pub mode: u32,
+    pub tag: u32,
+    pub file: StonePayloadLayoutFileView<'a>,
+}
+
+impl<'a> StonePayloadLayoutRecordView<'a> {
+    /// Decode every record of `bytes`, as encoded by [`StonePayloadLayoutRecord::encode_all`]
+    pub fn decode_all(mut bytes: &'a [u8]) -> impl Iterator<Item = Result<Self, StonePayloadDecodeError>> {
+        iter::from_fn(move || {
+            if bytes.is_empty() {
+                return None;
+            }
+
+            let record = Self::decode_view(&mut bytes);
+
+            // Nothing after a malformed record can be trusted
+            if record.is_err() {
+                bytes = &[];
+            }
+
+            Some(record)
+        })
+    }
+
+    pub fn to_record(&self) -> StonePayloadLayoutRecord {
+        StonePayloadLayoutRecord {
+            uid: self.uid,
+            gid: self.gid,
+            mode: self.mode,
+            tag: self.tag,
+            file: match self.file {
+                StonePayloadLayoutFileView::Regular(hash, target) => {
+                    StonePayloadLayoutFile::Regular(hash, target.into())
+                }
+                StonePayloadLayoutFileView::Symlink(source, target) => {
+                    StonePayloadLayoutFile::Symlink(source.into(), target.into())
+                }
+                StonePayloadLayoutFileView::Directory(target) => StonePayloadLayoutFile::Directory(target.into()),
+                StonePayloadLayoutFileView::CharacterDevice(target) => {
+                    StonePayloadLayoutFile::CharacterDevice(target.into())
+                }
+                StonePayloadLayoutFileView::BlockDevice(target) => StonePayloadLayoutFile::BlockDevice(target.into()),
+                StonePayloadLayoutFileView::Fifo(target) => StonePayloadLayoutFile::Fifo(target.into()),
+                StonePayloadLayoutFileView::Socket(target) => StonePayloadLayoutFile::Socket(target.into()),
+                StonePayloadLayoutFileView::Unknown(source, target) => {
+                    StonePayloadLayoutFile::Unknown(source.into(), target.into())
+                }
+            },
+        }
+    }
+}
+
+/// Fixed size portion of an encoded layout record
+struct Prelude {
+    uid: u32,
+    gid: u32,
+    mode: u32,
+    tag: u32,
+    source_length: u16,
+    target_length: u16,
+    file_type: StonePayloadLayoutFileType,
+}
+
+impl Prelude {
     fn decode<R: Read>(mut reader: R) -> Result<Self, StonePayloadDecodeError> {
         let uid = reader.read_u32()?;
         let gid = reader.read_u32()?;
@@ -112,9 +259,6 @@ impl Record for StonePayloadLayoutRecord {
 
         let source_length = reader.read_u16()?;
         let target_length = reader.read_u16()?;
-        fn sanitize(s: &str) -> &str {
-            s.trim_end_matches('\0')
-        }
 
         let file_type = match reader.read_u8()? {
             1 => StonePayloadLayoutFileType::Regular,
@@ -129,6 +273,38 @@ impl Record for StonePayloadLayoutRecord {
 
         let _padding = reader.read_array_::<11>()?;
 
+        Ok(Self {
+            uid,
+            gid,
+            mode,
+            tag,
+            source_length,
+            target_length,
+            file_type,
+        })
+    }
+}
+
+fn sanitize(s: &str) -> &str {
+    s.trim_end_matches('\0')
+}
+
+fn take_sanitized<'a>(bytes: &mut &'a [u8], length: u16) -> io::Result<&'a str> {
+    take_str(bytes, length as usize).map(sanitize)
+}
+
+impl Record for StonePayloadLayoutRecord {
+    fn decode<R: Read>(mut reader: R) -> Result<Self, StonePayloadDecodeError> {
+        let Prelude {
+            uid,
+            gid,
+            mode,
+            tag,
+            source_length,
+            target_length,
+            file_type,
+        } = Prelude::decode(&mut reader)?;
+
         // Make the layout entry *usable*
         let entry = match file_type {
             StonePayloadLayoutFileType::Regular => {
@@ -193,3 +369,57 @@ impl Record for StonePayloadLayoutRecord {
         4 + 4 + 4 + 4 + 2 + 2 + 1 + 11 + self.file.source().len() + self.file.target().len()
     }
 }
+
+impl<'a> RecordView<'a> for StonePayloadLayoutRecordView<'a> {
+    fn decode_view(bytes: &mut &'a [u8]) -> Result<Self, StonePayloadDecodeError> {
+        let Prelude {
+            uid,
+            gid,
+            mode,
+            tag,
+            source_length,
+            target_length,
+            file_type,
+        } = Prelude::decode(&mut *bytes)?;
+
+        let file = match file_type {
+            StonePayloadLayoutFileType::Regular => {
+                let hash = u128::from_be_bytes(
+                    take_bytes(bytes, source_length as usize)?
+                        .try_into()
+                        .map_err(|_| io::Error::from(io::ErrorKind::InvalidData))?,
+                );
+                StonePayloadLayoutFileView::Regular(hash, take_sanitized(bytes, target_length)?)
+            }
+            StonePayloadLayoutFileType::Symlink => StonePayloadLayoutFileView::Symlink(
+                take_sanitized(bytes, source_length)?,
+                take_sanitized(bytes, target_length)?,
+            ),
+            StonePayloadLayoutFileType::Directory => {
+                StonePayloadLayoutFileView::Directory(take_sanitized(bytes, target_length)?)
+            }
+            StonePayloadLayoutFileType::CharacterDevice => {
+                StonePayloadLayoutFileView::CharacterDevice(take_sanitized(bytes, target_length)?)
+            }
+            StonePayloadLayoutFileType::BlockDevice => {
+                StonePayloadLayoutFileView::BlockDevice(take_sanitized(bytes, target_length)?)
+            }
+            StonePayloadLayoutFileType::Fifo => StonePayloadLayoutFileView::Fifo(take_sanitized(bytes, target_length)?),
+            StonePayloadLayoutFileType::Socket => {
+                StonePayloadLayoutFileView::Socket(take_sanitized(bytes, target_length)?)
+            }
+            StonePayloadLayoutFileType::Unknown => StonePayloadLayoutFileView::Unknown(
+                take_sanitized(bytes, source_length)?,
+                take_sanitized(bytes, target_length)?,
+            ),
+        };
+
+        Ok(Self {
+            uid,
+            gid,
+            mode,
+            tag,
+            file,
+        })
+    }
+}
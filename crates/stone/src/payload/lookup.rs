@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+use std::io::{Read, Write};
+
+use super::{Record, RecordView, StonePayloadDecodeError, StonePayloadEncodeError, take_str};
+use crate::ext::{ReadExt, WriteExt};
+
+/// What the key of a [`StonePayloadLookupRecord`] identifies
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, strum::Display)]
+#[strum(serialize_all = "kebab-case")]
+#[repr(u8)]
+pub enum StonePayloadLookupKind {
+    /// Package name
+    Name = 1,
+    /// Provider in its `kind(name)` form
+    Provider = 2,
+    /// Hash of the package file
+    Hash = 3,
+    /// sha256 of the index a delta index applies to
+    Base = 4,
+    /// sha256 of the index produced by applying a delta index
+    Target = 5,
+    /// Hash of a package file dropped by a delta index, the offset is unused
+    Removed = 6,
+
+    Unknown = 255,
+}
+
+/// A LookupRecord (a series of sequential entries within the LookupPayload)
+/// maps a key to one of the Meta payloads of a repository index.
+///
+/// Records are sorted by kind & then key bytes so a single package can be
+/// found with a binary search, decoding only the Meta payload it points to.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct StonePayloadLookupRecord {
+    /// Offset of the Meta payload (its header) from the start of the archive
+    pub offset: u64,
+    pub kind: StonePayloadLookupKind,
+    pub key: String,
+}
+
+impl StonePayloadLookupRecord {
+    pub fn as_view(&self) -> StonePayloadLookupRecordView<'_> {
+        StonePayloadLookupRecordView {
+            offset: self.offset,
+            kind: self.kind,
+            key: &self.key,
+        }
+    }
+
+    /// All records of `records`, which must be sorted, matching `kind` & `key`
+    pub fn find<'a>(records: &'a [Self], kind: StonePayloadLookupKind, key: &str) -> &'a [Self] {
+        let start = records.partition_point(|record| (record.kind, record.key.as_str()) < (kind, key));
+        let end = start + records[start..].partition_point(|record| record.kind == kind && record.key == key);
+
+        &records[start..end]
+    }
+}
+
+/// Borrowed counterpart of [`StonePayloadLookupRecord`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct StonePayloadLookupRecordView<'a> {
+    pub offset: u64,
+    pub kind: StonePayloadLookupKind,
+    pub key: &'a str,
+}
+
+impl Record for StonePayloadLookupRecord {
+    fn decode<R: Read>(mut reader: R) -> Result<Self, StonePayloadDecodeError> {
+        let offset = reader.read_u64()?;
+        let key_length = reader.read_u16()?;
+        let kind = decode_kind(reader.read_u8()?);
+        let _padding = reader.read_array_::<1>()?;
+        let key = reader.read_string(key_length as u64)?;
+
+        Ok(Self { offset, kind, key })
+    }
+
+    fn encode<W: Write>(&self, writer: &mut W) -> Result<(), StonePayloadEncodeError> {
+        writer.write_u64(self.offset)?;
+        writer.write_u16(self.key.len() as u16)?;
+        writer.write_u8(self.kind as u8)?;
+        writer.write_array([0; 1])?;
+        writer.write_all(self.key.as_bytes())?;
+
+        Ok(())
+    }
+
+    fn size(&self) -> usize {
+        8 + 2 + 1 + 1 + self.key.len()
+    }
+}
+
+impl<'a> RecordView<'a> for StonePayloadLookupRecordView<'a> {
+    fn decode_view(bytes: &mut &'a [u8]) -> Result<Self, StonePayloadDecodeError> {
+        let offset = bytes.read_u64()?;
+        let key_length = bytes.read_u16()?;
+        let kind = decode_kind(bytes.read_u8()?);
+        let _padding = bytes.read_array_::<1>()?;
+        let key = take_str(bytes, key_length as usize)?;
+
+        Ok(Self { offset, kind, key })
+    }
+}
+
+fn decode_kind(kind: u8) -> StonePayloadLookupKind {
+    match kind {
+        1 => StonePayloadLookupKind::Name,
+        2 => StonePayloadLookupKind::Provider,
+        3 => StonePayloadLookupKind::Hash,
+        4 => StonePayloadLookupKind::Base,
+        5 => StonePayloadLookupKind::Target,
+        6 => StonePayloadLookupKind::Removed,
+        _ => StonePayloadLookupKind::Unknown,
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    #[test]
+    fn find() {
+        let record = |kind, key: &str, offset| StonePayloadLookupRecord {
+            offset,
+            kind,
+            key: key.to_owned(),
+        };
+
+        let records = [
+            record(StonePayloadLookupKind::Name, "bash", 32),
+            record(StonePayloadLookupKind::Name, "zlib", 64),
+            record(StonePayloadLookupKind::Provider, "binary(sh)", 32),
+            record(StonePayloadLookupKind::Provider, "binary(sh)", 96),
+            record(StonePayloadLookupKind::Provider, "soname(libz.so.1)", 64),
+        ];
+
+        let found = StonePayloadLookupRecord::find(&records, StonePayloadLookupKind::Provider, "binary(sh)");
+        assert_eq!(found.iter().map(|r| r.offset).collect::<Vec<_>>(), [32, 96]);
+
+        let found = StonePayloadLookupRecord::find(&records, StonePayloadLookupKind::Name, "zlib");
+        assert_eq!(found, &records[1..2]);
+
+        assert!(StonePayloadLookupRecord::find(&records, StonePayloadLookupKind::Hash, "bash").is_empty());
+    }
+}
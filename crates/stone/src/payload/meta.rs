@@ -1,9 +1,9 @@
 // SPDX-FileCopyrightText: 2023 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
 
-use std::io::{Read, Write};
+use std::io::{self, Read, Write};
 
-use super::{Record, StonePayloadDecodeError, StonePayloadEncodeError};
+use super::{Record, RecordView, StonePayloadDecodeError, StonePayloadEncodeError, take_bytes, take_str};
 use crate::ext::{ReadExt, WriteExt};
 
 /// The Meta payload contains a series of sequential records with
@@ -91,6 +91,79 @@ impl StonePayloadMetaPrimitive {
     }
 }
 
+impl StonePayloadMetaRecord {
+    pub fn as_view(&self) -> StonePayloadMetaRecordView<'_> {
+        StonePayloadMetaRecordView {
+            tag: self.tag,
+            primitive: match &self.primitive {
+                StonePayloadMetaPrimitive::Int8(i) => StonePayloadMetaPrimitiveView::Int8(*i),
+                StonePayloadMetaPrimitive::Uint8(i) => StonePayloadMetaPrimitiveView::Uint8(*i),
+                StonePayloadMetaPrimitive::Int16(i) => StonePayloadMetaPrimitiveView::Int16(*i),
+                StonePayloadMetaPrimitive::Uint16(i) => StonePayloadMetaPrimitiveView::Uint16(*i),
+                StonePayloadMetaPrimitive::Int32(i) => StonePayloadMetaPrimitiveView::Int32(*i),
+                StonePayloadMetaPrimitive::Uint32(i) => StonePayloadMetaPrimitiveView::Uint32(*i),
+                StonePayloadMetaPrimitive::Int64(i) => StonePayloadMetaPrimitiveView::Int64(*i),
+                StonePayloadMetaPrimitive::Uint64(i) => StonePayloadMetaPrimitiveView::Uint64(*i),
+                StonePayloadMetaPrimitive::String(s) => StonePayloadMetaPrimitiveView::String(s),
+                StonePayloadMetaPrimitive::Dependency(dep, s) => StonePayloadMetaPrimitiveView::Dependency(*dep, s),
+                StonePayloadMetaPrimitive::Provider(dep, s) => StonePayloadMetaPrimitiveView::Provider(*dep, s),
+                StonePayloadMetaPrimitive::Unknown(data) => StonePayloadMetaPrimitiveView::Unknown(data),
+            },
+        }
+    }
+}
+
+/// Borrowed counterpart of [`StonePayloadMetaRecord`], decoded
+/// without copying strings
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct StonePayloadMetaRecordView<'a> {
+    pub tag: StonePayloadMetaTag,
+    pub primitive: StonePayloadMetaPrimitiveView<'a>,
+}
+
+impl StonePayloadMetaRecordView<'_> {
+    pub fn to_record(&self) -> StonePayloadMetaRecord {
+        StonePayloadMetaRecord {
+            tag: self.tag,
+            primitive: match self.primitive {
+                StonePayloadMetaPrimitiveView::Int8(i) => StonePayloadMetaPrimitive::Int8(i),
+                StonePayloadMetaPrimitiveView::Uint8(i) => StonePayloadMetaPrimitive::Uint8(i),
+                StonePayloadMetaPrimitiveView::Int16(i) => StonePayloadMetaPrimitive::Int16(i),
+                StonePayloadMetaPrimitiveView::Uint16(i) => StonePayloadMetaPrimitive::Uint16(i),
+                StonePayloadMetaPrimitiveView::Int32(i) => StonePayloadMetaPrimitive::Int32(i),
+                StonePayloadMetaPrimitiveView::Uint32(i) => StonePayloadMetaPrimitive::Uint32(i),
+                StonePayloadMetaPrimitiveView::Int64(i) => StonePayloadMetaPrimitive::Int64(i),
+                StonePayloadMetaPrimitiveView::Uint64(i) => StonePayloadMetaPrimitive::Uint64(i),
+                StonePayloadMetaPrimitiveView::String(s) => StonePayloadMetaPrimitive::String(s.to_owned()),
+                StonePayloadMetaPrimitiveView::Dependency(dep, s) => {
+                    StonePayloadMetaPrimitive::Dependency(dep, s.to_owned())
+                }
+                StonePayloadMetaPrimitiveView::Provider(dep, s) => {
+                    StonePayloadMetaPrimitive::Provider(dep, s.to_owned())
+                }
+                StonePayloadMetaPrimitiveView::Unknown(data) => StonePayloadMetaPrimitive::Unknown(data.to_vec()),
+            },
+        }
+    }
+}
+
+/// Borrowed counterpart of [`StonePayloadMetaPrimitive`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum StonePayloadMetaPrimitiveView<'a> {
+    Int8(i8),
+    Uint8(u8),
+    Int16(i16),
+    Uint16(u16),
+    Int32(i32),
+    Uint32(u32),
+    Int64(i64),
+    Uint64(u64),
+    String(&'a str),
+    Dependency(StonePayloadMetaDependency, &'a str),
+    Provider(StonePayloadMetaDependency, &'a str),
+    Unknown(&'a [u8]),
+}
+
 #[derive(Debug, Clone, Copy, PartialEq, Eq, strum::Display)]
 #[strum(serialize_all = "kebab-case")]
 #[repr(u16)]
@@ -155,34 +228,44 @@ fn decode_dependency(i: u8) -> StonePayloadMetaDependency {
     }
 }
 
+/// Helper to decode a record's encoded tag
+/// Length of the string following the DependencyKind u8 of a `length` byte record
+fn dependency_length(length: u32) -> io::Result<u32> {
+    length
+        .checked_sub(1)
+        .ok_or_else(|| io::Error::new(io::ErrorKind::InvalidData, "dependency record without a kind"))
+}
+
+fn decode_tag(i: u16) -> StonePayloadMetaTag {
+    match i {
+        1 => StonePayloadMetaTag::Name,
+        2 => StonePayloadMetaTag::Architecture,
+        3 => StonePayloadMetaTag::Version,
+        4 => StonePayloadMetaTag::Summary,
+        5 => StonePayloadMetaTag::Description,
+        6 => StonePayloadMetaTag::Homepage,
+        7 => StonePayloadMetaTag::SourceID,
+        8 => StonePayloadMetaTag::Depends,
+        9 => StonePayloadMetaTag::Provides,
+        10 => StonePayloadMetaTag::Conflicts,
+        11 => StonePayloadMetaTag::Release,
+        12 => StonePayloadMetaTag::License,
+        13 => StonePayloadMetaTag::BuildRelease,
+        14 => StonePayloadMetaTag::PackageURI,
+        15 => StonePayloadMetaTag::PackageHash,
+        16 => StonePayloadMetaTag::PackageSize,
+        17 => StonePayloadMetaTag::BuildDepends,
+        18 => StonePayloadMetaTag::SourceURI,
+        19 => StonePayloadMetaTag::SourcePath,
+        20 => StonePayloadMetaTag::SourceRef,
+        _ => StonePayloadMetaTag::Unknown,
+    }
+}
+
 impl Record for StonePayloadMetaRecord {
     fn decode<R: Read>(mut reader: R) -> Result<Self, StonePayloadDecodeError> {
         let length = reader.read_u32()?;
-
-        let tag = match reader.read_u16()? {
-            1 => StonePayloadMetaTag::Name,
-            2 => StonePayloadMetaTag::Architecture,
-            3 => StonePayloadMetaTag::Version,
-            4 => StonePayloadMetaTag::Summary,
-            5 => StonePayloadMetaTag::Description,
-            6 => StonePayloadMetaTag::Homepage,
-            7 => StonePayloadMetaTag::SourceID,
-            8 => StonePayloadMetaTag::Depends,
-            9 => StonePayloadMetaTag::Provides,
-            10 => StonePayloadMetaTag::Conflicts,
-            11 => StonePayloadMetaTag::Release,
-            12 => StonePayloadMetaTag::License,
-            13 => StonePayloadMetaTag::BuildRelease,
-            14 => StonePayloadMetaTag::PackageURI,
-            15 => StonePayloadMetaTag::PackageHash,
-            16 => StonePayloadMetaTag::PackageSize,
-            17 => StonePayloadMetaTag::BuildDepends,
-            18 => StonePayloadMetaTag::SourceURI,
-            19 => StonePayloadMetaTag::SourcePath,
-            20 => StonePayloadMetaTag::SourceRef,
-            _ => StonePayloadMetaTag::Unknown,
-        };
-
+        let tag = decode_tag(reader.read_u16()?);
         let kind = reader.read_u8()?;
         let _padding = reader.read_array_::<1>()?;
 
@@ -202,12 +285,12 @@ impl Record for StonePayloadMetaRecord {
             10 => StonePayloadMetaPrimitive::Dependency(
                 // DependencyKind u8 subtracted from length
                 decode_dependency(reader.read_u8()?),
-                sanitize(reader.read_string(length as u64 - 1)?),
+                sanitize(reader.read_string(dependency_length(length)? as u64)?),
             ),
             11 => StonePayloadMetaPrimitive::Provider(
                 // DependencyKind u8 subtracted from length
                 decode_dependency(reader.read_u8()?),
-                sanitize(reader.read_string(length as u64 - 1)?),
+                sanitize(reader.read_string(dependency_length(length)? as u64)?),
             ),
             _ => StonePayloadMetaPrimitive::Unknown(reader.read_vec(length as usize)?),
         };
@@ -267,3 +350,56 @@ impl Record for StonePayloadMetaRecord {
         4 + 2 + 1 + 1 + self.primitive.size()
     }
 }
+
+impl<'a> RecordView<'a> for StonePayloadMetaRecordView<'a> {
+    fn decode_view(bytes: &mut &'a [u8]) -> Result<Self, StonePayloadDecodeError> {
+        let length = bytes.read_u32()?;
+        let tag = decode_tag(bytes.read_u16()?);
+        let kind = bytes.read_u8()?;
+        let _padding = bytes.read_array_::<1>()?;
+
+        // Remove null terminated byte from string
+        fn sanitize(s: &str) -> &str {
+            s.trim_end_matches('\0')
+        }
+
+        let primitive = match kind {
+            1 => StonePayloadMetaPrimitiveView::Int8(bytes.read_u8()? as i8),
+            2 => StonePayloadMetaPrimitiveView::Uint8(bytes.read_u8()?),
+            3 => StonePayloadMetaPrimitiveView::Int16(bytes.read_u16()? as i16),
+            4 => StonePayloadMetaPrimitiveView::Uint16(bytes.read_u16()?),
+            5 => StonePayloadMetaPrimitiveView::Int32(bytes.read_u32()? as i32),
+            6 => StonePayloadMetaPrimitiveView::Uint32(bytes.read_u32()?),
+            7 => StonePayloadMetaPrimitiveView::Int64(bytes.read_u64()? as i64),
+            8 => StonePayloadMetaPrimitiveView::Uint64(bytes.read_u64()?),
+            9 => StonePayloadMetaPrimitiveView::String(sanitize(take_str(bytes, length as usize)?)),
+            10 => StonePayloadMetaPrimitiveView::Dependency(
+                // DependencyKind u8 subtracted from length
+                decode_dependency(bytes.read_u8()?),
+                sanitize(take_str(bytes, dependency_length(length)? as usize)?),
+            ),
+            11 => StonePayloadMetaPrimitiveView::Provider(
+                // DependencyKind u8 subtracted from length
+                decode_dependency(bytes.read_u8()?),
+                sanitize(take_str(bytes, dependency_length(length)? as usize)?),
+            ),
+            _ => StonePayloadMetaPrimitiveView::Unknown(take_bytes(bytes, length as usize)?),
+        };
+
+        Ok(Self { tag, primitive })
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    #[test]
+    fn zero_length_dependency() {
+        // length, tag, kind (dependency), padding, then only the DependencyKind
+        let bytes = [0, 0, 0, 0, 0, 1, 10, 0, 0];
+
+        assert!(StonePayloadMetaRecord::decode(&bytes[..]).is_err());
+        assert!(StonePayloadMetaRecordView::decode_view(&mut &bytes[..]).is_err());
+    }
+}
@@ -3,8 +3,10 @@
 
 mod attribute;
 mod content;
+mod frame;
 mod index;
 pub mod layout;
+mod lookup;
 pub mod meta;
 
 use std::io::{self, Read, Write};
@@ -13,12 +15,18 @@ use thiserror::Error;
 
 use crate::ext::{ReadExt, WriteExt};
 
-pub use self::attribute::StonePayloadAttributeRecord;
+pub use self::attribute::{StonePayloadAttributeRecord, StonePayloadAttributeRecordView};
 pub use self::content::StonePayloadContent;
+pub use self::frame::StonePayloadFrameRecord;
 pub use self::index::StonePayloadIndexRecord;
-pub use self::layout::{StonePayloadLayoutFile, StonePayloadLayoutFileType, StonePayloadLayoutRecord};
+pub use self::layout::{
+    StonePayloadLayoutFile, StonePayloadLayoutFileType, StonePayloadLayoutFileView, StonePayloadLayoutRecord,
+    StonePayloadLayoutRecordView,
+};
+pub use self::lookup::{StonePayloadLookupKind, StonePayloadLookupRecord, StonePayloadLookupRecordView};
 pub use self::meta::{
-    StonePayloadMetaDependency, StonePayloadMetaPrimitive, StonePayloadMetaRecord, StonePayloadMetaTag,
+    StonePayloadMetaDependency, StonePayloadMetaPrimitive, StonePayloadMetaPrimitiveView, StonePayloadMetaRecord,
+    StonePayloadMetaRecordView, StonePayloadMetaTag,
 };
 
 #[derive(Debug, Clone, Copy, PartialEq, Eq, strum::Display)]
@@ -35,6 +43,10 @@ pub enum StonePayloadKind {
     Index = 4,
     // Attribute storage
     Attributes = 5,
+    // Seekable frame table for the content payload
+    Frames = 6,
+    // Sorted keys to the Meta payloads of a repository index
+    Lookup = 7,
 
     Unknown = 255,
 }
@@ -64,6 +76,9 @@ pub struct StonePayloadHeader {
 }
 
 impl StonePayloadHeader {
+    /// Size of the encoded header in bytes
+    pub const SIZE: usize = 8 + 8 + 8 + 4 + 2 + 1 + 1;
+
     pub fn decode<R: Read>(mut reader: R) -> Result<Self, StonePayloadDecodeError> {
         let stored_size = reader.read_u64()?;
         let plain_size = reader.read_u64()?;
@@ -77,6 +92,8 @@ impl StonePayloadHeader {
             3 => StonePayloadKind::Layout,
             4 => StonePayloadKind::Index,
             5 => StonePayloadKind::Attributes,
+            6 => StonePayloadKind::Frames,
+            7 => StonePayloadKind::Lookup,
             _ => StonePayloadKind::Unknown,
         };
 
@@ -116,6 +133,12 @@ pub(crate) trait Record: Sized {
     fn size(&self) -> usize;
 }
 
+/// A record which can be decoded directly from a byte slice, borrowing
+/// any strings or blobs rather than copying them
+pub(crate) trait RecordView<'a>: Sized {
+    fn decode_view(bytes: &mut &'a [u8]) -> Result<Self, StonePayloadDecodeError>;
+}
+
 pub(crate) fn decode_records<T: Record, R: Read>(
     mut reader: R,
     num_records: usize,
@@ -139,6 +162,22 @@ pub(crate) fn encode_records<T: Record, W: Write>(
     Ok(())
 }
 
+/// Split `length` bytes off the front of `bytes`
+pub(crate) fn take_bytes<'a>(bytes: &mut &'a [u8], length: usize) -> io::Result<&'a [u8]> {
+    let Some((head, tail)) = bytes.split_at_checked(length) else {
+        return Err(io::ErrorKind::UnexpectedEof.into());
+    };
+
+    *bytes = tail;
+
+    Ok(head)
+}
+
+/// Split a `length` byte UTF-8 string off the front of `bytes`
+pub(crate) fn take_str<'a>(bytes: &mut &'a [u8], length: usize) -> io::Result<&'a str> {
+    str::from_utf8(take_bytes(bytes, length)?).map_err(|error| io::Error::new(io::ErrorKind::InvalidData, error))
+}
+
 pub(crate) fn records_total_size<T: Record>(records: &[T]) -> usize {
     records.iter().map(T::size).sum()
 }
@@ -1,11 +1,59 @@
 // SPDX-FileCopyrightText: 2023 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
 
-use std::io::Read;
+use std::{
+    io::Read,
+    time::{Duration, Instant},
+};
 
 use xxhash_rust::xxh3::Xxh3;
 
-pub type Hasher = Xxh3;
+use crate::event;
+
+/// xxh3 state, also keeping track of the time spent hashing
+/// while an event hook is installed
+pub struct Hasher {
+    inner: Xxh3,
+    elapsed: Option<Duration>,
+}
+
+impl Hasher {
+    pub fn new() -> Self {
+        Self {
+            inner: Xxh3::new(),
+            elapsed: event::enabled().then_some(Duration::ZERO),
+        }
+    }
+
+    pub fn reset(&mut self) {
+        self.inner.reset();
+        self.elapsed = event::enabled().then_some(Duration::ZERO);
+    }
+
+    pub fn update(&mut self, buf: &[u8]) {
+        match &mut self.elapsed {
+            Some(elapsed) => {
+                let start = Instant::now();
+                self.inner.update(buf);
+                *elapsed += start.elapsed();
+            }
+            None => self.inner.update(buf),
+        }
+    }
+
+    pub fn digest(&self) -> u64 {
+        self.inner.digest()
+    }
+
+    pub fn digest128(&self) -> u128 {
+        self.inner.digest128()
+    }
+
+    /// Time spent hashing since the last reset
+    pub fn elapsed(&self) -> Duration {
+        self.elapsed.unwrap_or_default()
+    }
+}
 
 pub struct Reader<'a, R: Read> {
     inner: R,
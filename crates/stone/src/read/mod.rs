@@ -2,30 +2,55 @@
 // SPDX-License-Identifier: MPL-2.0
 #![allow(dead_code)]
 
-use std::io::{self, Cursor, Read, Seek, SeekFrom, Write};
+use std::{
+    io::{self, Cursor, Read, Seek, SeekFrom, Write},
+    time::Instant,
+};
 use thiserror::Error;
 
 use crate::{
-    StoneHeader, StoneHeaderDecodeError, StonePayload, StonePayloadAttributeRecord, StonePayloadCompression,
-    StonePayloadContent, StonePayloadDecodeError, StonePayloadHeader, StonePayloadIndexRecord, StonePayloadKind,
-    StonePayloadLayoutRecord, StonePayloadMetaRecord, payload,
+    StoneEvent, StoneHeader, StoneHeaderDecodeError, StonePayload, StonePayloadAttributeRecord,
+    StonePayloadCompression, StonePayloadContent, StonePayloadDecodeError, StonePayloadFrameRecord, StonePayloadHeader,
+    StonePayloadIndexRecord, StonePayloadKind, StonePayloadLayoutRecord, StonePayloadLookupRecord,
+    StonePayloadMetaRecord, event, payload,
 };
 
+pub use self::slice::{StoneSlicePayload, StoneSliceReader, read_slice};
+pub use self::unpack::StoneContentSink;
+pub use self::zstd::StoneDecodeContext;
+
 use self::zstd::Zstd;
 
 mod digest;
+mod slice;
+mod unpack;
 mod zstd;
 
-pub fn read<R: Read + Seek>(mut reader: R) -> Result<StoneReader<R>, StoneReadError> {
+pub fn read<R: Read + Seek>(reader: R) -> Result<StoneReader<R>, StoneReadError> {
+    read_with_context(reader, StoneDecodeContext::default())
+}
+
+/// Read a stone, decoding payloads with an existing [`StoneDecodeContext`]
+///
+/// The context can be recovered with [`StoneReader::into_context`] once
+/// done, so it can be reused for the next archive.
+pub fn read_with_context<R: Read + Seek>(
+    mut reader: R,
+    context: StoneDecodeContext,
+) -> Result<StoneReader<R>, StoneReadError> {
     let header = StoneHeader::decode(&mut reader).map_err(StoneReadError::HeaderDecode)?;
 
     Ok(StoneReader {
         header,
         reader,
         hasher: digest::Hasher::new(),
+        context,
+        table: None,
 
         #[cfg(feature = "ffi")]
         next_payload: 0,
+        #[cfg(feature = "ffi")]
+        next_offset: StoneHeader::SIZE as u64,
     })
 }
 
@@ -37,9 +62,15 @@ pub struct StoneReader<R> {
     pub header: StoneHeader,
     reader: R,
     hasher: digest::Hasher,
+    context: StoneDecodeContext,
+    /// Populated on first use by [`StoneReader::payload_table`]
+    table: Option<Vec<StonePayloadTableEntry>>,
 
     #[cfg(feature = "ffi")]
     next_payload: u16,
+    /// Where the header of payload `next_payload` starts
+    #[cfg(feature = "ffi")]
+    next_offset: u64,
 }
 
 impl<R: Read + Seek> StoneReader<R> {
@@ -56,8 +87,147 @@ impl<R: Read + Seek> StoneReader<R> {
             self.next_payload = self.header.num_payloads();
         }
 
-        Ok((0..self.header.num_payloads())
-            .flat_map(|_| StoneDecodedPayload::decode(&mut self.reader, &mut self.hasher).transpose()))
+        Ok((0..self.header.num_payloads()).flat_map(|_| {
+            StoneDecodedPayload::decode(&mut self.reader, &mut self.hasher, &mut self.context).transpose()
+        }))
+    }
+
+    /// Create a reader over `reader`, another handle to the same archive
+    ///
+    /// The header & payload table are shared with this reader, while the
+    /// position, hasher & decode state are not, so both can be used at the
+    /// same time, for example from different threads.
+    pub fn clone_with<S>(&self, reader: S) -> StoneReader<S> {
+        StoneReader {
+            header: self.header,
+            reader,
+            hasher: digest::Hasher::new(),
+            context: StoneDecodeContext::default(),
+            table: self.table.clone(),
+
+            #[cfg(feature = "ffi")]
+            next_payload: 0,
+            #[cfg(feature = "ffi")]
+            next_offset: StoneHeader::SIZE as u64,
+        }
+    }
+
+    /// The underlying source of this reader
+    pub fn get_ref(&self) -> &R {
+        &self.reader
+    }
+
+    /// Swap the decode context used by this reader, returning the previous one
+    pub fn replace_context(&mut self, context: StoneDecodeContext) -> StoneDecodeContext {
+        std::mem::replace(&mut self.context, context)
+    }
+
+    /// Consume the reader, keeping its decode context for reuse
+    pub fn into_context(self) -> StoneDecodeContext {
+        self.context
+    }
+
+    /// Scan the headers of all payloads without decoding them, seeking
+    /// over each body. The table is cached for the lifetime of the reader.
+    pub fn payload_table(&mut self) -> Result<&[StonePayloadTableEntry], StoneReadError> {
+        if self.table.is_none() {
+            let mut offset = self.reader.seek(SeekFrom::Start(StoneHeader::SIZE as u64))?;
+            let mut table = Vec::with_capacity(self.header.num_payloads() as usize);
+
+            for _ in 0..self.header.num_payloads() {
+                let header = match StonePayloadHeader::decode(&mut self.reader) {
+                    Ok(header) => header,
+                    Err(StonePayloadDecodeError::Io(error)) if error.kind() == io::ErrorKind::UnexpectedEof => break,
+                    Err(error) => return Err(StoneReadError::PayloadDecode(error)),
+                };
+
+                let body = offset + StonePayloadHeader::SIZE as u64;
+                offset = self.reader.seek(SeekFrom::Start(body + header.stored_size))?;
+
+                table.push(StonePayloadTableEntry { header, offset: body });
+            }
+
+            self.table = Some(table);
+        }
+
+        Ok(self.table.as_deref().unwrap_or_default())
+    }
+
+    /// Decode a single payload located via [`StoneReader::payload_table`]
+    pub fn decode_payload(&mut self, entry: &StonePayloadTableEntry) -> Result<StoneDecodedPayload, StoneReadError> {
+        self.decode_payload_at(entry.offset - StonePayloadHeader::SIZE as u64)
+    }
+
+    /// Decode the payload whose header starts at `offset`, such as the Meta
+    /// payload a [`StonePayloadLookupRecord`] points to
+    pub fn decode_payload_at(&mut self, offset: u64) -> Result<StoneDecodedPayload, StoneReadError> {
+        self.reader.seek(SeekFrom::Start(offset))?;
+
+        StoneDecodedPayload::decode(&mut self.reader, &mut self.hasher, &mut self.context)?
+            .ok_or_else(|| io::Error::from(io::ErrorKind::UnexpectedEof).into())
+    }
+
+    /// Decode only the first payload of the given kind, skipping everything else
+    pub fn payload_by_kind(&mut self, kind: StonePayloadKind) -> Result<Option<StoneDecodedPayload>, StoneReadError> {
+        let Some(entry) = self
+            .payload_table()?
+            .iter()
+            .find(|entry| entry.header.kind == kind)
+            .copied()
+        else {
+            return Ok(None);
+        };
+
+        self.decode_payload(&entry).map(Some)
+    }
+
+    /// Decompress only the bytes `start..end` of the content payload into `writer`
+    ///
+    /// With the `frames` of a seekable content payload only the frames covering
+    /// the range are decompressed, otherwise decoding starts from the beginning
+    /// of the payload. The payload checksum can't be validated for a partial
+    /// read, callers should check the digest of the index record instead.
+    pub fn extract_range<W: Write>(
+        &mut self,
+        content: &StonePayload<StonePayloadContent>,
+        frames: &[StonePayloadFrameRecord],
+        start: u64,
+        end: u64,
+        writer: &mut W,
+    ) -> Result<(), StoneReadError> {
+        if start > end || end > content.header.plain_size {
+            return Err(io::Error::new(io::ErrorKind::InvalidInput, "range outside of content payload").into());
+        }
+
+        if start == end {
+            return Ok(());
+        }
+
+        let first = frames.partition_point(|frame| frame.plain_end <= start);
+        let last = frames.partition_point(|frame| frame.plain_start < end);
+
+        let (plain_start, stored_start, stored_end) = if first < last {
+            (
+                frames[first].plain_start,
+                frames[first].stored_start,
+                frames[last - 1].stored_end,
+            )
+        } else {
+            (0, 0, content.header.stored_size)
+        };
+
+        self.reader.seek(SeekFrom::Start(content.body.offset + stored_start))?;
+
+        let framed = (&mut self.reader).take(stored_end - stored_start);
+        let mut decoder = PayloadReader::new(framed, &content.header, &mut self.context)?;
+
+        io::copy(&mut (&mut decoder).take(start - plain_start), &mut io::sink())?;
+
+        if io::copy(&mut decoder.take(end - start), writer)? != end - start {
+            return Err(io::Error::from(io::ErrorKind::UnexpectedEof).into());
+        }
+
+        Ok(())
     }
 
     pub fn unpack_content<W>(
@@ -68,16 +238,22 @@ impl<R: Read + Seek> StoneReader<R> {
     where
         W: Write,
     {
+        let started = event::start();
+
         self.reader.seek(SeekFrom::Start(content.body.offset))?;
         self.hasher.reset();
 
         let hashed = digest::Reader::new(&mut self.reader, &mut self.hasher);
         let framed = hashed.take(content.header.stored_size);
 
-        io::copy(&mut PayloadReader::new(framed, content.header.compression)?, writer)?;
+        io::copy(
+            &mut PayloadReader::new(framed, &content.header, &mut self.context)?,
+            writer,
+        )?;
 
         // Validate checksum
         validate_checksum(&self.hasher, &content.header)?;
+        emit_content_unpacked(started, &self.hasher, &content.header);
 
         Ok(())
     }
@@ -87,8 +263,18 @@ impl<R: Read + Seek> StoneReader<R> {
 impl<R: Read + Seek> StoneReader<R> {
     pub fn next_payload(&mut self) -> Result<Option<StoneDecodedPayload>, StoneReadError> {
         if self.next_payload < self.header.num_payloads() {
-            let payload = StoneDecodedPayload::decode(&mut self.reader, &mut self.hasher)?;
+            // Reader may have been moved by random access, make sure
+            // we continue from the correct payload
+            self.reader.seek(SeekFrom::Start(self.next_offset))?;
 
+            let payload = StoneDecodedPayload::decode(&mut self.reader, &mut self.hasher, &mut self.context)?;
+
+            if let Some(payload) = &payload {
+                self.next_offset = self
+                    .next_offset
+                    .saturating_add(StonePayloadHeader::SIZE as u64)
+                    .saturating_add(payload.header().stored_size);
+            }
             self.next_payload += 1;
 
             Ok(payload)
@@ -106,25 +292,27 @@ impl<R: Read + Seek> StoneReader<R> {
 
         let hashed = digest::Reader::new(&mut self.reader, &mut self.hasher);
         let framed = hashed.take(content.header.stored_size);
-        let reader = PayloadReader::new(framed, content.header.compression)?;
+        let reader = PayloadReader::new(framed, &content.header, &mut self.context)?;
 
         let buf_hint = reader.buf_hint();
 
         Ok(StonePayloadContentReader {
             reader,
-            header_checksum: u64::from_be_bytes(content.header.checksum),
+            header: content.header,
             is_checksum_valid: false,
             buf_hint,
+            started: event::start(),
         })
     }
 }
 
 #[cfg(feature = "ffi")]
 pub struct StonePayloadContentReader<'a, R: Read> {
-    reader: PayloadReader<io::Take<digest::Reader<'a, &'a mut R>>>,
-    header_checksum: u64,
+    reader: PayloadReader<'a, io::Take<digest::Reader<'a, &'a mut R>>>,
+    header: StonePayloadHeader,
     pub is_checksum_valid: bool,
     pub buf_hint: Option<usize>,
+    started: Option<Instant>,
 }
 
 #[cfg(feature = "ffi")]
@@ -132,7 +320,12 @@ impl<'a, R: Read> Read for StonePayloadContentReader<'a, R> {
     fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
         match self.reader.read(buf) {
             Ok(read) if !buf.is_empty() && read == 0 => {
-                self.is_checksum_valid = self.header_checksum == self.reader.get_mut().get_mut().hasher.digest();
+                let hasher = &self.reader.get_mut().get_mut().hasher;
+                self.is_checksum_valid = validate_checksum(hasher, &self.header).is_ok();
+
+                if self.is_checksum_valid {
+                    emit_content_unpacked(self.started.take(), hasher, &self.header);
+                }
 
                 Ok(read)
             }
@@ -142,16 +335,29 @@ impl<'a, R: Read> Read for StonePayloadContentReader<'a, R> {
     }
 }
 
-enum PayloadReader<R: Read> {
+/// Location of a payload within the archive
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(C)]
+pub struct StonePayloadTableEntry {
+    pub header: StonePayloadHeader,
+    /// Offset of the payload body, after its header
+    pub offset: u64,
+}
+
+enum PayloadReader<'a, R: Read> {
     Plain(R),
-    Zstd(Zstd<R>),
+    Zstd(Zstd<'a, R>),
 }
 
-impl<R: Read> PayloadReader<R> {
-    fn new(reader: R, compression: StonePayloadCompression) -> Result<Self, StoneReadError> {
-        Ok(match compression {
+impl<'a, R: Read> PayloadReader<'a, R> {
+    fn new(
+        reader: R,
+        header: &StonePayloadHeader,
+        context: &'a mut StoneDecodeContext,
+    ) -> Result<Self, StoneReadError> {
+        Ok(match header.compression {
             StonePayloadCompression::None => PayloadReader::Plain(reader),
-            StonePayloadCompression::Zstd => PayloadReader::Zstd(Zstd::new(reader)?),
+            StonePayloadCompression::Zstd => PayloadReader::Zstd(Zstd::new(reader, context)?),
             StonePayloadCompression::Unknown => return Err(StoneReadError::UnknownCompression),
         })
     }
@@ -171,7 +377,7 @@ impl<R: Read> PayloadReader<R> {
     }
 }
 
-impl<R: Read> Read for PayloadReader<R> {
+impl<R: Read> Read for PayloadReader<'_, R> {
     fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
         match self {
             PayloadReader::Plain(reader) => reader.read(buf),
@@ -186,6 +392,8 @@ pub enum StoneDecodedPayload {
     Attributes(StonePayload<Vec<StonePayloadAttributeRecord>>),
     Layout(StonePayload<Vec<StonePayloadLayoutRecord>>),
     Index(StonePayload<Vec<StonePayloadIndexRecord>>),
+    Frames(StonePayload<Vec<StonePayloadFrameRecord>>),
+    Lookup(StonePayload<Vec<StonePayloadLookupRecord>>),
     Content(StonePayload<StonePayloadContent>),
 
     /// Payload type not known / supported by this decoder
@@ -201,15 +409,22 @@ impl StoneDecodedPayload {
             StoneDecodedPayload::Attributes(payload) => &payload.header,
             StoneDecodedPayload::Layout(payload) => &payload.header,
             StoneDecodedPayload::Index(payload) => &payload.header,
+            StoneDecodedPayload::Frames(payload) => &payload.header,
+            StoneDecodedPayload::Lookup(payload) => &payload.header,
             StoneDecodedPayload::Content(payload) => &payload.header,
             StoneDecodedPayload::Unknown(payload) => &payload.header,
             StoneDecodedPayload::UnknownCompression(payload) => &payload.header,
         }
     }
 
-    fn decode<R: Read + Seek>(mut reader: R, hasher: &mut digest::Hasher) -> Result<Option<Self>, StoneReadError> {
+    fn decode<R: Read + Seek>(
+        mut reader: R,
+        hasher: &mut digest::Hasher,
+        context: &mut StoneDecodeContext,
+    ) -> Result<Option<Self>, StoneReadError> {
         match StonePayloadHeader::decode(&mut reader) {
             Ok(header) => {
+                let started = event::start();
                 hasher.reset();
                 let mut hashed = digest::Reader::new(&mut reader, hasher);
                 let mut framed = (&mut hashed).take(header.stored_size);
@@ -229,28 +444,42 @@ impl StoneDecodedPayload {
                     StonePayloadKind::Meta => StoneDecodedPayload::Meta(StonePayload {
                         header,
                         body: payload::decode_records(
-                            PayloadReader::new(&mut framed, header.compression)?,
+                            PayloadReader::new(&mut framed, &header, context)?,
                             header.num_records,
                         )?,
                     }),
                     StonePayloadKind::Layout => StoneDecodedPayload::Layout(StonePayload {
                         header,
                         body: payload::decode_records(
-                            PayloadReader::new(&mut framed, header.compression)?,
+                            PayloadReader::new(&mut framed, &header, context)?,
                             header.num_records,
                         )?,
                     }),
                     StonePayloadKind::Index => StoneDecodedPayload::Index(StonePayload {
                         header,
                         body: payload::decode_records(
-                            PayloadReader::new(&mut framed, header.compression)?,
+                            PayloadReader::new(&mut framed, &header, context)?,
                             header.num_records,
                         )?,
                     }),
                     StonePayloadKind::Attributes => StoneDecodedPayload::Attributes(StonePayload {
                         header,
                         body: payload::decode_records(
-                            PayloadReader::new(&mut framed, header.compression)?,
+                            PayloadReader::new(&mut framed, &header, context)?,
+                            header.num_records,
+                        )?,
+                    }),
+                    StonePayloadKind::Frames => StoneDecodedPayload::Frames(StonePayload {
+                        header,
+                        body: payload::decode_records(
+                            PayloadReader::new(&mut framed, &header, context)?,
+                            header.num_records,
+                        )?,
+                    }),
+                    StonePayloadKind::Lookup => StoneDecodedPayload::Lookup(StonePayload {
+                        header,
+                        body: payload::decode_records(
+                            PayloadReader::new(&mut framed, &header, context)?,
                             header.num_records,
                         )?,
                     }),
@@ -276,6 +505,16 @@ impl StoneDecodedPayload {
                 // Validate hash for known, non-content payloads
                 if !matches!(header.kind, StonePayloadKind::Content | StonePayloadKind::Unknown) {
                     validate_checksum(hasher, &header)?;
+
+                    if let Some(started) = started {
+                        event::emit(StoneEvent::PayloadDecoded {
+                            kind: header.kind,
+                            stored_size: header.stored_size,
+                            plain_size: header.plain_size,
+                            elapsed: started.elapsed(),
+                            checksum: hasher.elapsed(),
+                        });
+                    }
                 }
 
                 Ok(Some(payload))
@@ -313,6 +552,22 @@ impl StoneDecodedPayload {
         }
     }
 
+    pub fn frames(&self) -> Option<&StonePayload<Vec<StonePayloadFrameRecord>>> {
+        if let Self::Frames(frames) = self {
+            Some(frames)
+        } else {
+            None
+        }
+    }
+
+    pub fn lookup(&self) -> Option<&StonePayload<Vec<StonePayloadLookupRecord>>> {
+        if let Self::Lookup(lookup) = self {
+            Some(lookup)
+        } else {
+            None
+        }
+    }
+
     pub fn content(&self) -> Option<&StonePayload<StonePayloadContent>> {
         if let Self::Content(content) = self {
             Some(content)
@@ -327,6 +582,8 @@ impl StoneDecodedPayload {
             StoneDecodedPayload::Attributes(_) => "Attributes",
             StoneDecodedPayload::Layout(_) => "Layout",
             StoneDecodedPayload::Index(_) => "Index",
+            StoneDecodedPayload::Frames(_) => "Frames",
+            StoneDecodedPayload::Lookup(_) => "Lookup",
             StoneDecodedPayload::Content(_) => "Content",
             StoneDecodedPayload::Unknown(_) => "Unknown payload type",
             StoneDecodedPayload::UnknownCompression(payload) => match payload.header.kind {
@@ -336,11 +593,25 @@ impl StoneDecodedPayload {
                 StonePayloadKind::Layout => "Layout - unknown compression",
                 StonePayloadKind::Index => "Index - unknown compression",
                 StonePayloadKind::Attributes => "Attributes - unknown compression",
+                StonePayloadKind::Frames => "Frames - unknown compression",
+                StonePayloadKind::Lookup => "Lookup - unknown compression",
             },
         }
     }
 }
 
+/// Report a full read of the content payload begun at `started`, if anyone is listening
+fn emit_content_unpacked(started: Option<Instant>, hasher: &digest::Hasher, header: &StonePayloadHeader) {
+    if let Some(started) = started {
+        event::emit(StoneEvent::ContentUnpacked {
+            stored_size: header.stored_size,
+            plain_size: header.plain_size,
+            elapsed: started.elapsed(),
+            checksum: hasher.elapsed(),
+        });
+    }
+}
+
 fn validate_checksum(hasher: &digest::Hasher, header: &StonePayloadHeader) -> Result<(), StoneReadError> {
     let got = hasher.digest();
     let expected = u64::from_be_bytes(header.checksum);
@@ -364,12 +635,18 @@ pub enum StoneReadError {
     PayloadDecode(#[from] StonePayloadDecodeError),
     #[error("payload checksum mismatch: got {got:02x}, expected {expected:02x}")]
     PayloadChecksum { got: u64, expected: u64 },
+    #[error("asset checksum mismatch: got {got:02x}, expected {expected:02x}")]
+    AssetChecksum { got: u128, expected: u128 },
+    #[error("payload plain size {0} is not possible for its stored size")]
+    PayloadSize(u64),
     #[error("io")]
     Io(#[from] io::Error),
 }
 
 #[cfg(test)]
 mod test {
+    use std::num::NonZeroUsize;
+
     use xxhash_rust::xxh3::xxh3_128;
 
     use crate::{StoneHeaderVersion, StonePayloadLayoutFile};
@@ -430,4 +707,221 @@ mod test {
             }
         }
     }
+
+    #[test]
+    fn unpack_content_to_sink() {
+        use std::{collections::BTreeMap, sync::Mutex};
+
+        #[derive(Default)]
+        struct MemorySink(Mutex<BTreeMap<u128, Vec<u8>>>);
+
+        impl StoneContentSink for MemorySink {
+            type Writer = Vec<u8>;
+
+            fn create(&self, _index: &StonePayloadIndexRecord) -> io::Result<Option<Self::Writer>> {
+                Ok(Some(vec![]))
+            }
+
+            fn commit(&self, index: &StonePayloadIndexRecord, writer: Self::Writer) -> io::Result<()> {
+                self.0.lock().unwrap().insert(index.digest, writer);
+                Ok(())
+            }
+        }
+
+        let mut stone =
+            read_bytes(include_bytes!("../../../../test/bash-completion-2.11-1-1-x86_64.stone")).expect("valid stone");
+        let payloads = stone.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+
+        let content = payloads.iter().find_map(StoneDecodedPayload::content).unwrap();
+        let indices = payloads.iter().find_map(StoneDecodedPayload::index).unwrap();
+
+        let mut unpacked_content = vec![];
+        stone.unpack_content(content, &mut unpacked_content).unwrap();
+
+        let sink = MemorySink::default();
+        let mut progress = 0;
+        stone
+            .unpack_content_to(content, &indices.body, &sink, NonZeroUsize::new(2).unwrap(), |delta| {
+                progress += delta;
+            })
+            .unwrap();
+
+        assert_eq!(progress, content.header.plain_size);
+
+        let assets = sink.0.into_inner().unwrap();
+        for index in &indices.body {
+            assert_eq!(
+                assets[&index.digest],
+                unpacked_content[index.start as usize..index.end as usize]
+            );
+        }
+    }
+
+    #[test]
+    fn reuse_decode_context() {
+        let bytes = include_bytes!("../../../../test/bash-completion-2.11-1-1-x86_64.stone");
+
+        let mut stone = read_bytes(bytes).unwrap();
+        let expected = stone.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+        let mut context = stone.into_context();
+
+        for _ in 0..2 {
+            let mut stone = read_with_context(Cursor::new(bytes), context).unwrap();
+            let payloads = stone.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+
+            for (a, b) in payloads.iter().zip(&expected) {
+                assert_eq!(a.header(), b.header());
+            }
+
+            let content = payloads.iter().find_map(StoneDecodedPayload::content).unwrap();
+            let mut buffer = vec![];
+            stone.unpack_content(content, &mut buffer).unwrap();
+            assert_eq!(buffer.len() as u64, content.header.plain_size);
+
+            context = stone.into_context();
+        }
+    }
+
+    #[test]
+    fn clone_with() {
+        let bytes = include_bytes!("../../../../test/bash-completion-2.11-1-1-x86_64.stone");
+
+        let mut stone = read_bytes(bytes).unwrap();
+        let table = stone.payload_table().unwrap().to_vec();
+
+        let decoded = std::thread::scope(|scope| {
+            let handles = table
+                .iter()
+                .map(|entry| {
+                    let mut clone = stone.clone_with(Cursor::new(bytes));
+                    scope.spawn(move || *clone.decode_payload(entry).unwrap().header())
+                })
+                .collect::<Vec<_>>();
+
+            handles.into_iter().map(|h| h.join().unwrap()).collect::<Vec<_>>()
+        });
+
+        for (entry, header) in table.iter().zip(decoded) {
+            assert_eq!(entry.header, header);
+        }
+    }
+
+    #[test]
+    fn payload_by_kind() {
+        let mut stone =
+            read_bytes(include_bytes!("../../../../test/bash-completion-2.11-1-1-x86_64.stone")).expect("valid stone");
+
+        let table = stone.payload_table().unwrap().to_vec();
+        assert_eq!(table.len(), stone.header.num_payloads() as usize);
+
+        let payloads = stone.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+        for (entry, payload) in table.iter().zip(&payloads) {
+            assert_eq!(&entry.header, payload.header());
+        }
+
+        let layouts = stone.payload_by_kind(StonePayloadKind::Layout).unwrap().unwrap();
+        assert_eq!(
+            layouts.layout().unwrap().body,
+            payloads.iter().find_map(StoneDecodedPayload::layout).unwrap().body
+        );
+
+        let content = stone.payload_by_kind(StonePayloadKind::Content).unwrap().unwrap();
+        assert_eq!(
+            content.content().unwrap().body.offset,
+            payloads
+                .iter()
+                .find_map(StoneDecodedPayload::content)
+                .unwrap()
+                .body
+                .offset
+        );
+    }
+
+    #[test]
+    fn read_slice_matches_stream() {
+        let bytes = include_bytes!("../../../../test/bash-completion-2.11-1-1-x86_64.stone");
+
+        let payloads = read_bytes(bytes)
+            .unwrap()
+            .payloads()
+            .unwrap()
+            .collect::<Result<Vec<_>, _>>()
+            .unwrap();
+        let meta = payloads.iter().find_map(StoneDecodedPayload::meta).unwrap();
+        let layouts = payloads.iter().find_map(StoneDecodedPayload::layout).unwrap();
+        let indices = payloads.iter().find_map(StoneDecodedPayload::index).unwrap();
+        let content = payloads.iter().find_map(StoneDecodedPayload::content).unwrap();
+
+        let mut reader = read_slice(bytes).unwrap();
+        assert_eq!(reader.header, read_bytes(bytes).unwrap().header);
+
+        let slices = reader.payloads().unwrap();
+        assert_eq!(slices.len(), payloads.len());
+
+        let slice_meta = slices
+            .iter()
+            .find_map(|p| p.meta())
+            .unwrap()
+            .map(|r| r.unwrap().to_record())
+            .collect::<Vec<_>>();
+        let slice_layouts = slices
+            .iter()
+            .find_map(|p| p.layout())
+            .unwrap()
+            .map(|r| r.unwrap().to_record())
+            .collect::<Vec<_>>();
+        let slice_indices = slices
+            .iter()
+            .find_map(|p| p.index())
+            .unwrap()
+            .collect::<Result<Vec<_>, _>>()
+            .unwrap();
+        let slice_content = slices.iter().find_map(|p| p.content()).unwrap();
+
+        assert_eq!(slice_meta, meta.body);
+        assert_eq!(slice_layouts, layouts.body);
+        assert_eq!(slice_indices, indices.body);
+        assert_eq!(slice_content.body.offset, content.body.offset);
+        assert_eq!(
+            reader.content_bytes(&slice_content).len() as u64,
+            content.header.stored_size
+        );
+
+        let mut lazy = read_slice(bytes).unwrap();
+        let mut kinds = vec![];
+        while let Some(payload) = lazy.next_payload().unwrap() {
+            if let Some(records) = payload.layout() {
+                assert_eq!(
+                    records.map(|r| r.unwrap().to_record()).collect::<Vec<_>>(),
+                    layouts.body
+                );
+            }
+            kinds.push(payload.header.kind);
+        }
+        assert_eq!(kinds, payloads.iter().map(|p| p.header().kind).collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn read_slice_rejects_impossible_sizes() {
+        // Meta payload compressed with zstd, with the given stored & plain sizes
+        let archive = |stored_size: u64, plain_size: u64| {
+            let mut bytes = BASH_TEST_STONE.to_vec();
+            bytes.extend(stored_size.to_be_bytes());
+            bytes.extend(plain_size.to_be_bytes());
+            bytes.extend([0; 8]);
+            bytes.extend(1u32.to_be_bytes());
+            bytes.extend(1u16.to_be_bytes());
+            bytes.extend([1, 2]);
+            bytes.extend([0; 4]);
+            bytes
+        };
+
+        let bytes = archive(u64::MAX, 4);
+        let error = read_slice(&bytes).unwrap().payloads().err().unwrap();
+        assert!(matches!(error, StoneReadError::Io(e) if e.kind() == io::ErrorKind::UnexpectedEof));
+
+        let bytes = archive(4, 1 << 40);
+        let error = read_slice(&bytes).unwrap().next_payload().err().unwrap();
+        assert!(matches!(error, StoneReadError::PayloadSize(size) if size == 1 << 40));
+    }
 }
@@ -0,0 +1,304 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+use std::{
+    io::{self, Read},
+    ops::Range,
+};
+
+use xxhash_rust::xxh3::xxh3_64;
+use zstd::stream::read::Decoder;
+
+use crate::{
+    StoneEvent, StoneHeader, StonePayload, StonePayloadAttributeRecordView, StonePayloadCompression,
+    StonePayloadContent, StonePayloadDecodeError, StonePayloadFrameRecord, StonePayloadHeader, StonePayloadIndexRecord,
+    StonePayloadKind, StonePayloadLayoutRecordView, StonePayloadLookupRecordView, StonePayloadMetaRecordView, event,
+    payload::RecordView,
+};
+
+use super::{StoneDecodeContext, StoneReadError};
+
+/// Read a stone archive which is fully resident in memory,
+/// such as a memory mapped file
+pub fn read_slice(bytes: &[u8]) -> Result<StoneSliceReader<'_>, StoneReadError> {
+    let header = StoneHeader::decode(bytes).map_err(StoneReadError::HeaderDecode)?;
+
+    Ok(StoneSliceReader {
+        header,
+        bytes,
+        arena: vec![],
+        decoded: vec![],
+        next: (0, StoneHeader::SIZE),
+        context: StoneDecodeContext::default(),
+    })
+}
+
+/// Most a zstd frame can expand a single stored byte, bounding the plain
+/// size a (possibly crafted) payload header can ask us to allocate
+const MAX_COMPRESSION_RATIO: u64 = 1 << 16;
+
+/// Zero-copy reader over an in-memory stone archive
+///
+/// Uncompressed payloads are borrowed straight from the source bytes,
+/// compressed payloads are decompressed into a single arena owned
+/// by the reader so records never need their own allocations.
+pub struct StoneSliceReader<'a> {
+    pub header: StoneHeader,
+    bytes: &'a [u8],
+    arena: Vec<u8>,
+    /// Bodies decompressed by [`Self::next_payload`], kept until the reader is
+    /// dropped so earlier payloads remain valid
+    decoded: Vec<Box<[u8]>>,
+    /// Index & offset of the payload [`Self::next_payload`] returns
+    next: (u16, usize),
+    context: StoneDecodeContext,
+}
+
+impl<'a> StoneSliceReader<'a> {
+    /// Swap the decode context used by this reader, returning the previous one
+    pub fn replace_context(&mut self, context: StoneDecodeContext) -> StoneDecodeContext {
+        std::mem::replace(&mut self.context, context)
+    }
+
+    /// The raw bytes backing this reader
+    pub fn as_bytes(&self) -> &'a [u8] {
+        self.bytes
+    }
+
+    /// Decode all payloads
+    ///
+    /// Record payloads are checksummed & decompressed up front, content
+    /// payloads are left untouched for the caller to unpack.
+    pub fn payloads(&mut self) -> Result<Vec<StoneSlicePayload<'_>>, StoneReadError> {
+        let mut located = Vec::with_capacity(self.header.num_payloads() as usize);
+        let mut offset = StoneHeader::SIZE;
+        let mut arena_size = 0usize;
+
+        for _ in 0..self.header.num_payloads() {
+            let Some((header, body)) = locate(self.bytes, offset)? else {
+                break;
+            };
+
+            let arena = if decompresses(&header) {
+                let start = arena_size;
+                arena_size = arena_size
+                    .checked_add(plain_len(&header)?)
+                    .ok_or(StoneReadError::PayloadSize(header.plain_size))?;
+                Some(start..arena_size)
+            } else {
+                None
+            };
+
+            offset = body.end;
+            located.push((header, body, arena));
+        }
+
+        self.arena.clear();
+        self.arena.resize(arena_size, 0);
+
+        for (header, body, arena) in &located {
+            if has_records(header) {
+                let plain = arena.clone().map(|arena| &mut self.arena[arena]);
+                decode(&mut self.context, &self.bytes[body.clone()], header, plain)?;
+            }
+        }
+
+        Ok(located
+            .into_iter()
+            .map(|(header, body, arena)| StoneSlicePayload {
+                header,
+                offset: body.start as u64,
+                body: match arena {
+                    Some(arena) => &self.arena[arena],
+                    None => &self.bytes[body],
+                },
+            })
+            .collect())
+    }
+
+    /// Decode the next payload, or `None` once all have been read
+    ///
+    /// Unlike [`Self::payloads`] only this payload is checksummed & decompressed,
+    /// into a buffer of its own which lives as long as the reader.
+    pub fn next_payload(&mut self) -> Result<Option<StoneSlicePayload<'_>>, StoneReadError> {
+        let (index, offset) = self.next;
+
+        if index >= self.header.num_payloads() {
+            return Ok(None);
+        }
+        let Some((header, body)) = locate(self.bytes, offset)? else {
+            return Ok(None);
+        };
+
+        self.next = (index + 1, body.end);
+
+        let stored = &self.bytes[body.clone()];
+        let plain = if decompresses(&header) {
+            let mut plain = vec![0; plain_len(&header)?].into_boxed_slice();
+            decode(&mut self.context, stored, &header, Some(&mut plain))?;
+            self.decoded.push(plain);
+            self.decoded.last().map(|plain| &plain[..])
+        } else {
+            if has_records(&header) {
+                decode(&mut self.context, stored, &header, None)?;
+            }
+            None
+        };
+
+        Ok(Some(StoneSlicePayload {
+            header,
+            offset: body.start as u64,
+            body: plain.unwrap_or(stored),
+        }))
+    }
+
+    /// Compressed bytes of the provided content payload, borrowed from the source
+    pub fn content_bytes(&self, content: &StonePayload<StonePayloadContent>) -> &'a [u8] {
+        let start = content.body.offset as usize;
+        &self.bytes[start..start + content.header.stored_size as usize]
+    }
+}
+
+/// A payload borrowed from a [`StoneSliceReader`]
+///
+/// For record payloads `body` holds the plain (decompressed) bytes, for
+/// everything else it holds the stored bytes as found in the archive.
+#[derive(Debug, Clone, Copy)]
+pub struct StoneSlicePayload<'a> {
+    pub header: StonePayloadHeader,
+    /// Offset of the body within the archive
+    pub offset: u64,
+    pub body: &'a [u8],
+}
+
+impl<'a> StoneSlicePayload<'a> {
+    pub fn meta(self) -> Option<impl Iterator<Item = Result<StonePayloadMetaRecordView<'a>, StonePayloadDecodeError>>> {
+        self.records::<StonePayloadMetaRecordView<'a>>(StonePayloadKind::Meta)
+    }
+
+    pub fn attributes(
+        self,
+    ) -> Option<impl Iterator<Item = Result<StonePayloadAttributeRecordView<'a>, StonePayloadDecodeError>>> {
+        self.records::<StonePayloadAttributeRecordView<'a>>(StonePayloadKind::Attributes)
+    }
+
+    pub fn layout(
+        self,
+    ) -> Option<impl Iterator<Item = Result<StonePayloadLayoutRecordView<'a>, StonePayloadDecodeError>>> {
+        self.records::<StonePayloadLayoutRecordView<'a>>(StonePayloadKind::Layout)
+    }
+
+    pub fn index(self) -> Option<impl Iterator<Item = Result<StonePayloadIndexRecord, StonePayloadDecodeError>>> {
+        self.records::<StonePayloadIndexRecord>(StonePayloadKind::Index)
+    }
+
+    pub fn frames(self) -> Option<impl Iterator<Item = Result<StonePayloadFrameRecord, StonePayloadDecodeError>>> {
+        self.records::<StonePayloadFrameRecord>(StonePayloadKind::Frames)
+    }
+
+    pub fn lookup(
+        self,
+    ) -> Option<impl Iterator<Item = Result<StonePayloadLookupRecordView<'a>, StonePayloadDecodeError>>> {
+        self.records::<StonePayloadLookupRecordView<'a>>(StonePayloadKind::Lookup)
+    }
+
+    pub fn content(self) -> Option<StonePayload<StonePayloadContent>> {
+        (self.header.kind == StonePayloadKind::Content).then_some(StonePayload {
+            header: self.header,
+            body: StonePayloadContent { offset: self.offset },
+        })
+    }
+
+    fn records<T: RecordView<'a>>(
+        self,
+        kind: StonePayloadKind,
+    ) -> Option<impl Iterator<Item = Result<T, StonePayloadDecodeError>>> {
+        if self.header.kind != kind || !has_records(&self.header) {
+            return None;
+        }
+
+        let mut bytes = self.body;
+
+        Some((0..self.header.num_records).map(move |_| T::decode_view(&mut bytes)))
+    }
+}
+
+/// Header & body of the payload at `offset`, or `None` if the archive ends there
+fn locate(bytes: &[u8], offset: usize) -> Result<Option<(StonePayloadHeader, Range<usize>)>, StoneReadError> {
+    let header = match StonePayloadHeader::decode(bytes.get(offset..).unwrap_or_default()) {
+        Ok(header) => header,
+        Err(StonePayloadDecodeError::Io(error)) if error.kind() == io::ErrorKind::UnexpectedEof => return Ok(None),
+        Err(error) => return Err(StoneReadError::PayloadDecode(error)),
+    };
+
+    // `offset` is within `bytes`, so only the stored size can overflow
+    let start = offset + StonePayloadHeader::SIZE;
+    let end = usize::try_from(header.stored_size)
+        .ok()
+        .and_then(|size| start.checked_add(size))
+        .filter(|end| *end <= bytes.len())
+        .ok_or_else(|| io::Error::from(io::ErrorKind::UnexpectedEof))?;
+
+    Ok(Some((header, start..end)))
+}
+
+/// Plain size of a compressed payload, if it's one zstd could have produced
+fn plain_len(header: &StonePayloadHeader) -> Result<usize, StoneReadError> {
+    if header.plain_size > header.stored_size.saturating_mul(MAX_COMPRESSION_RATIO) {
+        return Err(StoneReadError::PayloadSize(header.plain_size));
+    }
+
+    usize::try_from(header.plain_size).map_err(|_| StoneReadError::PayloadSize(header.plain_size))
+}
+
+/// Checksum the stored bytes of a record payload & decompress them into `plain`
+fn decode(
+    context: &mut StoneDecodeContext,
+    stored: &[u8],
+    header: &StonePayloadHeader,
+    plain: Option<&mut [u8]>,
+) -> Result<(), StoneReadError> {
+    let started = event::start();
+
+    validate_checksum(stored, header)?;
+    let checksum = started.map(|started| started.elapsed());
+
+    if let Some(plain) = plain {
+        let mut decoder = Decoder::with_context(stored, context.dctx()?);
+        decoder.read_exact(plain)?;
+    }
+
+    if let (Some(started), Some(checksum)) = (started, checksum) {
+        event::emit(StoneEvent::PayloadDecoded {
+            kind: header.kind,
+            stored_size: header.stored_size,
+            plain_size: header.plain_size,
+            elapsed: started.elapsed(),
+            checksum,
+        });
+    }
+
+    Ok(())
+}
+
+/// Record payload whose body needs decompressing before use
+fn decompresses(header: &StonePayloadHeader) -> bool {
+    has_records(header) && header.compression == StonePayloadCompression::Zstd
+}
+
+/// Known record payload which we're able to decode
+fn has_records(header: &StonePayloadHeader) -> bool {
+    !matches!(header.kind, StonePayloadKind::Content | StonePayloadKind::Unknown)
+        && !matches!(header.compression, StonePayloadCompression::Unknown)
+}
+
+fn validate_checksum(stored: &[u8], header: &StonePayloadHeader) -> Result<(), StoneReadError> {
+    let got = xxh3_64(stored);
+    let expected = u64::from_be_bytes(header.checksum);
+
+    if got != expected {
+        Err(StoneReadError::PayloadChecksum { got, expected })
+    } else {
+        Ok(())
+    }
+}
@@ -0,0 +1,235 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+use std::{
+    io::{self, Read, Seek, SeekFrom, Write},
+    num::NonZeroUsize,
+    sync::{Mutex, mpsc},
+    thread,
+};
+
+use crate::{StoneEvent, StonePayload, StonePayloadContent, StonePayloadIndexRecord, event};
+
+use super::{PayloadReader, StoneReadError, StoneReader, digest, emit_content_unpacked, validate_checksum};
+
+/// Assets larger than this are streamed straight to their writer on the
+/// decompressing thread instead of being buffered & handed to a worker
+const MAX_BUFFERED_ASSET: u64 = 4 * 1024 * 1024;
+
+/// Destination for the assets of a content payload, see [`StoneReader::unpack_content_to`]
+///
+/// Methods are called concurrently from a pool of worker threads.
+pub trait StoneContentSink: Sync {
+    /// Dropped without being committed when the asset fails, e.g. on a digest
+    /// mismatch, so should discard anything it wrote
+    type Writer: Write + Send;
+
+    /// Open a writer for the asset described by `index`, or `None`
+    /// if it's already present and should be skipped
+    fn create(&self, index: &StonePayloadIndexRecord) -> io::Result<Option<Self::Writer>>;
+
+    /// All bytes of the asset were written and its digest matches
+    fn commit(&self, index: &StonePayloadIndexRecord, writer: Self::Writer) -> io::Result<()>;
+}
+
+impl<R: Read + Seek> StoneReader<R> {
+    /// Unpack every asset described by `indices` from the content payload
+    /// directly into `sink`, without staging the decompressed payload.
+    ///
+    /// Decompression happens on the calling thread while creating, verifying
+    /// and writing assets fans out over `workers` threads. Assets of up to
+    /// 4 MiB are buffered for them, at most `3 * workers + 1` at once: one held
+    /// by each worker, `2 * workers` queued and one being decompressed, so the
+    /// bound is `(3 * workers + 1) * 4 MiB`. Larger assets are streamed to the
+    /// sink on the calling thread without buffering. Callers unpacking several
+    /// payloads at once should split their threads between them. `on_progress`
+    /// receives the number of decompressed bytes as they are produced.
+    pub fn unpack_content_to<S: StoneContentSink>(
+        &mut self,
+        content: &StonePayload<StonePayloadContent>,
+        indices: &[StonePayloadIndexRecord],
+        sink: &S,
+        workers: NonZeroUsize,
+        mut on_progress: impl FnMut(u64),
+    ) -> Result<(), StoneReadError> {
+        let started = event::start();
+
+        let mut indices = indices.to_vec();
+        indices.sort_by_key(|index| index.start);
+        indices.dedup();
+
+        self.reader.seek(SeekFrom::Start(content.body.offset))?;
+        self.hasher.reset();
+
+        let hashed = digest::Reader::new(&mut self.reader, &mut self.hasher);
+        let mut decoder = PayloadReader::new(
+            hashed.take(content.header.stored_size),
+            &content.header,
+            &mut self.context,
+        )?;
+
+        let workers = workers.get();
+        let failure = Mutex::new(None);
+
+        thread::scope(|scope| -> Result<(), StoneReadError> {
+            let (sender, receiver) = mpsc::sync_channel::<(StonePayloadIndexRecord, Vec<u8>)>(workers * 2);
+            let receiver = Mutex::new(receiver);
+
+            for _ in 0..workers {
+                scope.spawn(|| {
+                    loop {
+                        // Release the lock before doing any work on the job
+                        let job = receiver.lock().unwrap_or_else(|e| e.into_inner()).recv();
+                        let Ok((index, data)) = job else {
+                            break;
+                        };
+
+                        if let Err(error) = write_buffered(sink, &index, &data) {
+                            failure.lock().unwrap_or_else(|e| e.into_inner()).get_or_insert(error);
+                        }
+                    }
+                });
+            }
+
+            let mut position = 0;
+
+            for index in &indices {
+                if failure.lock().unwrap_or_else(|e| e.into_inner()).is_some() {
+                    return Ok(());
+                }
+
+                // Overlapping ranges can't be streamed
+                if index.start < position {
+                    Err(io::Error::new(io::ErrorKind::InvalidData, "overlapping index ranges"))?;
+                }
+
+                let gap = index.start - position;
+                io::copy(&mut (&mut decoder).take(gap), &mut io::sink())?;
+                on_progress(gap);
+
+                let length = index.end - index.start;
+
+                if length > MAX_BUFFERED_ASSET {
+                    write_streamed(sink, index, &mut (&mut decoder).take(length))?;
+                } else {
+                    let mut data = vec![0; length as usize];
+                    decoder.read_exact(&mut data)?;
+
+                    if sender.send((*index, data)).is_err() {
+                        break;
+                    }
+                }
+
+                position = index.end;
+                on_progress(length);
+            }
+
+            // Drain whatever trails the last asset so the checksum covers the full payload
+            on_progress(io::copy(&mut decoder, &mut io::sink())?);
+
+            Ok(())
+        })?;
+
+        if let Some(error) = failure.into_inner().unwrap_or_else(|e| e.into_inner()) {
+            return Err(error);
+        }
+
+        drop(decoder);
+        validate_checksum(&self.hasher, &content.header)?;
+        emit_content_unpacked(started, &self.hasher, &content.header);
+
+        Ok(())
+    }
+}
+
+fn write_buffered<S: StoneContentSink>(
+    sink: &S,
+    index: &StonePayloadIndexRecord,
+    data: &[u8],
+) -> Result<(), StoneReadError> {
+    let mut hasher = digest::Hasher::new();
+    hasher.update(data);
+    let actual = hasher.digest128();
+
+    if actual != index.digest {
+        return Err(StoneReadError::AssetChecksum {
+            got: actual,
+            expected: index.digest,
+        });
+    }
+
+    emit_asset_verified(index, &hasher);
+
+    if let Some(mut writer) = sink.create(index)? {
+        writer.write_all(data)?;
+        sink.commit(index, writer)?;
+    }
+
+    Ok(())
+}
+
+fn write_streamed<S: StoneContentSink>(
+    sink: &S,
+    index: &StonePayloadIndexRecord,
+    reader: &mut impl Read,
+) -> Result<(), StoneReadError> {
+    let mut hasher = digest::Hasher::new();
+
+    let writer = sink.create(index)?;
+    let mut hashed = HashWriter {
+        writer,
+        hasher: &mut hasher,
+    };
+
+    io::copy(reader, &mut hashed)?;
+
+    let HashWriter { writer, .. } = hashed;
+    let actual = hasher.digest128();
+
+    if actual != index.digest {
+        return Err(StoneReadError::AssetChecksum {
+            got: actual,
+            expected: index.digest,
+        });
+    }
+
+    emit_asset_verified(index, &hasher);
+
+    if let Some(writer) = writer {
+        sink.commit(index, writer)?;
+    }
+
+    Ok(())
+}
+
+fn emit_asset_verified(index: &StonePayloadIndexRecord, hasher: &digest::Hasher) {
+    if event::enabled() {
+        event::emit(StoneEvent::AssetVerified {
+            size: index.end - index.start,
+            elapsed: hasher.elapsed(),
+        });
+    }
+}
+
+/// Hashes everything, forwarding to `writer` when the asset isn't skipped
+struct HashWriter<'a, W> {
+    writer: Option<W>,
+    hasher: &'a mut digest::Hasher,
+}
+
+impl<W: Write> Write for HashWriter<'_, W> {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let written = match &mut self.writer {
+            Some(writer) => writer.write(buf)?,
+            None => buf.len(),
+        };
+
+        self.hasher.update(&buf[..written]);
+
+        Ok(written)
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        self.writer.as_mut().map_or(Ok(()), Write::flush)
+    }
+}
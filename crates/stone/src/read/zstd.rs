@@ -1,33 +1,140 @@
 // SPDX-FileCopyrightText: 2023 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
 
-use std::io::{BufReader, Read, Result};
+use std::io::{self, BufRead, Read, Result};
 
 use zstd::stream::read::Decoder;
+use zstd::zstd_safe::{self, DCtx, DParameter, ResetDirective};
 
-pub struct Zstd<R: Read> {
-    decoder: Decoder<'static, BufReader<R>>,
+/// Largest window a frame may ask for. zstd sizes the window of each frame
+/// from its own frame header, this only lifts the default limit of 2^27 so
+/// content written with a larger window log can still be read.
+const WINDOW_LOG_MAX: u32 = 31;
+
+/// Decompression state which can be reused across payloads & archives
+///
+/// Creating a zstd decoder allocates its context and, once the first frame
+/// is seen, a window buffer of up to 2 GiB. Holding on to a context lets
+/// subsequent payloads reuse both instead of allocating them again.
+#[derive(Default)]
+pub struct StoneDecodeContext {
+    dctx: Option<DCtx<'static>>,
+    /// Scratch buffer for compressed input
+    buffer: Vec<u8>,
 }
 
-impl<R: Read> Zstd<R> {
-    pub fn new(reader: R) -> Result<Self> {
-        let mut decoder = Decoder::new(reader)?;
-        decoder.window_log_max(31)?;
+impl StoneDecodeContext {
+    /// Create an empty context, nothing is allocated until first use
+    pub fn new() -> Self {
+        Self::default()
+    }
 
-        Ok(Self { decoder })
+    /// The zstd context, ready to decode a new frame
+    pub(crate) fn dctx(&mut self) -> Result<&mut DCtx<'static>> {
+        prepare(&mut self.dctx)
+    }
+
+    fn parts(&mut self) -> Result<(&mut DCtx<'static>, &mut [u8])> {
+        if self.buffer.is_empty() {
+            self.buffer = vec![0; DCtx::in_size()];
+        }
+
+        Ok((prepare(&mut self.dctx)?, self.buffer.as_mut_slice()))
+    }
+}
+
+fn prepare(dctx: &mut Option<DCtx<'static>>) -> Result<&mut DCtx<'static>> {
+    let mut context = match dctx.take() {
+        Some(mut context) => {
+            // Previous use may have stopped part way through a frame
+            context.reset(ResetDirective::SessionOnly).map_err(map_error_code)?;
+            context
+        }
+        None => DCtx::try_create().ok_or_else(|| io::Error::other("failed to create zstd context"))?,
+    };
+
+    context
+        .set_parameter(DParameter::WindowLogMax(WINDOW_LOG_MAX))
+        .map_err(map_error_code)?;
+
+    Ok(dctx.insert(context))
+}
+
+pub struct Zstd<'a, R: Read> {
+    decoder: Decoder<'a, Buffered<'a, R>>,
+}
+
+impl<'a, R: Read> Zstd<'a, R> {
+    pub fn new(reader: R, context: &'a mut StoneDecodeContext) -> Result<Self> {
+        let (dctx, buffer) = context.parts()?;
+
+        Ok(Self {
+            decoder: Decoder::with_context(Buffered::new(reader, buffer), dctx),
+        })
     }
 
     pub fn get_mut(&mut self) -> &mut R {
-        self.decoder.get_mut().get_mut()
+        &mut self.decoder.get_mut().inner
     }
 
     pub fn capacity(&self) -> usize {
-        self.decoder.get_ref().capacity()
+        self.decoder.get_ref().buffer.len()
     }
 }
 
-impl<R: Read> Read for Zstd<R> {
+impl<R: Read> Read for Zstd<'_, R> {
     fn read(&mut self, buf: &mut [u8]) -> Result<usize> {
         self.decoder.read(buf)
     }
 }
+
+/// [`io::BufReader`] over a borrowed buffer so it can be reused
+pub struct Buffered<'a, R> {
+    inner: R,
+    buffer: &'a mut [u8],
+    pos: usize,
+    filled: usize,
+}
+
+impl<'a, R> Buffered<'a, R> {
+    fn new(inner: R, buffer: &'a mut [u8]) -> Self {
+        Self {
+            inner,
+            buffer,
+            pos: 0,
+            filled: 0,
+        }
+    }
+}
+
+impl<R: Read> Read for Buffered<'_, R> {
+    fn read(&mut self, buf: &mut [u8]) -> Result<usize> {
+        let available = self.fill_buf()?;
+        let amount = available.len().min(buf.len());
+
+        buf[..amount].copy_from_slice(&available[..amount]);
+        self.consume(amount);
+
+        Ok(amount)
+    }
+}
+
+impl<R: Read> BufRead for Buffered<'_, R> {
+    fn fill_buf(&mut self) -> Result<&[u8]> {
+        if self.pos >= self.filled {
+            self.filled = self.inner.read(self.buffer)?;
+            self.pos = 0;
+        }
+
+        Ok(&self.buffer[self.pos..self.filled])
+    }
+
+    fn consume(&mut self, amount: usize) {
+        self.pos = (self.pos + amount).min(self.filled);
+    }
+}
+
+fn map_error_code(code: usize) -> io::Error {
+    let msg = zstd_safe::get_error_name(code);
+    io::Error::other(msg.to_owned())
+}
@@ -6,8 +6,8 @@ use thiserror::Error;
 
 use crate::{
     StoneHeader, StoneHeaderV1, StoneHeaderV1FileType, StonePayloadAttributeRecord, StonePayloadCompression,
-    StonePayloadEncodeError, StonePayloadHeader, StonePayloadIndexRecord, StonePayloadKind, StonePayloadLayoutRecord,
-    StonePayloadMetaRecord, payload,
+    StonePayloadEncodeError, StonePayloadFrameRecord, StonePayloadHeader, StonePayloadIndexRecord, StonePayloadKind,
+    StonePayloadLayoutRecord, StonePayloadLookupRecord, StonePayloadMetaRecord, payload,
 };
 
 pub use self::digest::{StoneDigestWriter, StoneDigestWriterHasher};
@@ -23,6 +23,23 @@ pub struct StoneWriter<W, T> {
     payload_hasher: StoneDigestWriterHasher,
     // TODO: Allow plain encoding?
     encoder: zstd::Encoder,
+    parameters: zstd::Parameters,
+}
+
+impl<W, T> StoneWriter<W, T> {
+    /// Offset from the start of the archive the next payload added will be
+    /// written at, for recording in a [`StonePayloadLookupRecord`]
+    ///
+    /// Content is always written last, so this doesn't depend on it.
+    pub fn payload_offset(&self) -> u64 {
+        let payloads = self
+            .payloads
+            .iter()
+            .map(|payload| (StonePayloadHeader::SIZE + payload.content.len()) as u64)
+            .sum::<u64>();
+
+        StoneHeader::SIZE as u64 + payloads
+    }
 }
 
 impl<W: Write> StoneWriter<W, ()> {
@@ -33,10 +50,45 @@ impl<W: Write> StoneWriter<W, ()> {
             file_type,
             payloads: vec![],
             payload_hasher: StoneDigestWriterHasher::new(),
-            encoder: zstd::Encoder::new()?,
+            encoder: zstd::Encoder::new(&zstd::Parameters::default())?,
+            parameters: zstd::Parameters::default(),
+        })
+    }
+
+    /// zstd level used for every payload written from here on, including content
+    pub fn set_compression_level(&mut self, level: i32) -> Result<(), StoneWriteError> {
+        self.configure(zstd::Parameters {
+            level,
+            ..self.parameters
+        })
+    }
+
+    /// Log2 of the zstd window, `31` by default
+    ///
+    /// Readers size their window from the frame headers of the payload, so
+    /// they need as much memory to decode it as was used to write it.
+    pub fn set_window_log(&mut self, window_log: u32) -> Result<(), StoneWriteError> {
+        self.configure(zstd::Parameters {
+            window_log,
+            ..self.parameters
+        })
+    }
+
+    /// Find matches across the whole window, which mostly benefits large
+    /// content with repetition further apart than the default search reaches
+    pub fn set_long_distance_matching(&mut self, enabled: bool) -> Result<(), StoneWriteError> {
+        self.configure(zstd::Parameters {
+            long_distance_matching: enabled,
+            ..self.parameters
         })
     }
 
+    fn configure(&mut self, parameters: zstd::Parameters) -> Result<(), StoneWriteError> {
+        self.encoder.configure(&parameters)?;
+        self.parameters = parameters;
+        Ok(())
+    }
+
     pub fn add_payload<'a>(&mut self, payload: impl Into<StoneWritePayload<'a>>) -> Result<(), StoneWriteError> {
         self.payloads.push(encode_payload(
             payload.into().into(),
@@ -52,7 +104,44 @@ impl<W: Write> StoneWriter<W, ()> {
         pledged_size: Option<u64>,
         num_workers: u32,
     ) -> Result<StoneWriter<W, StoneContentWriter<B>>, StoneWriteError> {
-        let mut encoder = zstd::Encoder::new()?;
+        self.content_writer(buffer, pledged_size, num_workers, None)
+    }
+
+    /// Like [`StoneWriter::with_content`] but the content payload is split into
+    /// independent zstd frames, recorded in a frames payload, so single files
+    /// can be extracted without decompressing everything before them.
+    ///
+    /// A frame is cut at the first index boundary once it holds at least
+    /// `frame_size` plain bytes, `0` cuts a frame for every file. Readers
+    /// unaware of frames still decode the frames sequentially.
+    pub fn with_seekable_content<B>(
+        self,
+        buffer: B,
+        frame_size: u64,
+        num_workers: u32,
+    ) -> Result<StoneWriter<W, StoneContentWriter<B>>, StoneWriteError> {
+        // Frames have differing sizes, so nothing can be pledged
+        self.content_writer(
+            buffer,
+            None,
+            num_workers,
+            Some(ContentFrames {
+                frame_size,
+                records: vec![],
+                plain_start: 0,
+                stored_start: 0,
+            }),
+        )
+    }
+
+    fn content_writer<B>(
+        self,
+        buffer: B,
+        pledged_size: Option<u64>,
+        num_workers: u32,
+        frames: Option<ContentFrames>,
+    ) -> Result<StoneWriter<W, StoneContentWriter<B>>, StoneWriteError> {
+        let mut encoder = zstd::Encoder::new(&self.parameters)?;
         encoder.set_pledged_size(pledged_size)?;
         encoder.set_num_workers(num_workers)?;
 
@@ -63,6 +152,7 @@ impl<W: Write> StoneWriter<W, ()> {
                 plain_size: 0,
                 stored_size: 0,
                 indices: vec![],
+                frames,
                 index_hasher: StoneDigestWriterHasher::new(),
                 buffer_hasher: StoneDigestWriterHasher::new(),
                 encoder,
@@ -71,6 +161,7 @@ impl<W: Write> StoneWriter<W, ()> {
             payloads: self.payloads,
             payload_hasher: self.payload_hasher,
             encoder: self.encoder,
+            parameters: self.parameters,
         })
     }
 
@@ -93,7 +184,8 @@ where
         Ok(())
     }
 
-    pub fn add_content<R: Read>(&mut self, content: &mut R) -> Result<(), StoneWriteError> {
+    /// Compress `content` as the next file, returning its index record
+    pub fn add_content<R: Read>(&mut self, content: &mut R) -> Result<StonePayloadIndexRecord, StoneWriteError> {
         // Reset index hasher for this file
         self.content.index_hasher.reset();
 
@@ -128,23 +220,42 @@ where
         let end = self.content.plain_size;
 
         // Add index data
-        self.content
-            .indices
-            .push(StonePayloadIndexRecord { start, end, digest });
+        let index = StonePayloadIndexRecord { start, end, digest };
+        self.content.indices.push(index);
+
+        // Cut the frame on this index boundary once it's large enough
+        if self
+            .content
+            .frames
+            .as_ref()
+            .is_some_and(|frames| end > frames.plain_start && end - frames.plain_start >= frames.frame_size)
+        {
+            self.content.finish_frame()?;
+        }
 
-        Ok(())
+        Ok(index)
     }
 
     pub fn finalize(mut self) -> Result<(), StoneWriteError> {
         // Finish frame & get content payload checksum
         let checksum = {
-            let mut writer = StoneDigestWriter::new(&mut self.content.buffer, &mut self.content.buffer_hasher);
-            self.content.encoder.finish(&mut writer)?;
-            writer.flush()?;
-            self.content.stored_size += writer.bytes as u64;
+            match &self.content.frames {
+                // Don't emit an empty trailing frame if the last one was just cut
+                Some(frames) if frames.plain_start == self.content.plain_size && !frames.records.is_empty() => {}
+                _ => self.content.finish_frame()?,
+            }
             self.content.buffer_hasher.digest()
         };
 
+        // Add frames payload
+        if let Some(frames) = &self.content.frames {
+            self.payloads.push(encode_payload(
+                InnerPayload::Frames(&frames.records),
+                &mut self.payload_hasher,
+                &mut self.encoder,
+            )?);
+        }
+
         // Add index payloads
         self.payloads.push(encode_payload(
             InnerPayload::Index(&self.content.indices),
@@ -166,6 +277,8 @@ pub struct StoneContentWriter<B> {
     plain_size: u64,
     stored_size: u64,
     indices: Vec<StonePayloadIndexRecord>,
+    /// Only set for seekable content
+    frames: Option<ContentFrames>,
     /// Used to generate un-compressed digest of file
     /// contents used for [`Index`]
     index_hasher: StoneDigestWriterHasher,
@@ -175,6 +288,39 @@ pub struct StoneContentWriter<B> {
     encoder: zstd::Encoder,
 }
 
+impl<B: Write> StoneContentWriter<B> {
+    /// Finish the current zstd frame, recording it when seekable
+    fn finish_frame(&mut self) -> Result<(), StoneWriteError> {
+        let mut writer = StoneDigestWriter::new(&mut self.buffer, &mut self.buffer_hasher);
+        self.encoder.finish(&mut writer)?;
+        writer.flush()?;
+        self.stored_size += writer.bytes as u64;
+
+        if let Some(frames) = &mut self.frames {
+            frames.records.push(StonePayloadFrameRecord {
+                plain_start: frames.plain_start,
+                plain_end: self.plain_size,
+                stored_start: frames.stored_start,
+                stored_end: self.stored_size,
+            });
+
+            frames.plain_start = self.plain_size;
+            frames.stored_start = self.stored_size;
+        }
+
+        Ok(())
+    }
+}
+
+struct ContentFrames {
+    /// Minimum plain bytes before a frame is cut
+    frame_size: u64,
+    records: Vec<StonePayloadFrameRecord>,
+    /// Where the current frame started
+    plain_start: u64,
+    stored_start: u64,
+}
+
 struct EncodedPayload {
     header: StonePayloadHeader,
     content: Vec<u8>,
@@ -184,6 +330,8 @@ pub enum StoneWritePayload<'a> {
     Meta(&'a [StonePayloadMetaRecord]),
     Attributes(&'a [StonePayloadAttributeRecord]),
     Layout(&'a [StonePayloadLayoutRecord]),
+    /// Must be sorted by kind & key, see [`StonePayloadLookupRecord::find`]
+    Lookup(&'a [StonePayloadLookupRecord]),
 }
 
 impl<'a> From<StoneWritePayload<'a>> for InnerPayload<'a> {
@@ -192,6 +340,7 @@ impl<'a> From<StoneWritePayload<'a>> for InnerPayload<'a> {
             StoneWritePayload::Meta(payload) => InnerPayload::Meta(payload),
             StoneWritePayload::Attributes(payload) => InnerPayload::Attributes(payload),
             StoneWritePayload::Layout(payload) => InnerPayload::Layout(payload),
+            StoneWritePayload::Lookup(payload) => InnerPayload::Lookup(payload),
         }
     }
 }
@@ -204,6 +353,8 @@ enum InnerPayload<'a> {
     Attributes(&'a [StonePayloadAttributeRecord]),
     Layout(&'a [StonePayloadLayoutRecord]),
     Index(&'a [StonePayloadIndexRecord]),
+    Frames(&'a [StonePayloadFrameRecord]),
+    Lookup(&'a [StonePayloadLookupRecord]),
 }
 
 impl InnerPayload<'_> {
@@ -213,6 +364,8 @@ impl InnerPayload<'_> {
             InnerPayload::Attributes(records) => payload::records_total_size(records),
             InnerPayload::Layout(records) => payload::records_total_size(records),
             InnerPayload::Index(records) => payload::records_total_size(records),
+            InnerPayload::Frames(records) => payload::records_total_size(records),
+            InnerPayload::Lookup(records) => payload::records_total_size(records),
         }
     }
 
@@ -222,6 +375,8 @@ impl InnerPayload<'_> {
             InnerPayload::Attributes(payload) => payload.len(),
             InnerPayload::Layout(payload) => payload.len(),
             InnerPayload::Index(payload) => payload.len(),
+            InnerPayload::Frames(payload) => payload.len(),
+            InnerPayload::Lookup(payload) => payload.len(),
         }
     }
 
@@ -231,6 +386,8 @@ impl InnerPayload<'_> {
             InnerPayload::Attributes(records) => payload::encode_records(writer, records)?,
             InnerPayload::Layout(records) => payload::encode_records(writer, records)?,
             InnerPayload::Index(records) => payload::encode_records(writer, records)?,
+            InnerPayload::Frames(records) => payload::encode_records(writer, records)?,
+            InnerPayload::Lookup(records) => payload::encode_records(writer, records)?,
         }
         Ok(())
     }
@@ -241,6 +398,8 @@ impl InnerPayload<'_> {
             InnerPayload::Attributes(_) => StonePayloadKind::Attributes,
             InnerPayload::Layout(_) => StonePayloadKind::Layout,
             InnerPayload::Index(_) => StonePayloadKind::Index,
+            InnerPayload::Frames(_) => StonePayloadKind::Frames,
+            InnerPayload::Lookup(_) => StonePayloadKind::Lookup,
         }
     }
 }
@@ -263,6 +422,12 @@ impl<'a> From<&'a [StonePayloadLayoutRecord]> for StoneWritePayload<'a> {
     }
 }
 
+impl<'a> From<&'a [StonePayloadLookupRecord]> for StoneWritePayload<'a> {
+    fn from(payload: &'a [StonePayloadLookupRecord]) -> Self {
+        Self::Lookup(payload)
+    }
+}
+
 fn encode_payload(
     payload: InnerPayload<'_>,
     hasher: &mut StoneDigestWriterHasher,
@@ -9,6 +9,25 @@ use zstd::zstd_safe::{CParameter, ResetDirective};
 
 type Context = zstd_safe::CCtx<'static>;
 
+/// Compression parameters shared by every payload of a stone
+#[derive(Debug, Clone, Copy)]
+pub struct Parameters {
+    pub level: i32,
+    /// Log2 of the match window, which readers need as much memory for
+    pub window_log: u32,
+    pub long_distance_matching: bool,
+}
+
+impl Default for Parameters {
+    fn default() -> Self {
+        Self {
+            level: 18,
+            window_log: 31,
+            long_distance_matching: false,
+        }
+    }
+}
+
 /// Transparent encapsulation of zstd compression with the purpose
 /// of encoding moss (.stone) payloads to a stream
 pub struct Writer<'a, W: Write> {
@@ -74,19 +93,30 @@ pub struct Encoder {
 
 impl Encoder {
     /// Concrete zstd encoder
-    pub fn new() -> Result<Self> {
-        let mut context = Context::create();
-        context
-            .set_parameter(CParameter::CompressionLevel(18))
-            .map_err(map_error_code)?;
-        context
-            .set_parameter(CParameter::WindowLog(31))
-            .map_err(map_error_code)?;
-        Ok(Self {
-            context,
+    pub fn new(parameters: &Parameters) -> Result<Self> {
+        let mut encoder = Self {
+            context: Context::create(),
             output: vec![0; Context::out_size()],
             read_size: Context::in_size(),
-        })
+        };
+        encoder.configure(parameters)?;
+        Ok(encoder)
+    }
+
+    /// Apply `parameters` to all frames from here on
+    pub fn configure(&mut self, parameters: &Parameters) -> Result<()> {
+        self.context
+            .set_parameter(CParameter::CompressionLevel(parameters.level))
+            .map_err(map_error_code)?;
+        self.context
+            .set_parameter(CParameter::WindowLog(parameters.window_log))
+            .map_err(map_error_code)?;
+        self.context
+            .set_parameter(CParameter::EnableLongDistanceMatching(
+                parameters.long_distance_matching,
+            ))
+            .map_err(map_error_code)?;
+        Ok(())
     }
 
     /// Let zstd know of the final uncompressed size, to optimise compression
@@ -0,0 +1,172 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+//! Chrome trace event output, viewable in Perfetto or `about:tracing`
+//!
+//! Every span is written as one complete event once it closes, with its fields as
+//! arguments, and every event as an instant event. Events are written as lines of an
+//! open JSON array, which the trace viewers accept without the closing bracket, so
+//! the trace remains usable however the process exits.
+
+use std::{
+    fmt,
+    io::Write,
+    process,
+    sync::{
+        Mutex,
+        atomic::{AtomicU64, Ordering},
+    },
+    time::Instant,
+};
+
+use serde_json::{Map, Value, json};
+use tracing::{
+    Event, Subscriber,
+    field::{Field, Visit},
+    span,
+};
+use tracing_subscriber::{Layer, layer::Context, registry::LookupSpan};
+
+pub struct ChromeLayer<W> {
+    writer: Mutex<W>,
+    epoch: Instant,
+}
+
+impl<W: Write> ChromeLayer<W> {
+    /// Write the trace to `writer`, which should flush every line
+    pub fn new(mut writer: W) -> Self {
+        let _ = writeln!(writer, "[");
+
+        Self {
+            writer: Mutex::new(writer),
+            epoch: Instant::now(),
+        }
+    }
+
+    fn write(&self, event: Value) {
+        let mut writer = self.writer.lock().unwrap_or_else(|e| e.into_inner());
+        let _ = writeln!(writer, "{event},");
+    }
+
+    /// Microseconds since the layer was created
+    fn timestamp(&self, at: Instant) -> f64 {
+        at.duration_since(self.epoch).as_nanos() as f64 / 1e3
+    }
+}
+
+/// Fields & timing of a span, kept in its extensions until it closes
+struct Timing {
+    started: Instant,
+    tid: u64,
+    args: Map<String, Value>,
+}
+
+impl<S, W> Layer<S> for ChromeLayer<W>
+where
+    S: Subscriber + for<'a> LookupSpan<'a>,
+    W: Write + Send + 'static,
+{
+    fn on_new_span(&self, attrs: &span::Attributes<'_>, id: &span::Id, ctx: Context<'_, S>) {
+        let Some(span) = ctx.span(id) else {
+            return;
+        };
+
+        let mut args = Map::new();
+        attrs.record(&mut Args(&mut args));
+
+        span.extensions_mut().insert(Timing {
+            started: Instant::now(),
+            tid: thread_id(),
+            args,
+        });
+    }
+
+    fn on_record(&self, id: &span::Id, values: &span::Record<'_>, ctx: Context<'_, S>) {
+        if let Some(span) = ctx.span(id)
+            && let Some(timing) = span.extensions_mut().get_mut::<Timing>()
+        {
+            values.record(&mut Args(&mut timing.args));
+        }
+    }
+
+    fn on_event(&self, event: &Event<'_>, _ctx: Context<'_, S>) {
+        let mut args = Map::new();
+        event.record(&mut Args(&mut args));
+
+        let metadata = event.metadata();
+        let name = match args.remove("message") {
+            Some(Value::String(message)) => message,
+            _ => metadata.name().to_owned(),
+        };
+
+        self.write(json!({
+            "name": name,
+            "cat": metadata.target(),
+            "ph": "i",
+            "s": "t",
+            "ts": self.timestamp(Instant::now()),
+            "pid": process::id(),
+            "tid": thread_id(),
+            "args": args,
+        }));
+    }
+
+    fn on_close(&self, id: span::Id, ctx: Context<'_, S>) {
+        let Some(span) = ctx.span(&id) else {
+            return;
+        };
+        let Some(timing) = span.extensions_mut().remove::<Timing>() else {
+            return;
+        };
+
+        self.write(json!({
+            "name": span.name(),
+            "cat": span.metadata().target(),
+            "ph": "X",
+            "ts": self.timestamp(timing.started),
+            "dur": timing.started.elapsed().as_nanos() as f64 / 1e3,
+            "pid": process::id(),
+            "tid": timing.tid,
+            "args": timing.args,
+        }));
+    }
+}
+
+/// Small, stable id of the current thread, as trace viewers expect numbers
+fn thread_id() -> u64 {
+    static NEXT: AtomicU64 = AtomicU64::new(1);
+
+    thread_local! {
+        static ID: u64 = NEXT.fetch_add(1, Ordering::Relaxed);
+    }
+
+    ID.with(|id| *id)
+}
+
+struct Args<'a>(&'a mut Map<String, Value>);
+
+impl Visit for Args<'_> {
+    fn record_f64(&mut self, field: &Field, value: f64) {
+        self.0.insert(field.name().to_owned(), json!(value));
+    }
+
+    fn record_i64(&mut self, field: &Field, value: i64) {
+        self.0.insert(field.name().to_owned(), json!(value));
+    }
+
+    fn record_u64(&mut self, field: &Field, value: u64) {
+        self.0.insert(field.name().to_owned(), json!(value));
+    }
+
+    fn record_bool(&mut self, field: &Field, value: bool) {
+        self.0.insert(field.name().to_owned(), json!(value));
+    }
+
+    fn record_str(&mut self, field: &Field, value: &str) {
+        self.0.insert(field.name().to_owned(), json!(value));
+    }
+
+    fn record_debug(&mut self, field: &Field, value: &dyn fmt::Debug) {
+        self.0.insert(field.name().to_owned(), json!(format!("{value:?}")));
+    }
+}
@@ -3,4 +3,5 @@
 
 //! Common tracing utilities for moss and related tools
 
+pub mod chrome;
 pub mod logging;
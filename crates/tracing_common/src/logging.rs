@@ -3,14 +3,22 @@
 
 //! Tracing logging and configuration utilities
 
-use std::{fs::OpenOptions, io, str::FromStr};
+use std::{
+    fs::OpenOptions,
+    io::{self, LineWriter},
+    str::FromStr,
+};
 use tracing::level_filters::LevelFilter;
 use tracing_subscriber::{fmt, layer::SubscriberExt as _, util::SubscriberInitExt as _};
 
+use crate::chrome::ChromeLayer;
+
 #[derive(Debug, Clone, Copy)]
 pub enum OutputFormat {
     Text,
     Json,
+    /// Chrome trace events, see [`crate::chrome`]
+    Chrome,
 }
 
 #[derive(Debug, Clone)]
@@ -65,6 +73,25 @@ pub fn init_log(format: OutputFormat, level: LevelFilter, destination: OutputDes
                 .with(fmt::layer().json().with_writer(file))
                 .init();
         }
+        (OutputFormat::Chrome, OutputDestination::Stderr) => {
+            tracing_subscriber::registry()
+                .with(filter)
+                .with(ChromeLayer::new(io::stderr()))
+                .init();
+        }
+        (OutputFormat::Chrome, OutputDestination::File(path)) => {
+            // A trace is a single JSON array, so never append to an old one
+            let file = OpenOptions::new()
+                .create(true)
+                .write(true)
+                .truncate(true)
+                .open(&path)
+                .unwrap_or_else(|e| panic!("Failed to open log file {path}: {e}"));
+            tracing_subscriber::registry()
+                .with(filter)
+                .with(ChromeLayer::new(LineWriter::new(file)))
+                .init();
+        }
     }
 }
 
@@ -103,7 +130,13 @@ impl FromStr for LogConfig {
             match parts[1].to_lowercase().as_str() {
                 "text" => OutputFormat::Text,
                 "json" => OutputFormat::Json,
-                _ => return Err(format!("Invalid log format: {}. Valid formats: text, json", parts[1])),
+                "chrome" => OutputFormat::Chrome,
+                _ => {
+                    return Err(format!(
+                        "Invalid log format: {}. Valid formats: text, json, chrome",
+                        parts[1]
+                    ));
+                }
             }
         } else {
             OutputFormat::Text
@@ -17,6 +17,15 @@ pub struct Collection<'a> {
     hits: BTreeMap<String, BTreeSet<format::CompiledHandler>>,
 }
 
+/// Handlers of a single trigger, as baked by [`Collection::bake_batches`]
+#[derive(Debug)]
+pub struct Baked {
+    /// Name of the trigger
+    pub name: String,
+    /// Compiled handlers to run, in order
+    pub handlers: Vec<format::CompiledHandler>,
+}
+
 #[derive(Debug)]
 struct ExtractedHandler<'a> {
     id: &'a str,
@@ -79,6 +88,45 @@ impl<'a> Collection<'a> {
 
     /// Bake the trigger collection into a sane dependency order
     pub fn bake(&mut self) -> Result<Vec<format::CompiledHandler>, Error> {
+        let graph = self.graph()?;
+
+        // Recollect in dependency order
+        let results = graph
+            .topo()
+            .filter_map(|i| self.hits.remove(i))
+            .flatten()
+            .collect::<Vec<_>>();
+        Ok(results)
+    }
+
+    /// Bake the trigger collection into batches of triggers, each of which
+    /// only depends on those in earlier batches
+    ///
+    /// Triggers within a batch have no ordering between them, so may run
+    /// concurrently. Each trigger's own handlers are kept in order.
+    pub fn bake_batches(&mut self) -> Result<Vec<Vec<Baked>>, Error> {
+        let graph = self.graph()?;
+
+        let results = graph
+            .batched_topo()
+            .into_iter()
+            .map(|batch| {
+                batch
+                    .into_iter()
+                    .filter_map(|name| {
+                        let handlers = self.hits.remove(&name)?.into_iter().collect();
+                        Some(Baked { name, handlers })
+                    })
+                    .collect::<Vec<_>>()
+            })
+            // Triggers only referenced for ordering leave empty batches
+            .filter(|batch| !batch.is_empty())
+            .collect();
+        Ok(results)
+    }
+
+    /// Build the ordering graph between the triggers that were hit
+    fn graph(&self) -> Result<dag::Dag<String>, Error> {
         let mut graph = dag::Dag::new();
 
         // ensure all keys are in place
@@ -116,12 +164,68 @@ impl<'a> Collection<'a> {
             }
         }
 
-        // Recollect in dependency order
-        let results = graph
-            .topo()
-            .filter_map(|i| self.hits.remove(i))
-            .flatten()
+        Ok(graph)
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    fn trigger(name: &str, after: Option<&str>) -> Trigger {
+        serde_yaml::from_str(&format!(
+            "name: {name}
+description: {name}
+after: {after}
+paths:
+  /usr/share/{name}/*:
+    handlers:
+      - update
+handlers:
+  update:
+    run: /usr/bin/{name}
+    args: []
+",
+            after = after.unwrap_or("~"),
+        ))
+        .unwrap()
+    }
+
+    #[test]
+    fn bake_batches() {
+        let triggers = [
+            trigger("fonts", None),
+            trigger("icons", Some("fonts")),
+            trigger("mime", Some("unused")),
+            trigger("unused", Some("icons")),
+        ];
+        let mut collection = Collection::new(triggers.iter()).unwrap();
+        collection.process_paths(
+            [
+                "/usr/share/fonts/a.ttf",
+                "/usr/share/icons/a.png",
+                "/usr/share/mime/a.xml",
+            ]
+            .into_iter()
+            .map(String::from),
+        );
+
+        let batches = collection
+            .bake_batches()
+            .unwrap()
+            .into_iter()
+            .map(|batch| batch.into_iter().map(|baked| baked.name).collect::<BTreeSet<_>>())
             .collect::<Vec<_>>();
-        Ok(results)
+
+        // As with `bake`, only the orderings of triggers that were hit are
+        // followed. `unused` has no edges of its own so lands in the first
+        // batch, leaving `mime` alongside `icons` rather than after it
+        assert_eq!(
+            batches,
+            [
+                BTreeSet::from(["fonts".to_owned()]),
+                BTreeSet::from(["icons".to_owned(), "mime".to_owned()]),
+            ]
+        );
     }
 }
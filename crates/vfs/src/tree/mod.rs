@@ -212,6 +212,56 @@ impl<T: BlitFile> Tree<T> {
         }
     }
 
+    /// Every node under `/` in depth first order, paired with the
+    /// position of its parent within that same order
+    pub fn nodes(&self) -> impl Iterator<Item = (&T, Option<usize>)> + '_ {
+        let mut positions = HashMap::with_capacity(self.map.len());
+
+        self.resolve_node("/")
+            .into_iter()
+            .flat_map(|root| root.descendants(&self.arena))
+            .enumerate()
+            .map(move |(position, id)| {
+                positions.insert(id, position);
+
+                let node = &self.arena[id];
+                let parent = node.parent().and_then(|parent| positions.get(&parent).copied());
+
+                (&node.get().inner, parent)
+            })
+    }
+
+    /// Rebuild a tree from the output of [`Tree::nodes`]
+    ///
+    /// Nodes are trusted to already be free of conflicts and are appended
+    /// as is, skipping the sorting & symlink resolution of the builder.
+    pub fn from_nodes(nodes: impl IntoIterator<Item = (T, Option<usize>)>) -> Result<Self, Error> {
+        let nodes = nodes.into_iter();
+        let mut ids = Vec::with_capacity(nodes.size_hint().0);
+        let mut tree = Tree::with_capacity(nodes.size_hint().0);
+
+        for (inner, parent) in nodes {
+            let file = File::new(inner);
+
+            let parent = match parent {
+                Some(index) => Some(*ids.get(index).ok_or_else(|| Error::MissingParent {
+                    parent: format!("#{index} of {}", file.path.astr()),
+                })?),
+                None => None,
+            };
+
+            let node = tree.new_node(file);
+
+            if let Some(parent) = parent {
+                parent.append(node, &mut tree.arena);
+            }
+
+            ids.push(node);
+        }
+
+        Ok(tree)
+    }
+
     /// Return structured view beginning at `/`
     pub fn structured(&self) -> Option<Element<'_, T>> {
         self.resolve_node("/").map(|root| self.structured_children(root))
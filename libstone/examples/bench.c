@@ -0,0 +1,384 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+// Microbenchmarks of the reader hot paths through the C API, over a synthetic
+// archive written with the streaming writer. Every measurement is printed as
+// a single line of JSON so runs can be collected and compared:
+//
+//   just libstone bench <layouts> <content MiB> <iterations>
+//
+// There's no separate C++ harness: stone.hpp is inline over these same calls,
+// its only added work being the one copy of each payload's records through the
+// batch accessors measured here.
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stone.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Content is never split into files smaller than this
+#define MIN_FILE_SIZE 4096
+// ...or larger, as each is generated in memory
+#define MAX_FILE_SIZE (64 << 20)
+// Records copied out per call of the batch accessors
+#define BATCH_SIZE 1024
+
+typedef struct Config {
+  size_t layouts;
+  uint64_t content;
+  size_t iterations;
+} Config;
+
+typedef struct Measurement {
+  const char *name;
+  size_t iterations;
+  uint64_t total_ns;
+  uint64_t min_ns;
+  // Processed by each iteration, omitted when 0
+  uint64_t bytes;
+  uint64_t records;
+} Measurement;
+
+uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void record(Measurement *measurement, uint64_t elapsed) {
+  measurement->total_ns += elapsed;
+  if (measurement->iterations == 0 || elapsed < measurement->min_ns) {
+    measurement->min_ns = elapsed;
+  }
+  measurement->iterations += 1;
+}
+
+void measured(Measurement *measurement, uint64_t start) {
+  record(measurement, now_ns() - start);
+}
+
+void report(const Config *config, const Measurement *measurement) {
+  double mean_s =
+      (double)measurement->total_ns / measurement->iterations / 1e9;
+
+  printf("{\"bench\": \"%s\", \"layouts\": %zu, \"content_bytes\": %lu, "
+         "\"iterations\": %zu, \"min_ns\": %lu, \"mean_ns\": %.0f",
+         measurement->name, config->layouts, config->content,
+         measurement->iterations, measurement->min_ns, mean_s * 1e9);
+  if (measurement->bytes) {
+    printf(", \"bytes\": %lu, \"mb_per_s\": %.2f", measurement->bytes,
+           measurement->bytes / mean_s / 1e6);
+  }
+  if (measurement->records) {
+    printf(", \"records\": %lu, \"records_per_s\": %.0f", measurement->records,
+           measurement->records / mean_s);
+  }
+  printf("}\n");
+}
+
+// Deterministic content from an alphabet of 16 bytes, so it compresses about
+// 2:1 without ever repeating within the zstd window
+void synthesize(uint8_t *buf, size_t len, uint64_t seed) {
+  uint64_t state = seed | 1;
+
+  for (size_t i = 0; i < len; i++) {
+    if (i % 8 == 0) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+    }
+    buf[i] = 'a' + ((state >> (i % 8 * 8)) & 0x0f);
+  }
+}
+
+StoneString stone_string(const char *s) {
+  StoneString string = {(const uint8_t *)s, strlen(s)};
+  return string;
+}
+
+// Write the archive to `path`, measuring compression of the content alongside
+// encoding the other payloads but not the generation of the content itself
+void write_archive(const Config *config, const char *path) {
+  Measurement measurement = {.name = "write", .bytes = config->content};
+  StoneWriter *writer;
+  StoneWriterOptions options = {
+      .file_type = STONE_HEADER_V1_FILE_TYPE_BINARY,
+      .num_workers = sysconf(_SC_NPROCESSORS_ONLN),
+  };
+
+  uint64_t files = config->content / MIN_FILE_SIZE;
+  if (files > config->layouts) {
+    files = config->layouts;
+  }
+  if (files < (config->content + MAX_FILE_SIZE - 1) / MAX_FILE_SIZE) {
+    files = (config->content + MAX_FILE_SIZE - 1) / MAX_FILE_SIZE;
+  }
+  if (files == 0) {
+    files = 1;
+  }
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  assert(fd >= 0);
+  assert(stone_writer_new(fd, &options, &writer) == 0);
+
+  uint8_t *buf = malloc(config->content / files + 1);
+  uint8_t(*digests)[16] = calloc(files, 16);
+  StonePayloadLayoutRecord *layouts =
+      calloc(config->layouts, sizeof(StonePayloadLayoutRecord));
+  char *names = calloc(config->layouts, 32);
+  assert(buf && digests && ((layouts && names) || config->layouts == 0));
+
+  uint64_t start = now_ns();
+  uint64_t elapsed = 0;
+
+  StonePayloadMetaRecord meta = {0};
+  meta.tag = STONE_PAYLOAD_META_TAG_NAME;
+  meta.primitive_type = STONE_PAYLOAD_META_PRIMITIVE_TYPE_STRING;
+  meta.primitive_payload.string = stone_string("bench");
+  assert(stone_writer_add_meta_payload(writer, &meta, 1) == 0);
+
+  for (uint64_t i = 0; i < files; i++) {
+    StonePayloadIndexRecord index;
+    // Spread the remainder over the first files
+    size_t len = config->content / files + (i < config->content % files);
+
+    elapsed += now_ns() - start;
+    synthesize(buf, len, i + 1);
+    start = now_ns();
+
+    assert(stone_writer_add_content_buf(writer, buf, len, &index) == 0);
+    memcpy(digests[i], index.digest, 16);
+  }
+
+  // Every file of content is installed once, the rest is a mix of
+  // directories, symlinks & duplicates
+  for (size_t i = 0; i < config->layouts; i++) {
+    StonePayloadLayoutRecord *layout = &layouts[i];
+    char *name = &names[i * 32];
+
+    snprintf(name, 32, "usr/share/bench/%zu", i);
+
+    if (i < files || i % 3 == 2) {
+      layout->mode = 0100644;
+      layout->file_type = STONE_PAYLOAD_LAYOUT_FILE_TYPE_REGULAR;
+      memcpy(layout->file_payload.regular.hash, digests[i % files], 16);
+      layout->file_payload.regular.name = stone_string(name);
+    } else if (i % 3 == 0) {
+      layout->mode = 040755;
+      layout->file_type = STONE_PAYLOAD_LAYOUT_FILE_TYPE_DIRECTORY;
+      layout->file_payload.directory = stone_string(name);
+    } else {
+      layout->mode = 0120777;
+      layout->file_type = STONE_PAYLOAD_LAYOUT_FILE_TYPE_SYMLINK;
+      // Points at the preceding entry, whose name is the last digits
+      layout->file_payload.symlink.source =
+          stone_string(strrchr(&names[(i - 1) * 32], '/') + 1);
+      layout->file_payload.symlink.target = stone_string(name);
+    }
+  }
+
+  assert(stone_writer_add_layout_payload(writer, layouts, config->layouts) ==
+         0);
+  assert(stone_writer_finalize(writer) == 0);
+
+  measurement.total_ns = measurement.min_ns = elapsed + now_ns() - start;
+  measurement.iterations = 1;
+  report(config, &measurement);
+
+  free(names);
+  free(layouts);
+  free(digests);
+  free(buf);
+}
+
+// Header & payload table, without decoding any payload body
+void bench_open_file(const Config *config, const char *path) {
+  Measurement measurement = {.name = "open_file"};
+
+  for (size_t i = 0; i < config->iterations; i++) {
+    StoneReader *reader;
+    StoneHeaderVersion version;
+    size_t num_payloads;
+
+    uint64_t start = now_ns();
+    int fd = open(path, O_RDONLY);
+    assert(fd >= 0);
+    assert(stone_read_file(fd, &reader, &version) == 0);
+    assert(stone_reader_payload_table(reader, NULL, 0, &num_payloads) == 0);
+    stone_reader_destroy(reader);
+    measured(&measurement, start);
+  }
+
+  report(config, &measurement);
+}
+
+// Mapping also decompresses every record payload up front
+void bench_open_mmap(const Config *config, const char *path) {
+  Measurement measurement = {.name = "open_mmap"};
+  int fd = open(path, O_RDONLY);
+  assert(fd >= 0);
+
+  for (size_t i = 0; i < config->iterations; i++) {
+    StoneReader *reader;
+    StoneHeaderVersion version;
+
+    uint64_t start = now_ns();
+    assert(stone_read_mmap(fd, &reader, &version) == 0);
+    stone_reader_destroy(reader);
+    measured(&measurement, start);
+  }
+
+  close(fd);
+  report(config, &measurement);
+}
+
+void bench_decode(const Config *config, StoneReader *reader,
+                  StonePayloadKind kind, const char *name) {
+  Measurement measurement = {.name = name};
+
+  for (size_t i = 0; i < config->iterations; i++) {
+    StonePayload *payload;
+    StonePayloadHeader header;
+
+    uint64_t start = now_ns();
+    assert(stone_reader_payload_by_kind(reader, kind, &payload) == 0);
+    measured(&measurement, start);
+
+    stone_payload_header(payload, &header);
+    measurement.bytes = header.plain_size;
+    measurement.records = header.num_records;
+    stone_payload_destroy(payload);
+  }
+
+  report(config, &measurement);
+}
+
+// Walk the layout records one at a time & in batches, with the payload
+// decoded beforehand
+void bench_layout_records(const Config *config, StoneReader *reader) {
+  Measurement next = {.name = "layout_next", .records = config->layouts};
+  Measurement batch = {.name = "layout_batch", .records = config->layouts};
+  StonePayloadLayoutRecord *records =
+      calloc(BATCH_SIZE, sizeof(StonePayloadLayoutRecord));
+  assert(records);
+
+  for (size_t i = 0; i < config->iterations; i++) {
+    StonePayload *payload;
+    StonePayloadLayoutRecord record;
+    size_t num_records, total = 0;
+
+    assert(stone_reader_payload_by_kind(reader, STONE_PAYLOAD_KIND_LAYOUT,
+                                        &payload) == 0);
+    uint64_t start = now_ns();
+    while (stone_payload_next_layout_record(payload, &record) >= 0) {
+      total += 1;
+    }
+    measured(&next, start);
+    assert(total == config->layouts);
+    stone_payload_destroy(payload);
+
+    total = 0;
+    assert(stone_reader_payload_by_kind(reader, STONE_PAYLOAD_KIND_LAYOUT,
+                                        &payload) == 0);
+    start = now_ns();
+    do {
+      assert(stone_payload_layout_records(payload, records, BATCH_SIZE,
+                                          &num_records) == 0);
+      total += num_records;
+    } while (num_records > 0);
+    measured(&batch, start);
+    assert(total == config->layouts);
+    stone_payload_destroy(payload);
+  }
+
+  free(records);
+  report(config, &next);
+  report(config, &batch);
+}
+
+// Hashing time of the last content payload unpacked, as reported by libstone
+void on_event(const StoneEvent *event, void *data) {
+  if (event->kind == STONE_EVENT_KIND_CONTENT_UNPACKED) {
+    *(uint64_t *)data = event->checksum_ns;
+  }
+}
+
+// Unpacking takes ownership of the fd, so each gets its own
+void unpack(StoneReader *reader, StonePayload *payload) {
+  int devnull = open("/dev/null", O_WRONLY);
+  assert(devnull >= 0);
+  assert(stone_reader_unpack_content_payload(reader, payload, devnull) == 0);
+}
+
+void bench_unpack(const Config *config, StoneReader *reader) {
+  Measurement measurement = {.name = "unpack", .bytes = config->content};
+  Measurement checksum = {.name = "unpack_checksum",
+                          .bytes = config->content};
+  uint64_t checksum_ns = 0;
+  StonePayload *payload;
+
+  assert(stone_reader_payload_by_kind(reader, STONE_PAYLOAD_KIND_CONTENT,
+                                      &payload) == 0);
+
+  for (size_t i = 0; i < config->iterations; i++) {
+    uint64_t start = now_ns();
+    unpack(reader, payload);
+    measured(&measurement, start);
+  }
+
+  // Separately, so timing the checksum doesn't skew the above
+  stone_set_event_callback(on_event, &checksum_ns);
+  for (size_t i = 0; i < config->iterations; i++) {
+    unpack(reader, payload);
+    record(&checksum, checksum_ns);
+  }
+  stone_set_event_callback(NULL, NULL);
+
+  stone_payload_destroy(payload);
+  report(config, &measurement);
+  report(config, &checksum);
+}
+
+int main(int argc, char *argv[]) {
+  Config config = {
+      .layouts = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000,
+      .content = (argc > 2 ? strtoull(argv[2], NULL, 10) : 10) << 20,
+      .iterations = argc > 3 ? strtoull(argv[3], NULL, 10) : 10,
+  };
+  StoneReader *reader;
+  StoneHeaderVersion version;
+
+  if (argc > 4 || config.iterations == 0) {
+    printf("usage: %s [layouts] [content MiB] [iterations]\n", argv[0]);
+    exit(1);
+  }
+
+  const char *tmpdir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/stone-bench-%d.stone", tmpdir, getpid());
+
+  write_archive(&config, path);
+
+  bench_open_file(&config, path);
+  bench_open_mmap(&config, path);
+
+  int fd = open(path, O_RDONLY);
+  assert(fd >= 0);
+  assert(stone_read_file(fd, &reader, &version) == 0);
+
+  bench_decode(&config, reader, STONE_PAYLOAD_KIND_META, "decode_meta");
+  bench_decode(&config, reader, STONE_PAYLOAD_KIND_LAYOUT, "decode_layout");
+  bench_decode(&config, reader, STONE_PAYLOAD_KIND_INDEX, "decode_index");
+  bench_layout_records(&config, reader);
+  bench_unpack(&config, reader);
+
+  stone_reader_destroy(reader);
+  unlink(path);
+
+  return 0;
+}
@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <stone.hpp>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+void print_meta(const stone::MetaRecord &record) {
+  char tag[100];
+
+  stone_format_payload_meta_tag(record.tag(), reinterpret_cast<uint8_t *>(tag));
+  std::cout << "  " << tag << ": ";
+
+  record.visit([](auto value) {
+    using T = decltype(value);
+
+    if constexpr (std::is_same_v<T, std::string_view>) {
+      std::cout << value;
+    } else if constexpr (std::is_same_v<T, stone::Dependency>) {
+      char kind[100];
+
+      stone_format_payload_meta_dependency(value.kind,
+                                           reinterpret_cast<uint8_t *>(kind));
+      std::cout << kind << "(" << value.name << ")";
+    } else if constexpr (std::is_integral_v<T>) {
+      std::cout << +value;
+    }
+  });
+
+  std::cout << "\n";
+}
+
+void print_layout(const stone::LayoutRecord &record) {
+  std::cout << "  /usr/" << record.target();
+
+  if (auto source = record.symlink_source(); !source.empty()) {
+    std::cout << " -> " << source;
+  }
+
+  if (auto hash = record.hash()) {
+    char digest[33];
+
+    for (size_t i = 0; i < hash->size(); i++) {
+      std::snprintf(digest + i * 2, 3, "%02x", (*hash)[i]);
+    }
+    std::cout << " [" << digest << "]";
+  }
+
+  std::cout << "\n";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <stone>\n";
+    return 1;
+  }
+
+  try {
+    auto reader = stone::Reader::open(open(argv[1], O_RDONLY));
+    std::vector<std::byte> buf;
+    size_t unpacked = 0;
+
+    while (auto payload = reader.next_payload()) {
+      switch (payload->kind()) {
+      case STONE_PAYLOAD_KIND_META:
+        std::cout << "Meta:\n";
+        for (auto record : payload->metas()) {
+          print_meta(record);
+        }
+        break;
+      case STONE_PAYLOAD_KIND_LAYOUT:
+        std::cout << "Layout:\n";
+        for (auto record : payload->layouts()) {
+          print_layout(record);
+        }
+        break;
+      case STONE_PAYLOAD_KIND_CONTENT: {
+        auto content = reader.read_content(*payload);
+        buf.resize(content.buf_hint() > 0 ? content.buf_hint() : 1 << 16);
+
+        while (size_t read = content.read(buf)) {
+          unpacked += read;
+        }
+        if (!content.is_checksum_valid()) {
+          std::cerr << "Content checksum mismatch\n";
+          return 1;
+        }
+        break;
+      }
+      default:
+        break;
+      }
+    }
+
+    std::cout << "Unpacked " << unpacked << " bytes of content\n";
+  } catch (const stone::Error &error) {
+    std::cerr << "Failed to read stone: " << error.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -178,26 +178,32 @@ void print_inspect_output(StonePayloadMetaRecord *metas, int num_metas,
 
 void process_records(StonePayload *payload, StonePayloadHeader *payload_header,
                      void **records, int *num_records, int record_size,
-                     int (*next_record)(StonePayload *, void *),
+                     int (*fill_records)(StonePayload *, void *, size_t,
+                                         size_t *),
                      void (*print_record)(void *)) {
+  size_t filled = 0;
 
-  void *record;
-  int i = 0;
+  if (payload_header->num_records == 0) {
+    return;
+  }
+
+  *records = realloc(*records, record_size * (*num_records +
+                                              payload_header->num_records));
+  if (*records == NULL) {
+    exit(1);
+  }
 
-  *records =
-      realloc(*records, sizeof(StonePayloadLayoutRecord) *
-                            (*num_records + payload_header->num_records));
-  if (records == NULL) {
+  // Copy out every record of the payload in a single call
+  if (fill_records(payload, *records + *num_records * record_size,
+                   payload_header->num_records, &filled) < 0) {
     exit(1);
   }
 
-  while (next_record(payload, record = *records +
-                                       (*num_records + i) * record_size) >= 0) {
-    print_record(record);
-    i++;
+  for (size_t i = 0; i < filled; i++) {
+    print_record(*records + (*num_records + i) * record_size);
   }
 
-  *num_records += payload_header->num_records;
+  *num_records += filled;
 }
 
 void process_reader(StoneReader *reader, StoneHeaderVersion version) {
@@ -236,28 +242,28 @@ void process_reader(StoneReader *reader, StoneHeaderVersion version) {
     case STONE_PAYLOAD_KIND_LAYOUT: {
       process_records(payload, &payload_header, (void *)&layouts, &num_layouts,
                       sizeof(StonePayloadLayoutRecord),
-                      (void *)stone_payload_next_layout_record,
+                      (void *)stone_payload_layout_records,
                       (void *)print_payload_layout_record);
       break;
     }
     case STONE_PAYLOAD_KIND_META: {
       process_records(payload, &payload_header, (void *)&metas, &num_metas,
                       sizeof(StonePayloadMetaRecord),
-                      (void *)stone_payload_next_meta_record,
+                      (void *)stone_payload_meta_records,
                       (void *)print_payload_meta_record);
       break;
     }
     case STONE_PAYLOAD_KIND_INDEX: {
       process_records(payload, &payload_header, (void *)&indexes, &num_indexes,
                       sizeof(StonePayloadIndexRecord),
-                      (void *)stone_payload_next_index_record,
+                      (void *)stone_payload_index_records,
                       (void *)print_payload_index_record);
       break;
     }
     case STONE_PAYLOAD_KIND_ATTRIBUTES: {
       process_records(payload, &payload_header, (void *)&attributes,
                       &num_attributes, sizeof(StonePayloadAttributeRecord),
-                      (void *)stone_payload_next_attribute_record,
+                      (void *)stone_payload_attribute_records,
                       (void *)print_payload_attribute_record);
       break;
     }
@@ -267,7 +273,8 @@ void process_reader(StoneReader *reader, StoneHeaderVersion version) {
       fptr = fopen("/dev/null", "w+");
       char *buf;
       uint64_t buf_hint = 0;
-      int read = 0;
+      ssize_t read = 0;
+      struct iovec iov = {0};
 
       // We can instead unpack directly to file as a convenience
       // stone_reader_unpack_content_payload(reader, payload, fileno(fptr));
@@ -284,19 +291,21 @@ void process_reader(StoneReader *reader, StoneHeaderVersion version) {
         exit(1);
       }
 
-      while ((read = stone_payload_content_reader_read(
-                  content_reader, (void *)buf, buf_hint)) > 0) {
-        int total = 0, n = 0;
+      iov.iov_base = buf;
+      iov.iov_len = buf_hint;
 
-        while (total < read) {
-          n = fwrite(buf, 1, read - total, fptr);
-          if (n == 0) {
-            exit(1);
-          }
-          total += n;
+      while ((read = stone_payload_content_reader_read_into(content_reader,
+                                                            &iov, 1)) > 0) {
+        if (fwrite(buf, 1, read, fptr) != (size_t)read) {
+          exit(1);
         }
       }
 
+      if (read < 0) {
+        fprintf(stderr, "Failed to read content: %s\n", strerror(-read));
+        exit(1);
+      }
+
       assert(stone_payload_content_reader_is_checksum_valid(content_reader) ==
              1);
 
@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+#include <assert.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stone.h>
+#include <string.h>
+#include <unistd.h>
+
+StoneString stone_string(const char *s) {
+  StoneString string = {(const uint8_t *)s, strlen(s)};
+  return string;
+}
+
+int main(int argc, char *argv[]) {
+  StoneWriter *writer;
+  StoneWriterOptions options = {
+      .file_type = STONE_HEADER_V1_FILE_TYPE_BINARY,
+      .num_workers = 4,
+      .long_distance_matching = true,
+  };
+
+  if (argc < 3) {
+    printf("usage: %s <name> <file>...\n", argv[0]);
+    exit(1);
+  }
+
+  char output[4096];
+  snprintf(output, sizeof(output), "%s.stone", argv[1]);
+
+  int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  assert(fd >= 0);
+  assert(stone_writer_new(fd, &options, &writer) == 0);
+
+  StonePayloadMetaRecord meta = {0};
+  meta.tag = STONE_PAYLOAD_META_TAG_NAME;
+  meta.primitive_type = STONE_PAYLOAD_META_PRIMITIVE_TYPE_STRING;
+  meta.primitive_payload.string = stone_string(argv[1]);
+  assert(stone_writer_add_meta_payload(writer, &meta, 1) == 0);
+
+  int num_files = argc - 2;
+  StonePayloadLayoutRecord *layouts =
+      calloc(num_files, sizeof(StonePayloadLayoutRecord));
+
+  for (int i = 0; i < num_files; i++) {
+    StonePayloadIndexRecord index;
+    StonePayloadLayoutRecord *layout = &layouts[i];
+
+    int file = open(argv[i + 2], O_RDONLY);
+    assert(file >= 0);
+
+    // Hashed while compressed, no separate pass for the layout digest
+    assert(stone_writer_add_content_file(writer, file, &index) == 0);
+    close(file);
+
+    layout->mode = 0100644;
+    layout->file_type = STONE_PAYLOAD_LAYOUT_FILE_TYPE_REGULAR;
+    memcpy(layout->file_payload.regular.hash, index.digest, 16);
+    layout->file_payload.regular.name = stone_string(basename(argv[i + 2]));
+  }
+
+  assert(stone_writer_add_layout_payload(writer, layouts, num_files) == 0);
+  assert(stone_writer_finalize(writer) == 0);
+  free(layouts);
+
+  printf("Wrote %d files to '%s'\n", num_files, output);
+
+  return 0;
+}
@@ -0,0 +1,95 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+use libc::c_void;
+use stone::{StoneEventHook, StonePayloadKind};
+
+#[repr(u8)]
+pub enum StoneEventKind {
+    /// A record payload was read, checksummed & decoded
+    PayloadDecoded = 1,
+    /// The content payload was decompressed & checksummed in full
+    ContentUnpacked = 2,
+    /// An asset was hashed & matched its index record while unpacking
+    AssetVerified = 3,
+}
+
+/// Work done by a reader, see [`stone_set_event_callback`]
+#[repr(C)]
+pub struct StoneEvent {
+    pub kind: StoneEventKind,
+    /// The payload worked on, `Content` for assets
+    pub payload_kind: StonePayloadKind,
+    /// Compressed bytes read, `0` for assets
+    pub stored_size: u64,
+    /// Decompressed bytes, or the size of the asset
+    pub plain_size: u64,
+    /// Nanoseconds taken, including `checksum_ns`
+    pub elapsed_ns: u64,
+    /// Nanoseconds spent hashing
+    pub checksum_ns: u64,
+}
+
+impl From<&stone::StoneEvent> for StoneEvent {
+    fn from(event: &stone::StoneEvent) -> Self {
+        match *event {
+            stone::StoneEvent::PayloadDecoded {
+                kind,
+                stored_size,
+                plain_size,
+                elapsed,
+                checksum,
+            } => Self {
+                kind: StoneEventKind::PayloadDecoded,
+                payload_kind: kind,
+                stored_size,
+                plain_size,
+                elapsed_ns: elapsed.as_nanos() as u64,
+                checksum_ns: checksum.as_nanos() as u64,
+            },
+            stone::StoneEvent::ContentUnpacked {
+                stored_size,
+                plain_size,
+                elapsed,
+                checksum,
+            } => Self {
+                kind: StoneEventKind::ContentUnpacked,
+                payload_kind: StonePayloadKind::Content,
+                stored_size,
+                plain_size,
+                elapsed_ns: elapsed.as_nanos() as u64,
+                checksum_ns: checksum.as_nanos() as u64,
+            },
+            stone::StoneEvent::AssetVerified { size, elapsed } => Self {
+                kind: StoneEventKind::AssetVerified,
+                payload_kind: StonePayloadKind::Content,
+                stored_size: 0,
+                plain_size: size,
+                elapsed_ns: elapsed.as_nanos() as u64,
+                checksum_ns: elapsed.as_nanos() as u64,
+            },
+        }
+    }
+}
+
+pub type StoneEventCallback = Option<unsafe extern "C" fn(event: *const StoneEvent, data: *mut c_void)>;
+
+/// Caller provided data of a callback, which it's responsible
+/// for making safe to use from any thread
+struct CallbackData(*mut c_void);
+
+unsafe impl Send for CallbackData {}
+unsafe impl Sync for CallbackData {}
+
+impl CallbackData {
+    fn get(&self) -> *mut c_void {
+        self.0
+    }
+}
+
+/// Forward every event to `callback`
+pub fn hook(callback: unsafe extern "C" fn(*const StoneEvent, *mut c_void), data: *mut c_void) -> StoneEventHook {
+    let data = CallbackData(data);
+
+    Box::new(move |event| unsafe { callback(&StoneEvent::from(event), data.get()) })
+}
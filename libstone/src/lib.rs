@@ -6,29 +6,120 @@
 
 use std::{
     fs::File,
-    io::{Cursor, Read, Seek},
-    os::fd::FromRawFd,
+    io::{Cursor, Read, Seek, Write},
+    mem::MaybeUninit,
+    num::NonZeroUsize,
+    os::{
+        fd::{AsRawFd, FromRawFd, RawFd},
+        unix::fs::FileExt,
+    },
     ptr::NonNull,
     slice,
+    sync::Arc,
+    thread,
 };
 
-use libc::{c_char, c_int, c_void, size_t};
+use libc::{c_char, c_int, c_uint, c_void, iovec, size_t, ssize_t};
 use stone::{
-    StoneDecodedPayload, StoneHeader, StoneHeaderV1, StoneHeaderV1FileType, StoneHeaderVersion,
-    StonePayloadCompression, StonePayloadHeader, StonePayloadKind, StonePayloadLayoutFileType,
-    StonePayloadMetaDependency, StonePayloadMetaTag,
+    StoneHeader, StoneHeaderV1, StoneHeaderV1FileType, StoneHeaderVersion, StonePayloadCompression,
+    StonePayloadFrameRecord, StonePayloadHeader, StonePayloadKind, StonePayloadLayoutFileType,
+    StonePayloadMetaDependency, StonePayloadMetaTag, StonePayloadTableEntry,
 };
 
 pub use self::payload::{
     StonePayload, StonePayloadAttributeRecord, StonePayloadIndexRecord, StonePayloadLayoutRecord,
-    StonePayloadMetaPrimitiveType, StonePayloadMetaRecord,
+    StonePayloadLookupRecord, StonePayloadMetaPrimitiveType, StonePayloadMetaRecord,
 };
 
+pub use self::event::{StoneEvent, StoneEventCallback, StoneEventKind};
+pub use self::unpack::{STONE_UNPACK_SKIP_EXISTING, STONE_UNPACK_VERIFY_EXISTING};
+pub use self::write::{StoneWriter, StoneWriterOptions};
+
+mod event;
+mod mmap;
 mod payload;
+mod splice;
+mod unpack;
+mod write;
 
 pub const STONE_HEADER_SIZE: usize = 32;
 
-pub type StoneReader<'a> = stone::StoneReader<StoneReadImpl<'a>>;
+pub struct StoneReader<'a> {
+    inner: stone::StoneReader<StoneReadImpl<'a>>,
+    /// Set when opened with [`stone_read_mmap`], payloads are
+    /// then decoded zero-copy from the mapping
+    mapped: Option<Box<mmap::Mapped<'a>>>,
+    /// Frame table of seekable content, loaded on first [`stone_reader_extract_range`]
+    frames: Option<Vec<StonePayloadFrameRecord>>,
+    /// Context lent by [`stone_reader_set_decode_context`], handed back on destroy
+    context: Option<NonNull<StoneDecodeContext>>,
+}
+
+impl<'a> StoneReader<'a> {
+    fn new(inner: stone::StoneReader<StoneReadImpl<'a>>) -> Self {
+        Self {
+            inner,
+            mapped: None,
+            frames: None,
+            context: None,
+        }
+    }
+
+    /// Swap the context of whichever reader does the decoding
+    fn replace_context(&mut self, context: stone::StoneDecodeContext) -> stone::StoneDecodeContext {
+        match &mut self.mapped {
+            Some(mapped) => mapped.reader.replace_context(context),
+            None => self.inner.replace_context(context),
+        }
+    }
+
+    /// Independent reader over the same archive, see [`stone_reader_clone`]
+    fn try_clone(&self) -> Result<Self, Box<dyn std::error::Error>> {
+        let source = match self.inner.get_ref() {
+            StoneReadImpl::File(file) => StoneReadImpl::File(file.clone()),
+            StoneReadImpl::Buffer(cursor) => StoneReadImpl::Buffer(cursor.clone()),
+            StoneReadImpl::Shim(_) => Err("readers using a vtable can't be cloned")?,
+        };
+
+        let mapped = match &self.mapped {
+            Some(mapped) => Some(Box::new(mapped.try_clone()?)),
+            None => None,
+        };
+
+        Ok(Self {
+            inner: self.inner.clone_with(source),
+            mapped,
+            frames: self.frames.clone(),
+            context: None,
+        })
+    }
+
+    /// Return a lent context to its owner
+    unsafe fn release_context(&mut self) {
+        if let Some(mut owner) = self.context.take() {
+            let context = self.replace_context(stone::StoneDecodeContext::default());
+            unsafe { owner.as_mut().0 = Some(context) };
+        }
+    }
+
+    fn next_payload(&mut self) -> Result<Option<StonePayload>, Box<dyn std::error::Error>> {
+        match &mut self.mapped {
+            Some(mapped) => mapped.next_payload(),
+            None => Ok(self.inner.next_payload()?.map(StonePayload::from)),
+        }
+    }
+}
+
+impl Drop for StoneReader<'_> {
+    fn drop(&mut self) {
+        unsafe { self.release_context() };
+    }
+}
+
+/// Decoder state which can be shared by readers one at a time,
+/// see [`stone_reader_set_decode_context`]
+pub struct StoneDecodeContext(Option<stone::StoneDecodeContext>);
+
 pub type StonePayloadContentReader<'a> = stone::StonePayloadContentReader<'a, StoneReadImpl<'a>>;
 
 #[derive(Debug, Clone, Copy)]
@@ -45,10 +136,24 @@ impl StoneString {
             size: s.len(),
         }
     }
+
+    /// Borrow a string passed in from C, which must be valid UTF-8
+    pub unsafe fn as_str<'a>(&self) -> Result<&'a str, std::str::Utf8Error> {
+        std::str::from_utf8(unsafe { raw_slice(self.buf, self.size) })
+    }
+}
+
+/// Borrow `len` items at `ptr`, which may be null when empty
+unsafe fn raw_slice<'a, T>(ptr: *const T, len: size_t) -> &'a [T] {
+    if len == 0 {
+        &[]
+    } else {
+        unsafe { slice::from_raw_parts(ptr, len) }
+    }
 }
 
 pub enum StoneReadImpl<'a> {
-    File(File),
+    File(PositionalFile),
     Buffer(Cursor<&'a [u8]>),
     Shim(StoneReadShim),
 }
@@ -103,6 +208,24 @@ fn fallible(f: impl FnOnce() -> Result<(), Box<dyn std::error::Error>>) -> c_int
     if f().is_err() { -1 } else { 0 }
 }
 
+/// Best matching errno for `error`, for functions returning a negative errno
+fn error_code(error: &(dyn std::error::Error + 'static)) -> ssize_t {
+    let mut source = Some(error);
+
+    while let Some(error) = source {
+        if let Some(code) = error
+            .downcast_ref::<std::io::Error>()
+            .and_then(std::io::Error::raw_os_error)
+        {
+            return code as ssize_t;
+        }
+
+        source = error.source();
+    }
+
+    libc::EIO as ssize_t
+}
+
 #[repr(u8)]
 enum StoneSeekFrom {
     Start = 0,
@@ -116,6 +239,64 @@ pub struct StoneReadVTable {
     seek: Option<unsafe extern "C" fn(*mut c_void, i64, StoneSeekFrom) -> i64>,
 }
 
+/// File read with `pread` from a position of its own, so clones of a
+/// reader never share or move the fd offset
+pub struct PositionalFile {
+    file: Arc<File>,
+    position: u64,
+}
+
+impl PositionalFile {
+    fn new(file: File) -> Self {
+        Self {
+            file: Arc::new(file),
+            position: 0,
+        }
+    }
+}
+
+impl Clone for PositionalFile {
+    fn clone(&self) -> Self {
+        Self {
+            file: self.file.clone(),
+            position: self.position,
+        }
+    }
+}
+
+impl AsRawFd for PositionalFile {
+    fn as_raw_fd(&self) -> RawFd {
+        self.file.as_raw_fd()
+    }
+}
+
+impl Read for PositionalFile {
+    fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+        let read = self.file.read_at(buf, self.position)?;
+        self.position += read as u64;
+        Ok(read)
+    }
+}
+
+impl Seek for PositionalFile {
+    fn seek(&mut self, pos: std::io::SeekFrom) -> std::io::Result<u64> {
+        let position = match pos {
+            std::io::SeekFrom::Start(i) => Some(i),
+            std::io::SeekFrom::Current(i) => self.position.checked_add_signed(i),
+            std::io::SeekFrom::End(i) => self.file.metadata()?.len().checked_add_signed(i),
+        };
+
+        self.position =
+            position.ok_or_else(|| std::io::Error::new(std::io::ErrorKind::InvalidInput, "invalid seek position"))?;
+
+        Ok(self.position)
+    }
+
+    fn stream_position(&mut self) -> std::io::Result<u64> {
+        Ok(self.position)
+    }
+}
+
 pub struct StoneReadShim {
     data: *mut c_void,
     read: unsafe extern "C" fn(*mut c_void, *mut c_char, usize) -> usize,
@@ -166,7 +347,7 @@ pub unsafe extern "C" fn stone_read(
         }))?;
 
         *version.as_mut() = reader.header.version();
-        *reader_ptr.as_ptr() = Box::into_raw(Box::new(reader));
+        *reader_ptr.as_ptr() = Box::into_raw(Box::new(StoneReader::new(reader)));
 
         Ok(())
     })
@@ -182,10 +363,10 @@ pub unsafe extern "C" fn stone_read_file(
         let reader_ptr = NonNull::new(reader_ptr).ok_or("")?;
         let mut version = NonNull::new(version).ok_or("")?;
 
-        let reader = stone::read(StoneReadImpl::File(File::from_raw_fd(file)))?;
+        let reader = stone::read(StoneReadImpl::File(PositionalFile::new(File::from_raw_fd(file))))?;
 
         *version.as_mut() = reader.header.version();
-        *reader_ptr.as_ptr() = Box::into_raw(Box::new(reader));
+        *reader_ptr.as_ptr() = Box::into_raw(Box::new(StoneReader::new(reader)));
 
         Ok(())
     })
@@ -209,19 +390,122 @@ pub unsafe extern "C" fn stone_read_buf(
         ))))?;
 
         *version.as_mut() = reader.header.version();
+        *reader_ptr.as_ptr() = Box::into_raw(Box::new(StoneReader::new(reader)));
+
+        Ok(())
+    })
+}
+
+/// Memory map `file` and read the stone from the mapping.
+///
+/// Records of uncompressed payloads point straight into the mapping,
+/// compressed payloads are decompressed one at a time by
+/// `stone_reader_next_payload` into buffers owned by the reader. All
+/// `StoneString` and record buffers are therefore only valid until the
+/// reader is destroyed, even if the payload is still alive.
+///
+/// `file` is not taken ownership of and can be closed once this returns.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_read_mmap(
+    file: c_int,
+    reader_ptr: *mut *mut StoneReader,
+    version: *mut StoneHeaderVersion,
+) -> c_int {
+    fallible(|| unsafe {
+        let reader_ptr = NonNull::new(reader_ptr).ok_or("")?;
+        let mut version = NonNull::new(version).ok_or("")?;
+
+        let map = mmap::Mmap::map(file)?;
+        let bytes = map.as_unbounded_slice();
+
+        let reader = StoneReader {
+            inner: stone::read(StoneReadImpl::Buffer(Cursor::new(bytes)))?,
+            mapped: Some(Box::new(mmap::Mapped {
+                reader: stone::read_slice(bytes)?,
+                map: Arc::new(map),
+            })),
+            frames: None,
+            context: None,
+        };
+
+        *version.as_mut() = reader.inner.header.version();
         *reader_ptr.as_ptr() = Box::into_raw(Box::new(reader));
 
         Ok(())
     })
 }
 
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_decode_context_new() -> *mut StoneDecodeContext {
+    Box::into_raw(Box::new(StoneDecodeContext(Some(stone::StoneDecodeContext::new()))))
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_decode_context_destroy(context: *mut StoneDecodeContext) {
+    unsafe {
+        let Some(context) = NonNull::new(context) else {
+            return;
+        };
+
+        drop(Box::from_raw(context.as_ptr()));
+    }
+}
+
+/// Lend `context` to `reader` so its zstd state & buffers are reused instead
+/// of allocated again for this reader.
+///
+/// The context is handed back once the reader is destroyed, at which point
+/// it can be attached to another reader. A context can only be attached to a
+/// single reader at a time and must outlive it.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_reader_set_decode_context(
+    reader: *mut StoneReader,
+    context: *mut StoneDecodeContext,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut reader = NonNull::new(reader).ok_or("")?;
+        let mut context = NonNull::new(context).ok_or("")?;
+
+        let decode = context.as_mut().0.take().ok_or("context already attached")?;
+
+        let reader = reader.as_mut();
+        reader.release_context();
+        reader.replace_context(decode);
+        reader.context = Some(context);
+
+        Ok(())
+    })
+}
+
+/// Create an independent reader over the same archive as `reader`.
+///
+/// Each reader has its own position, checksum & decode state so the two can
+/// be used from different threads at the same time, for example to decode
+/// different payloads or content ranges in parallel. Payload iteration of the
+/// clone starts again from the first payload.
+///
+/// Readers created with `stone_read_file` read with `pread` and share the fd,
+/// which is closed once the last of them is destroyed. Readers created with
+/// `stone_read` can't be cloned.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_reader_clone(reader: *const StoneReader, clone_ptr: *mut *mut StoneReader) -> c_int {
+    fallible(|| unsafe {
+        let reader = NonNull::new(reader as *mut StoneReader).ok_or("")?;
+        let clone_ptr = NonNull::new(clone_ptr).ok_or("")?;
+
+        *clone_ptr.as_ptr() = Box::into_raw(Box::new(reader.as_ref().try_clone()?));
+
+        Ok(())
+    })
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn stone_reader_header_v1(reader: *const StoneReader, header: *mut StoneHeaderV1) -> c_int {
     fallible(|| unsafe {
         let reader = NonNull::new(reader as *mut StoneReader).ok_or("")?;
         let mut header = NonNull::new(header).ok_or("")?;
 
-        match &reader.as_ref().header {
+        match &reader.as_ref().inner.header {
             StoneHeader::V1(v1) => *header.as_mut() = *v1,
         }
 
@@ -239,7 +523,7 @@ pub unsafe extern "C" fn stone_reader_next_payload(
         let payload_ptr = NonNull::new(payload_ptr).ok_or("")?;
 
         if let Some(payload) = reader.as_mut().next_payload()? {
-            *payload_ptr.as_ptr() = Box::into_raw(Box::new(payload.into()));
+            *payload_ptr.as_ptr() = Box::into_raw(Box::new(payload));
         } else {
             Err("no more payloads")?;
         }
@@ -248,6 +532,86 @@ pub unsafe extern "C" fn stone_reader_next_payload(
     })
 }
 
+/// Scan payload headers without decoding any bodies, filling `entries` with up
+/// to `capacity` entries. `num_entries` is always set to the total number of
+/// payloads so callers can size their buffer by first passing a `capacity` of 0.
+///
+/// The table is cached by the reader and doesn't affect `stone_reader_next_payload`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_reader_payload_table(
+    reader: *mut StoneReader,
+    entries: *mut StonePayloadTableEntry,
+    capacity: size_t,
+    num_entries: *mut size_t,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut reader = NonNull::new(reader).ok_or("")?;
+        let mut num_entries = NonNull::new(num_entries).ok_or("")?;
+
+        let table = reader.as_mut().inner.payload_table()?;
+
+        if capacity > 0 {
+            let entries = NonNull::new(entries).ok_or("")?;
+            let out = slice::from_raw_parts_mut(entries.as_ptr(), capacity);
+
+            for (slot, entry) in out.iter_mut().zip(table) {
+                *slot = *entry;
+            }
+        }
+
+        *num_entries.as_mut() = table.len();
+
+        Ok(())
+    })
+}
+
+/// Decode only the first payload of `kind`, seeking over all others.
+///
+/// Fails if the stone has no payload of this kind. The returned payload must
+/// be freed with `stone_payload_destroy`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_reader_payload_by_kind(
+    reader: *mut StoneReader,
+    kind: StonePayloadKind,
+    payload_ptr: *mut *mut StonePayload,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut reader = NonNull::new(reader).ok_or("")?;
+        let payload_ptr = NonNull::new(payload_ptr).ok_or("")?;
+
+        if let Some(payload) = reader.as_mut().inner.payload_by_kind(kind)? {
+            *payload_ptr.as_ptr() = Box::into_raw(Box::new(payload.into()));
+        } else {
+            Err("no payload of kind")?;
+        }
+
+        Ok(())
+    })
+}
+
+/// Decode the payload whose header starts at `offset`, such as the Meta
+/// payload a `StonePayloadLookupRecord` points to.
+///
+/// Doesn't affect `stone_reader_next_payload`. The returned payload must be
+/// freed with `stone_payload_destroy`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_reader_read_payload_at(
+    reader: *mut StoneReader,
+    offset: u64,
+    payload_ptr: *mut *mut StonePayload,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut reader = NonNull::new(reader).ok_or("")?;
+        let payload_ptr = NonNull::new(payload_ptr).ok_or("")?;
+
+        let payload = reader.as_mut().inner.decode_payload_at(offset)?;
+
+        *payload_ptr.as_ptr() = Box::into_raw(Box::new(payload.into()));
+
+        Ok(())
+    })
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn stone_reader_unpack_content_payload(
     reader: *mut StoneReader,
@@ -259,8 +623,8 @@ pub unsafe extern "C" fn stone_reader_unpack_content_payload(
         let payload = NonNull::new(payload as *mut StonePayload).ok_or("")?;
         let mut file = File::from_raw_fd(file);
 
-        if let StoneDecodedPayload::Content(content) = &payload.as_ref().decoded {
-            reader.as_mut().unpack_content(content, &mut file)?;
+        if let Some(content) = payload.as_ref().content() {
+            reader.as_mut().inner.unpack_content(content, &mut file)?;
         } else {
             Err("incorrect payload kind")?;
         }
@@ -269,6 +633,143 @@ pub unsafe extern "C" fn stone_reader_unpack_content_payload(
     })
 }
 
+/// Write the decompressed content payload to the current position of `file`,
+/// returning the number of bytes written or a negative errno.
+///
+/// Uncompressed payloads aren't copied through userspace at all, they're
+/// handed to `copy_file_range` / `sendfile` straight from the source fd (or
+/// written straight from the mapping of `stone_read_mmap` readers). As the
+/// bytes are never seen the payload checksum isn't validated in that case.
+///
+/// `file` is not taken ownership of.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_reader_splice_content_payload(
+    reader: *mut StoneReader,
+    payload: *const StonePayload,
+    file: c_int,
+) -> ssize_t {
+    let result = || -> Result<u64, Box<dyn std::error::Error>> {
+        let mut reader = NonNull::new(reader).ok_or("")?;
+        let payload = NonNull::new(payload as *mut StonePayload).ok_or("")?;
+
+        let content = unsafe { payload.as_ref() }.content().ok_or("incorrect payload kind")?;
+        let reader = unsafe { reader.as_mut() };
+        let mut out = unsafe { splice::borrow_fd(file) };
+
+        let start = content.body.offset;
+        let len = content.header.stored_size;
+
+        match (content.header.compression, reader.inner.get_ref()) {
+            (StonePayloadCompression::None, StoneReadImpl::File(source)) => {
+                splice::copy_range(source.as_raw_fd(), start, len, file)?;
+            }
+            (StonePayloadCompression::None, StoneReadImpl::Buffer(source)) => {
+                let bytes = source.get_ref();
+                let body = bytes
+                    .get(start as usize..(start + len) as usize)
+                    .ok_or("truncated payload")?;
+
+                out.write_all(body)?;
+            }
+            _ => reader.inner.unpack_content(content, &mut *out)?,
+        }
+
+        Ok(content.header.plain_size)
+    };
+
+    match result() {
+        Ok(written) => written as ssize_t,
+        Err(error) => -error_code(&*error),
+    }
+}
+
+/// Unpack every asset of the content payload into `dirfd`, laid out as
+/// `aa/bb/cc/<digest>` exactly like the moss asset store.
+///
+/// Assets are written directly as they're decompressed, verified against
+/// the index payload and renamed into place from a pool of `workers`
+/// threads, or one per CPU when `0`. `flags` is a combination of
+/// `STONE_UNPACK_*` flags.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_reader_unpack_content_to_dir(
+    reader: *mut StoneReader,
+    payload: *const StonePayload,
+    dirfd: c_int,
+    flags: c_uint,
+    workers: c_uint,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut reader = NonNull::new(reader).ok_or("")?;
+        let payload = NonNull::new(payload as *mut StonePayload).ok_or("")?;
+
+        let content = payload.as_ref().content().ok_or("incorrect payload kind")?;
+
+        let inner = &mut reader.as_mut().inner;
+        let indices = inner.payload_by_kind(StonePayloadKind::Index)?;
+        let indices = indices
+            .as_ref()
+            .and_then(stone::StoneDecodedPayload::index)
+            .map(|p| p.body.as_slice())
+            .unwrap_or_default();
+
+        let workers = NonZeroUsize::new(workers as usize)
+            .unwrap_or_else(|| thread::available_parallelism().unwrap_or(NonZeroUsize::MIN));
+        inner.unpack_content_to(content, indices, &unpack::DirSink { dirfd, flags }, workers, |_| {})?;
+
+        Ok(())
+    })
+}
+
+/// Decompress the bytes `start..end` of the content payload into `buf`,
+/// which must have room for `end - start` bytes.
+///
+/// Seekable stones only decompress the frames covering the range, others
+/// are decoded from the start of the payload. No checksum is validated,
+/// compare against the index record digest if required.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_reader_extract_range(
+    reader: *mut StoneReader,
+    payload: *const StonePayload,
+    start: u64,
+    end: u64,
+    buf: *mut u8,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut reader = NonNull::new(reader).ok_or("")?;
+        let payload = NonNull::new(payload as *mut StonePayload).ok_or("")?;
+        let buf = NonNull::new(buf).ok_or("")?;
+
+        let content = payload.as_ref().content().ok_or("incorrect payload kind")?;
+        let length = end.checked_sub(start).ok_or("invalid range")? as usize;
+
+        let reader = reader.as_mut();
+
+        if reader.frames.is_none() {
+            let frames = reader.inner.payload_by_kind(StonePayloadKind::Frames)?;
+
+            reader.frames = Some(
+                frames
+                    .as_ref()
+                    .and_then(stone::StoneDecodedPayload::frames)
+                    .map(|p| p.body.clone())
+                    .unwrap_or_default(),
+            );
+        }
+
+        let mut out = slice::from_raw_parts_mut(buf.as_ptr(), length);
+
+        reader.inner.extract_range(
+            content,
+            reader.frames.as_deref().unwrap_or_default(),
+            start,
+            end,
+            &mut out,
+        )?;
+
+        Ok(())
+    })
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn stone_reader_read_content_payload<'a>(
     reader: *mut StoneReader<'a>,
@@ -280,8 +781,8 @@ pub unsafe extern "C" fn stone_reader_read_content_payload<'a>(
         let payload = NonNull::new(payload as *mut StonePayload).ok_or("")?;
         let content_reader = NonNull::new(content_reader).ok_or("")?;
 
-        if let StoneDecodedPayload::Content(content) = &payload.as_ref().decoded {
-            *content_reader.as_ptr() = Box::into_raw(Box::new(reader.as_mut().read_content(content)?));
+        if let Some(content) = payload.as_ref().content() {
+            *content_reader.as_ptr() = Box::into_raw(Box::new(reader.as_mut().inner.read_content(content)?));
         } else {
             Err("incorrect payload kind")?;
         }
@@ -319,6 +820,55 @@ pub unsafe extern "C" fn stone_payload_content_reader_read(
     }
 }
 
+/// Fill each buffer of `iov` in turn, like `readv`.
+///
+/// Returns the number of bytes read, which is only short of the total
+/// size of `iov` once the payload is exhausted, `0` at the end of the
+/// payload or a negative errno on failure.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_payload_content_reader_read_into(
+    content_reader: *mut StonePayloadContentReader,
+    iov: *const iovec,
+    iovcnt: c_int,
+) -> ssize_t {
+    unsafe {
+        let Some(mut content_reader) = NonNull::new(content_reader) else {
+            return -(libc::EINVAL as ssize_t);
+        };
+        if iovcnt < 0 || (iov.is_null() && iovcnt > 0) {
+            return -(libc::EINVAL as ssize_t);
+        }
+
+        let iov = if iovcnt > 0 {
+            slice::from_raw_parts(iov, iovcnt as usize)
+        } else {
+            &[]
+        };
+
+        let mut total = 0;
+
+        for vec in iov.iter().filter(|vec| vec.iov_len > 0) {
+            let buf = slice::from_raw_parts_mut(vec.iov_base as *mut u8, vec.iov_len);
+            let mut filled = 0;
+
+            while filled < buf.len() {
+                match content_reader.as_mut().read(&mut buf[filled..]) {
+                    Ok(0) => return (total + filled) as ssize_t,
+                    Ok(read) => filled += read,
+                    Err(error) if error.kind() == std::io::ErrorKind::Interrupted => {}
+                    // Report what was read, the error will surface again on the next call
+                    Err(_) if total + filled > 0 => return (total + filled) as ssize_t,
+                    Err(error) => return -error_code(&error),
+                }
+            }
+
+            total += filled;
+        }
+
+        total as ssize_t
+    }
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn stone_payload_content_reader_buf_hint(
     content_reader: *const StonePayloadContentReader,
@@ -429,6 +979,136 @@ pub unsafe extern "C" fn stone_payload_next_attribute_record(
     })
 }
 
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_payload_next_lookup_record(
+    payload: *mut StonePayload,
+    record: *mut StonePayloadLookupRecord,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut payload = NonNull::new(payload).ok_or("")?;
+        let mut record = NonNull::new(record).ok_or("")?;
+
+        *record.as_mut() = payload.as_mut().next_lookup_record().ok_or("")?;
+
+        Ok(())
+    })
+}
+
+/// Copy up to `capacity` of the payload's remaining layout records into `records`,
+/// storing how many were written in `num_records`.
+///
+/// Shares its cursor with `stone_payload_next_layout_record`, so repeated calls
+/// walk the payload in chunks. Fails if the payload isn't a layout payload.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_payload_layout_records(
+    payload: *mut StonePayload,
+    records: *mut StonePayloadLayoutRecord,
+    capacity: size_t,
+    num_records: *mut size_t,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut payload = NonNull::new(payload).ok_or("")?;
+        let records = NonNull::new(records).ok_or("")?;
+        let mut num_records = NonNull::new(num_records).ok_or("")?;
+
+        let out = slice::from_raw_parts_mut(records.as_ptr() as *mut MaybeUninit<StonePayloadLayoutRecord>, capacity);
+
+        *num_records.as_mut() = payload.as_mut().layout_records(out).ok_or("incorrect payload kind")?;
+
+        Ok(())
+    })
+}
+
+/// Batch counterpart of `stone_payload_next_meta_record`, see `stone_payload_layout_records`
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_payload_meta_records(
+    payload: *mut StonePayload,
+    records: *mut StonePayloadMetaRecord,
+    capacity: size_t,
+    num_records: *mut size_t,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut payload = NonNull::new(payload).ok_or("")?;
+        let records = NonNull::new(records).ok_or("")?;
+        let mut num_records = NonNull::new(num_records).ok_or("")?;
+
+        let out = slice::from_raw_parts_mut(records.as_ptr() as *mut MaybeUninit<StonePayloadMetaRecord>, capacity);
+
+        *num_records.as_mut() = payload.as_mut().meta_records(out).ok_or("incorrect payload kind")?;
+
+        Ok(())
+    })
+}
+
+/// Batch counterpart of `stone_payload_next_index_record`, see `stone_payload_layout_records`
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_payload_index_records(
+    payload: *mut StonePayload,
+    records: *mut StonePayloadIndexRecord,
+    capacity: size_t,
+    num_records: *mut size_t,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut payload = NonNull::new(payload).ok_or("")?;
+        let records = NonNull::new(records).ok_or("")?;
+        let mut num_records = NonNull::new(num_records).ok_or("")?;
+
+        let out = slice::from_raw_parts_mut(records.as_ptr() as *mut MaybeUninit<StonePayloadIndexRecord>, capacity);
+
+        *num_records.as_mut() = payload.as_mut().index_records(out).ok_or("incorrect payload kind")?;
+
+        Ok(())
+    })
+}
+
+/// Batch counterpart of `stone_payload_next_attribute_record`, see `stone_payload_layout_records`
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_payload_attribute_records(
+    payload: *mut StonePayload,
+    records: *mut StonePayloadAttributeRecord,
+    capacity: size_t,
+    num_records: *mut size_t,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut payload = NonNull::new(payload).ok_or("")?;
+        let records = NonNull::new(records).ok_or("")?;
+        let mut num_records = NonNull::new(num_records).ok_or("")?;
+
+        let out = slice::from_raw_parts_mut(
+            records.as_ptr() as *mut MaybeUninit<StonePayloadAttributeRecord>,
+            capacity,
+        );
+
+        *num_records.as_mut() = payload
+            .as_mut()
+            .attribute_records(out)
+            .ok_or("incorrect payload kind")?;
+
+        Ok(())
+    })
+}
+
+/// Batch counterpart of `stone_payload_next_lookup_record`, see `stone_payload_layout_records`
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_payload_lookup_records(
+    payload: *mut StonePayload,
+    records: *mut StonePayloadLookupRecord,
+    capacity: size_t,
+    num_records: *mut size_t,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut payload = NonNull::new(payload).ok_or("")?;
+        let records = NonNull::new(records).ok_or("")?;
+        let mut num_records = NonNull::new(num_records).ok_or("")?;
+
+        let out = slice::from_raw_parts_mut(records.as_ptr() as *mut MaybeUninit<StonePayloadLookupRecord>, capacity);
+
+        *num_records.as_mut() = payload.as_mut().lookup_records(out).ok_or("incorrect payload kind")?;
+
+        Ok(())
+    })
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn stone_payload_destroy(payload: *mut StonePayload) {
     unsafe {
@@ -440,6 +1120,165 @@ pub unsafe extern "C" fn stone_payload_destroy(payload: *mut StonePayload) {
     }
 }
 
+/// Start writing a stone archive to `file`, which is taken ownership of
+/// and closed once the writer is finalized or destroyed.
+///
+/// Payloads are compressed as they're added & content is hashed into its
+/// index records while being compressed, so every byte is only read once.
+/// After any function fails the writer can only be destroyed.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_writer_new(
+    file: c_int,
+    options: *const StoneWriterOptions,
+    writer_ptr: *mut *mut StoneWriter,
+) -> c_int {
+    fallible(|| unsafe {
+        let options = NonNull::new(options as *mut StoneWriterOptions).ok_or("")?;
+        let writer_ptr = NonNull::new(writer_ptr).ok_or("")?;
+
+        let writer = StoneWriter::new(File::from_raw_fd(file), options.as_ref())?;
+
+        *writer_ptr.as_ptr() = Box::into_raw(Box::new(writer));
+
+        Ok(())
+    })
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_writer_add_meta_payload(
+    writer: *mut StoneWriter,
+    records: *const StonePayloadMetaRecord,
+    num_records: size_t,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut writer = NonNull::new(writer).ok_or("")?;
+
+        let records = raw_slice(records, num_records)
+            .iter()
+            .map(|record| record.to_stone())
+            .collect::<Result<Vec<_>, _>>()?;
+
+        writer.as_mut().add_payload(records.as_slice().into())
+    })
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_writer_add_attribute_payload(
+    writer: *mut StoneWriter,
+    records: *const StonePayloadAttributeRecord,
+    num_records: size_t,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut writer = NonNull::new(writer).ok_or("")?;
+
+        let records = raw_slice(records, num_records)
+            .iter()
+            .map(|record| record.to_stone())
+            .collect::<Vec<_>>();
+
+        writer.as_mut().add_payload(records.as_slice().into())
+    })
+}
+
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_writer_add_layout_payload(
+    writer: *mut StoneWriter,
+    records: *const StonePayloadLayoutRecord,
+    num_records: size_t,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut writer = NonNull::new(writer).ok_or("")?;
+
+        let records = raw_slice(records, num_records)
+            .iter()
+            .map(|record| record.to_stone())
+            .collect::<Result<Vec<_>, _>>()?;
+
+        writer.as_mut().add_payload(records.as_slice().into())
+    })
+}
+
+/// Compress everything from the current offset of `file` to its end as the
+/// next file of the content payload.
+///
+/// When `index` isn't null it receives the index record of the file, whose
+/// digest is the hash to use for its layout record. `file` is not taken
+/// ownership of.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_writer_add_content_file(
+    writer: *mut StoneWriter,
+    file: c_int,
+    index: *mut StonePayloadIndexRecord,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut writer = NonNull::new(writer).ok_or("")?;
+        let mut file = splice::borrow_fd(file);
+
+        let record = writer.as_mut().add_content(&mut *file)?;
+
+        if let Some(mut index) = NonNull::new(index) {
+            *index.as_mut() = (&record).into();
+        }
+
+        Ok(())
+    })
+}
+
+/// Like `stone_writer_add_content_file` for a file already in memory
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_writer_add_content_buf(
+    writer: *mut StoneWriter,
+    buf: *const u8,
+    len: size_t,
+    index: *mut StonePayloadIndexRecord,
+) -> c_int {
+    fallible(|| unsafe {
+        let mut writer = NonNull::new(writer).ok_or("")?;
+
+        let record = writer.as_mut().add_content(&mut raw_slice(buf, len))?;
+
+        if let Some(mut index) = NonNull::new(index) {
+            *index.as_mut() = (&record).into();
+        }
+
+        Ok(())
+    })
+}
+
+/// Write out all payloads & destroy `writer`, whether or not this succeeds
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_writer_finalize(writer: *mut StoneWriter) -> c_int {
+    fallible(|| unsafe {
+        let writer = NonNull::new(writer).ok_or("")?;
+
+        Box::from_raw(writer.as_ptr()).finalize()
+    })
+}
+
+/// Abandon `writer` without finishing the archive
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_writer_destroy(writer: *mut StoneWriter) {
+    unsafe {
+        let Some(writer) = NonNull::new(writer) else {
+            return;
+        };
+
+        drop(Box::from_raw(writer.as_ptr()));
+    }
+}
+
+/// Call `callback` with `data` once each payload is decoded, the content
+/// payload is unpacked in full & every asset is verified while unpacking,
+/// replacing any previous callback. A `NULL` callback stops reporting.
+///
+/// Events come from every reader in the process and from whichever thread
+/// did the work, so `callback` must be thread safe. Nothing is timed while
+/// no callback is set.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn stone_set_event_callback(callback: StoneEventCallback, data: *mut c_void) {
+    stone::set_event_hook(callback.map(|callback| event::hook(callback, data)));
+}
+
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn stone_format_header_v1_file_type(file_type: StoneHeaderV1FileType, buf: *mut u8) {
     unsafe {
@@ -495,3 +1334,50 @@ unsafe fn fill_c_string(buf: *mut u8, content: impl ToString) {
         buf[content.len()] = b'\0';
     }
 }
+
+#[cfg(test)]
+mod test {
+    use std::ptr;
+
+    use super::*;
+
+    const BASH_COMPLETION: &[u8] = include_bytes!("../../test/bash-completion-2.11-1-1-x86_64.stone");
+
+    #[test]
+    fn next_payload_after_random_access() {
+        let mut stone = stone::read_bytes(BASH_COMPLETION).unwrap();
+        let table = stone.payload_table().unwrap().to_vec();
+        let last = table.last().unwrap().offset - StonePayloadHeader::SIZE as u64;
+
+        unsafe {
+            let mut reader = ptr::null_mut();
+            let mut version = StoneHeaderVersion::V1;
+            assert_eq!(
+                stone_read_buf(
+                    BASH_COMPLETION.as_ptr(),
+                    BASH_COMPLETION.len(),
+                    &mut reader,
+                    &mut version
+                ),
+                0
+            );
+
+            for entry in &table {
+                // Moves the reader elsewhere without building its payload table
+                let mut payload = ptr::null_mut();
+                assert_eq!(stone_reader_read_payload_at(reader, last, &mut payload), 0);
+                stone_payload_destroy(payload);
+
+                let mut payload = ptr::null_mut();
+                assert_eq!(stone_reader_next_payload(reader, &mut payload), 0);
+                assert_eq!((*payload).header(), &entry.header);
+                stone_payload_destroy(payload);
+            }
+
+            let mut payload = ptr::null_mut();
+            assert_eq!(stone_reader_next_payload(reader, &mut payload), -1);
+
+            stone_reader_destroy(reader);
+        }
+    }
+}
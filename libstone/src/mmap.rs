@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+use std::{io, ptr::NonNull, slice, sync::Arc};
+
+use libc::{c_int, c_void};
+
+use crate::StonePayload;
+
+/// Read-only private mapping of an entire file
+pub struct Mmap {
+    ptr: NonNull<c_void>,
+    len: usize,
+}
+
+impl Mmap {
+    pub unsafe fn map(fd: c_int) -> io::Result<Self> {
+        unsafe {
+            let mut stat = std::mem::zeroed::<libc::stat>();
+
+            if libc::fstat(fd, &mut stat) < 0 {
+                return Err(io::Error::last_os_error());
+            }
+
+            let len = stat.st_size as usize;
+
+            // Zero length mappings are invalid, and can't be a valid stone anyway
+            if len == 0 {
+                return Err(io::ErrorKind::UnexpectedEof.into());
+            }
+
+            let ptr = libc::mmap(std::ptr::null_mut(), len, libc::PROT_READ, libc::MAP_PRIVATE, fd, 0);
+
+            if ptr == libc::MAP_FAILED {
+                return Err(io::Error::last_os_error());
+            }
+
+            // Payloads are decoded front to back
+            libc::madvise(ptr, len, libc::MADV_SEQUENTIAL);
+
+            Ok(Self {
+                ptr: NonNull::new_unchecked(ptr),
+                len,
+            })
+        }
+    }
+
+    /// Bytes of the mapping with an unbounded lifetime
+    ///
+    /// # Safety
+    ///
+    /// Caller must ensure the returned slice doesn't outlive `self`
+    pub unsafe fn as_unbounded_slice<'a>(&self) -> &'a [u8] {
+        unsafe { slice::from_raw_parts(self.ptr.as_ptr() as *const u8, self.len) }
+    }
+}
+
+// SAFETY: Mapping is read-only & only unmapped on drop
+unsafe impl Send for Mmap {}
+unsafe impl Sync for Mmap {}
+
+impl Drop for Mmap {
+    fn drop(&mut self) {
+        unsafe {
+            libc::munmap(self.ptr.as_ptr(), self.len);
+        }
+    }
+}
+
+/// State for readers opened with [`crate::stone_read_mmap`]
+pub struct Mapped<'a> {
+    /// Decodes each payload as it's asked for, keeping its
+    /// decompressed body alive for the records handed out
+    pub reader: stone::StoneSliceReader<'a>,
+    // Must be dropped last, everything above borrows from it. Shared
+    // by every clone of the reader
+    pub map: Arc<Mmap>,
+}
+
+impl Mapped<'_> {
+    pub fn try_clone(&self) -> Result<Self, stone::StoneReadError> {
+        Ok(Self {
+            reader: stone::read_slice(self.reader.as_bytes())?,
+            map: self.map.clone(),
+        })
+    }
+
+    pub fn next_payload(&mut self) -> Result<Option<StonePayload>, Box<dyn std::error::Error>> {
+        match self.reader.next_payload()? {
+            Some(payload) => Ok(Some(StonePayload::from_slice(payload)?)),
+            None => Ok(None),
+        }
+    }
+}
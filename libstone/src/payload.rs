@@ -1,85 +1,246 @@
 // SPDX-FileCopyrightText: 2024 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
 
-use stone::{StoneDecodedPayload, StonePayloadHeader};
+use std::mem::MaybeUninit;
+
+use stone::{
+    StoneDecodedPayload, StonePayloadCompression, StonePayloadContent, StonePayloadDecodeError, StonePayloadHeader,
+    StonePayloadKind, StoneSlicePayload,
+};
 
 pub use self::attribute::StonePayloadAttributeRecord;
 pub use self::index::StonePayloadIndexRecord;
 pub use self::layout::StonePayloadLayoutRecord;
+pub use self::lookup::StonePayloadLookupRecord;
 pub use self::meta::{StonePayloadMetaPrimitiveType, StonePayloadMetaRecord};
 
 mod attribute;
 mod index;
 mod layout;
+mod lookup;
 mod meta;
 
 pub struct StonePayload {
-    pub decoded: StoneDecodedPayload,
+    body: StonePayloadBody,
     next_record: usize,
 }
 
+enum StonePayloadBody {
+    /// Owned payload decoded from a stream
+    Decoded(StoneDecodedPayload),
+    /// Records borrowing from a memory mapped reader, only
+    /// valid for as long as that reader is alive
+    Mapped(StonePayloadHeader, MappedRecords),
+}
+
+enum MappedRecords {
+    Meta(Vec<StonePayloadMetaRecord>),
+    Attributes(Vec<StonePayloadAttributeRecord>),
+    Layout(Vec<StonePayloadLayoutRecord>),
+    Index(Vec<StonePayloadIndexRecord>),
+    Lookup(Vec<StonePayloadLookupRecord>),
+}
+
 impl StonePayload {
     pub fn header(&self) -> &StonePayloadHeader {
-        self.decoded.header()
+        match &self.body {
+            StonePayloadBody::Decoded(decoded) => decoded.header(),
+            StonePayloadBody::Mapped(header, _) => header,
+        }
     }
 
-    pub fn next_layout_record(&mut self) -> Option<StonePayloadLayoutRecord> {
-        if self.next_record >= self.header().num_records {
-            return None;
+    pub fn content(&self) -> Option<&stone::StonePayload<StonePayloadContent>> {
+        match &self.body {
+            StonePayloadBody::Decoded(decoded) => decoded.content(),
+            StonePayloadBody::Mapped(..) => None,
         }
+    }
 
-        let payload = self.decoded.layout()?;
-        let record = payload.body.get(self.next_record)?;
-
-        self.next_record += 1;
+    /// Convert a zero-copy payload, records are only valid for as long
+    /// as the backing slice reader is alive
+    pub fn from_slice(payload: StoneSlicePayload<'_>) -> Result<Self, StonePayloadDecodeError> {
+        let header = payload.header;
+
+        let records = if let Some(records) = payload.meta() {
+            MappedRecords::Meta(records.map(|r| r.map(Into::into)).collect::<Result<_, _>>()?)
+        } else if let Some(records) = payload.attributes() {
+            MappedRecords::Attributes(records.map(|r| r.map(Into::into)).collect::<Result<_, _>>()?)
+        } else if let Some(records) = payload.layout() {
+            MappedRecords::Layout(records.map(|r| r.map(Into::into)).collect::<Result<_, _>>()?)
+        } else if let Some(records) = payload.index() {
+            MappedRecords::Index(records.map(|r| r.map(|r| (&r).into())).collect::<Result<_, _>>()?)
+        } else if let Some(records) = payload.lookup() {
+            MappedRecords::Lookup(records.map(|r| r.map(Into::into)).collect::<Result<_, _>>()?)
+        } else {
+            let decoded = if let Some(records) = payload.frames() {
+                // No C representation, kept around for seekable reads
+                StoneDecodedPayload::Frames(stone::StonePayload {
+                    header,
+                    body: records.collect::<Result<_, _>>()?,
+                })
+            } else if let Some(content) = payload.content() {
+                StoneDecodedPayload::Content(content)
+            } else if header.compression == StonePayloadCompression::Unknown {
+                StoneDecodedPayload::UnknownCompression(stone::StonePayload { header, body: () })
+            } else {
+                debug_assert_eq!(header.kind, StonePayloadKind::Unknown);
+                StoneDecodedPayload::Unknown(stone::StonePayload { header, body: () })
+            };
+
+            return Ok(decoded.into());
+        };
+
+        Ok(Self {
+            body: StonePayloadBody::Mapped(header, records),
+            next_record: 0,
+        })
+    }
 
-        Some(record.into())
+    pub fn next_layout_record(&mut self) -> Option<StonePayloadLayoutRecord> {
+        next(|out| self.layout_records(out))
     }
 
     pub fn next_meta_record(&mut self) -> Option<StonePayloadMetaRecord> {
-        if self.next_record >= self.header().num_records {
-            return None;
-        }
+        next(|out| self.meta_records(out))
+    }
 
-        let payload = self.decoded.meta()?;
-        let record = payload.body.get(self.next_record)?;
+    pub fn next_index_record(&mut self) -> Option<StonePayloadIndexRecord> {
+        next(|out| self.index_records(out))
+    }
 
-        self.next_record += 1;
+    pub fn next_attribute_record(&mut self) -> Option<StonePayloadAttributeRecord> {
+        next(|out| self.attribute_records(out))
+    }
 
-        Some(record.into())
+    pub fn next_lookup_record(&mut self) -> Option<StonePayloadLookupRecord> {
+        next(|out| self.lookup_records(out))
     }
 
-    pub fn next_index_record(&mut self) -> Option<StonePayloadIndexRecord> {
-        if self.next_record >= self.header().num_records {
-            return None;
-        }
+    /// Fill `out` with the next layout records, returning how many were written.
+    ///
+    /// Returns `None` if this isn't a layout payload.
+    pub fn layout_records(&mut self, out: &mut [MaybeUninit<StonePayloadLayoutRecord>]) -> Option<usize> {
+        self.records(
+            out,
+            |decoded| decoded.layout().map(|p| p.body.as_slice()),
+            |records| match records {
+                MappedRecords::Layout(records) => Some(records.as_slice()),
+                _ => None,
+            },
+        )
+    }
+
+    /// Fill `out` with the next meta records, returning how many were written.
+    ///
+    /// Returns `None` if this isn't a meta payload.
+    pub fn meta_records(&mut self, out: &mut [MaybeUninit<StonePayloadMetaRecord>]) -> Option<usize> {
+        self.records(
+            out,
+            |decoded| decoded.meta().map(|p| p.body.as_slice()),
+            |records| match records {
+                MappedRecords::Meta(records) => Some(records.as_slice()),
+                _ => None,
+            },
+        )
+    }
 
-        let payload = self.decoded.index()?;
-        let record = payload.body.get(self.next_record)?;
+    /// Fill `out` with the next index records, returning how many were written.
+    ///
+    /// Returns `None` if this isn't an index payload.
+    pub fn index_records(&mut self, out: &mut [MaybeUninit<StonePayloadIndexRecord>]) -> Option<usize> {
+        self.records(
+            out,
+            |decoded| decoded.index().map(|p| p.body.as_slice()),
+            |records| match records {
+                MappedRecords::Index(records) => Some(records.as_slice()),
+                _ => None,
+            },
+        )
+    }
 
-        self.next_record += 1;
+    /// Fill `out` with the next attribute records, returning how many were written.
+    ///
+    /// Returns `None` if this isn't an attribute payload.
+    pub fn attribute_records(&mut self, out: &mut [MaybeUninit<StonePayloadAttributeRecord>]) -> Option<usize> {
+        self.records(
+            out,
+            |decoded| decoded.attributes().map(|p| p.body.as_slice()),
+            |records| match records {
+                MappedRecords::Attributes(records) => Some(records.as_slice()),
+                _ => None,
+            },
+        )
+    }
 
-        Some(record.into())
+    /// Fill `out` with the next lookup records, returning how many were written.
+    ///
+    /// Returns `None` if this isn't a lookup payload.
+    pub fn lookup_records(&mut self, out: &mut [MaybeUninit<StonePayloadLookupRecord>]) -> Option<usize> {
+        self.records(
+            out,
+            |decoded| decoded.lookup().map(|p| p.body.as_slice()),
+            |records| match records {
+                MappedRecords::Lookup(records) => Some(records.as_slice()),
+                _ => None,
+            },
+        )
     }
 
-    pub fn next_attribute_record(&mut self) -> Option<StonePayloadAttributeRecord> {
-        if self.next_record >= self.header().num_records {
-            return None;
+    fn records<T, U>(
+        &mut self,
+        out: &mut [MaybeUninit<T>],
+        decoded: impl FnOnce(&StoneDecodedPayload) -> Option<&[U]>,
+        mapped: impl FnOnce(&MappedRecords) -> Option<&[T]>,
+    ) -> Option<usize>
+    where
+        T: Copy + for<'r> From<&'r U>,
+    {
+        let start = self.next_record.min(self.header().num_records);
+        let end = self.header().num_records;
+
+        let mut written = 0;
+
+        match &self.body {
+            StonePayloadBody::Decoded(payload) => {
+                let records = decoded(payload)?.get(start..end).unwrap_or_default();
+
+                for (slot, record) in out.iter_mut().zip(records) {
+                    slot.write(record.into());
+                    written += 1;
+                }
+            }
+            // Already in their C representation, this is a straight copy
+            StonePayloadBody::Mapped(_, records) => {
+                let records = mapped(records)?.get(start..end).unwrap_or_default();
+
+                for (slot, record) in out.iter_mut().zip(records) {
+                    slot.write(*record);
+                    written += 1;
+                }
+            }
         }
 
-        let payload = self.decoded.attributes()?;
-        let record = payload.body.get(self.next_record)?;
+        self.next_record = start + written;
+
+        Some(written)
+    }
+}
 
-        self.next_record += 1;
+/// Pull a single record through one of the batch accessors
+fn next<T>(fill: impl FnOnce(&mut [MaybeUninit<T>]) -> Option<usize>) -> Option<T> {
+    let mut slot = [MaybeUninit::uninit()];
 
-        Some(record.into())
+    match fill(&mut slot) {
+        // SAFETY: Slot was written to
+        Some(1) => Some(unsafe { slot[0].assume_init() }),
+        _ => None,
     }
 }
 
 impl From<StoneDecodedPayload> for StonePayload {
     fn from(decoded: StoneDecodedPayload) -> Self {
         Self {
-            decoded,
+            body: StonePayloadBody::Decoded(decoded),
             next_record: 0,
         }
     }
@@ -1,5 +1,7 @@
 // SPDX-FileCopyrightText: 2024 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
+use crate::raw_slice;
+
 #[derive(Debug, Clone, Copy)]
 #[repr(C)]
 pub struct StonePayloadAttributeRecord {
@@ -11,6 +13,12 @@ pub struct StonePayloadAttributeRecord {
 
 impl From<&stone::StonePayloadAttributeRecord> for StonePayloadAttributeRecord {
     fn from(record: &stone::StonePayloadAttributeRecord) -> Self {
+        record.as_view().into()
+    }
+}
+
+impl From<stone::StonePayloadAttributeRecordView<'_>> for StonePayloadAttributeRecord {
+    fn from(record: stone::StonePayloadAttributeRecordView<'_>) -> Self {
         Self {
             key_size: record.key.len(),
             key_buf: record.key.as_ptr(),
@@ -19,3 +27,15 @@ impl From<&stone::StonePayloadAttributeRecord> for StonePayloadAttributeRecord {
         }
     }
 }
+
+impl StonePayloadAttributeRecord {
+    /// Copy a record passed in from C
+    pub unsafe fn to_stone(&self) -> stone::StonePayloadAttributeRecord {
+        unsafe {
+            stone::StonePayloadAttributeRecord {
+                key: raw_slice(self.key_buf, self.key_size).to_vec(),
+                value: raw_slice(self.value_buf, self.value_size).to_vec(),
+            }
+        }
+    }
+}
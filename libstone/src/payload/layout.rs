@@ -1,6 +1,6 @@
 // SPDX-FileCopyrightText: 2024 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
-use stone::{StonePayloadLayoutFile, StonePayloadLayoutFileType};
+use stone::{StonePayloadLayoutFile, StonePayloadLayoutFileType, StonePayloadLayoutFileView};
 
 use crate::StoneString;
 
@@ -17,46 +17,93 @@ pub struct StonePayloadLayoutRecord {
 
 impl From<&stone::StonePayloadLayoutRecord> for StonePayloadLayoutRecord {
     fn from(record: &stone::StonePayloadLayoutRecord) -> Self {
+        record.as_view().into()
+    }
+}
+
+impl From<stone::StonePayloadLayoutRecordView<'_>> for StonePayloadLayoutRecord {
+    fn from(record: stone::StonePayloadLayoutRecordView<'_>) -> Self {
         StonePayloadLayoutRecord {
             uid: record.uid,
             gid: record.gid,
             mode: record.mode,
             tag: record.tag,
             file_type: record.file.file_type(),
-            file_payload: match &record.file {
-                StonePayloadLayoutFile::Regular(hash, name) => StonePayloadLayoutFilePayload {
+            file_payload: match record.file {
+                StonePayloadLayoutFileView::Regular(hash, name) => StonePayloadLayoutFilePayload {
                     regular: StonePayloadLayoutFileRegular {
                         hash: hash.to_be_bytes(),
                         name: StoneString::new(name),
                     },
                 },
-                StonePayloadLayoutFile::Symlink(source, target) => StonePayloadLayoutFilePayload {
+                StonePayloadLayoutFileView::Symlink(source, target) => StonePayloadLayoutFilePayload {
                     symlink: StonePayloadLayoutFileSymlink {
                         source: StoneString::new(source),
                         target: StoneString::new(target),
                     },
                 },
-                StonePayloadLayoutFile::Directory(name) => StonePayloadLayoutFilePayload {
+                StonePayloadLayoutFileView::Directory(name) => StonePayloadLayoutFilePayload {
                     directory: StoneString::new(name),
                 },
-                StonePayloadLayoutFile::CharacterDevice(name) => StonePayloadLayoutFilePayload {
+                StonePayloadLayoutFileView::CharacterDevice(name) => StonePayloadLayoutFilePayload {
                     character_device: StoneString::new(name),
                 },
-                StonePayloadLayoutFile::BlockDevice(name) => StonePayloadLayoutFilePayload {
+                StonePayloadLayoutFileView::BlockDevice(name) => StonePayloadLayoutFilePayload {
                     block_device: StoneString::new(name),
                 },
-                StonePayloadLayoutFile::Fifo(name) => StonePayloadLayoutFilePayload {
+                StonePayloadLayoutFileView::Fifo(name) => StonePayloadLayoutFilePayload {
                     fifo: StoneString::new(name),
                 },
-                StonePayloadLayoutFile::Socket(name) => StonePayloadLayoutFilePayload {
+                StonePayloadLayoutFileView::Socket(name) => StonePayloadLayoutFilePayload {
                     socket: StoneString::new(name),
                 },
-                StonePayloadLayoutFile::Unknown(..) => StonePayloadLayoutFilePayload { unknown: () },
+                StonePayloadLayoutFileView::Unknown(..) => StonePayloadLayoutFilePayload { unknown: () },
             },
         }
     }
 }
 
+impl StonePayloadLayoutRecord {
+    /// Copy a record passed in from C, reading the member of
+    /// `file_payload` selected by `file_type`
+    pub unsafe fn to_stone(&self) -> Result<stone::StonePayloadLayoutRecord, Box<dyn std::error::Error>> {
+        let payload = &self.file_payload;
+
+        let file = unsafe {
+            match self.file_type {
+                StonePayloadLayoutFileType::Regular => StonePayloadLayoutFile::Regular(
+                    u128::from_be_bytes(payload.regular.hash),
+                    payload.regular.name.as_str()?.into(),
+                ),
+                StonePayloadLayoutFileType::Symlink => StonePayloadLayoutFile::Symlink(
+                    payload.symlink.source.as_str()?.into(),
+                    payload.symlink.target.as_str()?.into(),
+                ),
+                StonePayloadLayoutFileType::Directory => {
+                    StonePayloadLayoutFile::Directory(payload.directory.as_str()?.into())
+                }
+                StonePayloadLayoutFileType::CharacterDevice => {
+                    StonePayloadLayoutFile::CharacterDevice(payload.character_device.as_str()?.into())
+                }
+                StonePayloadLayoutFileType::BlockDevice => {
+                    StonePayloadLayoutFile::BlockDevice(payload.block_device.as_str()?.into())
+                }
+                StonePayloadLayoutFileType::Fifo => StonePayloadLayoutFile::Fifo(payload.fifo.as_str()?.into()),
+                StonePayloadLayoutFileType::Socket => StonePayloadLayoutFile::Socket(payload.socket.as_str()?.into()),
+                StonePayloadLayoutFileType::Unknown => Err("unknown layout file type")?,
+            }
+        };
+
+        Ok(stone::StonePayloadLayoutRecord {
+            uid: self.uid,
+            gid: self.gid,
+            mode: self.mode,
+            tag: self.tag,
+            file,
+        })
+    }
+}
+
 #[derive(Clone, Copy)]
 #[repr(C)]
 pub union StonePayloadLayoutFilePayload {
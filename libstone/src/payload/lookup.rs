@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+use stone::StonePayloadLookupKind;
+
+use crate::StoneString;
+
+/// Records are sorted by `kind` & then the bytes of `key`, so a
+/// key can be found with a binary search
+#[derive(Debug, Clone, Copy)]
+#[repr(C)]
+pub struct StonePayloadLookupRecord {
+    /// Offset of the Meta payload, see `stone_reader_read_payload_at`
+    pub offset: u64,
+    pub kind: StonePayloadLookupKind,
+    pub key: StoneString,
+}
+
+impl From<&stone::StonePayloadLookupRecord> for StonePayloadLookupRecord {
+    fn from(record: &stone::StonePayloadLookupRecord) -> Self {
+        record.as_view().into()
+    }
+}
+
+impl From<stone::StonePayloadLookupRecordView<'_>> for StonePayloadLookupRecord {
+    fn from(record: stone::StonePayloadLookupRecordView<'_>) -> Self {
+        Self {
+            offset: record.offset,
+            kind: record.kind,
+            key: StoneString::new(record.key),
+        }
+    }
+}
@@ -1,9 +1,10 @@
 // SPDX-FileCopyrightText: 2024 AerynOS Developers
 // SPDX-License-Identifier: MPL-2.0
-use stone::{StonePayloadMetaDependency, StonePayloadMetaTag};
+use stone::{StonePayloadMetaDependency, StonePayloadMetaPrimitive, StonePayloadMetaTag};
 
 use crate::StoneString;
 
+#[derive(Clone, Copy)]
 #[repr(C)]
 pub struct StonePayloadMetaRecord {
     pub tag: StonePayloadMetaTag,
@@ -13,52 +14,96 @@ pub struct StonePayloadMetaRecord {
 
 impl From<&stone::StonePayloadMetaRecord> for StonePayloadMetaRecord {
     fn from(record: &stone::StonePayloadMetaRecord) -> Self {
+        record.as_view().into()
+    }
+}
+
+impl From<stone::StonePayloadMetaRecordView<'_>> for StonePayloadMetaRecord {
+    fn from(record: stone::StonePayloadMetaRecordView<'_>) -> Self {
         Self {
             tag: record.tag,
-            primitive_type: match &record.primitive {
-                stone::StonePayloadMetaPrimitive::Int8(_) => StonePayloadMetaPrimitiveType::Int8,
-                stone::StonePayloadMetaPrimitive::Uint8(_) => StonePayloadMetaPrimitiveType::Uint8,
-                stone::StonePayloadMetaPrimitive::Int16(_) => StonePayloadMetaPrimitiveType::Int16,
-                stone::StonePayloadMetaPrimitive::Uint16(_) => StonePayloadMetaPrimitiveType::Uint16,
-                stone::StonePayloadMetaPrimitive::Int32(_) => StonePayloadMetaPrimitiveType::Int32,
-                stone::StonePayloadMetaPrimitive::Uint32(_) => StonePayloadMetaPrimitiveType::Uint32,
-                stone::StonePayloadMetaPrimitive::Int64(_) => StonePayloadMetaPrimitiveType::Int64,
-                stone::StonePayloadMetaPrimitive::Uint64(_) => StonePayloadMetaPrimitiveType::Uint64,
-                stone::StonePayloadMetaPrimitive::String(_) => StonePayloadMetaPrimitiveType::String,
-                stone::StonePayloadMetaPrimitive::Dependency(..) => StonePayloadMetaPrimitiveType::Dependency,
-                stone::StonePayloadMetaPrimitive::Provider(..) => StonePayloadMetaPrimitiveType::Provider,
-                stone::StonePayloadMetaPrimitive::Unknown(_) => StonePayloadMetaPrimitiveType::Unknown,
+            primitive_type: match record.primitive {
+                stone::StonePayloadMetaPrimitiveView::Int8(_) => StonePayloadMetaPrimitiveType::Int8,
+                stone::StonePayloadMetaPrimitiveView::Uint8(_) => StonePayloadMetaPrimitiveType::Uint8,
+                stone::StonePayloadMetaPrimitiveView::Int16(_) => StonePayloadMetaPrimitiveType::Int16,
+                stone::StonePayloadMetaPrimitiveView::Uint16(_) => StonePayloadMetaPrimitiveType::Uint16,
+                stone::StonePayloadMetaPrimitiveView::Int32(_) => StonePayloadMetaPrimitiveType::Int32,
+                stone::StonePayloadMetaPrimitiveView::Uint32(_) => StonePayloadMetaPrimitiveType::Uint32,
+                stone::StonePayloadMetaPrimitiveView::Int64(_) => StonePayloadMetaPrimitiveType::Int64,
+                stone::StonePayloadMetaPrimitiveView::Uint64(_) => StonePayloadMetaPrimitiveType::Uint64,
+                stone::StonePayloadMetaPrimitiveView::String(_) => StonePayloadMetaPrimitiveType::String,
+                stone::StonePayloadMetaPrimitiveView::Dependency(..) => StonePayloadMetaPrimitiveType::Dependency,
+                stone::StonePayloadMetaPrimitiveView::Provider(..) => StonePayloadMetaPrimitiveType::Provider,
+                stone::StonePayloadMetaPrimitiveView::Unknown(_) => StonePayloadMetaPrimitiveType::Unknown,
             },
-            primitive_payload: match &record.primitive {
-                stone::StonePayloadMetaPrimitive::Int8(a) => StonePayloadMetaPrimitivePayload { int8: *a },
-                stone::StonePayloadMetaPrimitive::Uint8(a) => StonePayloadMetaPrimitivePayload { uint8: *a },
-                stone::StonePayloadMetaPrimitive::Int16(a) => StonePayloadMetaPrimitivePayload { int16: *a },
-                stone::StonePayloadMetaPrimitive::Uint16(a) => StonePayloadMetaPrimitivePayload { uint16: *a },
-                stone::StonePayloadMetaPrimitive::Int32(a) => StonePayloadMetaPrimitivePayload { int32: *a },
-                stone::StonePayloadMetaPrimitive::Uint32(a) => StonePayloadMetaPrimitivePayload { uint32: *a },
-                stone::StonePayloadMetaPrimitive::Int64(a) => StonePayloadMetaPrimitivePayload { int64: *a },
-                stone::StonePayloadMetaPrimitive::Uint64(a) => StonePayloadMetaPrimitivePayload { uint64: *a },
-                stone::StonePayloadMetaPrimitive::String(a) => StonePayloadMetaPrimitivePayload {
+            primitive_payload: match record.primitive {
+                stone::StonePayloadMetaPrimitiveView::Int8(a) => StonePayloadMetaPrimitivePayload { int8: a },
+                stone::StonePayloadMetaPrimitiveView::Uint8(a) => StonePayloadMetaPrimitivePayload { uint8: a },
+                stone::StonePayloadMetaPrimitiveView::Int16(a) => StonePayloadMetaPrimitivePayload { int16: a },
+                stone::StonePayloadMetaPrimitiveView::Uint16(a) => StonePayloadMetaPrimitivePayload { uint16: a },
+                stone::StonePayloadMetaPrimitiveView::Int32(a) => StonePayloadMetaPrimitivePayload { int32: a },
+                stone::StonePayloadMetaPrimitiveView::Uint32(a) => StonePayloadMetaPrimitivePayload { uint32: a },
+                stone::StonePayloadMetaPrimitiveView::Int64(a) => StonePayloadMetaPrimitivePayload { int64: a },
+                stone::StonePayloadMetaPrimitiveView::Uint64(a) => StonePayloadMetaPrimitivePayload { uint64: a },
+                stone::StonePayloadMetaPrimitiveView::String(a) => StonePayloadMetaPrimitivePayload {
                     string: StoneString::new(a),
                 },
-                stone::StonePayloadMetaPrimitive::Dependency(kind, name) => StonePayloadMetaPrimitivePayload {
+                stone::StonePayloadMetaPrimitiveView::Dependency(kind, name) => StonePayloadMetaPrimitivePayload {
                     dependency: StonePayloadMetaDependencyValue {
-                        kind: *kind,
+                        kind,
                         name: StoneString::new(name),
                     },
                 },
-                stone::StonePayloadMetaPrimitive::Provider(kind, name) => StonePayloadMetaPrimitivePayload {
+                stone::StonePayloadMetaPrimitiveView::Provider(kind, name) => StonePayloadMetaPrimitivePayload {
                     provider: StonePayloadMetaProviderValue {
-                        kind: *kind,
+                        kind,
                         name: StoneString::new(name),
                     },
                 },
-                stone::StonePayloadMetaPrimitive::Unknown(..) => StonePayloadMetaPrimitivePayload { unknown: () },
+                stone::StonePayloadMetaPrimitiveView::Unknown(..) => StonePayloadMetaPrimitivePayload { unknown: () },
             },
         }
     }
 }
 
+impl StonePayloadMetaRecord {
+    /// Copy a record passed in from C, reading the member of
+    /// `primitive_payload` selected by `primitive_type`
+    pub unsafe fn to_stone(&self) -> Result<stone::StonePayloadMetaRecord, Box<dyn std::error::Error>> {
+        let payload = &self.primitive_payload;
+
+        let primitive = unsafe {
+            match self.primitive_type {
+                StonePayloadMetaPrimitiveType::Int8 => StonePayloadMetaPrimitive::Int8(payload.int8),
+                StonePayloadMetaPrimitiveType::Uint8 => StonePayloadMetaPrimitive::Uint8(payload.uint8),
+                StonePayloadMetaPrimitiveType::Int16 => StonePayloadMetaPrimitive::Int16(payload.int16),
+                StonePayloadMetaPrimitiveType::Uint16 => StonePayloadMetaPrimitive::Uint16(payload.uint16),
+                StonePayloadMetaPrimitiveType::Int32 => StonePayloadMetaPrimitive::Int32(payload.int32),
+                StonePayloadMetaPrimitiveType::Uint32 => StonePayloadMetaPrimitive::Uint32(payload.uint32),
+                StonePayloadMetaPrimitiveType::Int64 => StonePayloadMetaPrimitive::Int64(payload.int64),
+                StonePayloadMetaPrimitiveType::Uint64 => StonePayloadMetaPrimitive::Uint64(payload.uint64),
+                StonePayloadMetaPrimitiveType::String => {
+                    StonePayloadMetaPrimitive::String(payload.string.as_str()?.to_owned())
+                }
+                StonePayloadMetaPrimitiveType::Dependency => StonePayloadMetaPrimitive::Dependency(
+                    payload.dependency.kind,
+                    payload.dependency.name.as_str()?.to_owned(),
+                ),
+                StonePayloadMetaPrimitiveType::Provider => StonePayloadMetaPrimitive::Provider(
+                    payload.provider.kind,
+                    payload.provider.name.as_str()?.to_owned(),
+                ),
+                StonePayloadMetaPrimitiveType::Unknown => Err("unknown meta primitive type")?,
+            }
+        };
+
+        Ok(stone::StonePayloadMetaRecord {
+            tag: self.tag,
+            primitive,
+        })
+    }
+}
+
 #[derive(Debug, Clone, Copy)]
 #[repr(u8)]
 pub enum StonePayloadMetaPrimitiveType {
@@ -76,6 +121,7 @@ pub enum StonePayloadMetaPrimitiveType {
     Unknown = 255,
 }
 
+#[derive(Clone, Copy)]
 #[repr(C)]
 pub union StonePayloadMetaPrimitivePayload {
     int8: i8,
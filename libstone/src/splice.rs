@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+use std::{
+    fs::File,
+    io::{self, Write},
+    mem::ManuallyDrop,
+    os::{fd::FromRawFd, unix::fs::FileExt},
+    ptr,
+};
+
+use libc::c_int;
+
+/// Largest single request, keeps byte counts within `ssize_t`
+const MAX_CHUNK: u64 = 1 << 30;
+
+#[derive(Clone, Copy)]
+enum Method {
+    CopyFileRange,
+    Sendfile,
+    Pread,
+}
+
+/// Borrow `fd` as a [`File`] without taking ownership of it
+pub unsafe fn borrow_fd(fd: c_int) -> ManuallyDrop<File> {
+    ManuallyDrop::new(unsafe { File::from_raw_fd(fd) })
+}
+
+/// Copy `len` bytes at `offset` of `src` to the current position of `dst`
+///
+/// Uses `copy_file_range` so the kernel (or filesystem, for reflinks)
+/// does the copy, then `sendfile`, only bouncing through userspace with
+/// `pread` if neither is supported between the two files.
+pub fn copy_range(src: c_int, offset: u64, len: u64, dst: c_int) -> io::Result<()> {
+    let mut method = Method::CopyFileRange;
+    let mut offset = offset;
+    let mut remaining = len;
+    let mut buffer = vec![];
+
+    while remaining > 0 {
+        let chunk = remaining.min(MAX_CHUNK) as usize;
+
+        let copied = match method {
+            Method::CopyFileRange => {
+                let mut off_in = offset as libc::loff_t;
+                unsafe { libc::copy_file_range(src, &mut off_in, dst, ptr::null_mut(), chunk, 0) }
+            }
+            Method::Sendfile => {
+                let mut off_in = offset as libc::off_t;
+                unsafe { libc::sendfile(dst, src, &mut off_in, chunk) }
+            }
+            Method::Pread => {
+                let source = unsafe { borrow_fd(src) };
+                let mut dest = unsafe { borrow_fd(dst) };
+
+                buffer.resize(chunk.min(128 * 1024), 0);
+
+                let read = source.read_at(&mut buffer, offset)?;
+                dest.write_all(&buffer[..read])?;
+
+                read as isize
+            }
+        };
+
+        if copied < 0 {
+            let error = io::Error::last_os_error();
+
+            method = match (error.raw_os_error(), method) {
+                (Some(libc::EINTR), method) => method,
+                // Not supported between these two files, try the next best thing
+                (Some(libc::ENOSYS | libc::EXDEV | libc::EINVAL | libc::EOPNOTSUPP), Method::CopyFileRange) => {
+                    Method::Sendfile
+                }
+                (Some(libc::ENOSYS | libc::EINVAL | libc::EOPNOTSUPP), Method::Sendfile) => Method::Pread,
+                _ => return Err(error),
+            };
+
+            continue;
+        }
+
+        if copied == 0 {
+            return Err(io::ErrorKind::UnexpectedEof.into());
+        }
+
+        offset += copied as u64;
+        remaining -= copied as u64;
+    }
+
+    Ok(())
+}
@@ -9,9 +9,21 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #define STONE_HEADER_SIZE 32
 
+/**
+ * Leave assets which already exist untouched, without verifying them
+ */
+#define STONE_UNPACK_SKIP_EXISTING (1 << 0)
+
+/**
+ * Hash assets which already exist & only rewrite them if their digest is wrong
+ */
+#define STONE_UNPACK_VERIFY_EXISTING (1 << 1)
+
 enum StoneSeekFrom
 #ifdef __cplusplus
   : uint8_t
@@ -25,6 +37,28 @@ enum StoneSeekFrom
 typedef uint8_t StoneSeekFrom;
 #endif // __cplusplus
 
+enum StoneEventKind
+#ifdef __cplusplus
+  : uint8_t
+#endif // __cplusplus
+ {
+  /**
+   * A record payload was read, checksummed & decoded
+   */
+  STONE_EVENT_KIND_PAYLOAD_DECODED = 1,
+  /**
+   * The content payload was decompressed & checksummed in full
+   */
+  STONE_EVENT_KIND_CONTENT_UNPACKED = 2,
+  /**
+   * An asset was hashed & matched its index record while unpacking
+   */
+  STONE_EVENT_KIND_ASSET_VERIFIED = 3,
+};
+#ifndef __cplusplus
+typedef uint8_t StoneEventKind;
+#endif // __cplusplus
+
 /**
  * Format versions are defined as u32, to allow further mangling in future
  */
@@ -82,6 +116,8 @@ enum StonePayloadKind
   STONE_PAYLOAD_KIND_LAYOUT = 3,
   STONE_PAYLOAD_KIND_INDEX = 4,
   STONE_PAYLOAD_KIND_ATTRIBUTES = 5,
+  STONE_PAYLOAD_KIND_FRAMES = 6,
+  STONE_PAYLOAD_KIND_LOOKUP = 7,
   STONE_PAYLOAD_KIND_UNKNOWN = 255,
 };
 #ifndef __cplusplus
@@ -244,12 +280,58 @@ enum StonePayloadMetaDependency
 typedef uint8_t StonePayloadMetaDependency;
 #endif // __cplusplus
 
+/**
+ * What the key of a [`StonePayloadLookupRecord`] identifies
+ */
+enum StonePayloadLookupKind
+#ifdef __cplusplus
+  : uint8_t
+#endif // __cplusplus
+ {
+  /**
+   * Package name
+   */
+  STONE_PAYLOAD_LOOKUP_KIND_NAME = 1,
+  /**
+   * Provider in its `kind(name)` form
+   */
+  STONE_PAYLOAD_LOOKUP_KIND_PROVIDER = 2,
+  /**
+   * Hash of the package file
+   */
+  STONE_PAYLOAD_LOOKUP_KIND_HASH = 3,
+  /**
+   * sha256 of the index a delta index applies to
+   */
+  STONE_PAYLOAD_LOOKUP_KIND_BASE = 4,
+  /**
+   * sha256 of the index produced by applying a delta index
+   */
+  STONE_PAYLOAD_LOOKUP_KIND_TARGET = 5,
+  /**
+   * Hash of a package file dropped by a delta index, the offset is unused
+   */
+  STONE_PAYLOAD_LOOKUP_KIND_REMOVED = 6,
+  STONE_PAYLOAD_LOOKUP_KIND_UNKNOWN = 255,
+};
+#ifndef __cplusplus
+typedef uint8_t StonePayloadLookupKind;
+#endif // __cplusplus
+
+/**
+ * Decoder state which can be shared by readers one at a time,
+ * see [`stone_reader_set_decode_context`]
+ */
+typedef struct StoneDecodeContext StoneDecodeContext;
+
 typedef struct StonePayload StonePayload;
 
 typedef struct StonePayloadContentReader StonePayloadContentReader;
 
 typedef struct StoneReader StoneReader;
 
+typedef struct StoneWriter StoneWriter;
+
 typedef struct StoneReadVTable {
   uintptr_t (*read)(void*, char*, uintptr_t);
   int64_t (*seek)(void*, int64_t, StoneSeekFrom);
@@ -277,6 +359,17 @@ typedef struct StonePayloadHeader {
   StonePayloadCompression compression;
 } StonePayloadHeader;
 
+/**
+ * Location of a payload within the archive
+ */
+typedef struct StonePayloadTableEntry {
+  struct StonePayloadHeader header;
+  /**
+   * Offset of the payload body, after its header
+   */
+  uint64_t offset;
+} StonePayloadTableEntry;
+
 typedef struct StoneString {
   const uint8_t *buf;
   size_t size;
@@ -354,6 +447,67 @@ typedef struct StonePayloadAttributeRecord {
   const uint8_t *value_buf;
 } StonePayloadAttributeRecord;
 
+/**
+ * Records are sorted by `kind` & then the bytes of `key`, so a
+ * key can be found with a binary search
+ */
+typedef struct StonePayloadLookupRecord {
+  /**
+   * Offset of the Meta payload, see `stone_reader_read_payload_at`
+   */
+  uint64_t offset;
+  StonePayloadLookupKind kind;
+  struct StoneString key;
+} StonePayloadLookupRecord;
+
+/**
+ * Work done by a reader, see [`stone_set_event_callback`]
+ */
+typedef struct StoneEvent {
+  StoneEventKind kind;
+  /**
+   * The payload worked on, `Content` for assets
+   */
+  StonePayloadKind payload_kind;
+  /**
+   * Compressed bytes read, `0` for assets
+   */
+  uint64_t stored_size;
+  /**
+   * Decompressed bytes, or the size of the asset
+   */
+  uint64_t plain_size;
+  /**
+   * Nanoseconds taken, including `checksum_ns`
+   */
+  uint64_t elapsed_ns;
+  /**
+   * Nanoseconds spent hashing
+   */
+  uint64_t checksum_ns;
+} StoneEvent;
+
+typedef void (*StoneEventCallback)(const struct StoneEvent *event, void *data);
+
+typedef struct StoneWriterOptions {
+  StoneHeaderV1FileType file_type;
+  /**
+   * zstd level for all payloads, `0` uses the default
+   */
+  int compression_level;
+  /**
+   * Threads compressing content alongside the caller, `0` compresses
+   * on the calling thread only
+   */
+  unsigned int num_workers;
+  /**
+   * Log2 of the zstd window, `0` uses the default of 31. Readers
+   * need as much memory to decode the content payload.
+   */
+  unsigned int window_log;
+  bool long_distance_matching;
+} StoneWriterOptions;
+
 
 
 #ifdef __cplusplus
@@ -372,14 +526,131 @@ int stone_read_buf(const uint8_t *buf,
                    StoneReader **reader_ptr,
                    StoneHeaderVersion *version);
 
+/**
+ * Memory map `file` and read the stone from the mapping.
+ *
+ * Records of uncompressed payloads point straight into the mapping,
+ * compressed payloads are decompressed one at a time by
+ * `stone_reader_next_payload` into buffers owned by the reader. All
+ * `StoneString` and record buffers are therefore only valid until the
+ * reader is destroyed, even if the payload is still alive.
+ *
+ * `file` is not taken ownership of and can be closed once this returns.
+ */
+int stone_read_mmap(int file, StoneReader **reader_ptr, StoneHeaderVersion *version);
+
+StoneDecodeContext *stone_decode_context_new(void);
+
+void stone_decode_context_destroy(StoneDecodeContext *context);
+
+/**
+ * Lend `context` to `reader` so its zstd state & buffers are reused instead
+ * of allocated again for this reader.
+ *
+ * The context is handed back once the reader is destroyed, at which point
+ * it can be attached to another reader. A context can only be attached to a
+ * single reader at a time and must outlive it.
+ */
+int stone_reader_set_decode_context(StoneReader *reader, StoneDecodeContext *context);
+
+/**
+ * Create an independent reader over the same archive as `reader`.
+ *
+ * Each reader has its own position, checksum & decode state so the two can
+ * be used from different threads at the same time, for example to decode
+ * different payloads or content ranges in parallel. Payload iteration of the
+ * clone starts again from the first payload.
+ *
+ * Readers created with `stone_read_file` read with `pread` and share the fd,
+ * which is closed once the last of them is destroyed. Readers created with
+ * `stone_read` can't be cloned.
+ */
+int stone_reader_clone(const StoneReader *reader, StoneReader **clone_ptr);
+
 int stone_reader_header_v1(const StoneReader *reader, struct StoneHeaderV1 *header);
 
 int stone_reader_next_payload(StoneReader *reader, struct StonePayload **payload_ptr);
 
+/**
+ * Scan payload headers without decoding any bodies, filling `entries` with up
+ * to `capacity` entries. `num_entries` is always set to the total number of
+ * payloads so callers can size their buffer by first passing a `capacity` of 0.
+ *
+ * The table is cached by the reader and doesn't affect `stone_reader_next_payload`.
+ */
+int stone_reader_payload_table(StoneReader *reader,
+                               struct StonePayloadTableEntry *entries,
+                               size_t capacity,
+                               size_t *num_entries);
+
+/**
+ * Decode only the first payload of `kind`, seeking over all others.
+ *
+ * Fails if the stone has no payload of this kind. The returned payload must
+ * be freed with `stone_payload_destroy`.
+ */
+int stone_reader_payload_by_kind(StoneReader *reader,
+                                 StonePayloadKind kind,
+                                 struct StonePayload **payload_ptr);
+
+/**
+ * Decode the payload whose header starts at `offset`, such as the Meta
+ * payload a `StonePayloadLookupRecord` points to.
+ *
+ * The returned payload must be freed with `stone_payload_destroy`.
+ */
+int stone_reader_read_payload_at(StoneReader *reader,
+                                 uint64_t offset,
+                                 struct StonePayload **payload_ptr);
+
 int stone_reader_unpack_content_payload(StoneReader *reader,
                                         const struct StonePayload *payload,
                                         int file);
 
+/**
+ * Unpack every asset of the content payload into `dirfd`, laid out as
+ * `aa/bb/cc/<digest>` exactly like the moss asset store.
+ *
+ * Assets are written directly as they're decompressed, verified against
+ * the index payload and renamed into place from a pool of `workers`
+ * threads, or one per CPU when `0`. `flags` is a combination of
+ * `STONE_UNPACK_*` flags.
+ */
+int stone_reader_unpack_content_to_dir(StoneReader *reader,
+                                       const struct StonePayload *payload,
+                                       int dirfd,
+                                       unsigned int flags,
+                                       unsigned int workers);
+
+/**
+ * Decompress the bytes `start..end` of the content payload into `buf`,
+ * which must have room for `end - start` bytes.
+ *
+ * Seekable stones only decompress the frames covering the range, others
+ * are decoded from the start of the payload. No checksum is validated,
+ * compare against the index record digest if required.
+ */
+int stone_reader_extract_range(StoneReader *reader,
+                               const struct StonePayload *payload,
+                               uint64_t start,
+                               uint64_t end,
+                               uint8_t *buf);
+
+/**
+ * Write the decompressed content payload to the current position of `file`,
+ * returning the number of bytes written or a negative errno.
+ *
+ * Uncompressed payloads aren't copied through userspace at all, they're
+ * handed to `copy_file_range` / `sendfile` straight from the source fd (or
+ * written straight from the mapping of `stone_read_mmap` readers). As the
+ * bytes are never seen the payload checksum isn't validated in that case.
+ *
+ * `file` is not taken ownership of.
+ */
+ssize_t stone_reader_splice_content_payload(StoneReader *reader,
+                                            const struct StonePayload *payload,
+                                            int file);
+
 int stone_reader_read_content_payload(StoneReader *reader,
                                       const struct StonePayload *payload,
                                       StonePayloadContentReader **content_reader);
@@ -390,6 +661,17 @@ size_t stone_payload_content_reader_read(StonePayloadContentReader *content_read
                                          uint8_t *buf,
                                          size_t size);
 
+/**
+ * Fill each buffer of `iov` in turn, like `readv`.
+ *
+ * Returns the number of bytes read, which is only short of the total
+ * size of `iov` once the payload is exhausted, `0` at the end of the
+ * payload or a negative errno on failure.
+ */
+ssize_t stone_payload_content_reader_read_into(StonePayloadContentReader *content_reader,
+                                               const struct iovec *iov,
+                                               int iovcnt);
+
 int stone_payload_content_reader_buf_hint(const StonePayloadContentReader *content_reader,
                                           uintptr_t *hint);
 
@@ -411,8 +693,118 @@ int stone_payload_next_index_record(struct StonePayload *payload,
 int stone_payload_next_attribute_record(struct StonePayload *payload,
                                         struct StonePayloadAttributeRecord *record);
 
+int stone_payload_next_lookup_record(struct StonePayload *payload,
+                                     struct StonePayloadLookupRecord *record);
+
+/**
+ * Copy up to `capacity` of the payload's remaining layout records into `records`,
+ * storing how many were written in `num_records`.
+ *
+ * Shares its cursor with `stone_payload_next_layout_record`, so repeated calls
+ * walk the payload in chunks. Fails if the payload isn't a layout payload.
+ */
+int stone_payload_layout_records(struct StonePayload *payload,
+                                 struct StonePayloadLayoutRecord *records,
+                                 size_t capacity,
+                                 size_t *num_records);
+
+/**
+ * Batch counterpart of `stone_payload_next_meta_record`, see `stone_payload_layout_records`
+ */
+int stone_payload_meta_records(struct StonePayload *payload,
+                               struct StonePayloadMetaRecord *records,
+                               size_t capacity,
+                               size_t *num_records);
+
+/**
+ * Batch counterpart of `stone_payload_next_index_record`, see `stone_payload_layout_records`
+ */
+int stone_payload_index_records(struct StonePayload *payload,
+                                struct StonePayloadIndexRecord *records,
+                                size_t capacity,
+                                size_t *num_records);
+
+/**
+ * Batch counterpart of `stone_payload_next_attribute_record`, see `stone_payload_layout_records`
+ */
+int stone_payload_attribute_records(struct StonePayload *payload,
+                                    struct StonePayloadAttributeRecord *records,
+                                    size_t capacity,
+                                    size_t *num_records);
+
+/**
+ * Batch counterpart of `stone_payload_next_lookup_record`, see `stone_payload_layout_records`
+ */
+int stone_payload_lookup_records(struct StonePayload *payload,
+                                 struct StonePayloadLookupRecord *records,
+                                 size_t capacity,
+                                 size_t *num_records);
+
 void stone_payload_destroy(struct StonePayload *payload);
 
+/**
+ * Start writing a stone archive to `file`, which is taken ownership of
+ * and closed once the writer is finalized or destroyed.
+ *
+ * Payloads are compressed as they're added & content is hashed into its
+ * index records while being compressed, so every byte is only read once.
+ * After any function fails the writer can only be destroyed.
+ */
+int stone_writer_new(int file, const struct StoneWriterOptions *options, StoneWriter **writer_ptr);
+
+int stone_writer_add_meta_payload(StoneWriter *writer,
+                                  const struct StonePayloadMetaRecord *records,
+                                  size_t num_records);
+
+int stone_writer_add_attribute_payload(StoneWriter *writer,
+                                       const struct StonePayloadAttributeRecord *records,
+                                       size_t num_records);
+
+int stone_writer_add_layout_payload(StoneWriter *writer,
+                                    const struct StonePayloadLayoutRecord *records,
+                                    size_t num_records);
+
+/**
+ * Compress everything from the current offset of `file` to its end as the
+ * next file of the content payload.
+ *
+ * When `index` isn't null it receives the index record of the file, whose
+ * digest is the hash to use for its layout record. `file` is not taken
+ * ownership of.
+ */
+int stone_writer_add_content_file(StoneWriter *writer,
+                                  int file,
+                                  struct StonePayloadIndexRecord *index);
+
+/**
+ * Like `stone_writer_add_content_file` for a file already in memory
+ */
+int stone_writer_add_content_buf(StoneWriter *writer,
+                                 const uint8_t *buf,
+                                 size_t len,
+                                 struct StonePayloadIndexRecord *index);
+
+/**
+ * Write out all payloads & destroy `writer`, whether or not this succeeds
+ */
+int stone_writer_finalize(StoneWriter *writer);
+
+/**
+ * Abandon `writer` without finishing the archive
+ */
+void stone_writer_destroy(StoneWriter *writer);
+
+/**
+ * Call `callback` with `data` once each payload is decoded, the content
+ * payload is unpacked in full & every asset is verified while unpacking,
+ * replacing any previous callback. A `NULL` callback stops reporting.
+ *
+ * Events come from every reader in the process and from whichever thread
+ * did the work, so `callback` must be thread safe. Nothing is timed while
+ * no callback is set.
+ */
+void stone_set_event_callback(StoneEventCallback callback, void *data);
+
 void stone_format_header_v1_file_type(StoneHeaderV1FileType file_type, uint8_t *buf);
 
 void stone_format_payload_compression(StonePayloadCompression compression, uint8_t *buf);
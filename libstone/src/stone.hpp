@@ -0,0 +1,681 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+// Header-only C++20 interface to libstone
+//
+// Handles are move-only and destroyed with their owner, failures are thrown
+// as `stone::Error`. Records are copied out of a payload once, when it's
+// decoded, and exposed as random access ranges of lightweight views.
+//
+// Lifetimes: every `std::string_view` and byte span handed out by a record
+// points into memory owned by the payload it came from, or by the reader for
+// readers created with `Reader::map`. They're valid for as long as both the
+// `Payload` and the `Reader` it was read from are alive, so neither should be
+// destroyed before the last view of its records. A `ContentReader` borrows
+// the reader it was created from in the same way.
+
+#ifndef STONE_HPP
+#define STONE_HPP
+
+#include <cerrno>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <stone.h>
+
+namespace stone {
+
+// A failed libstone call, with the errno reported by the call if it has one
+// and `EIO` otherwise
+class Error : public std::system_error {
+public:
+  explicit Error(const char *operation, int code = EIO)
+      : std::system_error(code, std::generic_category(), operation) {}
+};
+
+namespace detail {
+
+inline void check(int ret, const char *operation) {
+  if (ret < 0) {
+    throw Error(operation);
+  }
+}
+
+inline std::string_view view(const StoneString &string) noexcept {
+  return {reinterpret_cast<const char *>(string.buf), string.size};
+}
+
+inline std::span<const std::byte> bytes(const std::uint8_t *buf,
+                                        std::size_t size) noexcept {
+  return {reinterpret_cast<const std::byte *>(buf), size};
+}
+
+template <typename T, void (*Destroy)(T *)> struct Deleter {
+  void operator()(T *handle) const noexcept { Destroy(handle); }
+};
+
+template <typename T, void (*Destroy)(T *)>
+using Handle = std::unique_ptr<T, Deleter<T, Destroy>>;
+
+} // namespace detail
+
+// 128-bit digest of a file, big endian as in the layout records
+using Digest = std::span<const std::uint8_t, 16>;
+
+class LayoutRecord {
+public:
+  explicit LayoutRecord(const StonePayloadLayoutRecord &raw) noexcept
+      : raw_(&raw) {}
+
+  std::uint32_t uid() const noexcept { return raw_->uid; }
+  std::uint32_t gid() const noexcept { return raw_->gid; }
+  std::uint32_t mode() const noexcept { return raw_->mode; }
+  std::uint32_t tag() const noexcept { return raw_->tag; }
+  StonePayloadLayoutFileType file_type() const noexcept {
+    return raw_->file_type;
+  }
+
+  // Path the entry is installed at, relative to `/usr`
+  std::string_view target() const noexcept {
+    const auto &payload = raw_->file_payload;
+
+    switch (raw_->file_type) {
+    case STONE_PAYLOAD_LAYOUT_FILE_TYPE_REGULAR:
+      return detail::view(payload.regular.name);
+    case STONE_PAYLOAD_LAYOUT_FILE_TYPE_SYMLINK:
+      return detail::view(payload.symlink.target);
+    case STONE_PAYLOAD_LAYOUT_FILE_TYPE_DIRECTORY:
+      return detail::view(payload.directory);
+    case STONE_PAYLOAD_LAYOUT_FILE_TYPE_CHARACTER_DEVICE:
+      return detail::view(payload.character_device);
+    case STONE_PAYLOAD_LAYOUT_FILE_TYPE_BLOCK_DEVICE:
+      return detail::view(payload.block_device);
+    case STONE_PAYLOAD_LAYOUT_FILE_TYPE_FIFO:
+      return detail::view(payload.fifo);
+    case STONE_PAYLOAD_LAYOUT_FILE_TYPE_SOCKET:
+      return detail::view(payload.socket);
+    default:
+      return {};
+    }
+  }
+
+  // Digest of the content of a regular file, empty for any other type
+  std::optional<Digest> hash() const noexcept {
+    if (raw_->file_type != STONE_PAYLOAD_LAYOUT_FILE_TYPE_REGULAR) {
+      return std::nullopt;
+    }
+    return Digest(raw_->file_payload.regular.hash);
+  }
+
+  // What a symlink points to, empty for any other type
+  std::string_view symlink_source() const noexcept {
+    if (raw_->file_type != STONE_PAYLOAD_LAYOUT_FILE_TYPE_SYMLINK) {
+      return {};
+    }
+    return detail::view(raw_->file_payload.symlink.source);
+  }
+
+  const StonePayloadLayoutRecord &raw() const noexcept { return *raw_; }
+
+private:
+  const StonePayloadLayoutRecord *raw_;
+};
+
+// Value of a dependency or provider meta record
+struct Dependency {
+  StonePayloadMetaDependency kind;
+  std::string_view name;
+};
+
+class MetaRecord {
+public:
+  explicit MetaRecord(const StonePayloadMetaRecord &raw) noexcept
+      : raw_(&raw) {}
+
+  StonePayloadMetaTag tag() const noexcept { return raw_->tag; }
+  StonePayloadMetaPrimitiveType primitive_type() const noexcept {
+    return raw_->primitive_type;
+  }
+
+  // Call `visitor` with the value as its integer type, a `std::string_view`
+  // or a `Dependency`. Records of an unknown type are passed as
+  // `std::monostate`.
+  template <typename Visitor> decltype(auto) visit(Visitor &&visitor) const {
+    const auto &payload = raw_->primitive_payload;
+
+    switch (raw_->primitive_type) {
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_INT8:
+      return std::forward<Visitor>(visitor)(payload.int8);
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_UINT8:
+      return std::forward<Visitor>(visitor)(payload.uint8);
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_INT16:
+      return std::forward<Visitor>(visitor)(payload.int16);
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_UINT16:
+      return std::forward<Visitor>(visitor)(payload.uint16);
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_INT32:
+      return std::forward<Visitor>(visitor)(payload.int32);
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_UINT32:
+      return std::forward<Visitor>(visitor)(payload.uint32);
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_INT64:
+      return std::forward<Visitor>(visitor)(payload.int64);
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_UINT64:
+      return std::forward<Visitor>(visitor)(payload.uint64);
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_STRING:
+      return std::forward<Visitor>(visitor)(detail::view(payload.string));
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_DEPENDENCY:
+      return std::forward<Visitor>(visitor)(Dependency{
+          payload.dependency.kind, detail::view(payload.dependency.name)});
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_PROVIDER:
+      return std::forward<Visitor>(visitor)(Dependency{
+          payload.provider.kind, detail::view(payload.provider.name)});
+    default:
+      return std::forward<Visitor>(visitor)(std::monostate{});
+    }
+  }
+
+  // The value of a string record, empty for any other type
+  std::string_view string() const noexcept {
+    if (raw_->primitive_type != STONE_PAYLOAD_META_PRIMITIVE_TYPE_STRING) {
+      return {};
+    }
+    return detail::view(raw_->primitive_payload.string);
+  }
+
+  // The value of a dependency or provider record, if that's what this is
+  std::optional<Dependency> dependency() const noexcept {
+    const auto &payload = raw_->primitive_payload;
+
+    switch (raw_->primitive_type) {
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_DEPENDENCY:
+      return Dependency{payload.dependency.kind,
+                        detail::view(payload.dependency.name)};
+    case STONE_PAYLOAD_META_PRIMITIVE_TYPE_PROVIDER:
+      return Dependency{payload.provider.kind,
+                        detail::view(payload.provider.name)};
+    default:
+      return std::nullopt;
+    }
+  }
+
+  const StonePayloadMetaRecord &raw() const noexcept { return *raw_; }
+
+private:
+  const StonePayloadMetaRecord *raw_;
+};
+
+class IndexRecord {
+public:
+  explicit IndexRecord(const StonePayloadIndexRecord &raw) noexcept
+      : raw_(&raw) {}
+
+  // Offset of the file within the unpacked content payload
+  std::uint64_t start() const noexcept { return raw_->start; }
+  std::uint64_t end() const noexcept { return raw_->end; }
+  std::uint64_t size() const noexcept { return raw_->end - raw_->start; }
+  Digest digest() const noexcept { return Digest(raw_->digest); }
+
+  const StonePayloadIndexRecord &raw() const noexcept { return *raw_; }
+
+private:
+  const StonePayloadIndexRecord *raw_;
+};
+
+class AttributeRecord {
+public:
+  explicit AttributeRecord(const StonePayloadAttributeRecord &raw) noexcept
+      : raw_(&raw) {}
+
+  std::span<const std::byte> key() const noexcept {
+    return detail::bytes(raw_->key_buf, raw_->key_size);
+  }
+  std::span<const std::byte> value() const noexcept {
+    return detail::bytes(raw_->value_buf, raw_->value_size);
+  }
+
+  const StonePayloadAttributeRecord &raw() const noexcept { return *raw_; }
+
+private:
+  const StonePayloadAttributeRecord *raw_;
+};
+
+class LookupRecord {
+public:
+  explicit LookupRecord(const StonePayloadLookupRecord &raw) noexcept
+      : raw_(&raw) {}
+
+  // Offset of the Meta payload, see `Reader::payload_at`
+  std::uint64_t offset() const noexcept { return raw_->offset; }
+  StonePayloadLookupKind kind() const noexcept { return raw_->kind; }
+  std::string_view key() const noexcept { return detail::view(raw_->key); }
+
+  const StonePayloadLookupRecord &raw() const noexcept { return *raw_; }
+
+private:
+  const StonePayloadLookupRecord *raw_;
+};
+
+// Random access range over the records of a payload, yielding each as a
+// `Record` view of the underlying C struct
+template <typename Record, typename Raw>
+class Records : public std::ranges::view_interface<Records<Record, Raw>> {
+public:
+  class iterator {
+  public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Record;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(const Raw *position) noexcept : position_(position) {}
+
+    Record operator*() const noexcept { return Record(*position_); }
+    Record operator[](difference_type n) const noexcept {
+      return Record(position_[n]);
+    }
+
+    iterator &operator++() noexcept {
+      ++position_;
+      return *this;
+    }
+    iterator operator++(int) noexcept { return iterator(position_++); }
+    iterator &operator--() noexcept {
+      --position_;
+      return *this;
+    }
+    iterator operator--(int) noexcept { return iterator(position_--); }
+    iterator &operator+=(difference_type n) noexcept {
+      position_ += n;
+      return *this;
+    }
+    iterator &operator-=(difference_type n) noexcept {
+      position_ -= n;
+      return *this;
+    }
+
+    friend iterator operator+(iterator it, difference_type n) noexcept {
+      return it += n;
+    }
+    friend iterator operator+(difference_type n, iterator it) noexcept {
+      return it += n;
+    }
+    friend iterator operator-(iterator it, difference_type n) noexcept {
+      return it -= n;
+    }
+    friend difference_type operator-(iterator a, iterator b) noexcept {
+      return a.position_ - b.position_;
+    }
+
+    friend bool operator==(iterator, iterator) = default;
+    friend std::strong_ordering operator<=>(iterator, iterator) = default;
+
+  private:
+    const Raw *position_ = nullptr;
+  };
+
+  Records() = default;
+  explicit Records(std::span<const Raw> raw) noexcept : raw_(raw) {}
+
+  iterator begin() const noexcept { return iterator(raw_.data()); }
+  iterator end() const noexcept { return iterator(raw_.data() + raw_.size()); }
+
+  // The records as the C structs filled in by libstone
+  std::span<const Raw> raw() const noexcept { return raw_; }
+
+private:
+  std::span<const Raw> raw_;
+};
+
+using LayoutRecords = Records<LayoutRecord, StonePayloadLayoutRecord>;
+using MetaRecords = Records<MetaRecord, StonePayloadMetaRecord>;
+using IndexRecords = Records<IndexRecord, StonePayloadIndexRecord>;
+using AttributeRecords = Records<AttributeRecord, StonePayloadAttributeRecord>;
+using LookupRecords = Records<LookupRecord, StonePayloadLookupRecord>;
+
+class Payload {
+public:
+  // Take ownership of a payload returned by libstone
+  explicit Payload(StonePayload *payload) : handle_(payload) {
+    detail::check(stone_payload_header(payload, &header_),
+                  "stone_payload_header");
+
+    switch (header_.kind) {
+    case STONE_PAYLOAD_KIND_LAYOUT:
+      records_ = fill<StonePayloadLayoutRecord, stone_payload_layout_records>();
+      break;
+    case STONE_PAYLOAD_KIND_META:
+      records_ = fill<StonePayloadMetaRecord, stone_payload_meta_records>();
+      break;
+    case STONE_PAYLOAD_KIND_INDEX:
+      records_ = fill<StonePayloadIndexRecord, stone_payload_index_records>();
+      break;
+    case STONE_PAYLOAD_KIND_ATTRIBUTES:
+      records_ =
+          fill<StonePayloadAttributeRecord, stone_payload_attribute_records>();
+      break;
+    case STONE_PAYLOAD_KIND_LOOKUP:
+      records_ = fill<StonePayloadLookupRecord, stone_payload_lookup_records>();
+      break;
+    default:
+      break;
+    }
+  }
+
+  const StonePayloadHeader &header() const noexcept { return header_; }
+  StonePayloadKind kind() const noexcept { return header_.kind; }
+
+  // Records of the payload, which must be of the matching kind
+  LayoutRecords layouts() const {
+    return LayoutRecords(
+        records<StonePayloadLayoutRecord>("not a layout payload"));
+  }
+  MetaRecords metas() const {
+    return MetaRecords(records<StonePayloadMetaRecord>("not a meta payload"));
+  }
+  IndexRecords indexes() const {
+    return IndexRecords(
+        records<StonePayloadIndexRecord>("not an index payload"));
+  }
+  AttributeRecords attributes() const {
+    return AttributeRecords(
+        records<StonePayloadAttributeRecord>("not an attribute payload"));
+  }
+  LookupRecords lookups() const {
+    return LookupRecords(
+        records<StonePayloadLookupRecord>("not a lookup payload"));
+  }
+
+  StonePayload *get() const noexcept { return handle_.get(); }
+
+private:
+  template <typename Raw,
+            int (*Fill)(StonePayload *, Raw *, std::size_t, std::size_t *)>
+  std::vector<Raw> fill() {
+    std::vector<Raw> records(header_.num_records);
+    std::size_t filled = 0;
+
+    detail::check(Fill(handle_.get(), records.data(), records.size(), &filled),
+                  "failed to read payload records");
+    records.resize(filled);
+
+    return records;
+  }
+
+  template <typename Raw>
+  std::span<const Raw> records(const char *kind) const {
+    if (const auto *records = std::get_if<std::vector<Raw>>(&records_)) {
+      return *records;
+    }
+    throw Error(kind, EINVAL);
+  }
+
+  detail::Handle<StonePayload, stone_payload_destroy> handle_;
+  StonePayloadHeader header_{};
+  std::variant<std::monostate, std::vector<StonePayloadLayoutRecord>,
+               std::vector<StonePayloadMetaRecord>,
+               std::vector<StonePayloadIndexRecord>,
+               std::vector<StonePayloadAttributeRecord>,
+               std::vector<StonePayloadLookupRecord>>
+      records_;
+};
+
+// Streaming decompression of a content payload
+class ContentReader {
+public:
+  explicit ContentReader(StonePayloadContentReader *reader) noexcept
+      : handle_(reader) {}
+
+  // Fill as much of `buf` as possible, returning the number of bytes read,
+  // which is only short of `buf.size()` at the end of the content
+  std::size_t read(std::span<std::byte> buf) {
+    struct iovec iov = {buf.data(), buf.size()};
+
+    ssize_t read =
+        stone_payload_content_reader_read_into(handle_.get(), &iov, 1);
+    if (read < 0) {
+      throw Error("stone_payload_content_reader_read_into", -read);
+    }
+
+    return static_cast<std::size_t>(read);
+  }
+
+  // Suggested size of the buffer passed to `read`, 0 if there's none
+  std::size_t buf_hint() const {
+    std::uintptr_t hint = 0;
+    detail::check(stone_payload_content_reader_buf_hint(handle_.get(), &hint),
+                  "stone_payload_content_reader_buf_hint");
+    return hint;
+  }
+
+  // Only meaningful once all content has been read
+  bool is_checksum_valid() const noexcept {
+    return stone_payload_content_reader_is_checksum_valid(handle_.get()) == 1;
+  }
+
+  StonePayloadContentReader *get() const noexcept { return handle_.get(); }
+
+private:
+  detail::Handle<StonePayloadContentReader,
+                 stone_payload_content_reader_destroy>
+      handle_;
+};
+
+// Decoder state to reuse across readers, see `Reader::set_decode_context`
+class DecodeContext {
+public:
+  DecodeContext() : handle_(stone_decode_context_new()) {
+    if (!handle_) {
+      throw Error("stone_decode_context_new", ENOMEM);
+    }
+  }
+
+  StoneDecodeContext *get() const noexcept { return handle_.get(); }
+
+private:
+  detail::Handle<StoneDecodeContext, stone_decode_context_destroy> handle_;
+};
+
+class Reader {
+public:
+  // Read the stone in `fd`, which is taken ownership of
+  static Reader open(int fd) {
+    StoneReader *reader = nullptr;
+    StoneHeaderVersion version;
+
+    detail::check(stone_read_file(fd, &reader, &version), "stone_read_file");
+    return Reader(reader, version);
+  }
+
+  // Read the stone from a mapping of `fd`, which is not taken ownership of
+  // and can be closed once this returns
+  static Reader map(int fd) {
+    StoneReader *reader = nullptr;
+    StoneHeaderVersion version;
+
+    detail::check(stone_read_mmap(fd, &reader, &version), "stone_read_mmap");
+    return Reader(reader, version);
+  }
+
+  // Read the stone in `buf`, which must outlive the reader
+  static Reader from_buffer(std::span<const std::byte> buf) {
+    StoneReader *reader = nullptr;
+    StoneHeaderVersion version;
+
+    detail::check(
+        stone_read_buf(reinterpret_cast<const std::uint8_t *>(buf.data()),
+                       buf.size(), &reader, &version),
+        "stone_read_buf");
+    return Reader(reader, version);
+  }
+
+  // Independent reader over the same archive, see `stone_reader_clone`
+  Reader clone() const {
+    StoneReader *clone = nullptr;
+
+    detail::check(stone_reader_clone(handle_.get(), &clone),
+                  "stone_reader_clone");
+    return Reader(clone, version_);
+  }
+
+  StoneHeaderVersion version() const noexcept { return version_; }
+
+  StoneHeaderV1 header_v1() const {
+    StoneHeaderV1 header;
+
+    detail::check(stone_reader_header_v1(handle_.get(), &header),
+                  "stone_reader_header_v1");
+    return header;
+  }
+
+  // Lend `context` to this reader, which it must outlive
+  void set_decode_context(DecodeContext &context) {
+    detail::check(stone_reader_set_decode_context(handle_.get(), context.get()),
+                  "stone_reader_set_decode_context");
+  }
+
+  // Decode the next payload, or nothing once all have been read
+  std::optional<Payload> next_payload() {
+    StonePayload *payload = nullptr;
+
+    if (stone_reader_next_payload(handle_.get(), &payload) < 0) {
+      // The end of the payloads & errors are reported alike
+      if (payloads_read_ < header_v1().num_payloads) {
+        throw Error("stone_reader_next_payload");
+      }
+      return std::nullopt;
+    }
+
+    payloads_read_ += 1;
+    return Payload(payload);
+  }
+
+  std::vector<StonePayloadTableEntry> payload_table() {
+    std::size_t num_entries = 0;
+
+    detail::check(
+        stone_reader_payload_table(handle_.get(), nullptr, 0, &num_entries),
+        "stone_reader_payload_table");
+
+    std::vector<StonePayloadTableEntry> entries(num_entries);
+    detail::check(stone_reader_payload_table(handle_.get(), entries.data(),
+                                             entries.size(), &num_entries),
+                  "stone_reader_payload_table");
+    return entries;
+  }
+
+  // Decode only the first payload of `kind`, or nothing if there's none
+  std::optional<Payload> payload(StonePayloadKind kind) {
+    StonePayload *payload = nullptr;
+
+    if (stone_reader_payload_by_kind(handle_.get(), kind, &payload) < 0) {
+      // A missing payload & errors are reported alike
+      for (const auto &entry : payload_table()) {
+        if (entry.header.kind == kind) {
+          throw Error("stone_reader_payload_by_kind");
+        }
+      }
+      return std::nullopt;
+    }
+
+    return Payload(payload);
+  }
+
+  // Decode the payload whose header starts at `offset`
+  Payload payload_at(std::uint64_t offset) {
+    StonePayload *payload = nullptr;
+
+    detail::check(
+        stone_reader_read_payload_at(handle_.get(), offset, &payload),
+        "stone_reader_read_payload_at");
+    return Payload(payload);
+  }
+
+  ContentReader read_content(const Payload &content) {
+    StonePayloadContentReader *reader = nullptr;
+
+    detail::check(stone_reader_read_content_payload(handle_.get(),
+                                                    content.get(), &reader),
+                  "stone_reader_read_content_payload");
+    return ContentReader(reader);
+  }
+
+  // Decompress `buf.size()` bytes of the content starting at `start`
+  void extract_range(const Payload &content, std::uint64_t start,
+                     std::span<std::byte> buf) {
+    // An empty span may have no data, which the C API rejects
+    if (buf.empty()) {
+      return;
+    }
+
+    detail::check(stone_reader_extract_range(
+                      handle_.get(), content.get(), start, start + buf.size(),
+                      reinterpret_cast<std::uint8_t *>(buf.data())),
+                  "stone_reader_extract_range");
+  }
+
+  // Decompress the file of `index` into `buf`, which must be large enough
+  void extract(const Payload &content, const IndexRecord &index,
+               std::span<std::byte> buf) {
+    if (buf.size() < index.size()) {
+      throw Error("extract", EINVAL);
+    }
+    extract_range(content, index.start(), buf.first(index.size()));
+  }
+
+  // Write the content to `fd`, which is taken ownership of
+  void unpack_content(const Payload &content, int fd) {
+    detail::check(
+        stone_reader_unpack_content_payload(handle_.get(), content.get(), fd),
+        "stone_reader_unpack_content_payload");
+  }
+
+  // `flags` is a combination of `STONE_UNPACK_*` flags, `workers` is the
+  // number of threads writing assets or `0` for one per CPU
+  void unpack_content_to_dir(const Payload &content, int dirfd,
+                             unsigned int flags = 0, unsigned int workers = 0) {
+    detail::check(stone_reader_unpack_content_to_dir(handle_.get(),
+                                                     content.get(), dirfd,
+                                                     flags, workers),
+                  "stone_reader_unpack_content_to_dir");
+  }
+
+  // Write the content to `fd`, returning the number of bytes written
+  std::size_t splice_content(const Payload &content, int fd) {
+    ssize_t written =
+        stone_reader_splice_content_payload(handle_.get(), content.get(), fd);
+    if (written < 0) {
+      throw Error("stone_reader_splice_content_payload", -written);
+    }
+    return static_cast<std::size_t>(written);
+  }
+
+  StoneReader *get() const noexcept { return handle_.get(); }
+
+private:
+  Reader(StoneReader *reader, StoneHeaderVersion version) noexcept
+      : handle_(reader), version_(version) {}
+
+  detail::Handle<StoneReader, stone_reader_destroy> handle_;
+  StoneHeaderVersion version_;
+  std::uint16_t payloads_read_ = 0;
+};
+
+} // namespace stone
+
+// Records only point into the payload, so its iterators outlive the range
+template <typename Record, typename Raw>
+inline constexpr bool
+    std::ranges::enable_borrowed_range<stone::Records<Record, Raw>> = true;
+
+#endif /* STONE_HPP */
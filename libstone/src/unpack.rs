@@ -0,0 +1,199 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+use std::{
+    ffi::CString,
+    fs::File,
+    io::{self, Write},
+    os::fd::FromRawFd,
+};
+
+use libc::{c_int, c_uint};
+use stone::{StoneContentSink, StoneDigestWriter, StoneDigestWriterHasher, StonePayloadIndexRecord};
+
+/// Leave assets which already exist untouched, without verifying them
+pub const STONE_UNPACK_SKIP_EXISTING: c_uint = 1 << 0;
+/// Hash assets which already exist & only rewrite them if their digest is wrong
+pub const STONE_UNPACK_VERIFY_EXISTING: c_uint = 1 << 1;
+
+/// Writes assets relative to a directory fd, using the same
+/// `aa/bb/cc/<digest>` layout as the moss asset store
+pub struct DirSink {
+    pub dirfd: c_int,
+    pub flags: c_uint,
+}
+
+pub struct DirWriter {
+    file: File,
+    partial: PartialFile,
+    path: CString,
+}
+
+/// Unlinks the `.part` file on drop unless it was renamed into place
+struct PartialFile {
+    dirfd: c_int,
+    path: CString,
+    persisted: bool,
+}
+
+impl PartialFile {
+    fn persist(mut self, path: &CString) -> io::Result<()> {
+        if unsafe { libc::renameat(self.dirfd, self.path.as_ptr(), self.dirfd, path.as_ptr()) } < 0 {
+            return Err(io::Error::last_os_error());
+        }
+
+        self.persisted = true;
+
+        Ok(())
+    }
+}
+
+impl Drop for PartialFile {
+    fn drop(&mut self) {
+        if !self.persisted {
+            unsafe { libc::unlinkat(self.dirfd, self.path.as_ptr(), 0) };
+        }
+    }
+}
+
+impl Write for DirWriter {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        self.file.write(buf)
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        self.file.flush()
+    }
+}
+
+impl DirSink {
+    fn exists(&self, path: &CString) -> bool {
+        unsafe { libc::faccessat(self.dirfd, path.as_ptr(), libc::F_OK, 0) == 0 }
+    }
+
+    fn is_valid(&self, path: &CString, digest: u128) -> io::Result<bool> {
+        let mut file = self.open(path, libc::O_RDONLY, 0)?;
+        let mut hasher = StoneDigestWriterHasher::new();
+
+        io::copy(&mut file, &mut StoneDigestWriter::new(io::sink(), &mut hasher))?;
+
+        Ok(hasher.digest128() == digest)
+    }
+
+    fn open(&self, path: &CString, flags: c_int, mode: c_uint) -> io::Result<File> {
+        let fd = unsafe { libc::openat(self.dirfd, path.as_ptr(), flags | libc::O_CLOEXEC, mode) };
+
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+
+        Ok(unsafe { File::from_raw_fd(fd) })
+    }
+
+    fn create_dir(&self, path: &str) -> io::Result<()> {
+        let path = CString::new(path)?;
+
+        if unsafe { libc::mkdirat(self.dirfd, path.as_ptr(), 0o755) } < 0 {
+            let error = io::Error::last_os_error();
+
+            if error.kind() != io::ErrorKind::AlreadyExists {
+                return Err(error);
+            }
+        }
+
+        Ok(())
+    }
+}
+
+impl StoneContentSink for DirSink {
+    type Writer = DirWriter;
+
+    fn create(&self, index: &StonePayloadIndexRecord) -> io::Result<Option<DirWriter>> {
+        let hash = format!("{:02x}", index.digest);
+
+        let relative = if hash.len() >= 10 {
+            self.create_dir(&hash[..2])?;
+            self.create_dir(&format!("{}/{}", &hash[..2], &hash[2..4]))?;
+            self.create_dir(&format!("{}/{}/{}", &hash[..2], &hash[2..4], &hash[4..6]))?;
+
+            format!("{}/{}/{}/{hash}", &hash[..2], &hash[2..4], &hash[4..6])
+        } else {
+            hash
+        };
+
+        let path = CString::new(relative.as_str())?;
+        let partial_path = CString::new(format!("{relative}.part"))?;
+
+        if self.flags & STONE_UNPACK_SKIP_EXISTING != 0 && self.exists(&path) {
+            return Ok(None);
+        }
+
+        // Any error verifying simply forces the asset to be rewritten
+        if self.flags & STONE_UNPACK_VERIFY_EXISTING != 0
+            && self.exists(&path)
+            && self.is_valid(&path, index.digest).unwrap_or(false)
+        {
+            return Ok(None);
+        }
+
+        let file = self.open(&partial_path, libc::O_WRONLY | libc::O_CREAT | libc::O_TRUNC, 0o644)?;
+
+        Ok(Some(DirWriter {
+            file,
+            partial: PartialFile {
+                dirfd: self.dirfd,
+                path: partial_path,
+                persisted: false,
+            },
+            path,
+        }))
+    }
+
+    fn commit(&self, _index: &StonePayloadIndexRecord, writer: DirWriter) -> io::Result<()> {
+        let DirWriter { file, partial, path } = writer;
+
+        drop(file);
+        partial.persist(&path)
+    }
+}
+
+#[cfg(test)]
+#[allow(clippy::disallowed_methods)] // no fs-err here either
+mod test {
+    use std::{fs, os::fd::AsRawFd};
+
+    use super::*;
+
+    #[test]
+    fn uncommitted_asset_is_removed() {
+        let dir = std::env::temp_dir().join(format!("libstone-unpack-{}", std::process::id()));
+        fs::create_dir_all(&dir).unwrap();
+        let dirfd = File::open(&dir).unwrap();
+
+        let sink = DirSink {
+            dirfd: dirfd.as_raw_fd(),
+            flags: 0,
+        };
+        let index = StonePayloadIndexRecord {
+            start: 0,
+            end: 5,
+            digest: 0xabcdef0123456789,
+        };
+        let partial = dir.join("ab/cd/ef/abcdef0123456789.part");
+
+        // Dropped as if its digest didn't match
+        let mut writer = sink.create(&index).unwrap().unwrap();
+        writer.write_all(b"bogus").unwrap();
+        assert!(partial.exists());
+        drop(writer);
+        assert!(!partial.exists());
+
+        let mut writer = sink.create(&index).unwrap().unwrap();
+        writer.write_all(b"valid").unwrap();
+        sink.commit(&index, writer).unwrap();
+        assert!(!partial.exists());
+        assert_eq!(fs::read(dir.join("ab/cd/ef/abcdef0123456789")).unwrap(), b"valid");
+
+        fs::remove_dir_all(&dir).unwrap();
+    }
+}
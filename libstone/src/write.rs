@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+use std::{
+    error::Error,
+    fs::File,
+    io::{self, BufWriter, Read},
+    os::fd::FromRawFd,
+};
+
+use libc::{c_int, c_uint};
+use stone::{StoneContentWriter, StoneHeaderV1FileType, StonePayloadIndexRecord, StoneWritePayload};
+
+#[repr(C)]
+pub struct StoneWriterOptions {
+    pub file_type: StoneHeaderV1FileType,
+    /// zstd level for all payloads, `0` uses the default
+    pub compression_level: c_int,
+    /// Threads compressing content alongside the caller, `0` compresses
+    /// on the calling thread only
+    pub num_workers: c_uint,
+    /// Log2 of the zstd window, `0` uses the default of 31. Readers
+    /// need as much memory to decode the content payload.
+    pub window_log: c_uint,
+    pub long_distance_matching: bool,
+}
+
+pub struct StoneWriter {
+    state: State,
+    num_workers: u32,
+}
+
+enum State {
+    Payloads(stone::StoneWriter<BufWriter<File>, ()>),
+    Content(stone::StoneWriter<BufWriter<File>, StoneContentWriter<File>>),
+    /// Switching to content failed, nothing more can be written
+    Failed,
+}
+
+impl StoneWriter {
+    pub fn new(file: File, options: &StoneWriterOptions) -> Result<Self, Box<dyn Error>> {
+        let mut writer = stone::StoneWriter::new(BufWriter::new(file), options.file_type)?;
+
+        if options.compression_level != 0 {
+            writer.set_compression_level(options.compression_level)?;
+        }
+        if options.window_log != 0 {
+            writer.set_window_log(options.window_log)?;
+        }
+        writer.set_long_distance_matching(options.long_distance_matching)?;
+
+        Ok(Self {
+            state: State::Payloads(writer),
+            num_workers: options.num_workers,
+        })
+    }
+
+    pub fn add_payload(&mut self, payload: StoneWritePayload<'_>) -> Result<(), Box<dyn Error>> {
+        match &mut self.state {
+            State::Payloads(writer) => writer.add_payload(payload)?,
+            State::Content(writer) => writer.add_payload(payload)?,
+            State::Failed => Err("writer failed")?,
+        }
+
+        Ok(())
+    }
+
+    /// Compress `content` as the next file, the content payload
+    /// is started on the first call
+    pub fn add_content(&mut self, content: &mut impl Read) -> Result<StonePayloadIndexRecord, Box<dyn Error>> {
+        if let State::Payloads(_) = self.state {
+            let State::Payloads(writer) = std::mem::replace(&mut self.state, State::Failed) else {
+                unreachable!()
+            };
+
+            self.state = State::Content(writer.with_content(content_buffer()?, None, self.num_workers)?);
+        }
+
+        match &mut self.state {
+            State::Content(writer) => Ok(writer.add_content(content)?),
+            _ => Err("writer failed")?,
+        }
+    }
+
+    pub fn finalize(self) -> Result<(), Box<dyn Error>> {
+        match self.state {
+            State::Payloads(writer) => writer.finalize()?,
+            State::Content(writer) => writer.finalize()?,
+            State::Failed => Err("writer failed")?,
+        }
+
+        Ok(())
+    }
+}
+
+/// Compressed content is staged in anonymous memory, as its size has
+/// to be known before it's written out after all other payloads
+fn content_buffer() -> io::Result<File> {
+    let fd = unsafe { libc::memfd_create(c"stone-content".as_ptr(), libc::MFD_CLOEXEC) };
+
+    if fd < 0 {
+        return Err(io::Error::last_os_error());
+    }
+
+    Ok(unsafe { File::from_raw_fd(fd) })
+}
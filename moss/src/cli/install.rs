@@ -46,7 +46,10 @@ pub fn handle(args: &ArgMatches, installation: Installation) -> Result<(), Error
     let simulate = command.dry_run;
 
     // Grab a client for the root
-    let mut client = Client::new(environment::NAME, installation)?;
+    let mut client = Client::builder(environment::NAME, installation)
+        .blit_backend(super::blit_backend(args))
+        .incremental(args.get_flag("incremental"))
+        .build()?;
 
     // Make ephemeral if a blit target was provided
     if let Some(blit_target) = command.blit_target {
@@ -3,15 +3,16 @@
 
 use std::{env, io, path::Path, path::PathBuf};
 
-use clap::{Arg, ArgAction, Command};
+use clap::{Arg, ArgAction, ArgMatches, Command};
 use clap_complete::{
     generate_to,
     shells::{Bash, Fish, Zsh},
 };
 use clap_mangen::Man;
 use fs_err as fs;
-use moss::{Installation, installation};
+use moss::{Installation, client::BlitBackend, installation, metrics};
 use thiserror::Error;
+use tracing::warn;
 use tracing_common::{self, logging::LogConfig, logging::init_log_with_config};
 use tui::Styled;
 
@@ -73,11 +74,20 @@ fn command() -> Command {
         .arg(
             Arg::new("log")
                 .long("log")
-                .help("Logging configuration: <level>[:<format>][:<destination>]\nLevels: trace, debug, info, warn, error\nFormats: text, json\nDestinations: stderr, <file>")
+                .help("Logging configuration: <level>[:<format>][:<destination>]\nLevels: trace, debug, info, warn, error\nFormats: text, json, chrome (trace events of every span)\nDestinations: stderr, <file>")
                 .action(ArgAction::Set)
                 .global(true)
                 .value_parser(clap::value_parser!(LogConfig)),
         )
+        .arg(
+            Arg::new("metrics")
+                .long("metrics")
+                .global(true)
+                .help("Write performance counters of the run as JSON to FILE")
+                .action(ArgAction::Set)
+                .value_name("FILE")
+                .value_parser(clap::value_parser!(PathBuf)),
+        )
         .arg(
             Arg::new("yes")
                 .short('y')
@@ -86,6 +96,20 @@ fn command() -> Command {
                 .help("Assume yes for all questions")
                 .action(ArgAction::SetTrue),
         )
+        .arg(
+            Arg::new("io-uring")
+                .long("io-uring")
+                .global(true)
+                .help("Blit new states with io_uring where the kernel supports it")
+                .action(ArgAction::SetTrue),
+        )
+        .arg(
+            Arg::new("incremental")
+                .long("incremental")
+                .global(true)
+                .help("Stage new states from a btrfs snapshot of /usr, reflinking changed files")
+                .action(ArgAction::SetTrue),
+        )
         .arg(
             Arg::new("generate-manpages")
                 .long("generate-manpages")
@@ -196,6 +220,12 @@ pub fn process() -> Result<(), Error> {
     let root = matches.get_one::<PathBuf>("root").unwrap();
     let cache = matches.get_one::<PathBuf>("cache");
 
+    let metrics_path = matches.get_one::<PathBuf>("metrics");
+
+    if metrics_path.is_some() {
+        metrics::enable();
+    }
+
     let installation = Installation::open(root, cache.cloned())?;
 
     if let Some(system_model) = installation.system_model.as_ref() {
@@ -206,6 +236,20 @@ pub fn process() -> Result<(), Error> {
         }
     }
 
+    let result = run(&matches, installation, show_version);
+
+    // Don't let a failed write mask the outcome of the command itself
+    if let Some(path) = metrics_path
+        && let Err(error) = metrics::snapshot().write_json(path)
+    {
+        warn!(error = format!("{error:#}"), path = %path.display(), "Failed to write metrics");
+    }
+
+    result
+}
+
+/// Run the subcommand
+fn run(matches: &ArgMatches, installation: Installation, show_version: bool) -> Result<(), Error> {
     match matches.subcommand() {
         Some(("boot", args)) => boot::handle(args, installation).map_err(Error::Boot),
         Some(("cache", args)) => cache::handle(args, installation).map_err(Error::Cache),
@@ -236,6 +280,15 @@ pub fn process() -> Result<(), Error> {
     }
 }
 
+/// Backend chosen by the global `--io-uring` flag
+fn blit_backend(args: &ArgMatches) -> BlitBackend {
+    if args.get_flag("io-uring") {
+        BlitBackend::IoUring
+    } else {
+        BlitBackend::Threaded
+    }
+}
+
 fn replace_aliases(args: env::Args) -> Vec<String> {
     const ALIASES: &[(&str, &[&str])] = &[
         ("li", &["list", "installed"]),
@@ -37,7 +37,10 @@ pub fn handle(args: &ArgMatches, installation: Installation) -> Result<(), Error
     let yes = *args.get_one::<bool>("yes").unwrap();
     let simulate = command.dry_run;
 
-    let mut client = Client::new(environment::NAME, installation)?;
+    let mut client = Client::builder(environment::NAME, installation)
+        .blit_backend(super::blit_backend(args))
+        .incremental(args.get_flag("incremental"))
+        .build()?;
 
     client.remove(&pkgs, yes, simulate)?;
 
@@ -130,15 +130,15 @@ fn search_packages(client: &Client, flags: package::Flags, keyword: &str) -> BTr
 
     let keyword_lowercase = keyword.to_ascii_lowercase();
     for pkg in client.search_packages(keyword, flags) {
-        let pkg_name_lowercase = pkg.meta.name.as_str().to_ascii_lowercase();
+        let pkg_name_lowercase = pkg.name.as_str().to_ascii_lowercase();
         let match_kind = if pkg_name_lowercase.contains(&keyword_lowercase) {
             MatchKind::Name
         } else {
             MatchKind::Summary
         };
         results.entry(match_kind).or_default().push(Output {
-            name: pkg.meta.name,
-            summary: pkg.meta.summary,
+            name: pkg.name,
+            summary: pkg.summary,
             search_match: Some(keyword.to_owned()),
         });
     }
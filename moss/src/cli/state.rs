@@ -11,8 +11,8 @@ use clap::{ArgAction, ArgMatches, Command, CommandFactory, FromArgMatches, Parse
 use fs_err as fs;
 use moss::{
     Installation, State,
-    client::{self, Client, prune},
-    environment, state,
+    client::{self, Client, prune, verify},
+    environment, state, util,
 };
 use nix::unistd::gethostname;
 use thiserror::Error;
@@ -65,7 +65,15 @@ pub fn command() -> Command {
         .subcommand(
             Command::new("verify")
                 .about("Verify and fix system states and assets")
-                .arg(arg!(--verbose "Vebose output").action(ArgAction::SetTrue)),
+                .arg(arg!(--verbose "Vebose output").action(ArgAction::SetTrue))
+                .arg(
+                    arg!(--quick "Only check assets exist with the expected size, without hashing them")
+                        .action(ArgAction::SetTrue),
+                )
+                .arg(
+                    arg!(-j --jobs <NUM> "Number of assets to check at once")
+                        .value_parser(clap::value_parser!(u64).range(1..)),
+                ),
         )
         .subcommand(Export::command())
         // For profiling only, hence hidden.
@@ -217,9 +225,18 @@ pub fn remove(args: &ArgMatches, installation: Installation) -> Result<(), Error
 pub fn verify(args: &ArgMatches, installation: Installation) -> Result<(), Error> {
     let verbose = args.get_flag("verbose");
     let yes = args.get_flag("yes");
+    let mode = if args.get_flag("quick") {
+        verify::Mode::Quick
+    } else {
+        verify::Mode::Full
+    };
+    let jobs = args
+        .get_one::<u64>("jobs")
+        .map(|jobs| *jobs as usize)
+        .unwrap_or_else(|| util::num_cpus().get());
 
     let client = Client::new(environment::NAME, installation)?;
-    client.verify(yes, verbose)?;
+    client.verify(yes, verbose, mode, jobs)?;
 
     Ok(())
 }
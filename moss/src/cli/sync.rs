@@ -50,7 +50,9 @@ pub fn handle(args: &ArgMatches, installation: Installation) -> Result<(), Error
     let simulate = command.dry_run;
     let update = command.update;
 
-    let mut client_builder = Client::builder(environment::NAME, installation);
+    let mut client_builder = Client::builder(environment::NAME, installation)
+        .blit_backend(super::blit_backend(args))
+        .incremental(args.get_flag("incremental"));
 
     if let Some(path) = &command.import {
         client_builder = client_builder.system_model_path(path);
@@ -0,0 +1,229 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+//! Presence index of the content store
+//!
+//! Hashing an asset back is the only way to know it's intact, but doing so
+//! each time a package sharing it is unpacked means reading most of the store
+//! again on every reinstall. Instead, each asset whose digest has been checked,
+//! either while unpacking it from a stone or by a full verify, is recorded here
+//! and trusted until verify or prune say otherwise.
+//!
+//! The file is a header (magic, version & entry count) followed by the sorted
+//! little endian digests. It's mapped in & binary searched, so opening it costs
+//! the same no matter how large the store is. Changes are kept in memory until
+//! they're merged into a new file by [`AssetIndex::save`].
+
+use std::{
+    collections::BTreeSet,
+    io::{self, Write as _},
+    path::{Path, PathBuf},
+    sync::{Mutex, MutexGuard},
+};
+
+use fs_err as fs;
+use tracing::warn;
+
+use crate::{Installation, util::Mapping};
+
+const MAGIC: [u8; 8] = *b"mossidx\0";
+const VERSION: u32 = 1;
+
+const HEADER_SIZE: usize = 16;
+const ENTRY_SIZE: usize = 16;
+
+/// Digests of the assets known to be intact in the content store
+pub struct AssetIndex {
+    path: PathBuf,
+    stored: Option<Mapping>,
+    changes: Mutex<Changes>,
+    read_only: bool,
+}
+
+/// Changes made since the index was opened
+#[derive(Default)]
+struct Changes {
+    /// Verified digests that aren't stored yet
+    inserted: BTreeSet<u128>,
+    /// Stored digests that can no longer be trusted
+    removed: BTreeSet<u128>,
+}
+
+impl AssetIndex {
+    /// Open the index of the installation's content store
+    ///
+    /// A missing or unreadable index is treated as empty, only costing
+    /// a re-hash of each asset the next time it's needed.
+    pub fn open(installation: &Installation) -> Self {
+        let path = installation.assets_path("v2.index");
+
+        let stored = load(&path).unwrap_or_else(|err| {
+            warn!(error = format!("{err:#}"), "Ignoring invalid asset index");
+            None
+        });
+
+        Self {
+            path,
+            stored,
+            changes: Mutex::default(),
+            read_only: installation.read_only(),
+        }
+    }
+
+    /// Returns true if the asset of `digest` is known to be intact
+    pub fn contains(&self, digest: u128) -> bool {
+        let changes = self.changes();
+
+        if changes.removed.contains(&digest) {
+            false
+        } else {
+            changes.inserted.contains(&digest) || self.is_stored(digest)
+        }
+    }
+
+    /// Record the asset of `digest` as intact
+    pub fn insert(&self, digest: u128) {
+        let mut changes = self.changes();
+
+        if !changes.removed.remove(&digest) && !self.is_stored(digest) {
+            changes.inserted.insert(digest);
+        }
+    }
+
+    /// Stop trusting the asset of `digest`
+    pub fn remove(&self, digest: u128) {
+        let mut changes = self.changes();
+
+        if !changes.inserted.remove(&digest) && self.is_stored(digest) {
+            changes.removed.insert(digest);
+        }
+    }
+
+    /// Only keep the digests which `keep` returns true for
+    pub fn retain(&self, keep: impl Fn(u128) -> bool) {
+        let mut changes = self.changes();
+
+        changes.inserted.retain(|digest| keep(*digest));
+        let removed = self.stored().filter(|digest| !keep(*digest)).collect::<Vec<_>>();
+        changes.removed.extend(removed);
+    }
+
+    /// Write out the index with every change made so far, a no-op
+    /// if nothing changed or the installation is read-only
+    pub fn save(&self) -> io::Result<()> {
+        let changes = self.changes();
+
+        if self.read_only || (changes.inserted.is_empty() && changes.removed.is_empty()) {
+            return Ok(());
+        }
+
+        let mut digests = self
+            .stored()
+            .filter(|digest| !changes.removed.contains(digest))
+            .chain(changes.inserted.iter().copied())
+            .collect::<Vec<_>>();
+        digests.sort_unstable();
+
+        let partial = self.path.with_added_extension("part");
+
+        if let Some(parent) = self.path.parent() {
+            fs::create_dir_all(parent)?;
+        }
+
+        let mut file = io::BufWriter::new(fs::File::create(&partial)?);
+        file.write_all(&MAGIC)?;
+        file.write_all(&VERSION.to_le_bytes())?;
+        file.write_all(&(digests.len() as u32).to_le_bytes())?;
+        for digest in digests {
+            file.write_all(&digest.to_le_bytes())?;
+        }
+        file.into_inner().map_err(io::IntoInnerError::into_error)?;
+
+        // Unpacking trusts whatever is in here, so it's never seen half written
+        fs::rename(partial, &self.path)
+    }
+
+    fn changes(&self) -> MutexGuard<'_, Changes> {
+        self.changes.lock().unwrap_or_else(|e| e.into_inner())
+    }
+
+    fn entries(&self) -> &[[u8; ENTRY_SIZE]] {
+        self.stored
+            .as_ref()
+            .map_or(&[], |mapping| mapping.as_slice()[HEADER_SIZE..].as_chunks().0)
+    }
+
+    fn stored(&self) -> impl Iterator<Item = u128> + '_ {
+        self.entries().iter().map(|entry| u128::from_le_bytes(*entry))
+    }
+
+    fn is_stored(&self, digest: u128) -> bool {
+        self.entries()
+            .binary_search_by_key(&digest, |entry| u128::from_le_bytes(*entry))
+            .is_ok()
+    }
+}
+
+/// Map in the index at `path`, if there is one
+fn load(path: &Path) -> io::Result<Option<Mapping>> {
+    let file = match fs::File::open(path) {
+        Ok(file) => file,
+        Err(error) if error.kind() == io::ErrorKind::NotFound => return Ok(None),
+        Err(error) => return Err(error),
+    };
+    // SAFETY: The index is only ever replaced by renaming over it, see `AssetIndex::save`
+    let mapping = unsafe { Mapping::new(file.file())? };
+    let bytes = mapping.as_slice();
+
+    let invalid = |reason: &str| io::Error::new(io::ErrorKind::InvalidData, format!("invalid asset index: {reason}"));
+
+    let Some((header, entries)) = bytes.split_at_checked(HEADER_SIZE) else {
+        return Err(invalid("truncated"));
+    };
+    if header[..MAGIC.len()] != MAGIC || header[8..12] != VERSION.to_le_bytes() {
+        return Err(invalid("unknown format"));
+    }
+
+    let count = u32::from_le_bytes(header[12..16].try_into().unwrap()) as usize;
+    if entries.len() != count * ENTRY_SIZE {
+        return Err(invalid("truncated"));
+    }
+
+    Ok(Some(mapping))
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    #[test]
+    fn insert_remove_save() {
+        let dir = tempfile::tempdir().unwrap();
+        let installation = Installation::open(dir.path(), None).unwrap();
+
+        let index = AssetIndex::open(&installation);
+        assert!(!index.contains(1));
+
+        index.insert(1);
+        index.insert(2);
+        index.insert(3);
+        index.remove(2);
+        assert!(index.contains(1));
+        assert!(!index.contains(2));
+        index.save().unwrap();
+
+        let index = AssetIndex::open(&installation);
+        assert_eq!(index.stored().collect::<Vec<_>>(), vec![1, 3]);
+        assert!(index.contains(1) && index.contains(3));
+
+        index.remove(1);
+        index.insert(1 << 100);
+        assert!(!index.contains(1));
+        index.retain(|digest| digest != 3);
+        assert!(!index.contains(3));
+        index.save().unwrap();
+
+        let index = AssetIndex::open(&installation);
+        assert_eq!(index.stored().collect::<Vec<_>>(), vec![1 << 100]);
+    }
+}
@@ -6,17 +6,21 @@
 use std::collections::HashSet;
 use std::path::Path;
 use std::{
-    io,
+    io::{self, Write as _},
+    num::NonZeroUsize,
     path::PathBuf,
     sync::{Arc, Mutex},
 };
 
 use snafu::{OptionExt, ResultExt as _, Snafu, ensure};
-use stone::{StoneDecodedPayload, StoneDigestWriter, StoneDigestWriterHasher, StoneReadError};
+use stone::{
+    StoneContentSink, StoneDecodedPayload, StoneDigestWriter, StoneDigestWriterHasher, StonePayloadIndexRecord,
+    StoneReadError,
+};
 use tracing::warn;
 use url::Url;
 
-use crate::{Installation, package, request, util};
+use crate::{Installation, client::asset_index::AssetIndex, package, request, util};
 
 /// Synchronized set of assets that are currently being
 /// unpacked. Used to prevent unpacking the same asset
@@ -173,57 +177,20 @@ impl Download {
     }
 
     /// Unpack the downloaded package
+    ///
+    /// Assets are streamed straight from the content payload into the
+    /// asset store, with verification & writes spread over `workers` threads.
+    /// Assets already in `asset_index` are skipped without being read back,
+    /// and every asset written or re-hashed is recorded there.
     // TODO: Return an "Unpacked" struct which has a "blit" method on it?
     pub fn unpack(
         self,
         unpacking_in_progress: UnpackingInProgress,
+        asset_index: &AssetIndex,
+        workers: NonZeroUsize,
         on_progress: impl Fn(Progress) + Send + 'static,
     ) -> Result<UnpackedAsset, UnpackError> {
-        use fs_err::{self as fs, File};
-        use std::io::{self, Read, Seek, SeekFrom, Write};
-
-        struct ProgressWriter<'a, W> {
-            writer: W,
-            total: u64,
-            written: u64,
-            on_progress: &'a dyn Fn(Progress),
-        }
-
-        impl<'a, W> ProgressWriter<'a, W> {
-            pub fn new(writer: W, total: u64, on_progress: &'a impl Fn(Progress)) -> Self {
-                Self {
-                    writer,
-                    total,
-                    written: 0,
-                    on_progress,
-                }
-            }
-        }
-
-        impl<W: Write> Write for ProgressWriter<'_, W> {
-            fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
-                let bytes = self.writer.write(buf)?;
-
-                self.written += bytes as u64;
-
-                (self.on_progress)(Progress {
-                    delta: bytes as u64,
-                    completed: self.written,
-                    total: self.total,
-                });
-
-                Ok(bytes)
-            }
-
-            fn flush(&mut self) -> io::Result<()> {
-                self.writer.flush()
-            }
-        }
-
-        let content_dir = self.installation.cache_path("content");
-        let content_path = content_dir.join(self.id.as_str());
-
-        fs::create_dir_all(&content_dir)?;
+        use fs_err::File;
 
         let mut reader = stone::read(File::open(&self.path)?)?;
 
@@ -231,7 +198,7 @@ impl Download {
         let indices = payloads
             .iter()
             .filter_map(StoneDecodedPayload::index)
-            .flat_map(|p| &p.body)
+            .flat_map(|p| p.body.iter().copied())
             .collect::<Vec<_>>();
 
         if indices.is_empty() {
@@ -243,94 +210,168 @@ impl Download {
             .find_map(StoneDecodedPayload::content)
             .ok_or(UnpackError::MissingContent)?;
 
-        let content_file = File::options()
-            .read(true)
-            .write(true)
-            .create(true)
-            .truncate(true)
-            .open(&content_path)?;
-
-        reader.unpack_content(
-            content,
-            &mut ProgressWriter::new(&content_file, content.header.plain_size, &on_progress),
-        )?;
-
-        indices
-            .into_iter()
-            .map(|idx| {
-                let path = asset_path(&self.installation, &format!("{:02x}", idx.digest));
-                let partial_path = path.with_added_extension("part");
-
-                // Acquire in-progress guard.
-                let _guard = match unpacking_in_progress.acquire(path.clone()) {
-                    Some(guard) => guard,
-                    None => return Ok(()),
-                };
-
-                let is_unpacked_already = || -> Result<bool, UnpackError> {
-                    if fs::exists(&path)? {
-                        let mut hasher = StoneDigestWriterHasher::new();
-                        let mut file = File::open(&path)?;
-
-                        io::copy(&mut file, &mut StoneDigestWriter::new(io::sink(), &mut hasher))?;
-
-                        let actual_digest = hasher.digest128();
-
-                        return Ok(idx.digest == actual_digest);
-                    }
-
-                    Ok(false)
-                };
-
-                match is_unpacked_already() {
-                    Ok(true) => {
-                        return Ok(());
-                    }
-                    Ok(false) => {}
-                    // Always force unpack on any error checking cache validity
-                    Err(err) => {
-                        warn!(
-                            error = format!("{err:#}"),
-                            "Failed to verify if file is already unpacked, will re-unpack"
-                        );
-                    }
-                }
-
-                // Create parent dir
-                if let Some(parent) = path.parent() {
-                    fs::create_dir_all(parent)?;
-                }
-
-                // Split file reader over index range
-                let mut file = &content_file;
-                file.seek(SeekFrom::Start(idx.start))?;
-                let mut split_file = (&mut file).take(idx.end - idx.start);
+        let sink = AssetSink {
+            installation: &self.installation,
+            unpacking_in_progress: &unpacking_in_progress,
+            asset_index,
+        };
+
+        let total = content.header.plain_size;
+        let mut completed = 0;
+
+        reader
+            .unpack_content_to(content, &indices, &sink, workers, |delta| {
+                completed += delta;
+                on_progress(Progress {
+                    delta,
+                    completed,
+                    total,
+                });
+            })
+            .map_err(|error| match error {
+                StoneReadError::AssetChecksum { got, expected } => UnpackError::FileUnpackHashMismatch {
+                    path: asset_path(&self.installation, &format!("{expected:02x}")),
+                    expected,
+                    actual: got,
+                },
+                source => UnpackError::ReadStone { source },
+            })?;
+
+        Ok(UnpackedAsset { payloads })
+    }
+}
+
+/// Writes unpacked assets into the installation's asset store
+struct AssetSink<'a> {
+    installation: &'a Installation,
+    unpacking_in_progress: &'a UnpackingInProgress,
+    asset_index: &'a AssetIndex,
+}
+
+/// Asset being written to its `.part` path, renamed into place on commit
+struct AssetWriter {
+    file: fs_err::File,
+    path: PathBuf,
+    // Dropped before `_guard` so a failed asset is removed while we still own it
+    partial: PartialAsset,
+    _guard: InProgressGuard,
+}
+
+/// Removes the `.part` file on drop unless it was renamed into place
+struct PartialAsset {
+    path: PathBuf,
+    persisted: bool,
+}
+
+impl PartialAsset {
+    fn persist(mut self, path: &Path) -> io::Result<()> {
+        fs_err::rename(&self.path, path)?;
+        self.persisted = true;
+
+        Ok(())
+    }
+}
+
+impl Drop for PartialAsset {
+    fn drop(&mut self) {
+        if !self.persisted {
+            let _ = fs_err::remove_file(&self.path);
+        }
+    }
+}
+
+impl io::Write for AssetWriter {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        self.file.write(buf)
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        self.file.flush()
+    }
+}
+
+impl StoneContentSink for AssetSink<'_> {
+    type Writer = AssetWriter;
+
+    fn create(&self, index: &StonePayloadIndexRecord) -> io::Result<Option<AssetWriter>> {
+        use fs_err::{self as fs, File};
+
+        let path = asset_path(self.installation, &format!("{:02x}", index.digest));
+        let partial_path = path.with_added_extension("part");
+
+        // Acquire in-progress guard.
+        let Some(guard) = self.unpacking_in_progress.acquire(path.clone()) else {
+            return Ok(None);
+        };
+
+        // Verified before, only make sure it wasn't removed behind our back
+        if self.asset_index.contains(index.digest)
+            && fs::metadata(&path).is_ok_and(|metadata| metadata.len() == index.end - index.start)
+        {
+            return Ok(None);
+        }
 
+        let is_unpacked_already = || -> io::Result<bool> {
+            if fs::exists(&path)? {
                 let mut hasher = StoneDigestWriterHasher::new();
-                let mut output = File::create(&partial_path)?;
+                let mut file = File::open(&path)?;
 
-                io::copy(&mut split_file, &mut StoneDigestWriter::new(&mut output, &mut hasher))?;
+                io::copy(&mut file, &mut StoneDigestWriter::new(io::sink(), &mut hasher))?;
 
-                let digest = hasher.digest128();
+                let actual_digest = hasher.digest128();
 
-                ensure!(
-                    digest == idx.digest,
-                    FileUnpackHashMismatchSnafu {
-                        path: path.clone(),
-                        expected: idx.digest,
-                        actual: digest
-                    }
+                return Ok(index.digest == actual_digest);
+            }
+
+            Ok(false)
+        };
+
+        match is_unpacked_already() {
+            Ok(true) => {
+                self.asset_index.insert(index.digest);
+                return Ok(None);
+            }
+            Ok(false) => {}
+            // Always force unpack on any error checking cache validity
+            Err(err) => {
+                warn!(
+                    error = format!("{err:#}"),
+                    "Failed to verify if file is already unpacked, will re-unpack"
                 );
+            }
+        }
 
-                fs::rename(&partial_path, &path)?;
+        // Create parent dir
+        if let Some(parent) = path.parent() {
+            fs::create_dir_all(parent)?;
+        }
 
-                Ok(())
-            })
-            .collect::<Result<Vec<_>, UnpackError>>()?;
+        Ok(Some(AssetWriter {
+            file: File::create(&partial_path)?,
+            path,
+            partial: PartialAsset {
+                path: partial_path,
+                persisted: false,
+            },
+            _guard: guard,
+        }))
+    }
 
-        fs::remove_file(&content_path)?;
+    fn commit(&self, index: &StonePayloadIndexRecord, writer: AssetWriter) -> io::Result<()> {
+        let AssetWriter {
+            file,
+            path,
+            partial,
+            _guard,
+        } = writer;
 
-        Ok(UnpackedAsset { payloads })
+        drop(file);
+        partial.persist(&path)?;
+
+        // Its digest was checked while it was written
+        self.asset_index.insert(index.digest);
+
+        Ok(())
     }
 }
 
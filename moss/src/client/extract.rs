@@ -115,7 +115,12 @@ pub fn extract(stones: Vec<&PathBuf>, output_dir: &Path) -> Result<(), Error> {
             .collect::<Vec<_>>();
         let vfs = client::vfs(records)?;
 
-        client::blit_root(&installation, &vfs, &extraction_root.canonicalize()?)?;
+        client::blit_root(
+            &installation,
+            &vfs,
+            &extraction_root.canonicalize()?,
+            client::BlitBackend::Threaded,
+        )?;
     }
 
     // Clean up transient .moss install
@@ -0,0 +1,575 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+//! Incremental stateful blits
+//!
+//! Where the filesystem is btrfs each staged `/usr` is a subvolume. A new state
+//! starts from a snapshot of the active `/usr` and only rewrites entries that
+//! differ from the previous state's [`vfs::Tree`], so staging costs a walk of
+//! the snapshot's directories plus writes for what changed, rather than linking
+//! every file again. Hardlinks can't cross subvolumes, so files are reflinked
+//! from the asset store instead, which is why this is opt in through
+//! [`super::ClientBuilder::incremental`].
+//!
+//! The first incremental state, or any after the active `/usr` stopped being a
+//! subvolume, has no snapshot to start from and is blitted in full into a new
+//! subvolume. Hardlinks can't cross into it, so every file is reflinked, which
+//! shares extents rather than copying data but still costs an inode & a clone
+//! per file where a full blit only adds links. Staging fails if the asset store
+//! is on another filesystem, as extents can't be shared across one.
+//!
+//! The snapshot carries over whatever the active `/usr` holds, so a file is
+//! only kept if it still has the size & mtime of its asset. Hardlinks share
+//! them with the asset and reflinks are given them, an in place edit doesn't.
+
+use std::{
+    collections::HashMap,
+    ffi::CStr,
+    fs::Permissions,
+    io,
+    os::{
+        fd::{AsRawFd, OwnedFd, RawFd},
+        unix::fs::PermissionsExt,
+    },
+    path::Path,
+    time::Instant,
+};
+
+use fs_err as fs;
+use nix::{fcntl::OFlag, libc::AT_FDCWD, sys::stat::Mode, unistd::mkdir};
+use rayon::iter::{IntoParallelIterator, ParallelIterator};
+use rustix::{
+    fs::{AtFlags, statat},
+    ioctl::{Opcode, Setter, ioctl, opcode},
+};
+use stone::StonePayloadLayoutFile;
+use tracing::debug;
+use tui::{ProgressBar, Styled};
+use vfs::tree::{BlitFile, Element, Kind};
+
+use super::{BlitStats, EMPTY_FILE_HASH, Error, Link, PendingFile, asset_path, blit_element, blit_progress, open_fd};
+use crate::Installation;
+
+/// Directories held open for pending entries before they're blitted
+const MAX_PENDING_DIRS: usize = 256;
+
+/// How staging subvolumes are created, swapped out by tests
+struct Subvolumes {
+    /// Create [`SUBVOLUME`] within the staging directory as a snapshot of the active `/usr`
+    snapshot: fn(&Path, &OwnedFd) -> io::Result<()>,
+    /// Create [`SUBVOLUME`], empty, within the staging directory
+    create: fn(&OwnedFd) -> io::Result<()>,
+}
+
+const BTRFS: Subvolumes = Subvolumes {
+    snapshot,
+    create: create_subvolume,
+};
+
+/// Blit `tree` to `blit_target` as a subvolume, starting from a snapshot of the
+/// installation's `/usr` when `previous` yields the tree it was blitted from
+///
+/// `previous` is only called once the snapshot exists. Returns `false`, with
+/// `blit_target` left empty, if the filesystem doesn't support subvolumes.
+pub fn blit(
+    installation: &Installation,
+    tree: &vfs::Tree<PendingFile>,
+    blit_target: &Path,
+    previous: impl FnOnce() -> Result<Option<vfs::Tree<PendingFile>>, Error>,
+) -> Result<bool, Error> {
+    blit_with(installation, tree, blit_target, previous, &BTRFS)
+}
+
+fn blit_with(
+    installation: &Installation,
+    tree: &vfs::Tree<PendingFile>,
+    blit_target: &Path,
+    previous: impl FnOnce() -> Result<Option<vfs::Tree<PendingFile>>, Error>,
+    subvolumes: &Subvolumes,
+) -> Result<bool, Error> {
+    let Some(children) = usr_children(tree) else {
+        return Ok(false);
+    };
+
+    // undirt.
+    fs::remove_dir_all(blit_target)?;
+    mkdir(blit_target, Mode::from_bits_truncate(0o755))?;
+
+    let staging = open_dir(AT_FDCWD, blit_target)?;
+
+    let previous = match (subvolumes.snapshot)(&installation.root.join("usr"), &staging) {
+        Ok(()) => previous()?,
+        Err(error) => {
+            debug!(%error, "can't snapshot active /usr");
+
+            if let Err(error) = (subvolumes.create)(&staging) {
+                debug!(%error, "subvolumes unsupported, falling back to full blit");
+                return Ok(false);
+            }
+
+            None
+        }
+    };
+
+    let previous_children = previous.as_ref().and_then(usr_children).unwrap_or_default();
+
+    let progress = blit_progress(tree);
+    let now = Instant::now();
+
+    let cache = open_dir(AT_FDCWD, &installation.assets_path("v2"))?;
+    let usr = open_dir(staging.as_raw_fd(), SUBVOLUME)?;
+
+    let mut blitter = Blitter {
+        cache: &cache,
+        progress: &progress,
+        link: Link::Reflink,
+        pending: vec![],
+        stats: BlitStats::default(),
+        reused: 0,
+    };
+
+    // As with full blits, don't leave a pool lingering after staging
+    let rayon_runtime = rayon::ThreadPoolBuilder::new().build().expect("rayon runtime");
+
+    rayon_runtime.install(|| -> Result<(), Error> {
+        blitter.apply(&blit_target.join("usr"), usr, previous_children, children)?;
+        blitter.flush()
+    })?;
+
+    progress.finish_and_clear();
+
+    let elapsed = now.elapsed();
+    let num_entries = blitter.stats.num_entries();
+
+    println!(
+        "\n{} entries blitted, {} reused in {} {}",
+        num_entries.to_string().bold(),
+        blitter.reused.to_string().bold(),
+        format!("{:.2}s", elapsed.as_secs_f32()).bold(),
+        format!("({:.1}k / s)", num_entries as f32 / elapsed.as_secs_f32() / 1_000.0).dim()
+    );
+
+    Ok(true)
+}
+
+struct Blitter<'a> {
+    cache: &'a OwnedFd,
+    progress: &'a ProgressBar,
+    link: Link,
+    /// Entries missing from the snapshot, grouped by their parent directory
+    pending: Vec<(OwnedFd, Vec<Element<'a, PendingFile>>)>,
+    stats: BlitStats,
+    reused: u64,
+}
+
+impl<'a> Blitter<'a> {
+    /// Bring the contents of `dir`, last blitted from `previous`, in line with `children`
+    fn apply(
+        &mut self,
+        path: &Path,
+        dir: OwnedFd,
+        previous: Vec<Element<'a, PendingFile>>,
+        children: Vec<Element<'a, PendingFile>>,
+    ) -> Result<(), Error> {
+        let mut previous = previous.into_iter().map(|e| (name(&e), e)).collect::<HashMap<_, _>>();
+        let mut children = children.into_iter().map(|e| (name(&e), e)).collect::<HashMap<_, _>>();
+        let mut missing = vec![];
+
+        for entry in fs::read_dir(path)? {
+            let entry = entry?;
+            let path = entry.path();
+            let file_type = entry.file_type()?;
+            let name = entry.file_name();
+            let name = name.to_str();
+
+            let child = name.and_then(|name| children.remove(name));
+            let old = name.and_then(|name| previous.remove(name));
+
+            match (child, old) {
+                (Some(Element::Directory(name, item, children)), Some(Element::Directory(_, old, previous)))
+                    if file_type.is_dir() =>
+                {
+                    if item.layout.mode != old.layout.mode {
+                        fs::set_permissions(&path, Permissions::from_mode(item.layout.mode))?;
+                    }
+
+                    self.reuse();
+
+                    let subdir = open_dir(dir.as_raw_fd(), name)?;
+                    self.apply(&path, subdir, previous, children)?;
+                }
+                (Some(Element::Child(_, item)), Some(Element::Child(_, old)))
+                    if is_kind(file_type, item) && self.unchanged(&dir, &entry, item, old)? =>
+                {
+                    self.reuse();
+                }
+                // Removed, changed or never blitted by moss (i.e. trigger output)
+                (child, _) => {
+                    if file_type.is_dir() {
+                        fs::remove_dir_all(&path)?;
+                    } else {
+                        fs::remove_file(&path)?;
+                    }
+
+                    missing.extend(child);
+                }
+            }
+        }
+
+        missing.extend(children.into_values());
+
+        if !missing.is_empty() {
+            self.pending.push((dir, missing));
+
+            if self.pending.len() >= MAX_PENDING_DIRS {
+                self.flush()?;
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Whether the snapshot's `entry` of `dir`, of the kind blitted from `old`,
+    /// still matches `item`
+    fn unchanged(
+        &self,
+        dir: &OwnedFd,
+        entry: &fs::DirEntry,
+        item: &PendingFile,
+        old: &PendingFile,
+    ) -> io::Result<bool> {
+        if item.layout.mode != old.layout.mode || item.layout.file != old.layout.file {
+            return Ok(false);
+        }
+
+        match &item.layout.file {
+            StonePayloadLayoutFile::Regular(hash, _) => {
+                let stat = statat(dir, entry.file_name().as_os_str(), AtFlags::SYMLINK_NOFOLLOW)?;
+
+                if *hash == EMPTY_FILE_HASH {
+                    return Ok(stat.st_size == 0);
+                }
+
+                let asset = statat(self.cache, asset_path(*hash).as_path(), AtFlags::SYMLINK_NOFOLLOW)?;
+
+                Ok(stat.st_size == asset.st_size
+                    && stat.st_mtime == asset.st_mtime
+                    && stat.st_mtime_nsec == asset.st_mtime_nsec)
+            }
+            StonePayloadLayoutFile::Symlink(target, _) => {
+                Ok(fs::read_link(entry.path())? == Path::new(target.as_str()))
+            }
+            _ => Ok(true),
+        }
+    }
+
+    /// Count an entry kept as is from the snapshot
+    fn reuse(&mut self) {
+        self.progress.inc(1);
+        self.reused += 1;
+    }
+
+    /// Blit every pending entry, closing their directories
+    fn flush(&mut self) -> Result<(), Error> {
+        let (dirs, children): (Vec<_>, Vec<_>) = std::mem::take(&mut self.pending).into_iter().unzip();
+
+        let current_span = tracing::Span::current();
+        let stats = dirs
+            .iter()
+            .zip(children)
+            .flat_map(|(dir, children)| children.into_iter().map(|child| (dir.as_raw_fd(), child)))
+            .collect::<Vec<_>>()
+            .into_par_iter()
+            .map(|(dir, child)| {
+                let _guard = current_span.enter();
+                blit_element(dir, self.cache.as_raw_fd(), child, self.progress, self.link)
+            })
+            .try_reduce(BlitStats::default, |a, b| Ok(a.merge(b)))?;
+
+        self.stats = self.stats.merge(stats);
+
+        Ok(())
+    }
+}
+
+/// Children of `/usr` in `tree`, which holds every blitted path
+fn usr_children(tree: &vfs::Tree<PendingFile>) -> Option<Vec<Element<'_, PendingFile>>> {
+    let Element::Directory(_, _, children) = tree.structured()? else {
+        return None;
+    };
+
+    children.into_iter().find_map(|child| match child {
+        Element::Directory("usr", _, children) => Some(children),
+        _ => None,
+    })
+}
+
+fn open_dir<P: ?Sized + nix::NixPath>(dir: RawFd, path: &P) -> Result<OwnedFd, nix::Error> {
+    open_fd(
+        dir,
+        path,
+        OFlag::O_DIRECTORY | OFlag::O_RDONLY | OFlag::O_CLOEXEC,
+        Mode::empty(),
+    )
+}
+
+fn name<'a>(element: &Element<'a, PendingFile>) -> &'a str {
+    let (Element::Directory(name, ..) | Element::Child(name, _)) = element;
+    name
+}
+
+fn is_kind(file_type: std::fs::FileType, item: &PendingFile) -> bool {
+    match item.kind() {
+        Kind::Regular => file_type.is_file(),
+        Kind::Directory => file_type.is_dir(),
+        Kind::Symlink(_) => file_type.is_symlink(),
+    }
+}
+
+const BTRFS_IOCTL_MAGIC: u8 = 0x94;
+
+/// Inode of every subvolume's root directory
+const BTRFS_FIRST_FREE_OBJECTID: u64 = 256;
+
+/// Subvolume created in the staging directory
+const SUBVOLUME: &CStr = c"usr";
+
+/// `struct btrfs_ioctl_vol_args`
+#[repr(C)]
+struct VolumeArgs {
+    fd: i64,
+    name: [u8; 4088],
+}
+
+/// `struct btrfs_ioctl_vol_args_v2`
+#[repr(C)]
+struct VolumeArgsV2 {
+    fd: i64,
+    transid: u64,
+    flags: u64,
+    unused: [u64; 4],
+    name: [u8; 4040],
+}
+
+const BTRFS_IOC_SUBVOL_CREATE: Opcode = opcode::write::<VolumeArgs>(BTRFS_IOCTL_MAGIC, 14);
+const BTRFS_IOC_SNAP_CREATE_V2: Opcode = opcode::write::<VolumeArgsV2>(BTRFS_IOCTL_MAGIC, 23);
+
+/// Create [`SUBVOLUME`] within `parent` as a writable snapshot of `source`,
+/// which must be a subvolume on the same filesystem
+fn snapshot(source: &Path, parent: &OwnedFd) -> io::Result<()> {
+    let source = open_dir(AT_FDCWD, source)?;
+
+    // Otherwise btrfs snapshots whichever subvolume contains it
+    if rustix::fs::fstat(&source)?.st_ino != BTRFS_FIRST_FREE_OBJECTID {
+        return Err(rustix::io::Errno::INVAL.into());
+    }
+
+    let mut args = VolumeArgsV2 {
+        fd: source.as_raw_fd().into(),
+        transid: 0,
+        flags: 0,
+        unused: [0; 4],
+        name: [0; 4040],
+    };
+    args.name[..SUBVOLUME.count_bytes()].copy_from_slice(SUBVOLUME.to_bytes());
+
+    unsafe { ioctl(parent, Setter::<BTRFS_IOC_SNAP_CREATE_V2, _>::new(args))? };
+
+    Ok(())
+}
+
+/// Create [`SUBVOLUME`], empty, within `parent`
+fn create_subvolume(parent: &OwnedFd) -> io::Result<()> {
+    let mut args = VolumeArgs { fd: 0, name: [0; 4088] };
+    args.name[..SUBVOLUME.count_bytes()].copy_from_slice(SUBVOLUME.to_bytes());
+
+    unsafe { ioctl(parent, Setter::<BTRFS_IOC_SUBVOL_CREATE, _>::new(args))? };
+
+    Ok(())
+}
+
+#[cfg(test)]
+mod test {
+    use std::{collections::BTreeMap, os::unix::fs::MetadataExt, path::PathBuf};
+
+    use stone::{StonePayloadLayoutFile, StonePayloadLayoutRecord};
+
+    use super::*;
+    use crate::client::{asset_path, blit_threaded};
+
+    fn layout(mode: u32, file: StonePayloadLayoutFile) -> (crate::package::Id, StonePayloadLayoutRecord) {
+        let record = StonePayloadLayoutRecord {
+            uid: 0,
+            gid: 0,
+            mode,
+            tag: 0,
+            file,
+        };
+
+        ("test".to_owned().into(), record)
+    }
+
+    fn regular(path: &str, hash: u128) -> (crate::package::Id, StonePayloadLayoutRecord) {
+        layout(0o100644, StonePayloadLayoutFile::Regular(hash, path.into()))
+    }
+
+    fn symlink(path: &str, target: &str) -> (crate::package::Id, StonePayloadLayoutRecord) {
+        layout(0o120777, StonePayloadLayoutFile::Symlink(target.into(), path.into()))
+    }
+
+    fn directory(path: &str, mode: u32) -> (crate::package::Id, StonePayloadLayoutRecord) {
+        layout(0o040000 | mode, StonePayloadLayoutFile::Directory(path.into()))
+    }
+
+    /// Type, mode & inode of regular files (which are hardlinked assets) or
+    /// symlink target beneath `root`
+    fn contents(root: &Path) -> BTreeMap<PathBuf, (u32, String)> {
+        let mut contents = BTreeMap::new();
+        let mut dirs = vec![root.to_owned()];
+
+        while let Some(dir) = dirs.pop() {
+            for entry in fs::read_dir(&dir).unwrap() {
+                let path = entry.unwrap().path();
+                let metadata = fs::symlink_metadata(&path).unwrap();
+
+                let detail = if metadata.is_dir() {
+                    dirs.push(path.clone());
+                    String::new()
+                } else if metadata.is_symlink() {
+                    fs::read_link(&path).unwrap().display().to_string()
+                } else {
+                    metadata.ino().to_string()
+                };
+
+                contents.insert(path.strip_prefix(root).unwrap().to_owned(), (metadata.mode(), detail));
+            }
+        }
+
+        contents
+    }
+
+    #[test]
+    fn apply_matches_full_blit() {
+        let dir = tempfile::tempdir().unwrap();
+        let cache_dir = dir.path().join("cache");
+
+        for hash in [0x1111_u128 << 100, 0x2222 << 100, 0x3333 << 100, 0x4444 << 100] {
+            let path = cache_dir.join(asset_path(hash));
+            fs::create_dir_all(path.parent().unwrap()).unwrap();
+            fs::write(path, hash.to_string()).unwrap();
+        }
+
+        let old = crate::client::vfs(vec![
+            regular("bin/nano", 0x1111 << 100),
+            symlink("bin/rnano", "nano"),
+            directory("share/nano", 0o755),
+            regular("share/nano/a", 0x2222 << 100),
+            regular("share/doc/x", 0x3333 << 100),
+            regular("lib/gone", 0x4444 << 100),
+        ])
+        .unwrap();
+        let new = crate::client::vfs(vec![
+            regular("bin/nano", 0x4444 << 100),
+            symlink("bin/rnano", "nano"),
+            directory("share/nano", 0o700),
+            regular("share/nano/a", 0x2222 << 100),
+            regular("share/nano/b", 0x3333 << 100),
+            regular("lib/new", 0x1111 << 100),
+        ])
+        .unwrap();
+
+        let progress = ProgressBar::hidden();
+        let cache = open_dir(AT_FDCWD, &cache_dir).unwrap();
+
+        let blit = |tree: &vfs::Tree<PendingFile>, target: &Path| {
+            fs::create_dir(target).unwrap();
+            let target = open_dir(AT_FDCWD, target).unwrap();
+            let Some(Element::Directory(_, _, children)) = tree.structured() else {
+                panic!("empty tree");
+            };
+            blit_threaded(target.as_raw_fd(), cache.as_raw_fd(), children, &progress, Link::Hard).unwrap();
+        };
+
+        let full = dir.path().join("full");
+        blit(&new, &full);
+
+        let staged = dir.path().join("staged");
+        blit(&old, &staged);
+        // Left by a trigger
+        fs::write(staged.join("usr/share/nano/cache"), "").unwrap();
+        // Edited since it was blitted, which breaks the link as a reflink would be
+        fs::remove_file(staged.join("usr/share/nano/a")).unwrap();
+        fs::write(staged.join("usr/share/nano/a"), "edited").unwrap();
+
+        let mut blitter = Blitter {
+            cache: &cache,
+            progress: &progress,
+            link: Link::Hard,
+            pending: vec![],
+            stats: BlitStats::default(),
+            reused: 0,
+        };
+        let usr = open_dir(AT_FDCWD, &staged.join("usr")).unwrap();
+        blitter
+            .apply(
+                &staged.join("usr"),
+                usr,
+                usr_children(&old).unwrap(),
+                usr_children(&new).unwrap(),
+            )
+            .unwrap();
+        blitter.flush().unwrap();
+
+        assert_eq!(contents(&staged), contents(&full));
+        // `bin`, `bin/rnano`, `lib`, `share` & `share/nano`
+        assert_eq!(blitter.reused, 5);
+        // `bin/nano`, `lib/new`, `share/nano/b` & the edited `share/nano/a`
+        assert_eq!(blitter.stats.num_entries(), 4);
+    }
+
+    #[test]
+    fn blit_falls_back_without_subvolumes() {
+        let dir = tempfile::tempdir().unwrap();
+        let installation = Installation::open(dir.path(), None).unwrap();
+        fs::create_dir_all(installation.assets_path("v2")).unwrap();
+        fs::create_dir_all(installation.staging_dir()).unwrap();
+        fs::create_dir_all(dir.path().join("usr")).unwrap();
+
+        let tree = crate::client::vfs(vec![directory("share/nano", 0o755), symlink("bin/rnano", "nano")]).unwrap();
+        let staging = installation.staging_dir();
+
+        fn previous() -> Result<Option<vfs::Tree<PendingFile>>, Error> {
+            panic!("no snapshot to compare against")
+        }
+        fn no_snapshot(_: &Path, _: &OwnedFd) -> io::Result<()> {
+            Err(io::ErrorKind::Unsupported.into())
+        }
+        fn unsupported(_: &OwnedFd) -> io::Result<()> {
+            Err(io::ErrorKind::Unsupported.into())
+        }
+        fn mkdir_usr(parent: &OwnedFd) -> io::Result<()> {
+            Ok(nix::sys::stat::mkdirat(
+                parent.as_raw_fd(),
+                SUBVOLUME,
+                Mode::from_bits_truncate(0o755),
+            )?)
+        }
+
+        // Neither works, so nothing is staged
+        let subvolumes = Subvolumes {
+            snapshot: no_snapshot,
+            create: unsupported,
+        };
+        assert!(!blit_with(&installation, &tree, &staging, previous, &subvolumes).unwrap());
+        assert_eq!(fs::read_dir(&staging).unwrap().count(), 0);
+
+        // Staged in full to a new subvolume, stood in for by a directory
+        let subvolumes = Subvolumes {
+            snapshot: no_snapshot,
+            create: mkdir_usr,
+        };
+        assert!(blit_with(&installation, &tree, &staging, previous, &subvolumes).unwrap());
+        assert_eq!(fs::read_link(staging.join("usr/bin/rnano")).unwrap(), Path::new("nano"));
+        assert!(staging.join("usr/share/nano").is_dir());
+    }
+}
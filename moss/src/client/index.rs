@@ -2,25 +2,39 @@
 // SPDX-License-Identifier: MPL-2.0
 
 use std::{
-    collections::{BTreeMap, btree_map},
+    cell::Cell,
+    collections::{BTreeMap, BTreeSet, btree_map},
     io,
     path::{Path, PathBuf, StripPrefixError},
-    time::Duration,
+    time::{Duration, UNIX_EPOCH},
 };
 
 use camino::{Utf8Path, Utf8PathBuf};
 use fs_err as fs;
 use rayon::iter::{IntoParallelRefIterator, ParallelIterator};
 use sha2::{Digest, Sha256};
-use stone::{StoneHeaderV1FileType, StoneReadError, StoneWriteError, StoneWriter};
+use stone::{
+    StoneDecodeContext, StoneDecodedPayload, StoneHeaderV1FileType, StonePayloadAttributeRecord, StonePayloadKind,
+    StonePayloadLookupKind, StonePayloadLookupRecord, StoneReadError, StoneWriteError, StoneWriter,
+};
 use thiserror::Error;
+use tracing::warn;
 use tui::{MultiProgress, ProgressBar, ProgressStyle, Styled};
 
 use crate::{
     client,
     package::{self, Meta, MissingMetaFieldError},
+    util,
 };
 
+/// Meta of previously indexed files, written next to `stone.index`
+const CACHE_FILE: &str = "stone.index.cache";
+
+thread_local! {
+    /// Decoder state reused for every stone indexed on this thread
+    static DECODE_CONTEXT: Cell<StoneDecodeContext> = Cell::default();
+}
+
 /// Index a directory of stone files & produce a `stone.index` index file
 ///
 /// If `output_dir` is `None`, `stone.index` is output to `index_dir`
@@ -43,8 +57,11 @@ pub fn index(index_dir: &Path, output_dir: Option<&Path>) -> Result<(), Error> {
     );
     total_progress.tick();
 
+    let cache = read_cache(output_dir);
+
     let ctx = GetMetaCtx {
         output_dir,
+        cache: &cache,
         multi_progress: &multi_progress,
         total_progress: &total_progress,
     };
@@ -53,11 +70,14 @@ pub fn index(index_dir: &Path, output_dir: Option<&Path>) -> Result<(), Error> {
         .map(|path| get_meta(path, ctx))
         .collect::<Result<Vec<_>, _>>()?;
 
+    // Every file is cached, including releases superseded below
+    write_cache(output_dir, &list)?;
+
     let mut map = BTreeMap::new();
 
     // Add each meta to the map, removing
     // dupes by keeping the latest release
-    for meta in list {
+    for CacheEntry { meta, .. } in list {
         match map.entry(meta.name.clone()) {
             btree_map::Entry::Vacant(entry) => {
                 entry.insert(meta);
@@ -79,16 +99,23 @@ pub fn index(index_dir: &Path, output_dir: Option<&Path>) -> Result<(), Error> {
         }
     }
 
-    write_index(output_dir, map, &total_progress)?;
+    // Read before it's replaced, the delta is computed against it
+    let previous = read_previous_index(output_dir)?;
+
+    write_index(output_dir, &map, &total_progress)?;
+    let delta = write_delta_index(output_dir, previous, &map)?;
 
     multi_progress.clear()?;
 
     println!("\nIndex file written to {:?}", output_dir.join("stone.index").display());
+    if let Some(path) = delta {
+        println!("Delta index file written to {:?}", path.display());
+    }
 
     Ok(())
 }
 
-fn write_index(dir: &Path, map: BTreeMap<package::Name, Meta>, total_progress: &ProgressBar) -> Result<(), Error> {
+fn write_index(dir: &Path, map: &BTreeMap<package::Name, Meta>, total_progress: &ProgressBar) -> Result<(), Error> {
     total_progress.set_message("Writing index file");
     total_progress.set_style(
         ProgressStyle::with_template("\n {spinner} {wide_msg}")
@@ -100,32 +127,162 @@ fn write_index(dir: &Path, map: BTreeMap<package::Name, Meta>, total_progress: &
     let path = dir.join("stone.index");
     let mut file = fs::File::create(&path)?;
 
-    let write_stone_index = || {
-        let mut writer = StoneWriter::new(&mut file, StoneHeaderV1FileType::Repository)?;
+    write_packages(&mut file, StoneHeaderV1FileType::Repository, map.values(), vec![])
+        .map_err(|source| Error::StoneWrite { source, path })
+}
 
-        for (_, meta) in map {
-            let payload = meta.to_stone_payload();
-            writer.add_payload(payload.as_slice())?;
-        }
+/// The index being replaced by this run
+struct PreviousIndex {
+    /// sha256 of the index file
+    hash: String,
+    /// Package file hashes it lists
+    packages: BTreeSet<String>,
+}
 
-        writer.finalize()
+fn read_previous_index(dir: &Path) -> Result<Option<PreviousIndex>, Error> {
+    let path = dir.join("stone.index");
+
+    if !path.exists() {
+        return Ok(None);
+    }
+
+    let hash = util::sha256_hash(&mut fs::File::open(&path)?)?;
+
+    let read_packages = || {
+        let mut file = fs::File::open(&path)?;
+        let mut reader = stone::read(&mut file)?;
+
+        reader
+            .payloads()?
+            .filter_map(|payload| match payload {
+                Ok(StoneDecodedPayload::Meta(meta)) => Some(Ok(meta)),
+                Ok(_) => None,
+                Err(error) => Some(Err(error)),
+            })
+            .collect::<Result<Vec<_>, StoneReadError>>()
+    };
+    let payloads = read_packages().map_err(|source| Error::StoneRead {
+        source,
+        path: path.clone(),
+    })?;
+
+    let packages = payloads
+        .iter()
+        .map(|payload| Ok(Meta::from_stone_payload(&payload.body)?.hash))
+        .filter_map(Result::transpose)
+        .collect::<Result<_, Error>>()?;
+
+    Ok(Some(PreviousIndex { hash, packages }))
+}
+
+/// Write `stone.delta.index`, holding only the packages added & removed
+/// since `previous` so clients mirroring it don't refetch the full index
+fn write_delta_index(
+    dir: &Path,
+    previous: Option<PreviousIndex>,
+    map: &BTreeMap<package::Name, Meta>,
+) -> Result<Option<PathBuf>, Error> {
+    let path = dir.join("stone.delta.index");
+
+    let Some(previous) = previous else {
+        // A stale delta would be applied by clients still on its base
+        // index without bringing them up to this one
+        if path.exists() {
+            fs::remove_file(&path)?;
+        }
+        return Ok(None);
     };
 
-    write_stone_index().map_err(|source| Error::StoneWrite { source, path })
+    let target = util::sha256_hash(&mut fs::File::open(dir.join("stone.index"))?)?;
+    let current = map
+        .values()
+        .filter_map(|meta| meta.hash.as_deref())
+        .collect::<BTreeSet<_>>();
+
+    let record = |kind, key| StonePayloadLookupRecord { offset: 0, kind, key };
+    let mut lookup = vec![
+        record(StonePayloadLookupKind::Base, previous.hash),
+        record(StonePayloadLookupKind::Target, target),
+    ];
+    lookup.extend(
+        previous
+            .packages
+            .iter()
+            .filter(|hash| !current.contains(hash.as_str()))
+            .map(|hash| record(StonePayloadLookupKind::Removed, hash.clone())),
+    );
+
+    let added = map
+        .values()
+        .filter(|meta| meta.hash.as_ref().is_some_and(|hash| !previous.packages.contains(hash)));
+
+    let mut file = fs::File::create(&path)?;
+
+    write_packages(&mut file, StoneHeaderV1FileType::Delta, added, lookup).map_err(|source| Error::StoneWrite {
+        source,
+        path: path.clone(),
+    })?;
+
+    Ok(Some(path))
+}
+
+/// Write a Meta payload per package followed by the lookup payload indexing them
+fn write_packages<'a>(
+    file: &mut fs::File,
+    file_type: StoneHeaderV1FileType,
+    packages: impl Iterator<Item = &'a Meta>,
+    mut lookup: Vec<StonePayloadLookupRecord>,
+) -> Result<(), StoneWriteError> {
+    let mut writer = StoneWriter::new(file, file_type)?;
+
+    for meta in packages {
+        let offset = writer.payload_offset();
+        let record = |kind, key: String| StonePayloadLookupRecord { offset, kind, key };
+
+        lookup.push(record(StonePayloadLookupKind::Name, meta.name.to_string()));
+        lookup.extend(
+            meta.providers
+                .iter()
+                .map(|provider| record(StonePayloadLookupKind::Provider, provider.to_string())),
+        );
+        lookup.extend(meta.hash.clone().map(|hash| record(StonePayloadLookupKind::Hash, hash)));
+
+        let payload = meta.clone().to_stone_payload();
+        writer.add_payload(payload.as_slice())?;
+    }
+
+    // Lets clients find a single package without decoding every meta payload
+    lookup.sort_by(|a, b| (a.kind, &a.key).cmp(&(b.kind, &b.key)));
+    writer.add_payload(lookup.as_slice())?;
+
+    writer.finalize()
 }
 
 #[derive(Clone, Copy)]
 struct GetMetaCtx<'a> {
     output_dir: &'a Path,
+    cache: &'a BTreeMap<String, CacheEntry>,
     multi_progress: &'a MultiProgress,
     total_progress: &'a ProgressBar,
 }
 
-fn get_meta(path: &Path, ctx: GetMetaCtx<'_>) -> Result<Meta, Error> {
+fn get_meta(path: &Path, ctx: GetMetaCtx<'_>) -> Result<CacheEntry, Error> {
     let relative_path: Utf8PathBuf = rel_path_from_to(ctx.output_dir, path)
         .try_into()
         .map_err(|_| Error::NonUtf8Path { path: path.to_owned() })?;
 
+    let metadata = fs::metadata(path)?;
+    let modified = metadata.modified()?.duration_since(UNIX_EPOCH).unwrap_or_default();
+
+    // Unchanged since the last run, skip hashing & decoding it
+    if let Some(cached) = ctx.cache.get(relative_path.as_str())
+        && cached.modified == modified
+        && cached.meta.download_size == Some(metadata.len())
+    {
+        ctx.total_progress.inc(1);
+        return Ok(cached.clone());
+    }
+
     let progress = ctx
         .multi_progress
         .insert_before(ctx.total_progress, ProgressBar::new_spinner());
@@ -140,19 +297,22 @@ fn get_meta(path: &Path, ctx: GetMetaCtx<'_>) -> Result<Meta, Error> {
             .tick_chars("--=≡■≡=--"),
     );
 
-    let read_payloads = || -> Result<Vec<_>, _> {
+    // Only the meta payload is needed, skip decoding layout & index
+    let read_meta = || {
         let mut file = fs::File::open(path)?;
-        let mut reader = stone::read(&mut file)?;
-        reader.payloads()?.collect()
+        let mut reader = stone::read_with_context(&mut file, DECODE_CONTEXT.take())?;
+        let meta = reader.payload_by_kind(StonePayloadKind::Meta);
+        DECODE_CONTEXT.set(reader.into_context());
+        meta
     };
-    let payloads = read_payloads().map_err(|source| Error::StoneRead {
+    let payload = read_meta().map_err(|source| Error::StoneRead {
         source,
         path: path.to_owned(),
     })?;
 
-    let payload = payloads
-        .iter()
-        .find_map(|payload| payload.meta())
+    let payload = payload
+        .as_ref()
+        .and_then(StoneDecodedPayload::meta)
         .ok_or(Error::MissingMetaPayload)?;
 
     let mut meta = Meta::from_stone_payload(&payload.body)?;
@@ -166,7 +326,104 @@ fn get_meta(path: &Path, ctx: GetMetaCtx<'_>) -> Result<Meta, Error> {
         .suspend(|| println!("{} {}", "Indexed".green(), relative_path.as_str().bold()));
     ctx.total_progress.inc(1);
 
-    Ok(meta)
+    Ok(CacheEntry { meta, modified })
+}
+
+/// Meta of an indexed file along with the mtime it had when indexed
+#[derive(Clone)]
+struct CacheEntry {
+    meta: Meta,
+    modified: Duration,
+}
+
+/// Cached entries keyed by their path relative to the output directory
+///
+/// The cache can always be rebuilt, so any failure reading it only
+/// means every file gets indexed from scratch
+fn read_cache(dir: &Path) -> BTreeMap<String, CacheEntry> {
+    let path = dir.join(CACHE_FILE);
+
+    if !path.exists() {
+        return BTreeMap::new();
+    }
+
+    read_cache_entries(&path).unwrap_or_else(|error| {
+        warn!(%error, "ignoring index cache {}", path.display());
+        BTreeMap::new()
+    })
+}
+
+fn read_cache_entries(path: &Path) -> Result<BTreeMap<String, CacheEntry>, Error> {
+    let read_payloads = || {
+        let mut file = fs::File::open(path)?;
+        let mut reader = stone::read(&mut file)?;
+        reader.payloads()?.collect::<Result<Vec<_>, StoneReadError>>()
+    };
+    let payloads = read_payloads().map_err(|source| Error::StoneRead {
+        source,
+        path: path.to_owned(),
+    })?;
+
+    // Keyed by the relative path, matching the uri of each meta
+    let modified = payloads
+        .iter()
+        .filter_map(StoneDecodedPayload::attributes)
+        .flat_map(|payload| &payload.body)
+        .filter_map(|record| {
+            let key = std::str::from_utf8(&record.key).ok()?;
+            let (secs, nanos) = record.value.split_first_chunk::<8>()?;
+            let nanos = <[u8; 4]>::try_from(nanos).ok()?;
+
+            Some((key, Duration::new(u64::from_le_bytes(*secs), u32::from_le_bytes(nanos))))
+        })
+        .collect::<BTreeMap<_, _>>();
+
+    let mut entries = BTreeMap::new();
+
+    for payload in payloads.iter().filter_map(StoneDecodedPayload::meta) {
+        let meta = Meta::from_stone_payload(&payload.body)?;
+
+        if let Some(uri) = meta.uri.clone()
+            && let Some(&modified) = modified.get(uri.as_str())
+        {
+            entries.insert(uri, CacheEntry { meta, modified });
+        }
+    }
+
+    Ok(entries)
+}
+
+fn write_cache(dir: &Path, entries: &[CacheEntry]) -> Result<(), Error> {
+    let path = dir.join(CACHE_FILE);
+    let mut file = fs::File::create(&path)?;
+
+    let modified = entries
+        .iter()
+        .filter_map(|entry| {
+            let uri = entry.meta.uri.as_ref()?;
+            let mut value = entry.modified.as_secs().to_le_bytes().to_vec();
+            value.extend(entry.modified.subsec_nanos().to_le_bytes());
+
+            Some(StonePayloadAttributeRecord {
+                key: uri.as_bytes().to_vec(),
+                value,
+            })
+        })
+        .collect::<Vec<_>>();
+
+    let write_stone_cache = || {
+        let mut writer = StoneWriter::new(&mut file, StoneHeaderV1FileType::Repository)?;
+
+        for entry in entries {
+            let payload = entry.meta.clone().to_stone_payload();
+            writer.add_payload(payload.as_slice())?;
+        }
+        writer.add_payload(modified.as_slice())?;
+
+        writer.finalize()
+    };
+
+    write_stone_cache().map_err(|source| Error::StoneWrite { source, path })
 }
 
 fn stat_file(path: &Path, relative_path: &Utf8Path, progress: &ProgressBar) -> Result<(u64, String), Error> {
@@ -267,7 +524,36 @@ fn rel_path_from_to(from_dir: &Path, to: &Path) -> PathBuf {
 mod tests {
     use std::path::Path;
 
-    use super::rel_path_from_to;
+    use super::*;
+
+    #[test]
+    fn cache_round_trip() {
+        let bash_completion = include_bytes!("../../../test/bash-completion-2.11-1-1-x86_64.stone");
+
+        let mut stone = stone::read_bytes(bash_completion).unwrap();
+        let payloads = stone.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+        let payload = payloads.iter().find_map(StoneDecodedPayload::meta).unwrap();
+
+        let mut meta = Meta::from_stone_payload(&payload.body).unwrap();
+        meta.hash = Some("0123456789abcdef".to_owned());
+        meta.download_size = Some(bash_completion.len() as u64);
+        meta.uri = Some("b/bash-completion-2.11-1-1-x86_64.stone".to_owned());
+
+        let entry = CacheEntry {
+            meta,
+            modified: Duration::new(1_700_000_000, 123_456_789),
+        };
+
+        let dir = tempfile::tempdir().unwrap();
+        write_cache(dir.path(), std::slice::from_ref(&entry)).unwrap();
+
+        let cache = read_cache(dir.path());
+        let cached = &cache["b/bash-completion-2.11-1-1-x86_64.stone"];
+
+        assert_eq!(cache.len(), 1);
+        assert_eq!(cached.meta, entry.meta);
+        assert_eq!(cached.modified, entry.modified);
+    }
 
     #[test]
     fn test_rel_path_from_to_strips_prefix() {
@@ -148,9 +148,10 @@ pub fn install(client: &mut Client, pkgs: &[&str], yes: bool, simulate: bool) ->
     };
 
     // Perfect, apply state.
-    client.new_state(&new_state_pkgs, "Install")?;
+    let applied = client.new_state(&new_state_pkgs, "Install")?;
 
     timing.blit = instant.elapsed();
+    timing.triggers = applied.triggers;
 
     info!(
         blit_time_ms = timing.blit.as_millis(),
@@ -199,6 +200,8 @@ pub struct Timing {
     pub resolve: Duration,
     pub fetch: Duration,
     pub blit: Duration,
+    /// Time taken by each trigger, part of `blit`
+    pub triggers: Vec<client::TriggerTiming>,
 }
 
 /// Error's specific to installation operations
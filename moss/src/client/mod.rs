@@ -11,8 +11,14 @@
 use std::{
     borrow::Borrow,
     fmt, io,
-    os::{fd::RawFd, unix::fs::symlink},
+    num::NonZeroUsize,
+    os::{
+        fd::{AsRawFd, FromRawFd, OwnedFd, RawFd},
+        unix::fs::symlink,
+    },
     path::{Path, PathBuf},
+    sync::{Arc, Mutex},
+    thread,
     time::{Duration, Instant},
 };
 
@@ -24,17 +30,20 @@ use nix::{
     errno::Errno,
     fcntl::{self, OFlag},
     libc::{AT_FDCWD, RENAME_EXCHANGE, SYS_renameat2, syscall},
-    sys::stat::{Mode, fchmodat, mkdirat},
+    sys::stat::{Mode, fchmod, fchmodat, mkdirat},
     unistd::{close, linkat, mkdir, symlinkat},
 };
 use postblit::TriggerScope;
+pub use postblit::TriggerTiming;
 use rayon::iter::{IntoParallelIterator, ParallelIterator};
 use stone::{StoneDecodedPayload, StonePayloadLayoutFile, StonePayloadLayoutRecord};
 use thiserror::Error;
-use tracing::{info, info_span, trace};
+use tokio::sync::Semaphore;
+use tracing::{info, info_span, trace, warn};
 use tui::{MultiProgress, ProgressBar, ProgressStyle, Styled};
 use vfs::tree::{BlitFile, Element, builder::TreeBuilder};
 
+use self::asset_index::AssetIndex;
 use self::install::install;
 use self::prune::{prune_cache, prune_states};
 use self::remove::remove;
@@ -43,7 +52,9 @@ use self::verify::verify;
 use crate::{
     Installation, Package, Provider, Registry, Signal, State, SystemModel,
     client::fetch::fetch,
-    db, environment, installation, package,
+    db, environment, installation,
+    metrics::{self, Syscall},
+    package,
     registry::plugin::{self, Plugin},
     repository, runtime, signal,
     state::{self, Selection},
@@ -54,19 +65,23 @@ pub use self::extract::extract;
 pub use self::index::index;
 pub use self::self_upgrade::self_upgrade;
 
+mod asset_index;
 mod boot;
 mod cache;
 mod fetch;
+mod incremental;
 mod install;
 mod postblit;
 mod remove;
 mod self_upgrade;
 mod sync;
-mod verify;
+mod tree_cache;
+mod uring;
 
 pub mod extract;
 pub mod index;
 pub mod prune;
+pub mod verify;
 
 /// A builder for [`Client`]
 pub struct ClientBuilder {
@@ -75,6 +90,9 @@ pub struct ClientBuilder {
     repositories: Option<repository::Map>,
     system_model_path: Option<PathBuf>,
     blit_root: Option<PathBuf>,
+    blit_backend: BlitBackend,
+    incremental: bool,
+    cache_limits: CacheLimits,
 }
 
 impl ClientBuilder {
@@ -103,6 +121,31 @@ impl ClientBuilder {
         self
     }
 
+    /// Set how stateful blits create the staging tree, ephemeral
+    /// clients always use [`BlitBackend::Threaded`]
+    pub fn blit_backend(mut self, backend: BlitBackend) -> ClientBuilder {
+        self.blit_backend = backend;
+        self
+    }
+
+    /// Stage new states from a snapshot of the active `/usr` where the
+    /// filesystem is btrfs, see [`incremental`]
+    ///
+    /// Off by default, as hardlinks can't cross into the snapshot so new and
+    /// changed files are reflinked from the asset store instead. Each then
+    /// takes an inode of its own, sharing extents rather than the asset's
+    /// inode & page cache, in exchange for staging only what changed.
+    pub fn incremental(mut self, incremental: bool) -> ClientBuilder {
+        self.incremental = incremental;
+        self
+    }
+
+    /// Set how many packages are downloaded & unpacked at once when caching
+    pub fn cache_limits(mut self, limits: CacheLimits) -> ClientBuilder {
+        self.cache_limits = limits;
+        self
+    }
+
     /// Build the [`Client`]
     pub fn build(mut self) -> Result<Client, Error> {
         if let Some(path) = self.system_model_path {
@@ -134,6 +177,9 @@ impl ClientBuilder {
             state_db,
             layout_db,
             scope: Scope::Stateful,
+            blit_backend: self.blit_backend,
+            incremental: self.incremental,
+            cache_limits: self.cache_limits,
         };
 
         if let Some(blit_root) = self.blit_root {
@@ -161,6 +207,12 @@ pub struct Client {
     repositories: repository::Manager,
     /// Operational scope (real systems, ephemeral, etc)
     scope: Scope,
+    /// Backend for stateful blits
+    blit_backend: BlitBackend,
+    /// Whether stateful blits start from a snapshot of the active `/usr`
+    incremental: bool,
+    /// Bounds of the download & unpack pipeline
+    cache_limits: CacheLimits,
 }
 
 impl Client {
@@ -172,6 +224,9 @@ impl Client {
             repositories: None,
             system_model_path: None,
             blit_root: None,
+            blit_backend: BlitBackend::Threaded,
+            incremental: false,
+            cache_limits: CacheLimits::default(),
         }
     }
 
@@ -251,11 +306,11 @@ impl Client {
         Ok(())
     }
 
-    pub fn verify(&self, yes: bool, verbose: bool) -> Result<(), Error> {
+    pub fn verify(&self, yes: bool, verbose: bool, mode: verify::Mode, jobs: usize) -> Result<(), Error> {
         if self.scope.is_ephemeral() {
             return Err(Error::EphemeralProhibitedOperation);
         }
-        verify(self, yes, verbose)?;
+        verify(self, yes, verbose, mode, jobs)?;
         Ok(())
     }
 
@@ -336,7 +391,7 @@ impl Client {
         &'a self,
         keyword: &'a str,
         flags: package::Flags,
-    ) -> impl Iterator<Item = Package> + 'a {
+    ) -> impl Iterator<Item = package::SearchResult> + 'a {
         self.registry.by_keyword(keyword, flags)
     }
 
@@ -373,9 +428,8 @@ impl Client {
         // Archive old state
         self.archive_state(old)?;
 
-        // Build VFS from new state selections
-        // to build triggers from
-        let fstree = self.vfs(new.selections.iter().map(|selection| &selection.package))?;
+        // Load VFS of the new state to build triggers from
+        let fstree = self.state_vfs(&new)?;
 
         if !skip_triggers {
             // Run system triggers
@@ -393,8 +447,8 @@ impl Client {
     /// provided packages and write that state ID to the installation
     /// Then blit the filesystem, promote it, finally archiving the active ID
     ///
-    /// Returns `None` if the client is ephemeral
-    pub fn new_state(&self, selections: &[Selection], summary: impl ToString) -> Result<Option<State>, Error> {
+    /// The returned state is `None` if the client is ephemeral
+    pub fn new_state(&self, selections: &[Selection], summary: impl ToString) -> Result<NewState, Error> {
         let _guard = signal::ignore([Signal::SIGINT])?;
         let _fd = signal::inhibit(
             vec!["shutdown", "sleep", "idle", "handle-lid-switch"],
@@ -427,21 +481,26 @@ impl Client {
 
         let old_state = self.installation.active_state;
 
-        let fstree = self.blit_root(selections.iter().map(|s| &s.package))?;
+        let fstree = self.stage_root(selections.iter().map(|s| &s.package), old_state)?;
 
         let result = match &self.scope {
             Scope::Stateful => {
                 // Add to db
                 let state = self.state_db.add(selections, Some(&summary.to_string()), None)?;
 
-                self.apply_stateful_blit(fstree, &state, old_state, system_model)?;
+                self.cache_vfs(&state, &fstree);
+
+                let triggers = self.apply_stateful_blit(fstree, &state, old_state, system_model)?;
 
-                Ok(Some(state))
+                Ok(NewState {
+                    state: Some(state),
+                    triggers,
+                })
             }
             Scope::Ephemeral { blit_root } => {
-                self.apply_ephemeral_blit(fstree, blit_root, system_model)?;
+                let triggers = self.apply_ephemeral_blit(fstree, blit_root, system_model)?;
 
-                Ok(None)
+                Ok(NewState { state: None, triggers })
             }
         };
 
@@ -456,10 +515,18 @@ impl Client {
     }
 
     /// Apply all triggers with the given scope, wrapping with a progressbar.
-    fn apply_triggers(scope: TriggerScope<'_>, fstree: &vfs::Tree<PendingFile>) -> Result<(), postblit::Error> {
+    ///
+    /// Returns the time taken by each trigger, batch by batch in the order
+    /// [`triggers::Collection::bake_batches`] laid them out. Triggers within a
+    /// batch run concurrently, so this isn't the order they completed in.
+    fn apply_triggers(
+        scope: TriggerScope<'_>,
+        fstree: &vfs::Tree<PendingFile>,
+    ) -> Result<Vec<TriggerTiming>, postblit::Error> {
         let triggers = postblit::triggers(scope, fstree)?;
+        let total = triggers.num_triggers();
 
-        let progress = ProgressBar::new(triggers.len() as u64).with_style(
+        let progress = ProgressBar::new(total as u64).with_style(
             ProgressStyle::with_template("\n|{bar:20.green/blue}| {pos}/{len} {msg}")
                 .unwrap()
                 .progress_chars("■≡=- "),
@@ -480,35 +547,42 @@ impl Client {
 
         info!(
             phase = phase_name,
-            total_items = triggers.len(),
+            total_items = total,
             progress = 0.0,
             event_type = "progress_start",
         );
 
-        for (i, trigger) in progress.wrap_iter(triggers.iter()).enumerate() {
-            trigger.execute()?;
+        let mut timings = Vec::with_capacity(total);
 
-            info!(
-                progress = (i + 1) as f32 / triggers.len() as f32,
-                current = i + 1,
-                total = triggers.len(),
-                event_type = "progress_update",
-                "Executing `{}`",
-                trigger.handler()
-            );
+        for batch in triggers.batches() {
+            for timing in triggers.execute(batch)? {
+                progress.inc(1);
+
+                info!(
+                    progress = (timings.len() + 1) as f32 / total as f32,
+                    current = timings.len() + 1,
+                    total,
+                    duration_ms = timing.elapsed.as_millis(),
+                    event_type = "progress_update",
+                    "Executed `{}`",
+                    timing.name
+                );
+
+                timings.push(timing);
+            }
         }
 
         info!(
             phase = phase_name,
             duration_ms = timer.elapsed().as_millis(),
-            items_processed = triggers.len(),
+            items_processed = total,
             progress = 1.0,
             event_type = "progress_completed",
         );
 
         progress.finish_and_clear();
 
-        Ok(())
+        Ok(timings)
     }
 
     pub fn apply_stateful_blit(
@@ -517,7 +591,7 @@ impl Client {
         state: &State,
         old_state: Option<state::Id>,
         system_model: SystemModel,
-    ) -> Result<(), Error> {
+    ) -> Result<Vec<TriggerTiming>, Error> {
         record_state_id(&self.installation.staging_dir(), state.id)?;
         record_os_release(&self.installation.staging_dir())?;
         record_system_model(&self.installation.staging_dir(), system_model)?;
@@ -532,7 +606,7 @@ impl Client {
         fs::create_dir_all(isolation_etc)?;
 
         // Apply transaction triggers
-        Self::apply_triggers(TriggerScope::Transaction(&self.installation, &self.scope), &fstree)?;
+        let mut triggers = Self::apply_triggers(TriggerScope::Transaction(&self.installation, &self.scope), &fstree)?;
 
         // Staging is only used with [`Scope::Stateful`]
         self.promote_staging()?;
@@ -545,11 +619,14 @@ impl Client {
         }
 
         // At this point we're allowed to run system triggers
-        Self::apply_triggers(TriggerScope::System(&self.installation, &self.scope), &fstree)?;
+        triggers.extend(Self::apply_triggers(
+            TriggerScope::System(&self.installation, &self.scope),
+            &fstree,
+        )?);
 
         boot::synchronize(self, state)?;
 
-        Ok(())
+        Ok(triggers)
     }
 
     pub fn apply_ephemeral_blit(
@@ -557,7 +634,7 @@ impl Client {
         fstree: vfs::Tree<PendingFile>,
         blit_root: &Path,
         system_model: SystemModel,
-    ) -> Result<(), Error> {
+    ) -> Result<Vec<TriggerTiming>, Error> {
         record_os_release(blit_root)?;
         record_system_model(blit_root, system_model)?;
 
@@ -569,11 +646,14 @@ impl Client {
         fs::create_dir_all(etc)?;
 
         // ephemeral tx triggers
-        Self::apply_triggers(TriggerScope::Transaction(&self.installation, &self.scope), &fstree)?;
+        let mut triggers = Self::apply_triggers(TriggerScope::Transaction(&self.installation, &self.scope), &fstree)?;
         // ephemeral system triggers
-        Self::apply_triggers(TriggerScope::System(&self.installation, &self.scope), &fstree)?;
+        triggers.extend(Self::apply_triggers(
+            TriggerScope::System(&self.installation, &self.scope),
+            &fstree,
+        )?);
 
-        Ok(())
+        Ok(triggers)
     }
 
     /// "Activate" the staging tree
@@ -641,6 +721,9 @@ impl Client {
     }
 
     /// Download & unpack the provided packages. Packages already cached will be validated & skipped.
+    ///
+    /// Downloading & unpacking run as separate stages bounded by [`CacheLimits`], so
+    /// packages keep downloading while earlier ones unpack.
     pub async fn cache_packages<T>(&self, packages: &[T]) -> Result<(), Error>
     where
         T: Borrow<Package>,
@@ -659,12 +742,29 @@ impl Client {
         total_progress.tick();
 
         let unpacking_in_progress = cache::UnpackingInProgress::default();
+        let asset_index = Arc::new(AssetIndex::open(&self.installation));
+
+        let limits = self.cache_limits;
+        let buffered = Semaphore::new(limits.buffered_kib());
+        let downloads = Semaphore::new(limits.downloads.max(1));
+        let unpacks = Semaphore::new(limits.unpacks.max(1));
+
+        let download_throughput = Mutex::new(Throughput::default());
+        let unpack_throughput = Arc::new(Mutex::new(Throughput::default()));
 
         // Download and unpack each package
         let cached = stream::iter(packages)
             .map(|package| async {
                 let package: &Package = package.borrow();
 
+                // Stop downloading ahead once enough is waiting to be unpacked
+                let _buffered = buffered
+                    .acquire_many(limits.buffer_cost(package.meta.download_size))
+                    .await
+                    .expect("semaphore is never closed");
+                let download_permit = downloads.acquire().await.expect("semaphore is never closed");
+                download_throughput.lock().unwrap_or_else(|e| e.into_inner()).start();
+
                 // Setup the progress bar and set as downloading
                 let progress_bar = multi_progress.insert_before(
                     &total_progress,
@@ -701,11 +801,26 @@ impl Client {
 
                 let is_cached = download.was_cached;
 
+                let downloaded = if is_cached {
+                    0
+                } else {
+                    package.meta.download_size.unwrap_or_default()
+                };
+                download_throughput
+                    .lock()
+                    .unwrap_or_else(|e| e.into_inner())
+                    .finish(downloaded);
+                drop(download_permit);
+
+                let _unpack_permit = unpacks.acquire().await.expect("semaphore is never closed");
+
                 // Move rest of blocking code to threadpool
 
                 let multi_progress = multi_progress.clone();
                 let total_progress = total_progress.clone();
                 let unpacking_in_progress = unpacking_in_progress.clone();
+                let asset_index = asset_index.clone();
+                let unpack_throughput = unpack_throughput.clone();
                 let package = (*package).clone();
                 let current_span = tracing::Span::current();
 
@@ -714,6 +829,8 @@ impl Client {
                     let package_name = &package.meta.name;
                     let download_path = download.path().to_owned();
 
+                    unpack_throughput.lock().unwrap_or_else(|e| e.into_inner()).start();
+
                     // Set progress to unpacking
                     progress_bar.set_message(format!("{} {}", "Unpacking".yellow(), package_name.to_string().bold()));
                     progress_bar.set_length(1000);
@@ -721,7 +838,7 @@ impl Client {
 
                     // Unpack and update progress
                     let unpacked = download
-                        .unpack(unpacking_in_progress.clone(), {
+                        .unpack(unpacking_in_progress.clone(), &asset_index, limits.unpack_workers(), {
                             let progress_bar = progress_bar.clone();
                             let package_name = package_name.clone();
 
@@ -738,6 +855,15 @@ impl Client {
                         })
                         .map_err(|err| Error::CacheUnpack(err, package_name.clone(), download_path))?;
 
+                    unpack_throughput.lock().unwrap_or_else(|e| e.into_inner()).finish(
+                        unpacked
+                            .payloads
+                            .iter()
+                            .filter_map(StoneDecodedPayload::content)
+                            .map(|content| content.header.plain_size)
+                            .sum(),
+                    );
+
                     // Remove this progress bar
                     progress_bar.finish();
                     multi_progress.remove(&progress_bar);
@@ -771,10 +897,25 @@ impl Client {
                 })
                 .await
             })
-            // Use max network concurrency since we download files here
-            .buffer_unordered(environment::MAX_NETWORK_CONCURRENCY)
+            // Enough in flight to keep both stages busy, each is bounded by its own semaphore
+            .buffer_unordered(limits.downloads.max(1) + limits.unpacks.max(1))
             .try_collect::<Vec<_>>()
-            .await?;
+            .await;
+
+        download_throughput
+            .lock()
+            .unwrap_or_else(|e| e.into_inner())
+            .report("download");
+        unpack_throughput
+            .lock()
+            .unwrap_or_else(|e| e.into_inner())
+            .report("unpack");
+
+        // Keep whatever was verified, even if a package failed to cache
+        if let Err(err) = asset_index.save() {
+            warn!(error = format!("{err:#}"), "Failed to save asset index");
+        }
+        let cached = cached?;
 
         // Add layouts & packages to DBs
         runtime::unblock({
@@ -787,13 +928,22 @@ impl Client {
                 total_progress.tick();
 
                 // Add layouts
-                layout_db.batch_add(cached.iter().flat_map(|(p, u)| {
-                    u.payloads
-                        .iter()
-                        .flat_map(StoneDecodedPayload::layout)
-                        .flat_map(|p| p.body.as_slice())
-                        .map(|layout| (&p.id, layout))
-                }))?;
+                layout_db.batch_add(
+                    cached.iter().flat_map(|(p, u)| {
+                        u.payloads
+                            .iter()
+                            .flat_map(StoneDecodedPayload::layout)
+                            .flat_map(|p| p.body.as_slice())
+                            .map(|layout| (&p.id, layout))
+                    }),
+                    cached.iter().flat_map(|(_, u)| {
+                        u.payloads
+                            .iter()
+                            .flat_map(StoneDecodedPayload::index)
+                            .flat_map(|p| p.body.as_slice())
+                            .map(|index| (index.digest, index.end - index.start))
+                    }),
+                )?;
 
                 total_progress.inc(1);
                 total_progress.set_message("Storing DB packages");
@@ -825,6 +975,35 @@ impl Client {
         vfs(self.layout_db.query(packages)?)
     }
 
+    /// Load the [`vfs::Tree`] of a recorded state
+    ///
+    /// The tree cached when the state was created is used when present, otherwise
+    /// it's rebuilt from the layout db and cached for next time.
+    pub fn state_vfs(&self, state: &State) -> Result<vfs::Tree<PendingFile>, Error> {
+        match tree_cache::read(&self.installation, state) {
+            Ok(Some(tree)) => return Ok(tree),
+            Ok(None) => {}
+            Err(error) => warn!(%error, state = %state.id, "Ignoring unreadable vfs cache"),
+        }
+
+        let tree = self.vfs(state.selections.iter().map(|s| &s.package))?;
+        self.cache_vfs(state, &tree);
+
+        Ok(tree)
+    }
+
+    /// Cache the tree of `state`, which is only an optimisation so
+    /// failing to do so isn't fatal
+    fn cache_vfs(&self, state: &State, tree: &vfs::Tree<PendingFile>) {
+        if self.installation.read_only() {
+            return;
+        }
+
+        if let Err(error) = tree_cache::write(&self.installation, state, tree) {
+            warn!(%error, state = %state.id, "Failed to cache vfs");
+        }
+    }
+
     /// Blit the packages to a filesystem root
     ///
     /// This functionality is core to all moss filesystem transactions, forming the entire
@@ -841,14 +1020,49 @@ impl Client {
         &self,
         packages: impl IntoIterator<Item = &'a package::Id>,
     ) -> Result<vfs::Tree<PendingFile>, Error> {
-        let blit_target = match &self.scope {
-            Scope::Stateful => self.installation.staging_dir(),
-            Scope::Ephemeral { blit_root } => blit_root.to_owned(),
+        let (blit_target, backend) = match &self.scope {
+            Scope::Stateful => (self.installation.staging_dir(), self.blit_backend),
+            // Ephemeral roots are used by boulder, which needs to stay
+            // single threaded to unshare into its build namespaces
+            Scope::Ephemeral { blit_root } => (blit_root.to_owned(), BlitBackend::Threaded),
         };
 
         let fstree = self.vfs(packages)?;
 
-        blit_root(&self.installation, &fstree, &blit_target)?;
+        blit_root(&self.installation, &fstree, &blit_target, backend)?;
+
+        Ok(fstree)
+    }
+
+    /// Blit the packages to the staging tree of a new state
+    ///
+    /// When [`ClientBuilder::incremental`] is set and the filesystem supports
+    /// snapshots, only the entries differing from the `previous` active state
+    /// are written to a snapshot of its `/usr`. Otherwise, and for ephemeral
+    /// clients, this is [`Self::blit_root`].
+    fn stage_root<'a>(
+        &self,
+        packages: impl IntoIterator<Item = &'a package::Id>,
+        previous: Option<state::Id>,
+    ) -> Result<vfs::Tree<PendingFile>, Error> {
+        if self.scope.is_ephemeral() || !self.incremental {
+            return self.blit_root(packages);
+        }
+
+        let fstree = self.vfs(packages)?;
+        let staging_dir = self.installation.staging_dir();
+
+        let previous = || match previous {
+            Some(id) => {
+                let state = self.state_db.get(id)?;
+                Ok(Some(self.state_vfs(&state)?))
+            }
+            None => Ok(None),
+        };
+
+        if !incremental::blit(&self.installation, &fstree, &staging_dir, previous)? {
+            blit_root(&self.installation, &fstree, &staging_dir, self.blit_backend)?;
+        }
 
         Ok(fstree)
     }
@@ -952,6 +1166,9 @@ impl Client {
             state_db,
             layout_db,
             scope: Scope::Stateful,
+            blit_backend: BlitBackend::Threaded,
+            incremental: false,
+            cache_limits: CacheLimits::default(),
         })
     }
 }
@@ -1012,56 +1229,41 @@ pub fn vfs(layouts: Vec<(package::Id, StonePayloadLayoutRecord)>) -> Result<vfs:
 ///
 /// This provides a very quick means to generate a hardlinked "snapshot" on-demand,
 /// which can then be activated via [`Self::promote_staging`]
-pub fn blit_root(installation: &Installation, tree: &vfs::Tree<PendingFile>, blit_target: &Path) -> Result<(), Error> {
+pub fn blit_root(
+    installation: &Installation,
+    tree: &vfs::Tree<PendingFile>,
+    blit_target: &Path,
+    backend: BlitBackend,
+) -> Result<(), Error> {
     // undirt.
     fs::remove_dir_all(blit_target)?;
 
-    let progress = ProgressBar::new(1).with_style(
-        ProgressStyle::with_template("\n|{bar:20.red/blue}| {pos}/{len} {msg}")
-            .unwrap()
-            .progress_chars("■≡=- "),
-    );
-    progress.set_message("Blitting filesystem");
-    progress.enable_steady_tick(Duration::from_millis(150));
-    progress.tick();
+    let progress = blit_progress(tree);
 
     let now = Instant::now();
     let mut stats = BlitStats::default();
 
-    progress.set_length(tree.len());
-    progress.set_position(0_u64);
-
     let cache_dir = installation.assets_path("v2");
     let cache_fd = fcntl::open(&cache_dir, OFlag::O_DIRECTORY | OFlag::O_RDONLY, Mode::empty())?;
 
-    // We need to ensure this runtime is dropped so it doesn't linger
-    // since this is in the boulder call path & boulder can't have
-    // multithreading when CLONE into a user namespace / "container"
-    let rayon_runtime = rayon::ThreadPoolBuilder::new().build().expect("rayon runtime");
-
-    rayon_runtime.install(|| -> Result<(), Error> {
-        if let Some(root) = tree.structured() {
-            mkdir(blit_target, Mode::from_bits_truncate(0o755))?;
-            let root_dir = fcntl::open(blit_target, OFlag::O_DIRECTORY | OFlag::O_RDONLY, Mode::empty())?;
+    if let Some(root) = tree.structured() {
+        mkdir(blit_target, Mode::from_bits_truncate(0o755))?;
+        let root_dir = fcntl::open(blit_target, OFlag::O_DIRECTORY | OFlag::O_RDONLY, Mode::empty())?;
 
-            if let Element::Directory(_, _, children) = root {
-                let current_span = tracing::Span::current();
-                stats = stats.merge(
-                    children
-                        .into_par_iter()
-                        .map(|child| {
-                            let _guard = current_span.enter();
-                            blit_element(root_dir, cache_fd, child, &progress)
-                        })
-                        .try_reduce(BlitStats::default, |a, b| Ok(a.merge(b)))?,
-                );
-            }
+        if let Element::Directory(_, _, children) = root {
+            let ring = match backend {
+                BlitBackend::Threaded => None,
+                BlitBackend::IoUring => uring::Ring::new(),
+            };
 
-            close(root_dir)?;
+            stats = match ring {
+                Some(ring) => uring::blit(ring, root_dir, cache_fd, children, &progress)?,
+                None => blit_threaded(root_dir, cache_fd, children, &progress, Link::Hard)?,
+            };
         }
 
-        Ok(())
-    })?;
+        close(root_dir)?;
+    }
 
     progress.finish_and_clear();
 
@@ -1078,23 +1280,157 @@ pub fn blit_root(installation: &Installation, tree: &vfs::Tree<PendingFile>, bli
     Ok(())
 }
 
-/// Recursively write a directory, or a single flat inode, to the staging tree.
-/// Care is taken to retain the directory file descriptor to avoid costly path
-/// resolution at runtime.
-fn blit_element(
-    parent: RawFd,
-    cache: RawFd,
-    element: Element<'_, PendingFile>,
+/// Progress bar for blitting every entry of `tree`
+fn blit_progress(tree: &vfs::Tree<PendingFile>) -> ProgressBar {
+    let progress = ProgressBar::new(1).with_style(
+        ProgressStyle::with_template("\n|{bar:20.red/blue}| {pos}/{len} {msg}")
+            .unwrap()
+            .progress_chars("■≡=- "),
+    );
+    progress.set_message("Blitting filesystem");
+    progress.enable_steady_tick(Duration::from_millis(150));
+    progress.tick();
+
+    progress.set_length(tree.len());
+    progress.set_position(0_u64);
+
+    progress
+}
+
+/// Outcome of [`Client::new_state`]
+#[derive(Debug)]
+pub struct NewState {
+    /// The recorded state, `None` if the client is ephemeral
+    pub state: Option<State>,
+    /// Time taken by each transaction & system trigger
+    pub triggers: Vec<TriggerTiming>,
+}
+
+/// Bounds of the download → unpack pipeline of [`Client::cache_packages`]
+#[derive(Debug, Clone, Copy)]
+pub struct CacheLimits {
+    /// Packages downloaded at once
+    pub downloads: usize,
+    /// Packages unpacked at once, which share the available CPUs as worker threads
+    pub unpacks: usize,
+    /// Download size of the packages allowed to be in flight, from the start of their
+    /// download to the end of their unpack. Larger packages still run, one at a time.
+    pub buffered_bytes: u64,
+}
+
+impl Default for CacheLimits {
+    fn default() -> Self {
+        Self {
+            downloads: environment::MAX_NETWORK_CONCURRENCY,
+            unpacks: environment::MAX_NETWORK_CONCURRENCY,
+            buffered_bytes: environment::MAX_CACHE_BUFFERED_BYTES,
+        }
+    }
+}
+
+impl CacheLimits {
+    /// Semaphore permits standing for [`Self::buffered_bytes`], one per KiB
+    fn buffered_kib(&self) -> usize {
+        (self.buffered_bytes / 1024).clamp(1, u32::MAX as u64) as usize
+    }
+
+    /// Worker threads of each unpack, sharing the CPUs between [`Self::unpacks`]
+    fn unpack_workers(&self) -> NonZeroUsize {
+        let cpus = thread::available_parallelism().map_or(1, NonZeroUsize::get);
+        NonZeroUsize::new(cpus / self.unpacks.max(1)).unwrap_or(NonZeroUsize::MIN)
+    }
+
+    /// Permits a package of `download_size` holds while it's in flight
+    fn buffer_cost(&self, download_size: Option<u64>) -> u32 {
+        (download_size.unwrap_or_default() / 1024).min(self.buffered_kib() as u64) as u32
+    }
+}
+
+/// Bytes processed by a stage of [`Client::cache_packages`], from when
+/// its first package started to when its last one finished
+#[derive(Debug, Default)]
+struct Throughput {
+    bytes: u64,
+    started: Option<Instant>,
+    finished: Option<Instant>,
+}
+
+impl Throughput {
+    fn start(&mut self) {
+        self.started.get_or_insert_with(Instant::now);
+    }
+
+    fn finish(&mut self, bytes: u64) {
+        self.bytes += bytes;
+        self.finished = Some(Instant::now());
+    }
+
+    fn report(&self, stage: &str) {
+        let (Some(started), Some(finished)) = (self.started, self.finished) else {
+            return;
+        };
+        let elapsed = finished - started;
+
+        info!(
+            stage,
+            bytes = self.bytes,
+            duration_ms = elapsed.as_millis(),
+            mib_per_sec = self.bytes as f64 / 1024.0 / 1024.0 / elapsed.as_secs_f64().max(f64::EPSILON),
+            "Cache stage throughput"
+        );
+    }
+}
+
+/// How [`blit_root`] issues the syscalls creating each entry
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum BlitBackend {
+    /// Blocking "at" syscalls spread over a rayon pool
+    Threaded,
+    /// Batched io_uring submissions, falling back to [`Self::Threaded`] when
+    /// the kernel doesn't support them. Every entry is still punted to the
+    /// kernel's blocking workers, so this only pays off with cores to spare.
+    /// Those workers join the calling thread group, ruling it out ahead of
+    /// unsharing namespaces.
+    IoUring,
+}
+
+fn blit_threaded(
+    root_dir: RawFd,
+    cache_fd: RawFd,
+    children: Vec<Element<'_, PendingFile>>,
     progress: &ProgressBar,
+    link: Link,
 ) -> Result<BlitStats, Error> {
-    let mut stats = BlitStats::default();
+    // We need to ensure this runtime is dropped so it doesn't linger
+    // since this is in the boulder call path & boulder can't have
+    // multithreading when CLONE into a user namespace / "container"
+    let rayon_runtime = rayon::ThreadPoolBuilder::new().build().expect("rayon runtime");
 
-    progress.inc(1);
+    rayon_runtime.install(|| {
+        let current_span = tracing::Span::current();
+        children
+            .into_par_iter()
+            .map(|child| {
+                let _guard = current_span.enter();
+                blit_element(root_dir, cache_fd, child, progress, link)
+            })
+            .try_reduce(BlitStats::default, |a, b| Ok(a.merge(b)))
+    })
+}
 
-    let (_, item) = match &element {
-        Element::Directory(_, item, _) => ("directory", item),
-        Element::Child(_, item) => ("file", item),
-    };
+/// How [`blit_element_item`] creates regular files from the asset store
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Link {
+    /// Hardlink the asset
+    Hard,
+    /// Clone the asset's extents into a new inode, for trees on a
+    /// different btrfs subvolume which hardlinks can't cross
+    Reflink,
+}
+
+/// Advance the blit progress for `item`, which is about to be written
+fn report_progress(progress: &ProgressBar, item: &PendingFile) {
+    progress.inc(1);
 
     trace!(
         progress = progress.position() as f32 / progress.length().unwrap_or(1) as f32,
@@ -1104,11 +1440,27 @@ fn blit_element(
         "Blitting {}",
         item.path()
     );
+}
+
+/// Recursively write a directory, or a single flat inode, to the staging tree.
+/// Care is taken to retain the directory file descriptor to avoid costly path
+/// resolution at runtime.
+fn blit_element(
+    parent: RawFd,
+    cache: RawFd,
+    element: Element<'_, PendingFile>,
+    progress: &ProgressBar,
+    link: Link,
+) -> Result<BlitStats, Error> {
+    let mut stats = BlitStats::default();
+
+    let (Element::Directory(_, item, _) | Element::Child(_, item)) = &element;
+    report_progress(progress, item);
 
     match element {
         Element::Directory(name, item, children) => {
             // Construct within the parent
-            blit_element_item(parent, cache, name, item, &mut stats)?;
+            blit_element_item(parent, cache, name, item, link, &mut stats)?;
 
             // open the new dir
             let newdir = fcntl::openat(parent, name, OFlag::O_RDONLY | OFlag::O_DIRECTORY, Mode::empty())?;
@@ -1119,7 +1471,7 @@ fn blit_element(
                     .into_par_iter()
                     .map(|child| {
                         let _guard = current_span.enter();
-                        blit_element(newdir, cache, child, progress)
+                        blit_element(newdir, cache, child, progress, link)
                     })
                     .try_reduce(BlitStats::default, |a, b| Ok(a.merge(b)))?,
             );
@@ -1129,7 +1481,7 @@ fn blit_element(
             Ok(stats)
         }
         Element::Child(name, item) => {
-            blit_element_item(parent, cache, name, item, &mut stats)?;
+            blit_element_item(parent, cache, name, item, link, &mut stats)?;
 
             Ok(stats)
         }
@@ -1144,65 +1496,101 @@ fn blit_element(
 /// * `cache`   - raw file descriptor for the system asset pool tree
 /// * `subpath` - the base name of the new inode
 /// * `item`    - New inode being recorded
+/// * `link`    - How a regular file is created from its asset
 fn blit_element_item(
     parent: RawFd,
     cache: RawFd,
     subpath: &str,
     item: &PendingFile,
+    link: Link,
     stats: &mut BlitStats,
 ) -> Result<(), Error> {
     match &item.layout.file {
         StonePayloadLayoutFile::Regular(id, _) => {
-            let hash = format!("{id:02x}");
-            let directory = if hash.len() >= 10 {
-                PathBuf::from(&hash[..2]).join(&hash[2..4]).join(&hash[4..6])
-            } else {
-                "".into()
-            };
-
             // Link relative from cache to target
-            let fp = directory.join(hash);
+            let fp = asset_path(*id);
 
             match *id {
-                // Mystery empty-file hash. Do not allow dupes!
-                // https://github.com/serpent-os/tools/issues/372
-                0x99aa_06d3_0147_98d8_6001_c324_468d_497f => {
-                    let fd = fcntl::openat(
-                        parent,
-                        subpath,
-                        OFlag::O_CREAT | OFlag::O_WRONLY | OFlag::O_TRUNC,
-                        Mode::from_bits_truncate(item.layout.mode),
-                    )?;
-                    close(fd)?;
+                EMPTY_FILE_HASH => {
+                    let fd = metrics::syscall(Syscall::Openat, || {
+                        fcntl::openat(
+                            parent,
+                            subpath,
+                            OFlag::O_CREAT | OFlag::O_WRONLY | OFlag::O_TRUNC,
+                            Mode::from_bits_truncate(item.layout.mode),
+                        )
+                    })?;
+                    metrics::syscall(Syscall::Close, || close(fd))?;
                 }
                 // Regular file
-                _ => {
-                    linkat(
-                        Some(cache),
-                        fp.to_str().unwrap(),
-                        Some(parent),
-                        subpath,
-                        nix::unistd::LinkatFlags::NoSymlinkFollow,
-                    )?;
+                _ if link == Link::Hard => {
+                    metrics::syscall(Syscall::Linkat, || {
+                        linkat(
+                            Some(cache),
+                            fp.to_str().unwrap(),
+                            Some(parent),
+                            subpath,
+                            nix::unistd::LinkatFlags::NoSymlinkFollow,
+                        )
+                    })?;
 
                     // Fix permissions
-                    fchmodat(
-                        Some(parent),
+                    metrics::syscall(Syscall::Fchmodat, || {
+                        fchmodat(
+                            Some(parent),
+                            subpath,
+                            Mode::from_bits_truncate(item.layout.mode),
+                            nix::sys::stat::FchmodatFlags::NoFollowSymlink,
+                        )
+                    })?;
+                }
+                _ => {
+                    let source = open_fd(cache, &fp, OFlag::O_RDONLY | OFlag::O_CLOEXEC, Mode::empty())?;
+                    let target = open_fd(
+                        parent,
                         subpath,
+                        OFlag::O_CREAT | OFlag::O_EXCL | OFlag::O_WRONLY | OFlag::O_CLOEXEC,
                         Mode::from_bits_truncate(item.layout.mode),
-                        nix::sys::stat::FchmodatFlags::NoFollowSymlink,
                     )?;
+
+                    metrics::syscall(Syscall::Ficlone, || rustix::fs::ioctl_ficlone(&target, &source))
+                        .map_err(io::Error::from)?;
+
+                    // Carry over the asset's timestamps, which incremental blits
+                    // compare against to tell the clone hasn't been modified since
+                    let asset = rustix::fs::fstat(&source).map_err(io::Error::from)?;
+                    rustix::fs::futimens(
+                        &target,
+                        &rustix::fs::Timestamps {
+                            last_access: rustix::fs::Timespec {
+                                tv_sec: asset.st_atime as _,
+                                tv_nsec: asset.st_atime_nsec as _,
+                            },
+                            last_modification: rustix::fs::Timespec {
+                                tv_sec: asset.st_mtime as _,
+                                tv_nsec: asset.st_mtime_nsec as _,
+                            },
+                        },
+                    )
+                    .map_err(io::Error::from)?;
+
+                    // Fix permissions, the umask applies on creation
+                    metrics::syscall(Syscall::Fchmod, || {
+                        fchmod(target.as_raw_fd(), Mode::from_bits_truncate(item.layout.mode))
+                    })?;
                 }
             }
 
             stats.num_files += 1;
         }
         StonePayloadLayoutFile::Symlink(source, _) => {
-            symlinkat(source.as_str(), Some(parent), subpath)?;
+            metrics::syscall(Syscall::Symlinkat, || symlinkat(source.as_str(), Some(parent), subpath))?;
             stats.num_symlinks += 1;
         }
         StonePayloadLayoutFile::Directory(_) => {
-            mkdirat(parent, subpath, Mode::from_bits_truncate(item.layout.mode))?;
+            metrics::syscall(Syscall::Mkdirat, || {
+                mkdirat(parent, subpath, Mode::from_bits_truncate(item.layout.mode))
+            })?;
             stats.num_dirs += 1;
         }
 
@@ -1217,6 +1605,28 @@ fn blit_element_item(
     Ok(())
 }
 
+/// `openat` returning an owned fd
+fn open_fd<P: ?Sized + nix::NixPath>(dir: RawFd, path: &P, flags: OFlag, mode: Mode) -> Result<OwnedFd, Errno> {
+    metrics::syscall(Syscall::Openat, || fcntl::openat(dir, path, flags, mode))
+        .map(|fd| unsafe { OwnedFd::from_raw_fd(fd) })
+}
+
+/// Mystery empty-file hash. Do not allow dupes!
+/// https://github.com/serpent-os/tools/issues/372
+const EMPTY_FILE_HASH: u128 = 0x99aa_06d3_0147_98d8_6001_c324_468d_497f;
+
+/// Path of an asset relative to the asset store
+fn asset_path(id: u128) -> PathBuf {
+    let hash = format!("{id:02x}");
+    let directory = if hash.len() >= 10 {
+        PathBuf::from(&hash[..2]).join(&hash[2..4]).join(&hash[4..6])
+    } else {
+        "".into()
+    };
+
+    directory.join(hash)
+}
+
 fn record_state_id(root: &Path, state: state::Id) -> Result<(), Error> {
     let usr = root.join("usr");
     fs::create_dir_all(&usr)?;
@@ -7,9 +7,15 @@
 //!
 //! Note that currently we only load from `/usr/share/moss/triggers/{tx,sys.d}/*.yaml`
 //! and do not yet support local triggers
+//!
+//! Triggers are run in batches ordered by their `before` / `after` fields, with
+//! the triggers of a batch running concurrently. A sandboxed batch shares a single
+//! container, as only one can be entered at a time.
 use std::{
+    io::{self, Read as _, Write as _},
     path::{Path, PathBuf},
-    process,
+    process, thread,
+    time::{Duration, Instant},
 };
 
 use crate::Installation;
@@ -18,6 +24,7 @@ use itertools::Itertools;
 use serde::Deserialize;
 use thiserror::Error;
 use tracing::{error, warn};
+use triggers::Baked;
 use triggers::format::{CompiledHandler, Handler, Trigger};
 
 use super::PendingFile;
@@ -102,7 +109,17 @@ impl TriggerScope<'_> {
 #[derive(Debug)]
 pub(super) struct TriggerRunner<'a> {
     scope: TriggerScope<'a>,
-    trigger: CompiledHandler,
+    /// Batches to run one after the other
+    batches: Vec<Vec<Baked>>,
+}
+
+/// How long a trigger took to run
+#[derive(Debug, Clone)]
+pub struct TriggerTiming {
+    /// Name of the trigger
+    pub name: String,
+    /// Time spent running all of its handlers
+    pub elapsed: Duration,
 }
 
 /// Load all triggers matching the given scope and staging filesystem
@@ -114,7 +131,7 @@ pub(super) struct TriggerRunner<'a> {
 pub(super) fn triggers<'a>(
     scope: TriggerScope<'a>,
     fstree: &vfs::tree::Tree<PendingFile>,
-) -> Result<Vec<TriggerRunner<'a>>, Error> {
+) -> Result<TriggerRunner<'a>, Error> {
     // Pre-calculate trigger root path once
     let trigger_root = {
         let mut path = PathBuf::with_capacity(50);
@@ -141,31 +158,33 @@ pub(super) fn triggers<'a>(
             .collect_vec(),
     };
 
-    // Load trigger collection, process all the paths, convert to scoped TriggerRunner vec
+    // Load trigger collection, process all the paths, convert to a scoped TriggerRunner
     let mut collection = triggers::Collection::new(triggers.iter())?;
     collection.process_paths(fstree.iter().map(|m| m.to_string()));
-    let computed_commands = collection
-        .bake()?
-        .into_iter()
-        .map(|trigger| TriggerRunner { scope, trigger })
-        .collect_vec();
-    Ok(computed_commands)
+    let batches = collection.bake_batches()?;
+    Ok(TriggerRunner { scope, batches })
 }
 
 impl TriggerRunner<'_> {
-    pub fn handler(&self) -> &Handler {
-        self.trigger.handler()
+    /// Total number of triggers across all batches
+    pub fn num_triggers(&self) -> usize {
+        self.batches.iter().map(Vec::len).sum()
+    }
+
+    /// Batches of triggers in the order they must be executed
+    pub fn batches(&self) -> &[Vec<Baked>] {
+        &self.batches
     }
 
-    /// Execute a trigger, taking care to account for the transaction scope and client scope
+    /// Execute a batch of triggers, taking care to account for the transaction scope and client scope
     ///
     /// All transaction triggers are run via sandboxing ([`container::Container`]) to limit their
     /// system view, and limit write access.
     /// System triggers will execute without any sandboxing when moss is used directly against the
     /// live root filesystem, and will force sandboxing when using a non-`/` root (such as using the
     /// `-D argument with `moss install`)
-    pub fn execute(&self) -> Result<(), Error> {
-        match self.scope {
+    pub fn execute(&self, batch: &[Baked]) -> Result<Vec<TriggerTiming>, Error> {
+        let elapsed = match self.scope {
             TriggerScope::Transaction(install, _) => {
                 // TODO: Add caching support via /var/
                 let isolation = Container::new(install.isolation_dir())
@@ -174,12 +193,12 @@ impl TriggerRunner<'_> {
                     .bind_rw(self.scope.guest_path("usr"), "/usr")
                     .work_dir("/");
 
-                Ok(isolation.run(|| execute_trigger_directly(&self.trigger))?)
+                execute_isolated(isolation, batch)?
             }
             TriggerScope::System(install, _) => {
                 // OK, if the root == `/` then we can run directly, otherwise we need to containerise with RW.
                 if install.root.to_string_lossy() == "/" {
-                    Ok(execute_trigger_directly(&self.trigger)?)
+                    execute_batch(batch)?
                 } else {
                     let isolation = Container::new(install.isolation_dir())
                         .networking(false)
@@ -187,13 +206,73 @@ impl TriggerRunner<'_> {
                         .bind_rw(self.scope.guest_path("usr"), "/usr")
                         .work_dir("/");
 
-                    Ok(isolation.run(|| execute_trigger_directly(&self.trigger))?)
+                    execute_isolated(isolation, batch)?
                 }
             }
-        }
+        };
+
+        Ok(batch
+            .iter()
+            .zip(elapsed)
+            .map(|(baked, elapsed)| TriggerTiming {
+                name: baked.name.clone(),
+                elapsed,
+            })
+            .collect())
     }
 }
 
+/// Execute a batch within `isolation`
+///
+/// The batch runs in the container's own process, so the time taken by each
+/// trigger is sent back over a pipe.
+fn execute_isolated(isolation: Container, batch: &[Baked]) -> Result<Vec<Duration>, Error> {
+    let (mut reader, writer) = io::pipe()?;
+
+    isolation.run(|| {
+        let mut writer = &writer;
+        for elapsed in execute_batch(batch)? {
+            writer.write_all(&(elapsed.as_nanos() as u64).to_le_bytes())?;
+        }
+        Ok::<_, Error>(())
+    })?;
+
+    // The container is gone, so closing our end is all that's left before EOF
+    drop(writer);
+    let mut bytes = vec![];
+    reader.read_to_end(&mut bytes)?;
+
+    Ok(bytes
+        .as_chunks()
+        .0
+        .iter()
+        .map(|nanos| Duration::from_nanos(u64::from_le_bytes(*nanos)))
+        .collect())
+}
+
+/// Execute each trigger of the batch on its own thread, returning the time each took
+fn execute_batch(batch: &[Baked]) -> Result<Vec<Duration>, Error> {
+    thread::scope(|scope| {
+        let handles = batch
+            .iter()
+            .map(|baked| {
+                scope.spawn(|| {
+                    let started = Instant::now();
+                    for handler in &baked.handlers {
+                        execute_trigger_directly(handler)?;
+                    }
+                    Ok(started.elapsed())
+                })
+            })
+            .collect_vec();
+
+        handles
+            .into_iter()
+            .map(|handle| handle.join().unwrap_or_else(|panic| std::panic::resume_unwind(panic)))
+            .collect()
+    })
+}
+
 /// Internal executor for triggers.
 fn execute_trigger_directly(trigger: &CompiledHandler) -> Result<(), Error> {
     match trigger.handler() {
@@ -27,7 +27,7 @@ use tui::{
     pretty::autoprint_columns,
 };
 
-use crate::client::boot;
+use crate::client::{asset_index::AssetIndex, boot, tree_cache};
 use crate::util;
 use crate::{Client, Installation, State, client::cache, db, package, repository, state};
 
@@ -165,6 +165,7 @@ pub(super) fn prune_states(client: &Client, strategy: Strategy<'_>, yes: bool) -
 
     // Prune these states / packages from all dbs
     prune_databases(&removals, &package_removals, state_db, install_db, layout_db)?;
+    tree_cache::remove(installation, removals.iter().map(|s| s.id))?;
 
     timing.prune_db = instant.elapsed();
     info!(
@@ -178,20 +179,13 @@ pub(super) fn prune_states(client: &Client, strategy: Strategy<'_>, yes: bool) -
         // root
         installation.cache_path("downloads").join("v1"),
         // final set of hashes to compare against
-        install_db.file_hashes()?,
+        is_download_referenced(install_db.file_hashes()?),
         // path builder using hash
         |hash| cache::download_path(installation, &hash).ok(),
     )?;
 
     // Remove orphaned assets
-    remove_orphaned_files(
-        // root
-        installation.assets_path("v2"),
-        // final set of hashes to compare against
-        layout_db.file_hashes()?,
-        // path builder using hash
-        |hash| Some(cache::asset_path(installation, &hash)),
-    )?;
+    remove_orphaned_assets(installation, layout_db)?;
 
     timing.orphaned_files = instant.elapsed();
     info!(
@@ -293,20 +287,13 @@ pub(super) fn prune_cache(
             // root
             installation.cache_path("downloads").join("v1"),
             // final set of hashes to compare against
-            install_db.file_hashes()?,
+            is_download_referenced(install_db.file_hashes()?),
             // path builder using hash
             |hash| cache::download_path(installation, &hash).ok(),
         )?;
 
         // Remove orphaned assets (unpacked package assets in CAS)
-        num_removed_files += remove_orphaned_files(
-            // root
-            installation.assets_path("v2"),
-            // final set of hashes to compare against
-            layout_db.file_hashes()?,
-            // path builder using hash
-            |hash| Some(cache::asset_path(installation, &hash)),
-        )?;
+        num_removed_files += remove_orphaned_assets(installation, layout_db)?;
     }
 
     Ok(num_removed_files)
@@ -340,20 +327,20 @@ fn prune_databases(
     Ok(())
 }
 
-/// Removes all files under `root` that no longer exist in the provided `final_hashes` set
+/// Removes all files under `root` whose hash isn't part of the final set, per `is_referenced`
 fn remove_orphaned_files(
     root: PathBuf,
-    final_hashes: BTreeSet<String>,
+    is_referenced: impl Fn(&str) -> bool,
     compute_path: impl Fn(String) -> Option<PathBuf>,
 ) -> Result<usize, Error> {
     // Compute hashes to remove by (installed - final)
     let installed_hashes = enumerate_file_hashes(&root)?;
-    let hashes_to_remove = installed_hashes.difference(&final_hashes);
+    let hashes_to_remove = installed_hashes.into_iter().filter(|hash| !is_referenced(hash));
 
     // Remove each and it's parent dir if empty
     hashes_to_remove.into_iter().try_fold(0, |acc, hash| {
         // Compute path to file using hash
-        let Some(file) = compute_path(hash.clone()) else {
+        let Some(file) = compute_path(hash) else {
             return Ok(acc);
         };
         let partial = file.with_added_extension("part");
@@ -378,6 +365,36 @@ fn remove_orphaned_files(
     })
 }
 
+/// Removes all assets no longer referenced by the layout db, along with their
+/// entries in the [`AssetIndex`]
+fn remove_orphaned_assets(installation: &Installation, layout_db: &db::layout::Database) -> Result<usize, Error> {
+    let hashes = layout_db.file_hashes()?;
+    let asset_index = AssetIndex::open(installation);
+
+    asset_index.retain(|hash| hashes.contains(&hash));
+    asset_index.save()?;
+
+    remove_orphaned_files(
+        // root
+        installation.assets_path("v2"),
+        // final set of hashes to compare against
+        is_asset_referenced(hashes),
+        // path builder using hash
+        |hash| Some(cache::asset_path(installation, &hash)),
+    )
+}
+
+/// Match download file names against the `hashes` of the install db
+fn is_download_referenced(hashes: BTreeSet<String>) -> impl Fn(&str) -> bool {
+    move |name| hashes.contains(name)
+}
+
+/// Match asset file names against the `hashes` of the layout db, anything
+/// that isn't a hash isn't referenced either
+fn is_asset_referenced(hashes: BTreeSet<u128>) -> impl Fn(&str) -> bool {
+    move |name| u128::from_str_radix(name, 16).is_ok_and(|hash| hashes.contains(&hash))
+}
+
 /// Returns all nested files under `root` and parses the file name as a hash
 fn enumerate_file_hashes(root: impl AsRef<Path>) -> io::Result<BTreeSet<String>> {
     let files = enumerate_files(root)?;
@@ -160,9 +160,10 @@ pub fn remove(client: &mut Client, pkgs: &[&str], yes: bool, simulate: bool) ->
     };
 
     // Apply state
-    client.new_state(&new_state_pkgs, "Remove")?;
+    let applied = client.new_state(&new_state_pkgs, "Remove")?;
 
     timing.blit = instant.elapsed();
+    timing.triggers = applied.triggers;
 
     info!(
         blit_time_ms = timing.blit.as_millis(),
@@ -202,4 +203,6 @@ pub enum Error {
 pub struct Timing {
     pub resolve: Duration,
     pub blit: Duration,
+    /// Time taken by each trigger, part of `blit`
+    pub triggers: Vec<client::TriggerTiming>,
 }
@@ -202,9 +202,10 @@ pub fn sync(client: &Client, yes: bool, simulate: bool) -> Result<Timing, Error>
     };
 
     // Perfect, apply state.
-    client.new_state(&new_selections, "Sync")?;
+    let applied = client.new_state(&new_selections, "Sync")?;
 
     timing.blit = instant.elapsed();
+    timing.triggers = applied.triggers;
 
     info!(
         blit_time_ms = timing.blit.as_millis(),
@@ -288,6 +289,8 @@ pub struct Timing {
     pub resolve: Duration,
     pub fetch: Duration,
     pub blit: Duration,
+    /// Time taken by each trigger, part of `blit`
+    pub triggers: Vec<client::TriggerTiming>,
 }
 
 #[derive(Debug, Error)]
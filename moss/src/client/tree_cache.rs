@@ -0,0 +1,374 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+//! On disk copy of the [`vfs::Tree`] of each state
+//!
+//! A state's selections never change once it's recorded, so neither does its
+//! tree. Rebuilding it means querying every layout of every package from the
+//! layout db & resolving them all again, so the tree is written out once when
+//! the state is created and mapped back in whenever the state is blitted,
+//! verified or has its system triggers run.
+//!
+//! All integers are little endian, the file being laid out as:
+//!
+//! - header: magic, version, node count, string count, string bytes length
+//!   and the key of the selections the tree was built from
+//! - nodes: fixed size records in depth first order, each pointing at its
+//!   parent node & its strings by index
+//! - string offsets: `count + 1` offsets into the string bytes
+//! - string bytes: every package id, path & symlink source, stored once
+
+use std::{
+    collections::HashMap,
+    io::{self, Write as _},
+    path::PathBuf,
+};
+
+use astr::AStr;
+use fs_err as fs;
+use stone::{StonePayloadLayoutFile, StonePayloadLayoutFileType, StonePayloadLayoutRecord};
+use xxhash_rust::xxh3::Xxh3;
+
+use crate::{Installation, State, client::PendingFile, state, util::Mapping};
+
+const MAGIC: [u8; 8] = *b"mossvfs\0";
+const VERSION: u32 = 1;
+
+const HEADER_SIZE: usize = 40;
+const NODE_SIZE: usize = 56;
+
+/// Index of an absent parent or string
+const NONE: u32 = u32::MAX;
+
+/// Path of the cached tree for `state`
+pub fn path(installation: &Installation, state: state::Id) -> PathBuf {
+    installation.db_path("vfs").join(state.to_string())
+}
+
+/// Write `tree` as the cached tree of `state`
+pub fn write(installation: &Installation, state: &State, tree: &vfs::Tree<PendingFile>) -> io::Result<()> {
+    let mut strings = Strings::new();
+    let mut nodes = Vec::with_capacity(tree.len() as usize * NODE_SIZE);
+
+    for (file, parent) in tree.nodes() {
+        let (hash, source, target) = match &file.layout.file {
+            StonePayloadLayoutFile::Regular(hash, target) => (*hash, NONE, target),
+            StonePayloadLayoutFile::Symlink(source, target) | StonePayloadLayoutFile::Unknown(source, target) => {
+                (0, strings.intern(source), target)
+            }
+            StonePayloadLayoutFile::Directory(target)
+            | StonePayloadLayoutFile::CharacterDevice(target)
+            | StonePayloadLayoutFile::BlockDevice(target)
+            | StonePayloadLayoutFile::Fifo(target)
+            | StonePayloadLayoutFile::Socket(target) => (0, NONE, target),
+        };
+
+        nodes.extend_from_slice(&hash.to_le_bytes());
+        for field in [
+            parent.map_or(NONE, |parent| parent as u32),
+            strings.intern(file.id.as_str()),
+            strings.intern(target),
+            source,
+            file.layout.uid,
+            file.layout.gid,
+            file.layout.mode,
+            file.layout.tag,
+        ] {
+            nodes.extend_from_slice(&field.to_le_bytes());
+        }
+        nodes.extend_from_slice(&[file.layout.file.file_type() as u8, 0, 0, 0, 0, 0, 0, 0]);
+    }
+
+    let mut header = Vec::with_capacity(HEADER_SIZE);
+    header.extend_from_slice(&MAGIC);
+    for field in [
+        VERSION,
+        (nodes.len() / NODE_SIZE) as u32,
+        strings.offsets.len() as u32 - 1,
+        strings.bytes.len() as u32,
+    ] {
+        header.extend_from_slice(&field.to_le_bytes());
+    }
+    header.extend_from_slice(&key(state).to_le_bytes());
+
+    let path = path(installation, state.id);
+    let partial = path.with_extension("part");
+
+    fs::create_dir_all(installation.db_path("vfs"))?;
+
+    let mut file = io::BufWriter::new(fs::File::create(&partial)?);
+    file.write_all(&header)?;
+    file.write_all(&nodes)?;
+    for offset in &strings.offsets {
+        file.write_all(&offset.to_le_bytes())?;
+    }
+    file.write_all(&strings.bytes)?;
+    file.into_inner().map_err(io::IntoInnerError::into_error)?;
+
+    // Readers must never see a partially written tree
+    fs::rename(partial, path)
+}
+
+/// Load the cached tree of `state`
+///
+/// Returns `None` if there is no cached tree, or it wasn't built from the
+/// current selections of `state`.
+pub fn read(installation: &Installation, state: &State) -> io::Result<Option<vfs::Tree<PendingFile>>> {
+    let file = match fs::File::open(path(installation, state.id)) {
+        Ok(file) => file,
+        Err(error) if error.kind() == io::ErrorKind::NotFound => return Ok(None),
+        Err(error) => return Err(error),
+    };
+    // SAFETY: Cached trees are only ever replaced by renaming over them, see `write`
+    let mapping = unsafe { Mapping::new(file.file())? };
+    let bytes = mapping.as_slice();
+
+    if bytes.get(..MAGIC.len()) != Some(&MAGIC) || u32_at(bytes, 8)? != VERSION {
+        return Ok(None);
+    }
+    if u128_at(bytes, 24)? != key(state) {
+        return Ok(None);
+    }
+
+    let num_nodes = u32_at(bytes, 12)? as usize;
+    let num_strings = u32_at(bytes, 16)? as usize;
+    let strings_len = u32_at(bytes, 20)? as usize;
+
+    let offsets_start = HEADER_SIZE + num_nodes * NODE_SIZE;
+    let strings_start = offsets_start + (num_strings + 1) * 4;
+
+    if bytes.len() != strings_start + strings_len {
+        return Err(invalid("truncated"));
+    }
+
+    let string_bytes = &bytes[strings_start..];
+    let strings = (0..num_strings)
+        .map(|index| {
+            let start = u32_at(bytes, offsets_start + index * 4)? as usize;
+            let end = u32_at(bytes, offsets_start + (index + 1) * 4)? as usize;
+
+            let string = string_bytes
+                .get(start..end)
+                .ok_or_else(|| invalid("string out of bounds"))?;
+            let string = std::str::from_utf8(string).map_err(|_| invalid("string isn't utf-8"))?;
+
+            Ok(AStr::from(string))
+        })
+        .collect::<io::Result<Vec<_>>>()?;
+
+    let string = |index: u32| {
+        strings
+            .get(index as usize)
+            .cloned()
+            .ok_or_else(|| invalid("unknown string"))
+    };
+
+    let nodes = bytes[HEADER_SIZE..offsets_start]
+        .chunks_exact(NODE_SIZE)
+        .map(|node| {
+            let field = |index: usize| u32_at(node, 16 + index * 4);
+
+            let parent = field(0)?;
+            let target = string(field(2)?)?;
+            let source = || string(field(3)?);
+
+            let file = match file_type(node[48]) {
+                StonePayloadLayoutFileType::Regular => StonePayloadLayoutFile::Regular(u128_at(node, 0)?, target),
+                StonePayloadLayoutFileType::Symlink => StonePayloadLayoutFile::Symlink(source()?, target),
+                StonePayloadLayoutFileType::Directory => StonePayloadLayoutFile::Directory(target),
+                StonePayloadLayoutFileType::CharacterDevice => StonePayloadLayoutFile::CharacterDevice(target),
+                StonePayloadLayoutFileType::BlockDevice => StonePayloadLayoutFile::BlockDevice(target),
+                StonePayloadLayoutFileType::Fifo => StonePayloadLayoutFile::Fifo(target),
+                StonePayloadLayoutFileType::Socket => StonePayloadLayoutFile::Socket(target),
+                StonePayloadLayoutFileType::Unknown => StonePayloadLayoutFile::Unknown(source()?, target),
+            };
+
+            let pending = PendingFile {
+                id: string(field(1)?)?.into(),
+                layout: StonePayloadLayoutRecord {
+                    uid: field(4)?,
+                    gid: field(5)?,
+                    mode: field(6)?,
+                    tag: field(7)?,
+                    file,
+                },
+            };
+
+            Ok((pending, (parent != NONE).then_some(parent as usize)))
+        })
+        .collect::<io::Result<Vec<_>>>()?;
+
+    vfs::Tree::from_nodes(nodes)
+        .map(Some)
+        .map_err(|error| invalid(&error.to_string()))
+}
+
+/// Remove the cached trees of `states`
+pub fn remove(installation: &Installation, states: impl IntoIterator<Item = state::Id>) -> io::Result<()> {
+    for state in states {
+        match fs::remove_file(path(installation, state)) {
+            Err(error) if error.kind() != io::ErrorKind::NotFound => return Err(error),
+            _ => {}
+        }
+    }
+
+    Ok(())
+}
+
+/// Identify the selections of `state`, so a tree cached for a state id
+/// that has since been reused is never loaded
+fn key(state: &State) -> u128 {
+    let mut packages = state.selections.iter().map(|s| s.package.as_str()).collect::<Vec<_>>();
+    packages.sort_unstable();
+
+    let mut hasher = Xxh3::new();
+    for package in packages {
+        hasher.update(package.as_bytes());
+        hasher.update(&[0]);
+    }
+    hasher.digest128()
+}
+
+fn file_type(kind: u8) -> StonePayloadLayoutFileType {
+    match kind {
+        1 => StonePayloadLayoutFileType::Regular,
+        2 => StonePayloadLayoutFileType::Symlink,
+        3 => StonePayloadLayoutFileType::Directory,
+        4 => StonePayloadLayoutFileType::CharacterDevice,
+        5 => StonePayloadLayoutFileType::BlockDevice,
+        6 => StonePayloadLayoutFileType::Fifo,
+        7 => StonePayloadLayoutFileType::Socket,
+        _ => StonePayloadLayoutFileType::Unknown,
+    }
+}
+
+fn u32_at(bytes: &[u8], offset: usize) -> io::Result<u32> {
+    let bytes = bytes.get(offset..offset + 4).ok_or_else(|| invalid("truncated"))?;
+    Ok(u32::from_le_bytes(bytes.try_into().unwrap()))
+}
+
+fn u128_at(bytes: &[u8], offset: usize) -> io::Result<u128> {
+    let bytes = bytes.get(offset..offset + 16).ok_or_else(|| invalid("truncated"))?;
+    Ok(u128::from_le_bytes(bytes.try_into().unwrap()))
+}
+
+fn invalid(reason: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, format!("invalid vfs cache: {reason}"))
+}
+
+/// Interned string table, each distinct string stored once
+struct Strings<'a> {
+    indices: HashMap<&'a str, u32>,
+    offsets: Vec<u32>,
+    bytes: Vec<u8>,
+}
+
+impl<'a> Strings<'a> {
+    fn new() -> Self {
+        Self {
+            indices: HashMap::new(),
+            offsets: vec![0],
+            bytes: vec![],
+        }
+    }
+
+    fn intern(&mut self, string: &'a str) -> u32 {
+        *self.indices.entry(string).or_insert_with(|| {
+            self.bytes.extend_from_slice(string.as_bytes());
+            self.offsets.push(self.bytes.len() as u32);
+            self.offsets.len() as u32 - 2
+        })
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use chrono::Utc;
+
+    use super::*;
+    use crate::{package, state::Selection};
+
+    fn layout(package: &str, mode: u32, file: StonePayloadLayoutFile) -> (package::Id, StonePayloadLayoutRecord) {
+        let record = StonePayloadLayoutRecord {
+            uid: 0,
+            gid: 0,
+            mode,
+            tag: 0,
+            file,
+        };
+
+        (package.to_owned().into(), record)
+    }
+
+    fn state(packages: &[&str]) -> State {
+        State {
+            id: 1.into(),
+            summary: None,
+            description: None,
+            selections: packages
+                .iter()
+                .map(|package| Selection::explicit(package.to_string().into()))
+                .collect(),
+            created: Utc::now(),
+            kind: state::Kind::Transaction,
+        }
+    }
+
+    #[test]
+    fn round_trip() {
+        let dir = tempfile::tempdir().unwrap();
+        let installation = Installation::open(dir.path(), None).unwrap();
+
+        let tree = crate::client::vfs(vec![
+            layout(
+                "nano",
+                0o100755,
+                StonePayloadLayoutFile::Regular(0x1234 << 64, "bin/nano".into()),
+            ),
+            layout(
+                "nano",
+                0o120777,
+                StonePayloadLayoutFile::Symlink("nano".into(), "bin/rnano".into()),
+            ),
+            layout("nano", 0o040700, StonePayloadLayoutFile::Directory("share/nano".into())),
+            layout(
+                "baselayout",
+                0o120777,
+                StonePayloadLayoutFile::Symlink("lib".into(), "lib64".into()),
+            ),
+            layout("baselayout", 0o040755, StonePayloadLayoutFile::Directory("lib".into())),
+            layout(
+                "zlib",
+                0o100644,
+                StonePayloadLayoutFile::Regular(0x5678, "lib64/libz.so.1".into()),
+            ),
+            layout(
+                "zlib",
+                0o020644,
+                StonePayloadLayoutFile::CharacterDevice("lib/dev".into()),
+            ),
+        ])
+        .unwrap();
+
+        let state = state(&["nano", "baselayout", "zlib"]);
+        write(&installation, &state, &tree).unwrap();
+
+        let cached = read(&installation, &state).unwrap().unwrap();
+
+        let files = |tree: &vfs::Tree<PendingFile>| {
+            tree.iter()
+                .map(|file| (file.id.clone(), file.layout.clone()))
+                .collect::<Vec<_>>()
+        };
+        let parents = |tree: &vfs::Tree<PendingFile>| tree.nodes().map(|(_, parent)| parent).collect::<Vec<_>>();
+
+        assert_eq!(files(&cached), files(&tree));
+        assert_eq!(parents(&cached), parents(&tree));
+
+        // Same id, different selections
+        assert!(read(&installation, &self::state(&["nano"])).unwrap().is_none());
+
+        remove(&installation, [state.id]).unwrap();
+        assert!(read(&installation, &state).unwrap().is_none());
+    }
+}
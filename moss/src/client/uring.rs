@@ -0,0 +1,653 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+//! io_uring backend for [`super::blit_root`]
+//!
+//! Each directory is created by a `mkdirat`, once complete followed by the
+//! `openat` yielding the fd its children are created against, while files are
+//! hardlinked from the asset store and symlinks created alongside. Everything
+//! is submitted in batches from one thread and run in parallel by the kernel's
+//! io_uring workers. io_uring has no `fchmodat`, so the permissions of hardlinks
+//! are fixed in batches on a few local threads while the next submission runs.
+
+use std::{
+    cell::Cell,
+    ffi::{CString, c_void},
+    io,
+    os::fd::{AsRawFd, BorrowedFd, FromRawFd, OwnedFd, RawFd},
+    ptr,
+    rc::Rc,
+    sync::atomic::{AtomicU32, Ordering},
+};
+
+use nix::{
+    errno::Errno,
+    sys::stat::{FchmodatFlags, Mode, fchmodat},
+};
+use rayon::iter::{IntoParallelIterator, ParallelIterator};
+use rustix::{
+    fs::{AtFlags, OFlags},
+    io_uring::{
+        IORING_OFF_SQ_RING, IORING_OFF_SQES, IoringEnterFlags, IoringFeatureFlags, IoringOp, IoringOpFlags,
+        IoringRegisterOp, io_uring_cqe, io_uring_enter, io_uring_params, io_uring_probe, io_uring_probe_op,
+        io_uring_ptr, io_uring_register, io_uring_setup, io_uring_sqe, io_uring_user_data,
+    },
+    mm::{MapFlags, ProtFlags, mmap, munmap},
+};
+use stone::StonePayloadLayoutFile;
+use tracing::debug;
+use tui::ProgressBar;
+use vfs::tree::Element;
+
+use super::{BlitStats, EMPTY_FILE_HASH, Error, PendingFile, asset_path, report_progress};
+use crate::metrics::{self, Syscall};
+
+/// Submission slots, and so the most operations in flight at once
+const ENTRIES: u32 = 256;
+
+/// Directories held open while their children are created
+const MAX_OPEN_DIRS: usize = 256;
+
+/// Threads fixing the permissions of hardlinks, few as the ring does the rest
+const CHMOD_THREADS: usize = 4;
+
+/// Operations the backend needs, all available since Linux 5.15
+const OPS: &[IoringOp] = &[
+    IoringOp::Mkdirat,
+    IoringOp::Openat,
+    IoringOp::Linkat,
+    IoringOp::Symlinkat,
+];
+
+/// Blit `children` into `root`, as [`super::blit_threaded`] would
+pub fn blit(
+    ring: Ring,
+    root: RawFd,
+    cache: RawFd,
+    children: Vec<Element<'_, PendingFile>>,
+    progress: &ProgressBar,
+) -> Result<BlitStats, Error> {
+    let open_dirs = Rc::new(Cell::new(0));
+
+    let root = rustix::io::fcntl_dupfd_cloexec(unsafe { BorrowedFd::borrow_raw(root) }, 0).map_err(io::Error::from)?;
+    let root = Rc::new(Dir {
+        fd: root,
+        _ticket: Ticket::new(&open_dirs),
+    });
+
+    // As with the threaded backend, don't leave a pool lingering after blitting
+    let pool = rayon::ThreadPoolBuilder::new()
+        .num_threads(CHMOD_THREADS)
+        .build()
+        .expect("rayon runtime");
+
+    let mut blitter = Blitter {
+        ring,
+        pool,
+        cache,
+        progress,
+        open_dirs,
+        ops: vec![],
+        free: vec![],
+        in_flight: 0,
+        chmods: vec![],
+        // Worked through as a stack so subtrees finish, and close their
+        // directories, before their siblings are started
+        queue: children.into_iter().rev().map(|child| (root.clone(), child)).collect(),
+        stats: BlitStats::default(),
+    };
+    drop(root);
+
+    blitter.run()?;
+
+    Ok(blitter.stats)
+}
+
+struct Blitter<'a> {
+    ring: Ring,
+    pool: rayon::ThreadPool,
+    cache: RawFd,
+    progress: &'a ProgressBar,
+    open_dirs: Rc<Cell<usize>>,
+    /// Operations in flight, indexed by their user data
+    ops: Vec<Option<Op<'a>>>,
+    free: Vec<usize>,
+    in_flight: u32,
+    /// Hardlinks created whose permissions still need fixing
+    chmods: Vec<(Rc<Dir>, CString, u32)>,
+    queue: Vec<(Rc<Dir>, Element<'a, PendingFile>)>,
+    stats: BlitStats,
+}
+
+impl<'a> Blitter<'a> {
+    fn run(&mut self) -> Result<(), Error> {
+        let mut failure = None;
+
+        loop {
+            // Stop queueing work on failure, only waiting for what's in flight
+            while failure.is_none() && self.in_flight < ENTRIES {
+                let Some((_, next)) = self.queue.last() else {
+                    break;
+                };
+
+                // Wait for some to close before opening more directories
+                if matches!(next, Element::Directory(..)) && self.open_dirs.get() >= MAX_OPEN_DIRS && self.in_flight > 0
+                {
+                    break;
+                }
+
+                let (parent, element) = self.queue.pop().expect("queue entry");
+
+                if let Err(error) = self.prepare(parent, element) {
+                    failure = Some(error);
+                }
+            }
+
+            if self.in_flight == 0 {
+                break;
+            }
+
+            // Submitted entries still use the fds & names held by `self`, so
+            // errors only stop queueing more while those in flight are reaped
+            if let Err(error) = self.ring.submit() {
+                failure.get_or_insert(error.into());
+            }
+
+            // Keep the kernel busy while the previous completions are finished off here
+            if let Err(error) = self.fix_permissions() {
+                failure.get_or_insert(error);
+            }
+
+            // Never seen by the kernel, so nothing is left to wait for
+            if self.in_flight == self.ring.pending {
+                break;
+            }
+
+            if let Err(error) = self.ring.wait() {
+                failure.get_or_insert(error.into());
+            }
+
+            while let Some((user_data, result)) = self.ring.complete() {
+                if let Err(error) = self.complete(user_data as usize, result) {
+                    failure.get_or_insert(error);
+                }
+            }
+        }
+
+        if let Err(error) = self.fix_permissions() {
+            failure.get_or_insert(error);
+        }
+
+        failure.map_or(Ok(()), Err)
+    }
+
+    /// `fchmodat` every hardlink created since the last call, in parallel
+    fn fix_permissions(&mut self) -> Result<(), Error> {
+        let chmods = std::mem::take(&mut self.chmods);
+
+        // Directories stay open until every chmod against them is done
+        let pending = chmods
+            .iter()
+            .map(|(parent, name, mode)| (parent.fd.as_raw_fd(), name.as_c_str(), *mode))
+            .collect::<Vec<_>>();
+
+        self.pool.install(|| {
+            pending.into_par_iter().try_for_each(|(parent, name, mode)| {
+                metrics::syscall(Syscall::Fchmodat, || {
+                    fchmodat(
+                        Some(parent),
+                        name,
+                        Mode::from_bits_truncate(mode),
+                        FchmodatFlags::NoFollowSymlink,
+                    )
+                })
+            })
+        })?;
+
+        Ok(())
+    }
+
+    /// Queue the operations creating `element` within `parent`
+    fn prepare(&mut self, parent: Rc<Dir>, element: Element<'a, PendingFile>) -> Result<(), Error> {
+        let (Element::Directory(name, item, _) | Element::Child(name, item)) = &element;
+        report_progress(self.progress, item);
+
+        let name = CString::new(*name).map_err(|_| Errno::EINVAL)?;
+        let mode = item.layout.mode;
+
+        match element {
+            Element::Directory(_, _, children) => {
+                let mut mkdir = sqe(IoringOp::Mkdirat, parent.fd.as_raw_fd(), &name);
+                mkdir.len.len = mode;
+
+                // Opened by `complete` once created. Linking the two would
+                // cancel the `openat` whenever the `mkdirat` fails, even with
+                // `EEXIST`, and a partial submission could split the pair.
+                let ticket = Ticket::new(&self.open_dirs);
+
+                self.push(
+                    mkdir,
+                    Op::MkdirOpen {
+                        parent,
+                        name,
+                        children,
+                        ticket,
+                    },
+                );
+            }
+            Element::Child(_, item) => match &item.layout.file {
+                StonePayloadLayoutFile::Regular(EMPTY_FILE_HASH, _) => {
+                    let mut create = sqe(IoringOp::Openat, parent.fd.as_raw_fd(), &name);
+                    create.len.len = mode;
+                    create.op_flags.open_flags = OFlags::CREATE | OFlags::WRONLY | OFlags::TRUNC | OFlags::CLOEXEC;
+
+                    self.push(
+                        create,
+                        Op::Create {
+                            _parent: parent,
+                            _name: name,
+                        },
+                    );
+                }
+                StonePayloadLayoutFile::Regular(id, _) => {
+                    let source = CString::new(asset_path(*id).into_os_string().into_encoded_bytes())
+                        .map_err(|_| Errno::EINVAL)?;
+
+                    let mut link = sqe(IoringOp::Linkat, self.cache, &source);
+                    link.len.len = parent.fd.as_raw_fd() as u32;
+                    link.off_or_addr2.addr2 = io_uring_ptr::new(name.as_ptr().cast_mut().cast());
+                    link.op_flags.hardlink_flags = AtFlags::empty();
+
+                    self.push(
+                        link,
+                        Op::Link {
+                            parent,
+                            name,
+                            _source: source,
+                            mode,
+                        },
+                    );
+                }
+                StonePayloadLayoutFile::Symlink(target, _) => {
+                    let target = CString::new(target.as_str()).map_err(|_| Errno::EINVAL)?;
+
+                    let mut symlink = sqe(IoringOp::Symlinkat, parent.fd.as_raw_fd(), &target);
+                    symlink.off_or_addr2.addr2 = io_uring_ptr::new(name.as_ptr().cast_mut().cast());
+
+                    self.push(
+                        symlink,
+                        Op::Symlink {
+                            _parent: parent,
+                            _name: name,
+                            _target: target,
+                        },
+                    );
+                }
+                StonePayloadLayoutFile::Directory(_) => {
+                    let mut mkdir = sqe(IoringOp::Mkdirat, parent.fd.as_raw_fd(), &name);
+                    mkdir.len.len = mode;
+
+                    self.push(
+                        mkdir,
+                        Op::Mkdir {
+                            _parent: parent,
+                            _name: name,
+                        },
+                    );
+                }
+
+                // Unimplemented
+                StonePayloadLayoutFile::CharacterDevice(_)
+                | StonePayloadLayoutFile::BlockDevice(_)
+                | StonePayloadLayoutFile::Fifo(_)
+                | StonePayloadLayoutFile::Socket(_)
+                | StonePayloadLayoutFile::Unknown(..) => {}
+            },
+        }
+
+        Ok(())
+    }
+
+    fn push(&mut self, mut sqe: io_uring_sqe, op: Op<'a>) {
+        let index = match self.free.pop() {
+            Some(index) => {
+                self.ops[index] = Some(op);
+                index
+            }
+            None => {
+                self.ops.push(Some(op));
+                self.ops.len() - 1
+            }
+        };
+
+        sqe.user_data = io_uring_user_data::from_u64(index as u64);
+
+        // Safety: `op` owns every path the entry points to until it completes
+        // and `run` never has more entries in flight than the ring has slots
+        unsafe { self.ring.push(sqe) };
+        self.in_flight += 1;
+    }
+
+    fn complete(&mut self, index: usize, result: i32) -> Result<(), Error> {
+        let op = self.ops[index].take().expect("operation in flight");
+        self.free.push(index);
+        self.in_flight -= 1;
+
+        // Directories already present are reused, as their children are still created
+        if let Op::MkdirOpen {
+            parent,
+            name,
+            children,
+            ticket,
+        } = op
+        {
+            if result < 0 && result != -(Errno::EEXIST as i32) {
+                return Err(Errno::from_i32(-result).into());
+            }
+            if result == 0 {
+                self.stats.num_dirs += 1;
+            }
+
+            let mut open = sqe(IoringOp::Openat, parent.fd.as_raw_fd(), &name);
+            open.op_flags.open_flags = OFlags::RDONLY | OFlags::DIRECTORY | OFlags::CLOEXEC;
+
+            self.push(
+                open,
+                Op::Open {
+                    _parent: parent,
+                    _name: name,
+                    children,
+                    ticket,
+                },
+            );
+
+            return Ok(());
+        }
+
+        if result < 0 {
+            return Err(Errno::from_i32(-result).into());
+        }
+
+        match op {
+            Op::Mkdir { .. } => self.stats.num_dirs += 1,
+            // Handled above
+            Op::MkdirOpen { .. } => {}
+            Op::Open { children, ticket, .. } => {
+                let dir = Rc::new(Dir {
+                    fd: unsafe { OwnedFd::from_raw_fd(result) },
+                    _ticket: ticket,
+                });
+
+                self.queue
+                    .extend(children.into_iter().rev().map(|child| (dir.clone(), child)));
+            }
+            Op::Create { .. } => {
+                drop(unsafe { OwnedFd::from_raw_fd(result) });
+                self.stats.num_files += 1;
+            }
+            Op::Link { parent, name, mode, .. } => {
+                self.chmods.push((parent, name, mode));
+                self.stats.num_files += 1;
+            }
+            Op::Symlink { .. } => self.stats.num_symlinks += 1,
+        }
+
+        Ok(())
+    }
+}
+
+/// An operation in flight, owning everything its entry points to
+enum Op<'a> {
+    Mkdir {
+        _parent: Rc<Dir>,
+        _name: CString,
+    },
+    /// Directory with children, opened once created
+    MkdirOpen {
+        parent: Rc<Dir>,
+        name: CString,
+        children: Vec<Element<'a, PendingFile>>,
+        ticket: Ticket,
+    },
+    Open {
+        _parent: Rc<Dir>,
+        _name: CString,
+        children: Vec<Element<'a, PendingFile>>,
+        ticket: Ticket,
+    },
+    Create {
+        _parent: Rc<Dir>,
+        _name: CString,
+    },
+    Link {
+        parent: Rc<Dir>,
+        name: CString,
+        _source: CString,
+        mode: u32,
+    },
+    Symlink {
+        _parent: Rc<Dir>,
+        _name: CString,
+        _target: CString,
+    },
+}
+
+/// A staged directory, closed once every child has been created
+struct Dir {
+    fd: OwnedFd,
+    _ticket: Ticket,
+}
+
+/// Counts a directory as open from queueing its `openat` until it's closed
+struct Ticket(Rc<Cell<usize>>);
+
+impl Ticket {
+    fn new(open: &Rc<Cell<usize>>) -> Self {
+        open.set(open.get() + 1);
+        Self(open.clone())
+    }
+}
+
+impl Drop for Ticket {
+    fn drop(&mut self) {
+        self.0.set(self.0.get() - 1);
+    }
+}
+
+fn sqe(opcode: IoringOp, fd: RawFd, path: &CString) -> io_uring_sqe {
+    let mut sqe = io_uring_sqe::default();
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr_or_splice_off_in.addr = io_uring_ptr::new(path.as_ptr().cast_mut().cast());
+    sqe
+}
+
+/// A minimal io_uring instance, only exposing what blitting needs
+pub struct Ring {
+    fd: OwnedFd,
+    _ring: Mapping,
+    sqes: Mapping,
+    sq_tail: *const AtomicU32,
+    sq_mask: u32,
+    sq_array: *mut u32,
+    cq_head: *const AtomicU32,
+    cq_tail: *const AtomicU32,
+    cq_mask: u32,
+    cqes: *const io_uring_cqe,
+    tail: u32,
+    /// Entries pushed but not yet consumed by the kernel
+    pending: u32,
+}
+
+impl Ring {
+    /// Set up a ring for blitting, or `None` if io_uring is unsupported,
+    /// disabled or lacks any of the operations needed
+    pub fn new() -> Option<Self> {
+        match Self::setup() {
+            Ok(Some(ring)) => Some(ring),
+            Ok(None) => {
+                debug!("io_uring lacks blit operations, falling back to threaded blit");
+                None
+            }
+            Err(error) => {
+                debug!(%error, "io_uring unavailable, falling back to threaded blit");
+                None
+            }
+        }
+    }
+
+    fn setup() -> io::Result<Option<Self>> {
+        let mut params = io_uring_params::default();
+        let fd = unsafe { io_uring_setup(ENTRIES, &mut params)? };
+
+        // Predates every op we need, only older kernels map the rings separately
+        if !params.features.contains(IoringFeatureFlags::SINGLE_MMAP) {
+            return Ok(None);
+        }
+
+        let sq_len = params.sq_off.array as usize + params.sq_entries as usize * size_of::<u32>();
+        let cq_len = params.cq_off.cqes as usize + params.cq_entries as usize * size_of::<io_uring_cqe>();
+        let ring = Mapping::new(&fd, sq_len.max(cq_len), IORING_OFF_SQ_RING)?;
+        let sqes = Mapping::new(
+            &fd,
+            params.sq_entries as usize * size_of::<io_uring_sqe>(),
+            IORING_OFF_SQES,
+        )?;
+
+        let at = |offset: u32| unsafe { ring.ptr.byte_add(offset as usize) };
+
+        let ring = unsafe {
+            Self {
+                sq_tail: at(params.sq_off.tail).cast(),
+                sq_mask: *at(params.sq_off.ring_mask).cast::<u32>(),
+                sq_array: at(params.sq_off.array).cast(),
+                cq_head: at(params.cq_off.head).cast(),
+                cq_tail: at(params.cq_off.tail).cast(),
+                cq_mask: *at(params.cq_off.ring_mask).cast::<u32>(),
+                cqes: at(params.cq_off.cqes).cast(),
+                tail: (*at(params.sq_off.tail).cast::<AtomicU32>()).load(Ordering::Acquire),
+                pending: 0,
+                fd,
+                _ring: ring,
+                sqes,
+            }
+        };
+
+        Ok(ring.supports(OPS)?.then_some(ring))
+    }
+
+    fn supports(&self, ops: &[IoringOp]) -> io::Result<bool> {
+        #[repr(C)]
+        struct Probe {
+            header: io_uring_probe,
+            ops: [io_uring_probe_op; 256],
+        }
+
+        let mut probe = unsafe { std::mem::zeroed::<Probe>() };
+
+        unsafe {
+            io_uring_register(
+                &self.fd,
+                IoringRegisterOp::RegisterProbe,
+                (&raw mut probe).cast::<c_void>(),
+                probe.ops.len() as u32,
+            )?;
+        }
+
+        Ok(ops.iter().all(|&op| {
+            let op = op as usize;
+            op < probe.header.ops_len as usize && probe.ops[op].flags.contains(IoringOpFlags::SUPPORTED)
+        }))
+    }
+
+    /// Queue `sqe` for the next submission
+    ///
+    /// # Safety
+    ///
+    /// Fewer entries than the ring has slots may be in flight, and
+    /// everything `sqe` points to must outlive its completion
+    unsafe fn push(&mut self, sqe: io_uring_sqe) {
+        let index = self.tail & self.sq_mask;
+
+        unsafe {
+            self.sqes.ptr.cast::<io_uring_sqe>().add(index as usize).write(sqe);
+            self.sq_array.add(index as usize).write(index);
+        }
+
+        self.tail = self.tail.wrapping_add(1);
+        self.pending += 1;
+    }
+
+    /// Submit everything queued without waiting
+    fn submit(&mut self) -> io::Result<()> {
+        unsafe { (*self.sq_tail).store(self.tail, Ordering::Release) };
+
+        while self.pending > 0 {
+            match unsafe { io_uring_enter(&self.fd, self.pending, 0, IoringEnterFlags::empty()) } {
+                Ok(submitted) => self.pending -= submitted,
+                Err(rustix::io::Errno::INTR) => continue,
+                Err(error) => return Err(error.into()),
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Wait for at least one completion
+    fn wait(&mut self) -> io::Result<()> {
+        loop {
+            match unsafe { io_uring_enter(&self.fd, 0, 1, IoringEnterFlags::GETEVENTS) } {
+                Ok(_) => return Ok(()),
+                Err(rustix::io::Errno::INTR) => continue,
+                Err(error) => return Err(error.into()),
+            }
+        }
+    }
+
+    /// Pop the next completion as its user data & result
+    fn complete(&mut self) -> Option<(u64, i32)> {
+        unsafe {
+            let head = (*self.cq_head).load(Ordering::Relaxed);
+
+            if head == (*self.cq_tail).load(Ordering::Acquire) {
+                return None;
+            }
+
+            let cqe = &*self.cqes.add((head & self.cq_mask) as usize);
+            let completion = (cqe.user_data.u64_(), cqe.res);
+
+            (*self.cq_head).store(head.wrapping_add(1), Ordering::Release);
+
+            Some(completion)
+        }
+    }
+}
+
+/// Shared mapping of the ring, unmapped on drop
+struct Mapping {
+    ptr: *mut c_void,
+    len: usize,
+}
+
+impl Mapping {
+    fn new(fd: &OwnedFd, len: usize, offset: u64) -> io::Result<Self> {
+        let ptr = unsafe {
+            mmap(
+                ptr::null_mut(),
+                len,
+                ProtFlags::READ | ProtFlags::WRITE,
+                MapFlags::SHARED | MapFlags::POPULATE,
+                fd,
+                offset,
+            )?
+        };
+
+        Ok(Self { ptr, len })
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        let _ = unsafe { munmap(self.ptr, self.len) };
+    }
+}
@@ -2,15 +2,19 @@
 // SPDX-License-Identifier: MPL-2.0
 
 use std::{
-    collections::{BTreeMap, BTreeSet},
-    fmt, io,
-    path::PathBuf,
+    collections::{BTreeMap, BTreeSet, HashMap},
+    fmt,
+    fs::Metadata,
+    io::{self, Read as _, Write as _},
+    os::unix::fs::MetadataExt as _,
+    path::{Path, PathBuf},
+    sync::Mutex,
 };
 
 use astr::AStr;
 use fs_err as fs;
 use rayon::iter::{IntoParallelIterator as _, IntoParallelRefIterator as _, ParallelIterator as _};
-use stone::{StoneDigestWriter, StoneDigestWriterHasher, StonePayloadLayoutFile};
+use stone::{StoneDigestWriterHasher, StonePayloadLayoutFile};
 use tui::{
     ProgressBar, ProgressStyle, Styled,
     dialoguer::{Confirm, theme::ColorfulTheme},
@@ -19,15 +23,32 @@ use vfs::tree::BlitFile;
 
 use crate::{
     Client, Package, Signal,
-    client::{self, cache},
+    client::{self, asset_index::AssetIndex, cache},
     package, runtime, signal, state,
 };
 
-pub fn verify(client: &Client, yes: bool, verbose: bool) -> Result<(), client::Error> {
+/// How thoroughly [`verify`] checks the content store
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Mode {
+    /// Check each asset exists with the size recorded when it was cached
+    Quick,
+    /// Also hash every asset, resuming where an interrupted verify stopped
+    Full,
+}
+
+/// Read buffer used while hashing, assets smaller than this are read in one go
+const READ_BUFFER_SIZE: usize = 1024 * 1024;
+
+/// Verify the content store & every state, then fix all issues found
+///
+/// Up to `jobs` assets are checked at once, bounding the I/O queued at any
+/// one time on slow disks.
+pub fn verify(client: &Client, yes: bool, verbose: bool, mode: Mode, jobs: usize) -> Result<(), client::Error> {
     println!("Verifying assets");
 
     // Get all installed layouts, this is our source of truth
     let layouts = client.layout_db.all()?;
+    let sizes = client.layout_db.file_sizes()?;
 
     // Group by unique assets (hash)
     let mut unique_assets = BTreeMap::new();
@@ -35,10 +56,19 @@ pub fn verify(client: &Client, yes: bool, verbose: bool) -> Result<(), client::E
         let StonePayloadLayoutFile::Regular(hash, file) = layout.file else {
             continue;
         };
-        unique_assets
-            .entry(format!("{hash:02x}"))
-            .or_insert_with(Vec::new)
-            .push((package, file));
+        unique_assets.entry(hash).or_insert_with(Vec::new).push((package, file));
+    }
+
+    let checkpoint_path = client.installation.assets_path("verify.checkpoint");
+    let checkpoint = match mode {
+        Mode::Full if !client.installation.read_only() => Some(Checkpoint::open(&checkpoint_path)?),
+        Mode::Full | Mode::Quick => None,
+    };
+
+    let asset_index = AssetIndex::open(&client.installation);
+
+    if let Some(checkpoint) = checkpoint.as_ref().filter(|c| !c.verified.is_empty()) {
+        println!("Resuming, {} assets already verified", checkpoint.verified.len());
     }
 
     let pb = ProgressBar::new(unique_assets.len() as u64)
@@ -50,63 +80,92 @@ pub fn verify(client: &Client, yes: bool, verbose: bool) -> Result<(), client::E
         );
     pb.tick();
 
+    let pool = rayon::ThreadPoolBuilder::new()
+        .num_threads(jobs)
+        .build()
+        .expect("rayon runtime");
+
     // For each asset, ensure it exists in the content store and isn't corrupt (hash is correct)
-    let mut issues = unique_assets
-        .into_par_iter()
-        .try_fold(Vec::new, |mut acc, (hash, meta)| -> io::Result<_> {
-            // Padded so output is consistent
-            let display_hash = format!("{hash:0>32}");
+    let mut issues = pool.install(|| {
+        unique_assets
+            .into_par_iter()
+            .try_fold(Vec::new, |mut acc, (id, meta)| -> io::Result<_> {
+                let hash = format!("{id:02x}");
+                // Padded so output is consistent
+                let display_hash = format!("{hash:0>32}");
 
-            let path = cache::asset_path(&client.installation, &hash);
+                let path = cache::asset_path(&client.installation, &hash);
 
-            let files = meta.iter().map(|(_, file)| file).cloned().collect::<BTreeSet<_>>();
+                let files = meta.iter().map(|(_, file)| file).cloned().collect::<BTreeSet<_>>();
 
-            pb.set_message(format!("Verifying {display_hash}"));
+                pb.set_message(format!("Verifying {display_hash}"));
 
-            if !path.exists() {
-                pb.inc(1);
-                if verbose {
-                    pb.suspend(|| println!(" {} {display_hash} - {files:?}", "×".yellow()));
-                }
-                acc.push(Issue::MissingAsset {
-                    hash,
-                    files,
-                    packages: meta.into_iter().map(|(package, _)| package).collect(),
-                });
-                return Ok(acc);
-            }
+                let Ok(metadata) = fs::metadata(&path) else {
+                    asset_index.remove(id);
+                    pb.inc(1);
+                    if verbose {
+                        pb.suspend(|| println!(" {} {display_hash} - {files:?}", "×".yellow()));
+                    }
+                    acc.push(Issue::MissingAsset {
+                        hash,
+                        files,
+                        packages: meta.into_iter().map(|(package, _)| package).collect(),
+                    });
+                    return Ok(acc);
+                };
 
-            let mut hasher = StoneDigestWriterHasher::new();
-            let mut digest_writer = StoneDigestWriter::new(io::sink(), &mut hasher);
-            let mut file = fs::File::open(&path)?;
+                // Sizes are cheap to check, only hash what's left
+                let is_corrupt = if sizes.get(&id).is_some_and(|size| *size != metadata.len()) {
+                    true
+                } else if let Some(checkpoint) = &checkpoint {
+                    if checkpoint.is_verified(id, &metadata) {
+                        false
+                    } else if digest(&path, metadata.len())? == id {
+                        checkpoint.record(id, &metadata)?;
+                        false
+                    } else {
+                        true
+                    }
+                } else if mode == Mode::Full {
+                    digest(&path, metadata.len())? != id
+                } else {
+                    false
+                };
 
-            // Copy bytes to null sink so we don't
-            // explode memory
-            io::copy(&mut file, &mut digest_writer)?;
+                if is_corrupt {
+                    asset_index.remove(id);
+                    pb.inc(1);
+                    if verbose {
+                        pb.suspend(|| println!(" {} {display_hash} - {files:?}", "×".yellow()));
+                    }
+                    acc.push(Issue::CorruptAsset {
+                        hash,
+                        files,
+                        packages: meta.into_iter().map(|(package, _)| package).collect(),
+                    });
+                    return Ok(acc);
+                }
 
-            let verified_hash = format!("{:02x}", hasher.digest128());
+                if mode == Mode::Full {
+                    asset_index.insert(id);
+                }
 
-            if verified_hash != hash {
                 pb.inc(1);
                 if verbose {
-                    pb.suspend(|| println!(" {} {display_hash} - {files:?}", "×".yellow()));
+                    pb.suspend(|| println!(" {} {display_hash} - {files:?}", "»".green()));
                 }
-                acc.push(Issue::CorruptAsset {
-                    hash,
-                    files,
-                    packages: meta.into_iter().map(|(package, _)| package).collect(),
-                });
-                return Ok(acc);
-            }
 
-            pb.inc(1);
-            if verbose {
-                pb.suspend(|| println!(" {} {display_hash} - {files:?}", "»".green()));
-            }
+                Ok(acc)
+            })
+            .try_reduce(Vec::new, try_reduce_vec_concat)
+    })?;
 
-            Ok(acc)
-        })
-        .try_reduce(Vec::new, try_reduce_vec_concat)?;
+    asset_index.save()?;
+
+    // Every asset was checked, the next verify starts over
+    if checkpoint.is_some() {
+        fs::remove_file(&checkpoint_path)?;
+    }
 
     // Get all states
     let states = client.state_db.all()?;
@@ -125,7 +184,7 @@ pub fn verify(client: &Client, yes: bool, verbose: bool) -> Result<(), client::E
 
             let is_active = client.installation.active_state == Some(state.id);
 
-            let vfs = client.vfs(state.selections.iter().map(|s| &s.package))?;
+            let vfs = client.state_vfs(state)?;
 
             let base = if is_active {
                 client.installation.root.join("usr")
@@ -355,7 +414,140 @@ impl fmt::Display for Issue {
     }
 }
 
+/// Hash the contents of the `len` byte asset at `path`
+fn digest(path: &Path, len: u64) -> io::Result<u128> {
+    let mut file = fs::File::open(path)?;
+    let mut buffer = vec![0; (len as usize).clamp(1, READ_BUFFER_SIZE)];
+    let mut hasher = StoneDigestWriterHasher::new();
+
+    loop {
+        match file.read(&mut buffer) {
+            Ok(0) => break,
+            Ok(read) => hasher.update(&buffer[..read]),
+            Err(error) if error.kind() == io::ErrorKind::Interrupted => continue,
+            Err(error) => return Err(error),
+        }
+    }
+
+    Ok(hasher.digest128())
+}
+
+/// Assets hashed by a full verify so far, so an interrupted verify
+/// resumes instead of hashing everything all over again
+///
+/// Each line records the hash of a verified asset along with its size &
+/// modification time, any asset changed since is hashed again.
+struct Checkpoint {
+    verified: HashMap<u128, Stamp>,
+    file: Mutex<fs::File>,
+}
+
+/// Size & modification time of an asset
+type Stamp = (u64, i64, i64);
+
+impl Checkpoint {
+    fn open(path: &Path) -> io::Result<Self> {
+        let contents = match fs::read_to_string(path) {
+            Ok(contents) => contents,
+            Err(error) if error.kind() == io::ErrorKind::NotFound => String::new(),
+            Err(error) => return Err(error),
+        };
+        let verified = contents.lines().filter_map(parse_checkpoint_line).collect();
+        let mut file = fs::OpenOptions::new().create(true).append(true).open(path)?;
+
+        // Terminate a line cut short when the last verify was killed, so it
+        // isn't merged with the first one recorded by this verify
+        if !contents.is_empty() && !contents.ends_with('\n') {
+            file.write_all(b"\n")?;
+        }
+
+        Ok(Self {
+            verified,
+            file: Mutex::new(file),
+        })
+    }
+
+    fn is_verified(&self, hash: u128, metadata: &Metadata) -> bool {
+        self.verified.get(&hash) == Some(&stamp(metadata))
+    }
+
+    fn record(&self, hash: u128, metadata: &Metadata) -> io::Result<()> {
+        let (size, mtime, mtime_nsec) = stamp(metadata);
+        let line = format!("{hash:02x} {size} {mtime} {mtime_nsec}\n");
+
+        // Written straight through, a verify is usually interrupted by killing it
+        self.file
+            .lock()
+            .unwrap_or_else(|e| e.into_inner())
+            .write_all(line.as_bytes())
+    }
+}
+
+fn stamp(metadata: &Metadata) -> Stamp {
+    (metadata.len(), metadata.mtime(), metadata.mtime_nsec())
+}
+
+/// Parse a line of a [`Checkpoint`], ignoring a partially written last line
+fn parse_checkpoint_line(line: &str) -> Option<(u128, Stamp)> {
+    let mut fields = line.split(' ');
+
+    let hash = u128::from_str_radix(fields.next()?, 16).ok()?;
+    let size = fields.next()?.parse().ok()?;
+    let mtime = fields.next()?.parse().ok()?;
+    let mtime_nsec = fields.next()?.parse().ok()?;
+
+    fields.next().is_none().then_some((hash, (size, mtime, mtime_nsec)))
+}
+
 fn try_reduce_vec_concat<T, E>(mut a: Vec<T>, mut b: Vec<T>) -> Result<Vec<T>, E> {
     a.append(&mut b);
     Ok(a)
 }
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    #[test]
+    fn checkpoint_resumes() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("verify.checkpoint");
+        let asset = dir.path().join("asset");
+
+        fs::write(&asset, "contents").unwrap();
+        let metadata = fs::metadata(&asset).unwrap();
+        let hash = digest(&asset, metadata.len()).unwrap();
+
+        let checkpoint = Checkpoint::open(&path).unwrap();
+        assert!(!checkpoint.is_verified(hash, &metadata));
+        checkpoint.record(hash, &metadata).unwrap();
+        drop(checkpoint);
+
+        // Interrupted halfway through writing the next line
+        fs::OpenOptions::new()
+            .append(true)
+            .open(&path)
+            .unwrap()
+            .write_all(b"abc 12")
+            .unwrap();
+
+        let checkpoint = Checkpoint::open(&path).unwrap();
+        assert_eq!(checkpoint.verified.len(), 1);
+        assert!(checkpoint.is_verified(hash, &metadata));
+
+        // Recorded after the partial line, not appended to it
+        let other = dir.path().join("other");
+        fs::write(&other, "other contents").unwrap();
+        let other_metadata = fs::metadata(&other).unwrap();
+        let other_hash = digest(&other, other_metadata.len()).unwrap();
+        checkpoint.record(other_hash, &other_metadata).unwrap();
+
+        let reloaded = Checkpoint::open(&path).unwrap();
+        assert_eq!(reloaded.verified.len(), 2);
+        assert!(reloaded.is_verified(hash, &metadata));
+        assert!(reloaded.is_verified(other_hash, &other_metadata));
+
+        fs::write(&asset, "changed contents").unwrap();
+        assert!(!checkpoint.is_verified(hash, &fs::metadata(&asset).unwrap()));
+    }
+}
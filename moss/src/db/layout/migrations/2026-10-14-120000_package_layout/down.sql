@@ -0,0 +1,6 @@
+-- SPDX-FileCopyrightText: 2026 AerynOS Developers
+-- SPDX-License-Identifier: MPL-2.0
+
+-- This file should undo anything in `up.sql`
+
+DROP TABLE IF EXISTS package_layout;
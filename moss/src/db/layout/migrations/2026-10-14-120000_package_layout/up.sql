@@ -0,0 +1,13 @@
+-- SPDX-FileCopyrightText: 2026 AerynOS Developers
+-- SPDX-License-Identifier: MPL-2.0
+
+-- Every layout entry of a package in a single row, `records` holding them
+-- encoded as in a stone layout payload & `hashes` the sorted, distinct
+-- 128-bit hashes of its regular files, big endian
+--
+-- Rows of the `layout` table are moved here when the database is opened
+CREATE TABLE IF NOT EXISTS package_layout (
+    package_id TEXT NOT NULL PRIMARY KEY,
+    records BLOB NOT NULL,
+    hashes BLOB NOT NULL
+);
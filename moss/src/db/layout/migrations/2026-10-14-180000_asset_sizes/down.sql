@@ -0,0 +1,6 @@
+-- SPDX-FileCopyrightText: 2026 AerynOS Developers
+-- SPDX-License-Identifier: MPL-2.0
+
+-- This file should undo anything in `up.sql`
+
+ALTER TABLE package_layout DROP COLUMN sizes;
@@ -0,0 +1,7 @@
+-- SPDX-FileCopyrightText: 2026 AerynOS Developers
+-- SPDX-License-Identifier: MPL-2.0
+
+-- Size of each asset in `hashes` as a big endian u64, in the same order.
+-- The maximum value marks an unknown size, and layouts stored before sizes
+-- were recorded have none at all
+ALTER TABLE package_layout ADD COLUMN sizes BLOB NOT NULL DEFAULT x'';
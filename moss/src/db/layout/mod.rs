@@ -5,17 +5,20 @@ use astr::AStr;
 use diesel::prelude::*;
 use diesel::{Connection as _, SqliteConnection};
 use diesel_migrations::{EmbeddedMigrations, MigrationHarness, embed_migrations};
-use std::{borrow::Cow, collections::BTreeSet};
+use std::collections::{BTreeMap, BTreeSet};
 
-use stone::{StonePayloadLayoutFile, StonePayloadLayoutRecord};
+use stone::{StonePayloadLayoutFile, StonePayloadLayoutRecord, StonePayloadLayoutRecordView};
 
-use crate::package;
+use crate::{metrics, package};
 
 pub use super::Error;
-use super::{Connection, MAX_VARIABLE_NUMBER};
+use super::{Connection, MAX_VARIABLE_NUMBER, QueryTimer};
 
 const MIGRATIONS: EmbeddedMigrations = embed_migrations!("src/db/layout/migrations");
 
+/// Recorded size of an asset whose size isn't known
+const UNKNOWN_SIZE: u64 = u64::MAX;
+
 mod schema;
 
 #[derive(Debug, Clone)]
@@ -26,8 +29,10 @@ pub struct Database {
 impl Database {
     pub fn new(url: &str) -> Result<Self, Error> {
         let mut conn = SqliteConnection::establish(url)?;
+        conn.set_instrumentation(QueryTimer::new(metrics::Db::Layout));
 
         conn.run_pending_migrations(MIGRATIONS).map_err(Error::Migration)?;
+        migrate_rows(&mut conn)?;
 
         Ok(Database {
             conn: Connection::new(conn),
@@ -45,14 +50,13 @@ impl Database {
             let mut output = vec![];
 
             for chunk in packages.chunks(MAX_VARIABLE_NUMBER) {
-                output.extend(
-                    model::layout::table
-                        .select(model::Layout::as_select())
-                        .filter(model::layout::package_id.eq_any(chunk))
-                        .load_iter(conn)?
-                        .map(map_layout)
-                        .collect::<Result<Vec<_>, _>>()?,
-                );
+                for row in model::package_layout::table
+                    .select(model::PackageLayout::as_select())
+                    .filter(model::package_layout::package_id.eq_any(chunk))
+                    .load_iter(conn)?
+                {
+                    decode_layouts(row?, &mut output)?;
+                }
             }
 
             Ok(output)
@@ -61,81 +65,94 @@ impl Database {
 
     pub fn all(&self) -> Result<Vec<(package::Id, StonePayloadLayoutRecord)>, Error> {
         self.conn.exec(|conn| {
-            model::layout::table
-                .select(model::Layout::as_select())
+            let mut output = vec![];
+
+            for row in model::package_layout::table
+                .select(model::PackageLayout::as_select())
                 .load_iter(conn)?
-                .map(map_layout)
-                .collect()
+            {
+                decode_layouts(row?, &mut output)?;
+            }
+
+            Ok(output)
         })
     }
 
     pub fn package_ids(&self) -> Result<BTreeSet<package::Id>, Error> {
         self.conn.exec(|conn| {
-            Ok(model::layout::table
-                .select(model::layout::package_id)
-                .distinct()
+            Ok(model::package_layout::table
+                .select(model::package_layout::package_id)
                 .load_iter::<AStr, _>(conn)?
                 .map(|result| result.map(package::Id::from))
                 .collect::<Result<_, _>>()?)
         })
     }
 
-    pub fn file_hashes(&self) -> Result<BTreeSet<String>, Error> {
+    /// Hashes of every regular file of every package
+    pub fn file_hashes(&self) -> Result<BTreeSet<u128>, Error> {
+        self.conn.exec(|conn| {
+            let mut hashes = BTreeSet::new();
+
+            for row in model::package_layout::table
+                .select(model::package_layout::hashes)
+                .load_iter::<Vec<u8>, _>(conn)?
+            {
+                hashes.extend(
+                    row?.chunks_exact(16)
+                        .map(|hash| u128::from_be_bytes(hash.try_into().unwrap())),
+                );
+            }
+
+            Ok(hashes)
+        })
+    }
+
+    /// Size of every asset whose size was recorded when it was cached
+    pub fn file_sizes(&self) -> Result<BTreeMap<u128, u64>, Error> {
         self.conn.exec(|conn| {
-            let hashes = model::layout::table
-                .select(model::layout::entry_value1.assume_not_null())
-                .distinct()
-                .filter(model::layout::entry_type.eq("regular"))
-                .load::<String>(conn)?;
-
-            Ok(hashes
-                .into_iter()
-                .filter_map(|hash| hash.parse::<u128>().ok().map(|hash| format!("{hash:02x}")))
-                .collect())
+            let mut sizes = BTreeMap::new();
+
+            for row in model::package_layout::table
+                .select((model::package_layout::hashes, model::package_layout::sizes))
+                .load_iter::<(Vec<u8>, Vec<u8>), _>(conn)?
+            {
+                let (hashes, lengths) = row?;
+
+                sizes.extend(
+                    hashes
+                        .chunks_exact(16)
+                        .zip(lengths.chunks_exact(8))
+                        .map(|(hash, size)| {
+                            (
+                                u128::from_be_bytes(hash.try_into().unwrap()),
+                                u64::from_be_bytes(size.try_into().unwrap()),
+                            )
+                        })
+                        .filter(|(_, size)| *size != UNKNOWN_SIZE),
+                );
+            }
+
+            Ok(sizes)
         })
     }
 
     pub fn add(&self, package: &package::Id, layout: &StonePayloadLayoutRecord) -> Result<(), Error> {
-        self.batch_add(vec![(package, layout)])
+        self.batch_add(vec![(package, layout)], [])
     }
 
+    /// Store the layouts of each package, replacing any layouts previously stored
+    /// for that package
+    ///
+    /// `sizes` maps asset hashes to their size, as given by the index payload of
+    /// the package, so assets can be checked without hashing them
     pub fn batch_add<'a>(
         &self,
         layouts: impl IntoIterator<Item = (&'a package::Id, &'a StonePayloadLayoutRecord)>,
+        sizes: impl IntoIterator<Item = (u128, u64)>,
     ) -> Result<(), Error> {
-        self.conn.exclusive_tx(|tx| {
-            let mut ids = vec![];
-
-            let values = layouts
-                .into_iter()
-                .map(|(package_id, layout)| {
-                    ids.push(package_id.as_str());
-
-                    let (entry_type, entry_value1, entry_value2) = encode_entry(&layout.file);
-
-                    model::NewLayout {
-                        package_id: package_id.to_string(),
-                        uid: layout.uid as i32,
-                        gid: layout.gid as i32,
-                        mode: layout.mode as i32,
-                        tag: layout.tag as i32,
-                        entry_type,
-                        entry_value1,
-                        entry_value2,
-                    }
-                })
-                .collect::<Vec<_>>();
-
-            ids.sort();
-            ids.dedup();
-            batch_remove_impl(&ids, tx)?;
+        let sizes = sizes.into_iter().collect::<BTreeMap<_, _>>();
 
-            for chunk in values.chunks(MAX_VARIABLE_NUMBER / 8) {
-                diesel::insert_into(model::layout::table).values(chunk).execute(tx)?;
-            }
-
-            Ok(())
-        })
+        self.conn.exclusive_tx(|tx| batch_add_impl(layouts, &sizes, tx))
     }
 
     pub fn remove(&self, package: &package::Id) -> Result<(), Error> {
@@ -153,13 +170,111 @@ impl Database {
     }
 }
 
+fn batch_add_impl<'a>(
+    layouts: impl IntoIterator<Item = (&'a package::Id, &'a StonePayloadLayoutRecord)>,
+    sizes: &BTreeMap<u128, u64>,
+    tx: &mut SqliteConnection,
+) -> Result<(), Error> {
+    let mut packages = BTreeMap::<&str, Vec<&StonePayloadLayoutRecord>>::new();
+
+    for (package, layout) in layouts {
+        packages.entry(package.as_str()).or_default().push(layout);
+    }
+
+    let values = packages
+        .iter()
+        .map(|(package_id, layouts)| {
+            let mut records = vec![];
+            StonePayloadLayoutRecord::encode_all(layouts.iter().copied(), &mut records)
+                .map_err(|_| Error::LayoutEntryEncode)?;
+
+            let hashes = layouts
+                .iter()
+                .filter_map(|layout| match layout.file {
+                    StonePayloadLayoutFile::Regular(hash, _) => Some(hash),
+                    _ => None,
+                })
+                .collect::<BTreeSet<_>>();
+
+            Ok(model::NewPackageLayout {
+                package_id: *package_id,
+                records,
+                sizes: hashes
+                    .iter()
+                    .flat_map(|hash| sizes.get(hash).copied().unwrap_or(UNKNOWN_SIZE).to_be_bytes())
+                    .collect(),
+                hashes: hashes.into_iter().flat_map(u128::to_be_bytes).collect(),
+            })
+        })
+        .collect::<Result<Vec<_>, Error>>()?;
+
+    batch_remove_impl(&packages.into_keys().collect::<Vec<_>>(), tx)?;
+
+    for chunk in values.chunks(MAX_VARIABLE_NUMBER / 4) {
+        diesel::insert_into(model::package_layout::table)
+            .values(chunk)
+            .execute(tx)?;
+    }
+
+    Ok(())
+}
+
 fn batch_remove_impl(packages: &[&str], tx: &mut SqliteConnection) -> Result<(), Error> {
     for chunk in packages.chunks(MAX_VARIABLE_NUMBER) {
-        diesel::delete(model::layout::table.filter(model::layout::package_id.eq_any(chunk))).execute(tx)?;
+        diesel::delete(model::package_layout::table.filter(model::package_layout::package_id.eq_any(chunk)))
+            .execute(tx)?;
     }
     Ok(())
 }
 
+/// Append every layout of `row` to `output`
+fn decode_layouts(
+    row: model::PackageLayout,
+    output: &mut Vec<(package::Id, StonePayloadLayoutRecord)>,
+) -> Result<(), Error> {
+    for layout in StonePayloadLayoutRecordView::decode_all(&row.records) {
+        let layout = layout.map_err(|_| Error::LayoutEntryDecode)?;
+
+        output.push((row.package_id.clone(), layout.to_record()));
+    }
+
+    Ok(())
+}
+
+/// Older versions stored a row per layout entry in the `layout` table,
+/// move any of those over to a row per package
+fn migrate_rows(conn: &mut SqliteConnection) -> Result<(), Error> {
+    let has_rows =
+        diesel::select(diesel::dsl::exists(model::layout::table.select(model::layout::id))).get_result::<bool>(conn)?;
+
+    if !has_rows {
+        return Ok(());
+    }
+
+    conn.exclusive_transaction(|tx| {
+        let layouts = model::layout::table
+            .select(model::Layout::as_select())
+            .order(model::layout::id)
+            .load_iter(tx)?
+            .map(map_layout)
+            .collect::<Result<Vec<_>, _>>()?;
+
+        batch_add_impl(
+            layouts.iter().map(|(package, layout)| (package, layout)),
+            &BTreeMap::new(),
+            tx,
+        )?;
+        diesel::delete(model::layout::table).execute(tx)?;
+
+        Ok::<_, Error>(())
+    })?;
+
+    // Give back the space of the old rows
+    diesel::sql_query("VACUUM").execute(conn)?;
+
+    Ok(())
+}
+
 fn map_layout(result: QueryResult<model::Layout>) -> Result<(package::Id, StonePayloadLayoutRecord), Error> {
     let row = result?;
 
@@ -199,28 +314,13 @@ fn decode_entry(
     }
 }
 
-fn encode_entry(entry: &StonePayloadLayoutFile) -> (&'static str, Option<Cow<'_, str>>, Option<&str>) {
-    match entry {
-        StonePayloadLayoutFile::Regular(hash, name) => ("regular", Some(hash.to_string().into()), Some(name)),
-        StonePayloadLayoutFile::Symlink(a, b) => ("symlink", Some(a.into()), Some(b)),
-        StonePayloadLayoutFile::Directory(name) => ("directory", Some(name.into()), None),
-        StonePayloadLayoutFile::CharacterDevice(name) => ("character-device", Some(name.into()), None),
-        StonePayloadLayoutFile::BlockDevice(name) => ("block-device", Some(name.into()), None),
-        StonePayloadLayoutFile::Fifo(name) => ("fifo", Some(name.into()), None),
-        StonePayloadLayoutFile::Socket(name) => ("socket", Some(name.into()), None),
-        StonePayloadLayoutFile::Unknown(a, b) => ("unknown", Some(a.into()), Some(b)),
-    }
-}
-
 mod model {
-    use std::borrow::Cow;
-
     use astr::AStr;
     use diesel::{Selectable, associations::Identifiable, deserialize::Queryable, prelude::Insertable};
 
     use crate::package;
 
-    pub use super::schema::layout;
+    pub use super::schema::{layout, package_layout};
 
     #[derive(Queryable, Selectable, Identifiable)]
     #[diesel(table_name = layout)]
@@ -237,17 +337,21 @@ mod model {
         pub entry_value2: Option<AStr>,
     }
 
+    #[derive(Queryable, Selectable)]
+    #[diesel(table_name = package_layout)]
+    pub struct PackageLayout {
+        #[diesel(deserialize_as = AStr)]
+        pub package_id: package::Id,
+        pub records: Vec<u8>,
+    }
+
     #[derive(Insertable)]
-    #[diesel(table_name = layout)]
-    pub struct NewLayout<'a> {
-        pub package_id: String,
-        pub uid: i32,
-        pub gid: i32,
-        pub mode: i32,
-        pub tag: i32,
-        pub entry_type: &'a str,
-        pub entry_value1: Option<Cow<'a, str>>,
-        pub entry_value2: Option<&'a str>,
+    #[diesel(table_name = package_layout)]
+    pub struct NewPackageLayout<'a> {
+        pub package_id: &'a str,
+        pub records: Vec<u8>,
+        pub hashes: Vec<u8>,
+        pub sizes: Vec<u8>,
     }
 }
 
@@ -275,10 +379,93 @@ mod test {
 
         let count = layouts.len();
 
-        database.batch_add(layouts.iter().map(|(p, l)| (p, *l))).unwrap();
+        database.batch_add(layouts.iter().map(|(p, l)| (p, *l)), []).unwrap();
 
         let all = database.all().unwrap();
 
         assert_eq!(count, all.len());
     }
+
+    #[test]
+    fn file_hashes() {
+        let database = Database::new(":memory:").unwrap();
+
+        let layout = |file| StonePayloadLayoutRecord {
+            uid: 0,
+            gid: 0,
+            mode: 0o644,
+            tag: 0,
+            file,
+        };
+        let nano = package::Id::from("nano");
+        let zlib = package::Id::from("zlib");
+        let layouts = [
+            (
+                &nano,
+                layout(StonePayloadLayoutFile::Regular(u128::MAX, "bin/nano".into())),
+            ),
+            (
+                &nano,
+                layout(StonePayloadLayoutFile::Regular(u128::MAX, "bin/rnano".into())),
+            ),
+            (&nano, layout(StonePayloadLayoutFile::Directory("share/nano".into()))),
+            (
+                &zlib,
+                layout(StonePayloadLayoutFile::Regular(1, "lib/libz.so.1".into())),
+            ),
+        ];
+
+        database
+            .batch_add(layouts.iter().map(|(p, l)| (*p, l)), [(1, 4096)])
+            .unwrap();
+
+        assert_eq!(database.file_hashes().unwrap(), BTreeSet::from([1, u128::MAX]));
+        assert_eq!(database.file_sizes().unwrap(), BTreeMap::from([(1, 4096)]));
+        assert_eq!(
+            database.query([&nano]).unwrap(),
+            layouts[..3]
+                .iter()
+                .map(|(p, l)| ((*p).clone(), l.clone()))
+                .collect::<Vec<_>>()
+        );
+
+        database.remove(&nano).unwrap();
+
+        assert_eq!(database.file_hashes().unwrap(), BTreeSet::from([1]));
+    }
+
+    #[test]
+    fn migrate_layout_rows() {
+        let mut conn = SqliteConnection::establish(":memory:").unwrap();
+        conn.run_pending_migrations(MIGRATIONS).unwrap();
+
+        diesel::sql_query(
+            "INSERT INTO layout (package_id, uid, gid, mode, tag, entry_type, entry_value1, entry_value2) VALUES
+                ('nano', 0, 0, 33261, 0, 'regular', '1234', 'bin/nano'),
+                ('nano', 0, 0, 41471, 0, 'symlink', 'nano', 'bin/rnano')",
+        )
+        .execute(&mut conn)
+        .unwrap();
+
+        migrate_rows(&mut conn).unwrap();
+
+        let database = Database {
+            conn: Connection::new(conn),
+        };
+
+        let files = database
+            .all()
+            .unwrap()
+            .into_iter()
+            .map(|(_, layout)| layout.file)
+            .collect::<Vec<_>>();
+        assert_eq!(
+            files,
+            [
+                StonePayloadLayoutFile::Regular(1234, "bin/nano".into()),
+                StonePayloadLayoutFile::Symlink("nano".into(), "bin/rnano".into()),
+            ]
+        );
+        assert_eq!(database.file_hashes().unwrap(), BTreeSet::from([1234]));
+    }
 }
@@ -13,3 +13,12 @@ diesel::table! {
         entry_value2 -> Nullable<Text>,
     }
 }
+
+diesel::table! {
+    package_layout (package_id) {
+        package_id -> Text,
+        records -> Binary,
+        hashes -> Binary,
+        sizes -> Binary,
+    }
+}
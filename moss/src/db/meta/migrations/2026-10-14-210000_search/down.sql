@@ -0,0 +1,9 @@
+-- SPDX-FileCopyrightText: 2026 AerynOS Developers
+-- SPDX-License-Identifier: MPL-2.0
+
+-- This file should undo anything in `up.sql`
+DROP TRIGGER IF EXISTS meta_search_insert;
+DROP TRIGGER IF EXISTS meta_search_delete;
+DROP TRIGGER IF EXISTS meta_search_update;
+DROP TABLE IF EXISTS meta_search;
+DROP TABLE IF EXISTS meta_search_key;
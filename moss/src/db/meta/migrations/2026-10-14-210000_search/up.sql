@@ -0,0 +1,43 @@
+-- SPDX-FileCopyrightText: 2026 AerynOS Developers
+-- SPDX-License-Identifier: MPL-2.0
+
+-- Trigram index over the fields `moss search` matches against, carrying
+-- just what it displays
+CREATE VIRTUAL TABLE IF NOT EXISTS meta_search USING fts5(
+    package UNINDEXED,
+    name,
+    summary,
+    tokenize = 'trigram'
+);
+
+-- Rowid of each package's `meta_search` row. `meta` is keyed on `package`,
+-- so its implicit rowid can change on VACUUM and can't be shared, while an
+-- INTEGER PRIMARY KEY is stable
+CREATE TABLE IF NOT EXISTS meta_search_key (
+    id INTEGER PRIMARY KEY,
+    package TEXT NOT NULL UNIQUE
+);
+
+CREATE TRIGGER IF NOT EXISTS meta_search_insert AFTER INSERT ON meta BEGIN
+    INSERT INTO meta_search_key (package) VALUES (new.package);
+    INSERT INTO meta_search (rowid, package, name, summary)
+        SELECT id, new.package, new.name, new.summary FROM meta_search_key WHERE package = new.package;
+END;
+
+CREATE TRIGGER IF NOT EXISTS meta_search_delete AFTER DELETE ON meta BEGIN
+    DELETE FROM meta_search WHERE rowid = (SELECT id FROM meta_search_key WHERE package = old.package);
+    DELETE FROM meta_search_key WHERE package = old.package;
+END;
+
+CREATE TRIGGER IF NOT EXISTS meta_search_update AFTER UPDATE ON meta BEGIN
+    DELETE FROM meta_search WHERE rowid = (SELECT id FROM meta_search_key WHERE package = old.package);
+    DELETE FROM meta_search_key WHERE package = old.package;
+    INSERT INTO meta_search_key (package) VALUES (new.package);
+    INSERT INTO meta_search (rowid, package, name, summary)
+        SELECT id, new.package, new.name, new.summary FROM meta_search_key WHERE package = new.package;
+END;
+
+INSERT INTO meta_search_key (package) SELECT package FROM meta;
+INSERT INTO meta_search (rowid, package, name, summary)
+    SELECT meta_search_key.id, meta.package, meta.name, meta.summary
+    FROM meta JOIN meta_search_key ON meta_search_key.package = meta.package;
@@ -8,7 +8,8 @@ use diesel::prelude::*;
 use diesel::{Connection as _, SqliteConnection};
 use diesel_migrations::{EmbeddedMigrations, MigrationHarness, embed_migrations};
 
-use crate::db::Connection;
+use crate::db::{Connection, QueryTimer};
+use crate::metrics;
 use crate::package::{self, Meta};
 use crate::{Dependency, Provider};
 
@@ -20,13 +21,15 @@ const MIGRATIONS: EmbeddedMigrations = embed_migrations!("src/db/meta/migrations
 mod schema;
 
 #[derive(Debug)]
-pub enum Filter<'a> {
+pub enum Filter {
     Provider(Provider),
     Dependency(Dependency),
     Name(package::Name),
-    Keyword(&'a str),
 }
 
+/// Keywords shorter than a trigram can't be looked up in the search index
+const MIN_INDEXED_KEYWORD: usize = 3;
+
 #[derive(Debug, Clone)]
 pub struct Database {
     conn: Connection,
@@ -35,6 +38,7 @@ pub struct Database {
 impl Database {
     pub fn new(url: &str) -> Result<Self, Error> {
         let mut conn = SqliteConnection::establish(url)?;
+        conn.set_instrumentation(QueryTimer::new(metrics::Db::Meta));
 
         conn.run_pending_migrations(MIGRATIONS).map_err(Error::Migration)?;
 
@@ -112,7 +116,7 @@ impl Database {
         })
     }
 
-    pub fn query(&self, filter: Option<Filter<'_>>) -> Result<Vec<(package::Id, Meta)>, Error> {
+    pub fn query(&self, filter: Option<Filter>) -> Result<Vec<(package::Id, Meta)>, Error> {
         self.conn.exec(|conn| {
             let map_row = |result| {
                 let meta: model::Meta = result?;
@@ -155,17 +159,6 @@ impl Database {
                     .select(model::Meta::as_select())
                     .filter(model::meta::name.eq(name.to_string()))
                     .load_iter::<model::Meta, _>(conn)?,
-                Some(Filter::Keyword(keyword)) => {
-                    let pattern = format!("%{keyword}%");
-                    model::meta::table
-                        .select(model::Meta::as_select())
-                        .filter(
-                            model::meta::name
-                                .like(pattern.clone())
-                                .or(model::meta::summary.like(pattern)),
-                        )
-                        .load_iter::<model::Meta, _>(conn)?
-                }
                 None => model::meta::table
                     .select(model::Meta::as_select())
                     .load_iter::<model::Meta, _>(conn)?,
@@ -228,6 +221,38 @@ impl Database {
         })
     }
 
+    /// Packages whose name or summary contain `keyword`, ignoring case
+    ///
+    /// Served from the `meta_search` index kept in step with `meta`, so only
+    /// the fields shown for a match are read back.
+    pub fn search(&self, keyword: &str) -> Result<Vec<package::SearchResult>, Error> {
+        self.conn.exec(|conn| {
+            let rows = if keyword.chars().count() >= MIN_INDEXED_KEYWORD {
+                // Quoted as a single phrase, which the trigram tokenizer matches as a substring
+                let phrase = format!("\"{}\"", keyword.replace('"', "\"\""));
+                diesel::sql_query("SELECT package, name, summary FROM meta_search WHERE meta_search MATCH ?")
+                    .bind::<diesel::sql_types::Text, _>(phrase)
+                    .load::<model::SearchRow>(conn)?
+            } else {
+                let pattern = format!("%{keyword}%");
+                diesel::sql_query(
+                    "SELECT package, name, summary FROM meta_search WHERE name LIKE ?1 OR summary LIKE ?1",
+                )
+                .bind::<diesel::sql_types::Text, _>(pattern)
+                .load::<model::SearchRow>(conn)?
+            };
+
+            Ok(rows
+                .into_iter()
+                .map(|row| package::SearchResult {
+                    id: package::Id::from(row.package),
+                    name: row.name,
+                    summary: row.summary,
+                })
+                .collect())
+        })
+    }
+
     pub fn package_ids(&self) -> Result<BTreeSet<package::Id>, Error> {
         self.conn.exec(|conn| {
             Ok(model::meta::table
@@ -255,98 +280,20 @@ impl Database {
     }
 
     pub fn batch_add(&self, packages: Vec<(package::Id, Meta)>) -> Result<(), Error> {
-        self.conn.exclusive_tx(|tx| {
-            let ids = packages.iter().map(|(id, _)| id.as_str()).collect::<Vec<_>>();
-            let entries = packages
-                .iter()
-                .map(|(package, meta)| model::NewMeta {
-                    package: package.as_str(),
-                    name: meta.name.as_str(),
-                    version_identifier: &meta.version_identifier,
-                    source_release: meta.source_release as i32,
-                    build_release: meta.build_release as i32,
-                    architecture: &meta.architecture,
-                    summary: &meta.summary,
-                    description: &meta.description,
-                    source_id: &meta.source_id,
-                    homepage: &meta.homepage,
-                    uri: meta.uri.as_deref(),
-                    hash: meta.hash.as_deref(),
-                    download_size: meta.download_size.map(|size| size as i64),
-                })
-                .collect::<Vec<_>>();
-            let licenses = packages
-                .iter()
-                .flat_map(|(package, meta)| {
-                    meta.licenses.iter().map(|license| {
-                        (
-                            model::meta_licenses::package.eq(package.as_str()),
-                            model::meta_licenses::license.eq(license),
-                        )
-                    })
-                })
-                .collect::<Vec<_>>();
-            let dependencies = packages
-                .iter()
-                .flat_map(|(package, meta)| {
-                    meta.dependencies.iter().map(|dependency| {
-                        (
-                            model::meta_dependencies::package.eq(package.as_str()),
-                            model::meta_dependencies::dependency.eq(dependency.to_string()),
-                        )
-                    })
-                })
-                .collect::<Vec<_>>();
-            let providers = packages
-                .iter()
-                .flat_map(|(package, meta)| {
-                    meta.providers.iter().map(|provider| {
-                        (
-                            model::meta_providers::package.eq(package.as_str()),
-                            model::meta_providers::provider.eq(provider.to_string()),
-                        )
-                    })
-                })
-                .collect::<Vec<_>>();
-            let conflicts = packages
-                .iter()
-                .flat_map(|(package, meta)| {
-                    meta.conflicts.iter().map(|conflict| {
-                        (
-                            model::meta_conflicts::package.eq(package.as_str()),
-                            model::meta_conflicts::conflict.eq(conflict.to_string()),
-                        )
-                    })
-                })
-                .collect::<Vec<_>>();
-
-            batch_remove_impl(&ids, tx)?;
-
-            for chunk in entries.chunks(MAX_VARIABLE_NUMBER / 13) {
-                diesel::insert_into(model::meta::table).values(chunk).execute(tx)?;
-            }
-            for chunk in licenses.chunks(MAX_VARIABLE_NUMBER / 2) {
-                diesel::insert_or_ignore_into(model::meta_licenses::table)
-                    .values(chunk)
-                    .execute(tx)?;
-            }
-            for chunk in dependencies.chunks(MAX_VARIABLE_NUMBER / 2) {
-                diesel::insert_or_ignore_into(model::meta_dependencies::table)
-                    .values(chunk)
-                    .execute(tx)?;
-            }
-            for chunk in providers.chunks(MAX_VARIABLE_NUMBER / 2) {
-                diesel::insert_or_ignore_into(model::meta_providers::table)
-                    .values(chunk)
-                    .execute(tx)?;
-            }
-            for chunk in conflicts.chunks(MAX_VARIABLE_NUMBER / 2) {
-                diesel::insert_or_ignore_into(model::meta_conflicts::table)
-                    .values(chunk)
-                    .execute(tx)?;
-            }
+        self.conn.exclusive_tx(|tx| batch_add_impl(&packages, tx))
+    }
 
-            Ok(())
+    /// Remove & add packages in a single transaction, so readers never
+    /// observe a partially applied repository update
+    pub fn apply_delta<'a>(
+        &self,
+        removed: impl IntoIterator<Item = &'a package::Id>,
+        added: Vec<(package::Id, Meta)>,
+    ) -> Result<(), Error> {
+        self.conn.exclusive_tx(|tx| {
+            let removed = removed.into_iter().map(package::Id::as_str).collect::<Vec<_>>();
+            batch_remove_impl(&removed, tx)?;
+            batch_add_impl(&added, tx)
         })
     }
 
@@ -363,6 +310,100 @@ impl Database {
     }
 }
 
+fn batch_add_impl(packages: &[(package::Id, Meta)], tx: &mut SqliteConnection) -> Result<(), Error> {
+    let ids = packages.iter().map(|(id, _)| id.as_str()).collect::<Vec<_>>();
+    let entries = packages
+        .iter()
+        .map(|(package, meta)| model::NewMeta {
+            package: package.as_str(),
+            name: meta.name.as_str(),
+            version_identifier: &meta.version_identifier,
+            source_release: meta.source_release as i32,
+            build_release: meta.build_release as i32,
+            architecture: &meta.architecture,
+            summary: &meta.summary,
+            description: &meta.description,
+            source_id: &meta.source_id,
+            homepage: &meta.homepage,
+            uri: meta.uri.as_deref(),
+            hash: meta.hash.as_deref(),
+            download_size: meta.download_size.map(|size| size as i64),
+        })
+        .collect::<Vec<_>>();
+    let licenses = packages
+        .iter()
+        .flat_map(|(package, meta)| {
+            meta.licenses.iter().map(|license| {
+                (
+                    model::meta_licenses::package.eq(package.as_str()),
+                    model::meta_licenses::license.eq(license),
+                )
+            })
+        })
+        .collect::<Vec<_>>();
+    let dependencies = packages
+        .iter()
+        .flat_map(|(package, meta)| {
+            meta.dependencies.iter().map(|dependency| {
+                (
+                    model::meta_dependencies::package.eq(package.as_str()),
+                    model::meta_dependencies::dependency.eq(dependency.to_string()),
+                )
+            })
+        })
+        .collect::<Vec<_>>();
+    let providers = packages
+        .iter()
+        .flat_map(|(package, meta)| {
+            meta.providers.iter().map(|provider| {
+                (
+                    model::meta_providers::package.eq(package.as_str()),
+                    model::meta_providers::provider.eq(provider.to_string()),
+                )
+            })
+        })
+        .collect::<Vec<_>>();
+    let conflicts = packages
+        .iter()
+        .flat_map(|(package, meta)| {
+            meta.conflicts.iter().map(|conflict| {
+                (
+                    model::meta_conflicts::package.eq(package.as_str()),
+                    model::meta_conflicts::conflict.eq(conflict.to_string()),
+                )
+            })
+        })
+        .collect::<Vec<_>>();
+
+    batch_remove_impl(&ids, tx)?;
+
+    for chunk in entries.chunks(MAX_VARIABLE_NUMBER / 13) {
+        diesel::insert_into(model::meta::table).values(chunk).execute(tx)?;
+    }
+    for chunk in licenses.chunks(MAX_VARIABLE_NUMBER / 2) {
+        diesel::insert_or_ignore_into(model::meta_licenses::table)
+            .values(chunk)
+            .execute(tx)?;
+    }
+    for chunk in dependencies.chunks(MAX_VARIABLE_NUMBER / 2) {
+        diesel::insert_or_ignore_into(model::meta_dependencies::table)
+            .values(chunk)
+            .execute(tx)?;
+    }
+    for chunk in providers.chunks(MAX_VARIABLE_NUMBER / 2) {
+        diesel::insert_or_ignore_into(model::meta_providers::table)
+            .values(chunk)
+            .execute(tx)?;
+    }
+    for chunk in conflicts.chunks(MAX_VARIABLE_NUMBER / 2) {
+        diesel::insert_or_ignore_into(model::meta_conflicts::table)
+            .values(chunk)
+            .execute(tx)?;
+    }
+
+    Ok(())
+}
+
 fn batch_remove_impl(packages: &[&str], tx: &mut SqliteConnection) -> Result<(), Error> {
     for chunk in packages.chunks(MAX_VARIABLE_NUMBER) {
         diesel::delete(model::meta::table.filter(model::meta::package.eq_any(chunk))).execute(tx)?;
@@ -374,8 +415,9 @@ mod model {
     use diesel::{
         Selectable,
         associations::{Associations, Identifiable},
-        deserialize::Queryable,
+        deserialize::{Queryable, QueryableByName},
         prelude::Insertable,
+        sql_types::Text,
     };
 
     pub use crate::db::meta::schema::{meta, meta_conflicts, meta_dependencies, meta_licenses, meta_providers};
@@ -452,6 +494,16 @@ mod model {
         pub conflict: crate::Provider,
     }
 
+    #[derive(QueryableByName)]
+    pub struct SearchRow {
+        #[diesel(sql_type = Text)]
+        pub package: String,
+        #[diesel(sql_type = Text, deserialize_as = String)]
+        pub name: package::Name,
+        #[diesel(sql_type = Text)]
+        pub summary: String,
+    }
+
     #[derive(Insertable)]
     #[diesel(table_name = meta)]
     pub struct NewMeta<'a> {
@@ -505,7 +557,17 @@ mod test {
         let fetched = db.query(Some(lookup)).unwrap();
         assert_eq!(fetched.len(), 1);
 
+        // Both indexed & short keywords match case insensitively
+        for keyword in ["COMPLETION", "bash-c", "sh"] {
+            let found = db.search(keyword).unwrap();
+            assert_eq!(found.len(), 1);
+            assert_eq!(found[0].id, id);
+            assert_eq!(found[0].name, meta.name);
+        }
+        assert!(db.search("\"nothing\"").unwrap().is_empty());
+
         db.remove(&id).unwrap();
+        assert!(db.search("completion").unwrap().is_empty());
 
         let result = db.get(&id);
 
@@ -518,6 +580,68 @@ mod test {
         assert!(result.is_err());
     }
 
+    #[test]
+    fn apply_delta() {
+        let db = Database::new(":memory:").unwrap();
+
+        let bash_completion = include_bytes!("../../../../test/bash-completion-2.11-1-1-x86_64.stone");
+
+        let mut stone = stone::read_bytes(bash_completion).unwrap();
+
+        let payloads = stone.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+        let meta_payload = payloads.iter().find_map(StoneDecodedPayload::meta).unwrap();
+        let meta = Meta::from_stone_payload(&meta_payload.body).unwrap();
+
+        let old = package::Id::from("old");
+        let kept = package::Id::from("kept");
+        let new = package::Id::from("new");
+
+        db.batch_add(vec![(old.clone(), meta.clone()), (kept.clone(), meta.clone())])
+            .unwrap();
+        db.apply_delta([&old], vec![(new.clone(), meta)]).unwrap();
+
+        assert_eq!(db.package_ids().unwrap(), BTreeSet::from([kept, new]));
+        assert!(db.get(&old).is_err());
+    }
+
+    #[test]
+    fn search_survives_vacuum() {
+        let db = Database::new(":memory:").unwrap();
+
+        let bash_completion = include_bytes!("../../../../test/bash-completion-2.11-1-1-x86_64.stone");
+
+        let mut stone = stone::read_bytes(bash_completion).unwrap();
+
+        let payloads = stone.payloads().unwrap().collect::<Result<Vec<_>, _>>().unwrap();
+        let meta_payload = payloads.iter().find_map(StoneDecodedPayload::meta).unwrap();
+        let meta = Meta::from_stone_payload(&meta_payload.body).unwrap();
+
+        let [a, b, c, d] = ["a", "b", "c", "d"].map(package::Id::from);
+        let found = || {
+            db.search("completion")
+                .unwrap()
+                .into_iter()
+                .map(|result| result.id)
+                .collect::<BTreeSet<_>>()
+        };
+
+        db.batch_add(vec![
+            (a.clone(), meta.clone()),
+            (b.clone(), meta.clone()),
+            (c.clone(), meta.clone()),
+        ])
+        .unwrap();
+        db.remove(&a).unwrap();
+
+        // Renumbers the implicit rowids of `meta`, which the index mustn't rely on
+        db.conn.exec(|conn| diesel::sql_query("VACUUM").execute(conn)).unwrap();
+
+        db.add(d.clone(), meta).unwrap();
+        db.remove(&b).unwrap();
+
+        assert_eq!(found(), BTreeSet::from([c, d]));
+    }
+
     #[test]
     fn test_conflict_is_recognized() {
         let db = Database::new(":memory:").unwrap();
@@ -4,12 +4,18 @@
 use std::{
     fmt,
     sync::{Arc, Mutex},
+    time::Instant,
 };
 
 use chrono::{DateTime, Utc};
-use diesel::SqliteConnection;
+use diesel::{
+    SqliteConnection,
+    connection::{Instrumentation, InstrumentationEvent},
+};
 use thiserror::Error;
 
+use crate::metrics;
+
 pub mod layout;
 pub mod meta;
 pub mod state;
@@ -41,6 +47,34 @@ impl Connection {
     }
 }
 
+/// Times every query of a connection into [`metrics`]
+struct QueryTimer {
+    db: metrics::Db,
+    started: Option<Instant>,
+}
+
+impl QueryTimer {
+    fn new(db: metrics::Db) -> Self {
+        Self { db, started: None }
+    }
+}
+
+impl Instrumentation for QueryTimer {
+    fn on_connection_event(&mut self, event: InstrumentationEvent<'_>) {
+        match event {
+            InstrumentationEvent::StartQuery { .. } => {
+                self.started = metrics::enabled().then(Instant::now);
+            }
+            InstrumentationEvent::FinishQuery { .. } => {
+                if let Some(started) = self.started.take() {
+                    metrics::query(self.db, started.elapsed());
+                }
+            }
+            _ => {}
+        }
+    }
+}
+
 impl fmt::Debug for Connection {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
         f.debug_struct("Connection").finish()
@@ -65,6 +99,8 @@ pub enum Error {
     RowNotFound,
     #[error("failed to decode layout entry")]
     LayoutEntryDecode,
+    #[error("failed to encode layout entry")]
+    LayoutEntryEncode,
     #[error("invalid timestamp: {0}")]
     InvalidTimestamp(i64),
     #[error("diesel")]
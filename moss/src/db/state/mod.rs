@@ -7,9 +7,9 @@ use diesel::{Connection as _, SqliteConnection};
 use diesel_migrations::{EmbeddedMigrations, MigrationHarness, embed_migrations};
 use itertools::Itertools;
 
-use super::{Connection, Error, MAX_VARIABLE_NUMBER};
-use crate::State;
+use super::{Connection, Error, MAX_VARIABLE_NUMBER, QueryTimer};
 use crate::state::{self, Id, Selection};
+use crate::{State, metrics};
 
 const MIGRATIONS: EmbeddedMigrations = embed_migrations!("src/db/state/migrations");
 
@@ -23,6 +23,7 @@ pub struct Database {
 impl Database {
     pub fn new(url: &str) -> Result<Self, Error> {
         let mut conn = SqliteConnection::establish(url)?;
+        conn.set_instrumentation(QueryTimer::new(metrics::Db::State));
 
         conn.run_pending_migrations(MIGRATIONS).map_err(Error::Migration)?;
 
@@ -6,6 +6,8 @@ pub const NAME: &str = env!("CARGO_PKG_NAME");
 pub const MAX_DISK_CONCURRENCY: usize = 16;
 /// Max concurrency for network tasks
 pub const MAX_NETWORK_CONCURRENCY: usize = 8;
+/// Max download size of packages being cached at once, 2 GiB
+pub const MAX_CACHE_BUFFERED_BYTES: u64 = 2 * 1024 * 1024 * 1024;
 /// Buffer size used when reading a file, 4 MiB
 pub const FILE_READ_BUFFER_SIZE: usize = 4 * 1024 * 1024;
 /// Threshold to begin chunking file during read, 16 KiB
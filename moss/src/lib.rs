@@ -16,6 +16,7 @@ pub mod db;
 pub mod dependency;
 pub mod environment;
 pub mod installation;
+pub mod metrics;
 pub mod package;
 pub mod registry;
 pub mod repository;
@@ -0,0 +1,400 @@
+// SPDX-FileCopyrightText: 2026 AerynOS Developers
+// SPDX-License-Identifier: MPL-2.0
+
+//! Process wide performance counters
+//!
+//! Nothing is counted until [`enable`] is called, after which [`snapshot`]
+//! gathers the counters of every stone read, blit syscall and database query
+//! of the process so far into a [`Snapshot`] that serializes to JSON.
+
+use std::{
+    collections::BTreeMap,
+    io,
+    path::Path,
+    sync::atomic::{AtomicBool, AtomicU64, Ordering},
+    time::{Duration, Instant},
+};
+
+use fs_err::File;
+use serde::Serialize;
+use stone::{StoneEvent, StonePayloadKind};
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+static METRICS: Metrics = Metrics::new();
+
+/// Start counting, including the work of every stone reader
+pub fn enable() {
+    ENABLED.store(true, Ordering::Relaxed);
+    stone::set_event_hook(Some(Box::new(record_stone_event)));
+}
+
+pub fn enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+/// Run `f` as one call of `syscall`, timing it when counting is enabled
+pub fn syscall<T>(syscall: Syscall, f: impl FnOnce() -> T) -> T {
+    if !enabled() {
+        return f();
+    }
+
+    let started = Instant::now();
+    let result = f();
+    METRICS.syscalls[syscall as usize].record(started.elapsed());
+    result
+}
+
+/// Record a query against `db` which took `elapsed`
+pub fn query(db: Db, elapsed: Duration) {
+    if enabled() {
+        METRICS.queries[db as usize].record(elapsed);
+    }
+}
+
+/// Syscalls issued while blitting a state
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Syscall {
+    Openat,
+    Close,
+    Linkat,
+    Fchmodat,
+    Fchmod,
+    Ficlone,
+    Symlinkat,
+    Mkdirat,
+}
+
+impl Syscall {
+    const ALL: [Self; 8] = [
+        Self::Openat,
+        Self::Close,
+        Self::Linkat,
+        Self::Fchmodat,
+        Self::Fchmod,
+        Self::Ficlone,
+        Self::Symlinkat,
+        Self::Mkdirat,
+    ];
+
+    fn name(self) -> &'static str {
+        match self {
+            Self::Openat => "openat",
+            Self::Close => "close",
+            Self::Linkat => "linkat",
+            Self::Fchmodat => "fchmodat",
+            Self::Fchmod => "fchmod",
+            Self::Ficlone => "ficlone",
+            Self::Symlinkat => "symlinkat",
+            Self::Mkdirat => "mkdirat",
+        }
+    }
+}
+
+/// Databases of an installation
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Db {
+    Layout,
+    Meta,
+    State,
+}
+
+impl Db {
+    const ALL: [Self; 3] = [Self::Layout, Self::Meta, Self::State];
+
+    fn name(self) -> &'static str {
+        match self {
+            Self::Layout => "layout",
+            Self::Meta => "meta",
+            Self::State => "state",
+        }
+    }
+}
+
+/// Record payload kinds, in the order of [`Metrics::payloads`]
+const PAYLOAD_KINDS: [StonePayloadKind; 8] = [
+    StonePayloadKind::Meta,
+    StonePayloadKind::Content,
+    StonePayloadKind::Layout,
+    StonePayloadKind::Index,
+    StonePayloadKind::Attributes,
+    StonePayloadKind::Frames,
+    StonePayloadKind::Lookup,
+    StonePayloadKind::Unknown,
+];
+
+/// Histogram buckets, the last holding everything from ~4s up
+const BUCKETS: usize = 23;
+
+/// Latencies bucketed by powers of two microseconds
+struct Histogram {
+    count: AtomicU64,
+    total_ns: AtomicU64,
+    max_ns: AtomicU64,
+    /// Bucket `i > 0` holds latencies in `[2^(i-1), 2^i)` µs, bucket 0 those under 1µs
+    buckets: [AtomicU64; BUCKETS],
+}
+
+impl Histogram {
+    const fn new() -> Self {
+        Self {
+            count: AtomicU64::new(0),
+            total_ns: AtomicU64::new(0),
+            max_ns: AtomicU64::new(0),
+            buckets: [const { AtomicU64::new(0) }; BUCKETS],
+        }
+    }
+
+    fn record(&self, elapsed: Duration) {
+        let ns = elapsed.as_nanos() as u64;
+        let bucket = (u64::BITS - (ns / 1000).leading_zeros()) as usize;
+
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.total_ns.fetch_add(ns, Ordering::Relaxed);
+        self.max_ns.fetch_max(ns, Ordering::Relaxed);
+        self.buckets[bucket.min(BUCKETS - 1)].fetch_add(1, Ordering::Relaxed);
+    }
+
+    fn snapshot(&self) -> HistogramSnapshot {
+        let count = self.count.load(Ordering::Relaxed);
+        let total_ns = self.total_ns.load(Ordering::Relaxed);
+
+        HistogramSnapshot {
+            count,
+            total_ms: total_ns as f64 / 1e6,
+            mean_us: if count > 0 {
+                total_ns as f64 / count as f64 / 1e3
+            } else {
+                0.0
+            },
+            max_us: self.max_ns.load(Ordering::Relaxed) as f64 / 1e3,
+            buckets: self
+                .buckets
+                .iter()
+                .enumerate()
+                .filter_map(|(i, bucket)| {
+                    let count = bucket.load(Ordering::Relaxed);
+                    (count > 0).then(|| Bucket {
+                        below_us: (i < BUCKETS - 1).then_some(1 << i),
+                        count,
+                    })
+                })
+                .collect(),
+        }
+    }
+}
+
+/// Bytes moved by some operation & the time it took
+struct Throughput {
+    stored_bytes: AtomicU64,
+    plain_bytes: AtomicU64,
+    checksum_ns: AtomicU64,
+    elapsed: Histogram,
+}
+
+impl Throughput {
+    const fn new() -> Self {
+        Self {
+            stored_bytes: AtomicU64::new(0),
+            plain_bytes: AtomicU64::new(0),
+            checksum_ns: AtomicU64::new(0),
+            elapsed: Histogram::new(),
+        }
+    }
+
+    fn record(&self, stored_size: u64, plain_size: u64, elapsed: Duration, checksum: Duration) {
+        self.stored_bytes.fetch_add(stored_size, Ordering::Relaxed);
+        self.plain_bytes.fetch_add(plain_size, Ordering::Relaxed);
+        self.checksum_ns
+            .fetch_add(checksum.as_nanos() as u64, Ordering::Relaxed);
+        self.elapsed.record(elapsed);
+    }
+
+    fn snapshot(&self) -> ThroughputSnapshot {
+        let elapsed = self.elapsed.snapshot();
+        let plain_bytes = self.plain_bytes.load(Ordering::Relaxed);
+
+        ThroughputSnapshot {
+            stored_bytes: self.stored_bytes.load(Ordering::Relaxed),
+            plain_bytes,
+            checksum_ms: self.checksum_ns.load(Ordering::Relaxed) as f64 / 1e6,
+            mib_per_sec: mib_per_sec(plain_bytes, elapsed.total_ms),
+            elapsed,
+        }
+    }
+}
+
+struct Metrics {
+    payloads: [Throughput; PAYLOAD_KINDS.len()],
+    unpack: Throughput,
+    asset_bytes: AtomicU64,
+    asset_hash: Histogram,
+    syscalls: [Histogram; Syscall::ALL.len()],
+    queries: [Histogram; Db::ALL.len()],
+}
+
+impl Metrics {
+    const fn new() -> Self {
+        Self {
+            payloads: [const { Throughput::new() }; PAYLOAD_KINDS.len()],
+            unpack: Throughput::new(),
+            asset_bytes: AtomicU64::new(0),
+            asset_hash: Histogram::new(),
+            syscalls: [const { Histogram::new() }; Syscall::ALL.len()],
+            queries: [const { Histogram::new() }; Db::ALL.len()],
+        }
+    }
+}
+
+fn record_stone_event(event: &StoneEvent) {
+    match *event {
+        StoneEvent::PayloadDecoded {
+            kind,
+            stored_size,
+            plain_size,
+            elapsed,
+            checksum,
+        } => {
+            let index = PAYLOAD_KINDS
+                .iter()
+                .position(|known| *known == kind)
+                .unwrap_or(PAYLOAD_KINDS.len() - 1);
+            METRICS.payloads[index].record(stored_size, plain_size, elapsed, checksum);
+        }
+        StoneEvent::ContentUnpacked {
+            stored_size,
+            plain_size,
+            elapsed,
+            checksum,
+        } => METRICS.unpack.record(stored_size, plain_size, elapsed, checksum),
+        StoneEvent::AssetVerified { size, elapsed } => {
+            METRICS.asset_bytes.fetch_add(size, Ordering::Relaxed);
+            METRICS.asset_hash.record(elapsed);
+        }
+    }
+}
+
+fn mib_per_sec(bytes: u64, ms: f64) -> f64 {
+    if ms > 0.0 {
+        bytes as f64 / (1 << 20) as f64 / (ms / 1e3)
+    } else {
+        0.0
+    }
+}
+
+/// Gather all counters so far
+pub fn snapshot() -> Snapshot {
+    let asset_hash = METRICS.asset_hash.snapshot();
+    let asset_bytes = METRICS.asset_bytes.load(Ordering::Relaxed);
+
+    Snapshot {
+        payloads: PAYLOAD_KINDS
+            .iter()
+            .zip(&METRICS.payloads)
+            .map(|(kind, payload)| (kind.to_string(), payload.snapshot()))
+            .filter(|(_, payload)| payload.elapsed.count > 0)
+            .collect(),
+        unpack: METRICS.unpack.snapshot(),
+        assets: AssetSnapshot {
+            bytes: asset_bytes,
+            mib_per_sec: mib_per_sec(asset_bytes, asset_hash.total_ms),
+            hash: asset_hash,
+        },
+        syscalls: Syscall::ALL
+            .iter()
+            .map(|syscall| (syscall.name(), METRICS.syscalls[*syscall as usize].snapshot()))
+            .filter(|(_, histogram)| histogram.count > 0)
+            .collect(),
+        queries: Db::ALL
+            .iter()
+            .map(|db| (db.name(), METRICS.queries[*db as usize].snapshot()))
+            .filter(|(_, histogram)| histogram.count > 0)
+            .collect(),
+    }
+}
+
+/// Counters of the process at some point in time
+#[derive(Debug, Serialize)]
+pub struct Snapshot {
+    /// Record payloads decoded, by kind
+    pub payloads: BTreeMap<String, ThroughputSnapshot>,
+    /// Content payloads unpacked into the asset store
+    pub unpack: ThroughputSnapshot,
+    /// Assets hashed while unpacking
+    pub assets: AssetSnapshot,
+    /// Syscalls issued while blitting, by name
+    pub syscalls: BTreeMap<&'static str, HistogramSnapshot>,
+    /// Queries, by database
+    pub queries: BTreeMap<&'static str, HistogramSnapshot>,
+}
+
+impl Snapshot {
+    /// Write as pretty printed JSON to `path`
+    pub fn write_json(&self, path: &Path) -> io::Result<()> {
+        let file = File::create(path)?;
+        serde_json::to_writer_pretty(file, self).map_err(io::Error::from)
+    }
+}
+
+#[derive(Debug, Serialize)]
+pub struct ThroughputSnapshot {
+    pub stored_bytes: u64,
+    pub plain_bytes: u64,
+    /// Of `elapsed`, spent checksumming
+    pub checksum_ms: f64,
+    /// Of plain bytes, per unit of `elapsed`
+    pub mib_per_sec: f64,
+    pub elapsed: HistogramSnapshot,
+}
+
+#[derive(Debug, Serialize)]
+pub struct AssetSnapshot {
+    pub bytes: u64,
+    pub mib_per_sec: f64,
+    pub hash: HistogramSnapshot,
+}
+
+#[derive(Debug, Serialize)]
+pub struct HistogramSnapshot {
+    pub count: u64,
+    pub total_ms: f64,
+    pub mean_us: f64,
+    pub max_us: f64,
+    /// Non empty buckets only
+    pub buckets: Vec<Bucket>,
+}
+
+#[derive(Debug, Serialize)]
+pub struct Bucket {
+    /// Exclusive upper bound, unbounded for the last bucket
+    pub below_us: Option<u64>,
+    pub count: u64,
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    #[test]
+    fn histogram_buckets() {
+        let histogram = Histogram::new();
+
+        for us in [0, 1, 3, 3, 1000] {
+            histogram.record(Duration::from_micros(us));
+        }
+        histogram.record(Duration::from_secs(3600));
+
+        let snapshot = histogram.snapshot();
+        let buckets = snapshot
+            .buckets
+            .iter()
+            .map(|bucket| (bucket.below_us, bucket.count))
+            .collect::<Vec<_>>();
+
+        assert_eq!(snapshot.count, 6);
+        assert_eq!(snapshot.max_us, 3600e6);
+        assert_eq!(
+            buckets,
+            [(Some(1), 1), (Some(2), 1), (Some(4), 2), (Some(1024), 1), (None, 1)]
+        );
+    }
+}
@@ -56,6 +56,14 @@ impl Borrow<str> for Id {
     }
 }
 
+/// A [`Package`] found by a keyword search, with only what's shown for it
+#[derive(Debug, Clone, PartialEq, Eq, PartialOrd, Ord)]
+pub struct SearchResult {
+    pub name: Name,
+    pub summary: String,
+    pub id: Id,
+}
+
 #[derive(Debug, Clone, PartialEq, Eq)]
 pub struct Package {
     pub id: Id,
@@ -63,6 +71,16 @@ pub struct Package {
     pub flags: Flags,
 }
 
+impl Package {
+    pub fn into_search_result(self) -> SearchResult {
+        SearchResult {
+            name: self.meta.name,
+            summary: self.meta.summary,
+            id: self.id,
+        }
+    }
+}
+
 impl PartialOrd for Package {
     fn partial_cmp(&self, other: &Self) -> Option<std::cmp::Ordering> {
         Some(self.cmp(other))
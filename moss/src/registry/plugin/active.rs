@@ -3,6 +3,7 @@
 
 use log::warn;
 
+use crate::package::SearchResult;
 use crate::{Package, Provider, State, db, package};
 
 // TODO:
@@ -41,7 +42,7 @@ impl Active {
     }
 
     /// Query, restricted to state
-    fn query(&self, flags: package::Flags, filter: Option<db::meta::Filter<'_>>) -> Vec<Package> {
+    fn query(&self, flags: package::Flags, filter: Option<db::meta::Filter>) -> Vec<Package> {
         if flags.installed || flags == package::Flags::default() {
             // TODO: Error handling
             let packages = match self.db.query(filter) {
@@ -71,8 +72,29 @@ impl Active {
         self.query(flags, None)
     }
 
-    pub fn query_keyword(&self, keyword: &str, flags: package::Flags) -> Vec<Package> {
-        self.query(flags, Some(db::meta::Filter::Keyword(keyword)))
+    /// Search, restricted to state
+    pub fn search(&self, keyword: &str, flags: package::Flags) -> Vec<SearchResult> {
+        if flags.installed || flags == package::Flags::default() {
+            // TODO: Error handling
+            let results = match self.db.search(keyword) {
+                Ok(results) => results,
+                Err(error) => {
+                    warn!("failed to search installed packages: {error}");
+                    return vec![];
+                }
+            };
+
+            results
+                .into_iter()
+                .filter(|result| {
+                    self.installed_package(result.id.clone())
+                        // Filter for explicit only packages, if applicable
+                        .is_some_and(|(_, package_flags)| !flags.explicit || package_flags.explicit)
+                })
+                .collect()
+        } else {
+            vec![]
+        }
     }
 
     /// Query all packages that match the given provider identity
@@ -6,11 +6,11 @@ use std::io;
 use std::path::PathBuf;
 
 use fs_err::File;
-use stone::{StoneDecodedPayload, StoneReadError};
+use stone::{StoneDecodedPayload, StonePayloadKind, StoneReadError};
 use thiserror::Error;
 
 use crate::Provider;
-use crate::package::{self, Meta, MissingMetaFieldError, Package, meta};
+use crate::package::{self, Meta, MissingMetaFieldError, Package, SearchResult, meta};
 
 // TODO:
 #[derive(Default, Debug, Clone, PartialEq, Eq)]
@@ -25,16 +25,13 @@ impl Cobble {
         let path = path.into();
         let mut file = File::open(&path)?;
         let mut reader = stone::read(&mut file)?;
-        let mut payloads = reader.payloads()?;
 
         // Grab the metapayload
-        let metadata = payloads
-            .find_map(|result| {
-                if let Ok(StoneDecodedPayload::Meta(meta)) = result {
-                    Some(meta)
-                } else {
-                    None
-                }
+        let metadata = reader
+            .payload_by_kind(StonePayloadKind::Meta)?
+            .and_then(|payload| match payload {
+                StoneDecodedPayload::Meta(meta) => Some(meta),
+                _ => None,
             })
             .ok_or(Error::MissingMetaPayload)?;
 
@@ -70,10 +67,13 @@ impl Cobble {
         self.query(flags, |_| true)
     }
 
-    pub fn query_keyword(&self, keyword: &str, flags: package::Flags) -> Vec<Package> {
+    pub fn search(&self, keyword: &str, flags: package::Flags) -> Vec<SearchResult> {
         self.query(flags, |meta| {
             meta.name.contains(keyword) || meta.summary.contains(keyword)
         })
+        .into_iter()
+        .map(Package::into_search_result)
+        .collect()
     }
 
     pub fn query_provider(&self, provider: &Provider, flags: package::Flags) -> Vec<Package> {
@@ -61,14 +61,15 @@ impl Plugin {
         })
     }
 
-    pub fn query_keyword(&self, keyword: &str, flags: package::Flags) -> package::Sorted<Vec<Package>> {
+    /// Returns the packages whose name or summary contain `keyword`
+    pub fn search(&self, keyword: &str, flags: package::Flags) -> package::Sorted<Vec<package::SearchResult>> {
         package::Sorted::new(match self {
-            Plugin::Active(plugin) => plugin.query_keyword(keyword, flags),
-            Plugin::Cobble(plugin) => plugin.query_keyword(keyword, flags),
-            Plugin::Repository(plugin) => plugin.query_keyword(keyword, flags),
+            Plugin::Active(plugin) => plugin.search(keyword, flags),
+            Plugin::Cobble(plugin) => plugin.search(keyword, flags),
+            Plugin::Repository(plugin) => plugin.search(keyword, flags),
 
             #[cfg(any(test, feature = "testing"))]
-            Plugin::Test(plugin) => plugin.query_keyword(keyword, flags),
+            Plugin::Test(plugin) => plugin.search(keyword, flags),
         })
     }
 
@@ -157,7 +158,7 @@ pub mod test {
                 .collect()
         }
 
-        pub fn query_keyword(&self, keyword: &str, _flags: package::Flags) -> Vec<Package> {
+        pub fn search(&self, keyword: &str, _flags: package::Flags) -> Vec<package::SearchResult> {
             let keyword_lower = keyword.to_ascii_lowercase();
             self.packages
                 .iter()
@@ -166,6 +167,7 @@ pub mod test {
                         || pkg.meta.summary.to_ascii_lowercase().contains(&keyword_lower)
                 })
                 .cloned()
+                .map(Package::into_search_result)
                 .collect()
         }
 
@@ -5,7 +5,7 @@ use log::warn;
 
 use crate::{
     Provider, db,
-    package::{self, Package},
+    package::{self, Package, SearchResult},
     repository,
 };
 
@@ -50,7 +50,7 @@ impl Repository {
         }
     }
 
-    fn query(&self, flags: package::Flags, filter: Option<db::meta::Filter<'_>>) -> Vec<Package> {
+    fn query(&self, flags: package::Flags, filter: Option<db::meta::Filter>) -> Vec<Package> {
         if flags.available || flags == package::Flags::default() {
             // TODO: Error handling
             let packages = match self.active.db.query(filter) {
@@ -78,8 +78,16 @@ impl Repository {
         self.query(flags, None)
     }
 
-    pub fn query_keyword(&self, keyword: &str, flags: package::Flags) -> Vec<Package> {
-        self.query(flags, Some(db::meta::Filter::Keyword(keyword)))
+    pub fn search(&self, keyword: &str, flags: package::Flags) -> Vec<SearchResult> {
+        if flags.available || flags == package::Flags::default() {
+            // TODO: Error handling
+            self.active.db.search(keyword).unwrap_or_else(|error| {
+                warn!("failed to search repository packages: {error}");
+                vec![]
+            })
+        } else {
+            vec![]
+        }
     }
 
     /// Query all packages that match the given provider identity
@@ -19,6 +19,22 @@ enum ProviderFilter {
     Available(Provider),
 }
 
+/// Registry lookup made on behalf of a [`ProviderFilter`]
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+enum Source {
+    Installed,
+    Available,
+}
+
+impl Source {
+    fn flags(self) -> package::Flags {
+        match self {
+            Source::Installed => package::Flags::new().with_installed(),
+            Source::Available => package::Flags::new().with_available(),
+        }
+    }
+}
+
 /// Dependency lookup strategy
 #[derive(Clone, Copy, Debug, strum::Display)]
 #[strum(serialize_all = "kebab-case")]
@@ -49,6 +65,11 @@ pub struct Transaction<'a> {
     /// already added to the transaction so we don't have to hit the
     /// registry again
     selection_providers: HashMap<Provider, package::Id>,
+
+    /// Every registry lookup made so far, including those nothing matched.
+    /// The registry can't change while it's borrowed, so each provider is
+    /// only looked up once per source rather than once per dependent.
+    resolved: HashMap<(Provider, Source), Option<package::Id>>,
 }
 
 /// Construct a new Transaction wrapped around the underlying [`Registry`].
@@ -62,6 +83,7 @@ pub fn new(registry: &Registry, lookup: Lookup) -> Result<Transaction<'_>, Error
         packages: Dag::default(),
         lookup,
         selection_providers: HashMap::default(),
+        resolved: HashMap::default(),
     })
 }
 
@@ -151,7 +173,7 @@ impl Transaction<'_> {
     }
 
     // Try all strategies to resolve a provider for installation
-    fn resolve_provider(&self, provider: Provider) -> Result<package::Id, Error> {
+    fn resolve_provider(&mut self, provider: Provider) -> Result<package::Id, Error> {
         match self.lookup {
             Lookup::InstalledOnly => self
                 .resolve_provider_with_filter(ProviderFilter::Selections(provider.clone()))
@@ -171,24 +193,29 @@ impl Transaction<'_> {
     }
 
     /// Attempt to resolve the filterered provider
-    fn resolve_provider_with_filter(&self, filter: ProviderFilter) -> Result<package::Id, Error> {
-        match filter {
-            ProviderFilter::Available(provider) => self
-                .registry
-                .by_provider_id_only(&provider, package::Flags::new().with_available())
-                .next()
-                .ok_or(Error::NoCandidate(provider.to_string())),
-            ProviderFilter::Installed(provider) => self
-                .registry
-                .by_provider_id_only(&provider, package::Flags::new().with_installed())
-                .next()
-                .ok_or(Error::NoCandidate(provider.to_string())),
-            ProviderFilter::Selections(provider) => self
-                .selection_providers
-                .get(&provider)
-                .cloned()
-                .ok_or(Error::NoCandidate(provider.to_string())),
-        }
+    fn resolve_provider_with_filter(&mut self, filter: ProviderFilter) -> Result<package::Id, Error> {
+        let key = match filter {
+            ProviderFilter::Available(provider) => (provider, Source::Available),
+            ProviderFilter::Installed(provider) => (provider, Source::Installed),
+            ProviderFilter::Selections(provider) => {
+                return self
+                    .selection_providers
+                    .get(&provider)
+                    .cloned()
+                    .ok_or(Error::NoCandidate(provider.to_string()));
+            }
+        };
+
+        let resolved = match self.resolved.get(&key) {
+            Some(resolved) => resolved.clone(),
+            None => {
+                let resolved = self.registry.by_provider_id_only(&key.0, key.1.flags()).next();
+                self.resolved.insert(key.clone(), resolved.clone());
+                resolved
+            }
+        };
+
+        resolved.ok_or_else(|| Error::NoCandidate(key.0.to_string()))
     }
 }
 
@@ -10,8 +10,12 @@ use std::time::Duration;
 use astr::AStr;
 use fs_err::{self as fs, File};
 use futures_util::{StreamExt, stream};
-use stone::{StoneDecodedPayload, StonePayloadMetaTag, StoneReadError};
+use stone::{
+    StoneDecodedPayload, StoneHeader, StoneHeaderV1, StoneHeaderV1FileType, StonePayloadLookupKind,
+    StonePayloadMetaTag, StoneReadError,
+};
 use thiserror::Error;
+use tracing::warn;
 use url::Url;
 use xxhash_rust::xxh3::xxh3_64;
 
@@ -24,6 +28,7 @@ use crate::{
     repository::{self, Format, OutdatedRepoIndexUri, Repository, format},
     runtime,
     system_model::LoadedSystemModel,
+    util,
 };
 
 #[derive(Debug)]
@@ -185,8 +190,28 @@ impl Manager {
         };
 
         if repo.repository.active {
-            let file = fetch_index(&self.source, &repo, &self.installation).await?;
-            runtime::unblock(move || update_meta_db(&repo, &file)).await?;
+            let out_dir = cache_dir(self.source.identifier(), &repo.repository, &self.installation);
+            let index_uri = resolve_index_uri(&self.source, &repo, &out_dir).await?;
+
+            // Apply only what changed when the repo publishes a delta
+            // against the index the meta db mirrors. The delta is only an
+            // optimisation, so any failure falls back to the full index.
+            if let Some(delta) = fetch_delta_index(&index_uri, &out_dir).await {
+                let (repo, out_dir) = (repo.clone(), out_dir.clone());
+
+                match runtime::unblock(move || apply_delta_index(&repo, &out_dir, &delta)).await {
+                    Ok(true) => return Ok(()),
+                    Ok(false) => {}
+                    Err(error) => warn!(
+                        repository = %id,
+                        error = format!("{error:#}"),
+                        "Failed to apply delta index, fetching the full index"
+                    ),
+                }
+            }
+
+            let (file, hash) = fetch_index(index_uri, &out_dir).await?;
+            runtime::unblock(move || update_meta_db(&repo, &out_dir, &file, &hash)).await?;
         }
 
         Ok(())
@@ -421,18 +446,10 @@ fn load_cached_index_uri(
     content.parse().map_err(Error::ParseCachedIndexUri).map(Some)
 }
 
-/// Fetches a stone index file from the repository URL
-/// and saves it to the repo installation path
-async fn fetch_index(
-    source: &Arc<Source>,
-    state: &repository::Cached,
-    installation: &Installation,
-) -> Result<PathBuf, Error> {
-    let out_dir = cache_dir(source.identifier(), &state.repository, installation);
-
-    fs_err::tokio::create_dir_all(&out_dir)
-        .await
-        .map_err(Error::CreateDir)?;
+/// Resolves the URI of the repository's stone index file,
+/// ensuring its cache directory exists
+async fn resolve_index_uri(source: &Arc<Source>, state: &repository::Cached, out_dir: &Path) -> Result<Url, Error> {
+    fs_err::tokio::create_dir_all(out_dir).await.map_err(Error::CreateDir)?;
 
     let index_uri = match &state.repository.source {
         repository::Source::DirectIndex(uri) => match identify_legacy_index_uri(uri) {
@@ -461,19 +478,46 @@ async fn fetch_index(
                 uri.clone()
             }
         },
-        repository::Source::RootIndex(source) => resolve_index_from_root(state, &out_dir, source).await?,
+        repository::Source::RootIndex(source) => resolve_index_from_root(state, out_dir, source).await?,
     };
 
+    Ok(index_uri)
+}
+
+/// Fetches a stone index file from the repository URL and saves it
+/// to the repo cache directory, returning its path & sha256 hash
+async fn fetch_index(index_uri: Url, out_dir: &Path) -> Result<(PathBuf, String), Error> {
     let out_path = out_dir.join("stone.index");
 
     // Fetch index & write to `out_path`
-    repository::fetch_index(index_uri, &out_path).await?;
+    let hash = repository::fetch_index(index_uri, &out_path).await?;
 
-    Ok(out_path)
+    Ok((out_path, hash))
+}
+
+/// Fetches the delta index published next to `index_uri`, if the meta db
+/// mirrors a known index it could apply to
+async fn fetch_delta_index(index_uri: &Url, out_dir: &Path) -> Option<PathBuf> {
+    if !out_dir.join("index-hash").exists() {
+        return None;
+    }
+
+    let delta_uri = index_uri.join("stone.delta.index").ok()?;
+    let out_path = out_dir.join("stone.delta.index");
+
+    // Repositories aren't required to publish one
+    repository::fetch_index(delta_uri, &out_path).await.ok()?;
+
+    Some(out_path)
 }
 
 /// Updates a stones metadata into the meta db
-fn update_meta_db(state: &repository::Cached, index_path: &Path) -> Result<(), Error> {
+fn update_meta_db(state: &repository::Cached, out_dir: &Path, index_path: &Path, hash: &str) -> Result<(), Error> {
+    let hash_path = out_dir.join("index-hash");
+
+    // No delta can be applied until the db mirrors this index again
+    util::ignore_notfound(fs::remove_file(&hash_path)).map_err(Error::WriteIndexHash)?;
+
     // Wipe db since we're refreshing from a new index file
     state.db.wipe()?;
 
@@ -483,16 +527,72 @@ fn update_meta_db(state: &repository::Cached, index_path: &Path) -> Result<(), E
 
     let payloads = reader.payloads()?.collect::<Result<Vec<_>, _>>()?;
 
-    // Construct Meta for each payload
-    let packages = payloads
-        .into_iter()
-        .filter_map(|payload| {
-            if let StoneDecodedPayload::Meta(meta) = payload {
-                Some(meta)
-            } else {
-                None
-            }
+    // Batch add to db
+    state.db.batch_add(packages(&payloads)?)?;
+
+    fs::write(&hash_path, hash).map_err(Error::WriteIndexHash)?;
+
+    Ok(())
+}
+
+/// Applies a delta index to the meta db, returning `false` if it
+/// doesn't apply to the index the db currently mirrors
+fn apply_delta_index(state: &repository::Cached, out_dir: &Path, delta_path: &Path) -> Result<bool, Error> {
+    let hash_path = out_dir.join("index-hash");
+    let hash = fs::read_to_string(&hash_path).map_err(Error::ReadIndexHash)?;
+
+    let mut file = File::open(delta_path).map_err(Error::OpenIndex)?;
+    let mut reader = stone::read(&mut file)?;
+
+    if !matches!(
+        reader.header,
+        StoneHeader::V1(StoneHeaderV1 {
+            file_type: StoneHeaderV1FileType::Delta,
+            ..
         })
+    ) {
+        return Ok(false);
+    }
+
+    let payloads = reader.payloads()?.collect::<Result<Vec<_>, _>>()?;
+
+    let Some(lookup) = payloads.iter().find_map(StoneDecodedPayload::lookup) else {
+        return Ok(false);
+    };
+    let records = |kind: StonePayloadLookupKind| lookup.body.iter().filter(move |record| record.kind == kind);
+
+    let (Some(base), Some(target)) = (
+        records(StonePayloadLookupKind::Base).next(),
+        records(StonePayloadLookupKind::Target).next(),
+    ) else {
+        return Ok(false);
+    };
+
+    // Nothing changed since the last refresh
+    if target.key == hash.trim() {
+        return Ok(true);
+    }
+
+    if base.key != hash.trim() {
+        return Ok(false);
+    }
+
+    let removed = records(StonePayloadLookupKind::Removed)
+        .map(|record| package::Id::from(AStr::from(record.key.as_str())))
+        .collect::<Vec<_>>();
+
+    state.db.apply_delta(&removed, packages(&payloads)?)?;
+
+    fs::write(&hash_path, &target.key).map_err(Error::WriteIndexHash)?;
+
+    Ok(true)
+}
+
+/// Construct Meta for each meta payload, keyed by the package hash
+fn packages(payloads: &[StoneDecodedPayload]) -> Result<Vec<(package::Id, package::Meta)>, Error> {
+    payloads
+        .iter()
+        .filter_map(StoneDecodedPayload::meta)
         .map(|payload| {
             let meta = package::Meta::from_stone_payload(&payload.body)?;
 
@@ -505,12 +605,7 @@ fn update_meta_db(state: &repository::Cached, index_path: &Path) -> Result<(), E
 
             Ok((id, meta))
         })
-        .collect::<Result<Vec<_>, Error>>()?;
-
-    // Batch add to db
-    state.db.batch_add(packages)?;
-
-    Ok(())
+        .collect()
 }
 
 async fn resolve_index_from_root(
@@ -575,6 +670,10 @@ pub enum Error {
     ReadCachedIndexUri(#[source] io::Error),
     #[error("write cached index uri")]
     WriteCachedIndexUri(#[source] io::Error),
+    #[error("read cached index hash")]
+    ReadIndexHash(#[source] io::Error),
+    #[error("write cached index hash")]
+    WriteIndexHash(#[source] io::Error),
     #[error("parse cached index uri")]
     ParseCachedIndexUri(#[source] url::ParseError),
     #[error("one or more repositories has an unsupported format")]
@@ -182,9 +182,9 @@ impl Config for Map {
     }
 }
 
-async fn fetch_index(url: Url, out_path: impl Into<PathBuf>) -> Result<(), FetchError> {
-    request::download(url, &out_path.into()).await?;
-    Ok(())
+/// Download an index file, returning its sha256 hash
+async fn fetch_index(url: Url, out_path: impl Into<PathBuf>) -> Result<String, FetchError> {
+    Ok(request::download_with_sha256(url, &out_path.into()).await?)
 }
 
 #[derive(Debug, Error)]
@@ -4,15 +4,16 @@
 use std::{
     io::{self, Read, Seek, Write},
     num::NonZeroUsize,
-    os::unix::fs::symlink,
+    os::{fd::AsFd, unix::fs::symlink},
     path::{Path, PathBuf},
     pin::Pin,
-    thread,
+    ptr, slice, thread,
 };
 
 use fs_err as fs;
 use nix::unistd::{LinkatFlags, linkat};
 use rayon::iter::{IntoParallelRefIterator, ParallelBridge, ParallelIterator};
+use rustix::mm::{MapFlags, ProtFlags, mmap, munmap};
 use sha2::{Digest, Sha256};
 use stone::{StoneDecodedPayload, StoneReadError};
 use tokio::io::AsyncRead;
@@ -352,3 +353,48 @@ impl<T: AsyncRead + Unpin> AsyncRead for Sha256Wrapper<T> {
 pub fn stone_payloads<R: Read + Seek>(reader: &mut R) -> Result<Vec<StoneDecodedPayload>, StoneReadError> {
     stone::read(reader)?.payloads()?.collect::<Result<Vec<_>, _>>()
 }
+
+/// Read-only private mapping of an entire file, unmapped on drop
+pub struct Mapping {
+    ptr: *mut std::ffi::c_void,
+    len: usize,
+}
+
+// The mapping is never written to, so given the contract of `Mapping::new`
+// it can be read from any thread
+unsafe impl Send for Mapping {}
+unsafe impl Sync for Mapping {}
+
+impl Mapping {
+    /// Map in the whole of `fd`
+    ///
+    /// # Safety
+    ///
+    /// The file must not be truncated or modified, by this process or any
+    /// other, until the mapping is dropped. Reading past a new end faults, and
+    /// the contents of `as_slice` would otherwise change under its borrow.
+    /// Files replaced by renaming over them are fine, the mapping keeps the
+    /// old inode.
+    pub unsafe fn new(fd: impl AsFd) -> io::Result<Self> {
+        let len = rustix::fs::fstat(&fd)?.st_size as usize;
+
+        // Zero length mappings are invalid
+        if len == 0 {
+            return Err(io::Error::new(io::ErrorKind::InvalidData, "can't map an empty file"));
+        }
+
+        let ptr = unsafe { mmap(ptr::null_mut(), len, ProtFlags::READ, MapFlags::PRIVATE, fd, 0)? };
+
+        Ok(Self { ptr, len })
+    }
+
+    pub fn as_slice(&self) -> &[u8] {
+        unsafe { slice::from_raw_parts(self.ptr.cast(), self.len) }
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        let _ = unsafe { munmap(self.ptr, self.len) };
+    }
+}